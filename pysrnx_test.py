@@ -0,0 +1,101 @@
+"""pysrnx_test.py - Smoke test for the srnx Python module.
+
+Run "make check-pysrnx", which builds the module with "make pysrnx" and
+then runs this script.  The module needs Python 3.10 or later.
+"""
+
+import os
+import unittest
+
+import srnx
+
+TESTDATA = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                        'testdata')
+SLIP_RNX = os.path.join(TESTDATA, 'slip.rnx')
+SLIP_SRNX = os.path.join(TESTDATA, 'slip.srnx')
+
+# G01's observations in testdata/slip.rnx, times 1000.  The cycle slip
+# record (epoch flag 6) is not an observation.
+L1 = [12345678123, 12345679123]
+L2 = [23456789456, 23456790456]
+
+
+class ReaderTest(unittest.TestCase):
+    def test_obs(self):
+        with srnx.Reader(SLIP_SRNX) as reader:
+            self.assertEqual(reader.satellites(), ['G01'])
+            self.assertEqual(reader.codes('G'), ['L1', 'L2'])
+            times = memoryview(reader.epoch_times())
+            self.assertEqual(times.format, 'q')
+            self.assertEqual(times[1] - times[0], 30 * 10**9)
+            values, lli, ssi = reader.obs('G01', 0)
+        self.assertEqual(len(values), 2)
+        self.assertEqual(memoryview(values).tolist(), L1)
+        self.assertEqual(bytes(lli), b'  ')
+        self.assertEqual(bytes(ssi), b'  ')
+
+    def test_closed(self):
+        reader = srnx.Reader(SLIP_SRNX)
+        reader.close()
+        self.assertRaises(ValueError, reader.obs, 'G01', 0)
+
+
+class BufferTest(unittest.TestCase):
+    def test_view(self):
+        values = srnx.Reader(SLIP_SRNX).obs('G01', 1)[0]
+        view = memoryview(values)
+        self.assertTrue(view.c_contiguous)
+        self.assertEqual((view.ndim, view.shape), (1, (2,)))
+        self.assertEqual((view.itemsize, view.nbytes), (8, 16))
+
+        # Views share the array's memory rather than copying it.
+        view[0] = 5
+        self.assertEqual(memoryview(values)[0], 5)
+
+        # A view keeps the array's memory alive.
+        del values
+        self.assertEqual(view.tolist(), [5, L2[1]])
+        view.release()
+
+    def test_missing_file(self):
+        self.assertRaises(OSError, srnx.Reader,
+                          os.path.join(TESTDATA, 'missing.srnx'))
+
+
+class ReadFilesTest(unittest.TestCase):
+    def test_threads(self):
+        for threads in (1, 3):
+            result = srnx.read_files([SLIP_SRNX] * 4, 'G01', 1,
+                                     threads=threads)
+            self.assertEqual(len(result), 4)
+            for values, lli, ssi in result:
+                self.assertEqual(memoryview(values).tolist(), L2)
+                self.assertEqual(len(lli), 2)
+                self.assertEqual(len(ssi), 2)
+
+    def test_pread(self):
+        result = srnx.read_files([SLIP_SRNX], 'G01', 0, pread=True)
+        self.assertEqual(memoryview(result[0][0]).tolist(), L1)
+
+    def test_empty(self):
+        self.assertEqual(srnx.read_files([], 'G01', 0), [])
+
+
+class RinexParserTest(unittest.TestCase):
+    def test_read(self):
+        with srnx.RinexParser(SLIP_RNX) as parser:
+            self.assertTrue(parser.header.startswith(b'     2.11'))
+            batch = parser.read()
+            self.assertEqual(len(parser.read()['epochs']), 0)
+        epochs = memoryview(batch['epochs'])
+        self.assertEqual(epochs.itemsize, 24)
+        self.assertEqual(len(epochs), 4)
+        self.assertEqual(bytes(batch['satellite']), b'G01\0' * 6)
+        self.assertEqual(memoryview(batch['code']).tolist(),
+                         [0, 1, 0, 1, 0, 1])
+        self.assertEqual(memoryview(batch['value']).tolist()[4:],
+                         [L1[1], L2[1]])
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -110,6 +110,39 @@ enum rinex_error
 
 typedef enum rinex_error rinex_error_t;
 
+/** RINEX_MAX_SVN is one more than the largest satellite number that
+ * a RINEX observation record can name.
+ */
+#define RINEX_MAX_SVN 100
+
+/** rinex_sat_entry locates one satellite's data in an observation
+ * record, so a consumer does not have to walk #rinex_parser.buffer.
+ */
+struct rinex_sat_entry
+{
+    /** system is the satellite system identifier, as in
+     * #rinex_parser.buffer (so it may be ' ' in RINEX 2 files).
+     */
+    char system;
+
+    /** svn is the satellite number. */
+    unsigned char svn;
+
+    /** n_obs is the number of observations present for the satellite. */
+    unsigned short n_obs;
+
+    /** buffer_ofs is the offset of the satellite's system identifier
+     * in #rinex_parser.buffer; its presence bitfield starts two bytes
+     * later.
+     */
+    int buffer_ofs;
+
+    /** obs_ofs is the index of the satellite's first observation in
+     * #rinex_parser.obs, #rinex_parser.lli and #rinex_parser.ssi.
+     */
+    int obs_ofs;
+};
+
 /** rinex_parser is an abstract base type for loading data from files
  * containing RINEX observation-like data.
  */
@@ -162,6 +195,21 @@ struct rinex_parser
      */
     int64_t *obs;
 
+    /** sats has one entry for each satellite in the current record,
+     * in the same order as #buffer, when the record holds observations
+     * or cycle slips.  It has \a epoch.n_sats valid entries.
+     */
+    struct rinex_sat_entry *sats;
+
+    /** sat_slot is NULL unless rinex_enable_sat_lookup() was called.
+     * Then, for a satellite in the current record, \a sat_slot[
+     * (system & 31) * RINEX_MAX_SVN + svn] is its index in #sats,
+     * where a blank system is indexed as 'G'.
+     * Entries for other satellites are stale; rinex_find_sat() checks
+     * for that.
+     */
+    unsigned short *sat_slot;
+
     /** n_obs counts the possible observations per satellite system.
      *
      * For the satellite system with identifier 'A', n_obs['A' & 31]
@@ -169,6 +217,17 @@ struct rinex_parser
      */
     short n_obs[32];
 
+    /** slip_text is the text of a cycle slip record (\a epoch.flag is
+     * '6'), laid out as #buffer would hold it for other special events,
+     * or NULL if the parser does not keep it.  It points into #stream
+     * or the parser's own buffers, so it is only valid until the next
+     * call to #read.
+     */
+    const char *slip_text;
+
+    /** slip_text_len is the number of bytes at #slip_text. */
+    int slip_text_len;
+
     /** stream is the source of data for this file parser. */
     struct rinex_stream *stream;
 
@@ -200,9 +259,11 @@ const char *rinex_open(struct rinex_parser **p_parser, struct rinex_stream *stre
 
 /** Finds the start of the first line with the given header label.
  *
- * \warning Has undefined behavior for the first header.  This should
- *   not be a problem because the first header should be at p->buffer
- *   anyway.
+ * Before the first record is read, this uses an index that
+ * rinex_open() builds, so it takes constant time.
+ *
+ * \warning After a record is read, this searches \a p->buffer and has
+ *   undefined behavior for its first line.
  * \param[in] p RINEX parser with header in \a p->buffer.
  * \param[in] label Header label to search for.
  * \param[in] sizeof_label Size of \a label, including nul terminator.
@@ -216,6 +277,30 @@ const char *rinex_find_header
     unsigned int sizeof_label
 );
 
+/** Makes the parser maintain #rinex_parser.sat_slot, so that
+ * rinex_find_sat() takes constant time.
+ *
+ * \param[in,out] p RINEX parser to update.
+ * \returns Zero on success, else ENOMEM.
+ */
+int rinex_enable_sat_lookup(struct rinex_parser *p);
+
+/** Finds a satellite in the current observation record.
+ *
+ * \param[in] p RINEX parser that has read an observation record.
+ * \param[in] system Satellite system identifier, as in
+ *   rinex_sat_entry.system.  ' ' and 'G' both match GPS satellites,
+ *   whether the record names them with a blank system or with 'G'.
+ * \param[in] svn Satellite number.
+ * \returns The satellite's entry in \a p->sats, or NULL if the record
+ *   does not include the satellite.
+ */
+const struct rinex_sat_entry *rinex_find_sat(
+    const struct rinex_parser *p,
+    char system,
+    int svn
+);
+
 struct rinex_stream *rinex_mmap_stream(const char *filename);
 struct rinex_stream *rinex_stdio_stream(const char *filename);
 struct rinex_stream *rinex_stdin_stream(void);
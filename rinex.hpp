@@ -0,0 +1,288 @@
+/** rinex.hpp - C++17 interface to the RINEX parser.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(RINEX_HPP_e2a4c7f1_5b93_4d06_8c1e_3f7b09d2a6e8)
+#define RINEX_HPP_e2a4c7f1_5b93_4d06_8c1e_3f7b09d2a6e8
+
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include "rinex.h"
+
+/* This is a header-only layer over the pull parser in rinex.h.  The
+ * parser's buffers are exposed directly; nothing is copied per record.
+ */
+
+namespace rinex
+{
+
+/** stream owns a rinex_stream. */
+class stream
+{
+public:
+    stream() noexcept : stream_(nullptr) { }
+
+    /** Takes ownership of \a s, which may be null. */
+    explicit stream(rinex_stream *s) noexcept : stream_(s) { }
+
+    stream(stream &&other) noexcept : stream_(other.release()) { }
+    stream(const stream &) = delete;
+    ~stream() { reset(); }
+
+    stream &operator=(stream &&other) noexcept
+    {
+        std::swap(stream_, other.stream_);
+        return *this;
+    }
+    stream &operator=(const stream &) = delete;
+
+    /** Opens \a filename with mmap(); throws on failure. */
+    static stream mmap(const char *filename)
+    {
+        return checked(rinex_mmap_stream(filename), filename);
+    }
+
+    /** Opens \a filename with stdio; throws on failure. */
+    static stream stdio(const char *filename)
+    {
+        return checked(rinex_stdio_stream(filename), filename);
+    }
+
+    /** Reads standard input; throws on failure. */
+    static stream stdin_stream()
+    {
+        return checked(rinex_stdin_stream(), "stdin");
+    }
+
+    /** Returns the C stream. */
+    rinex_stream *get() const noexcept { return stream_; }
+
+    /** Gives up ownership of the C stream and returns it. */
+    rinex_stream *release() noexcept
+    {
+        rinex_stream *s = stream_;
+        stream_ = nullptr;
+        return s;
+    }
+
+    /** Destroys the C stream, if any. */
+    void reset() noexcept
+    {
+        if (stream_)
+        {
+            stream_->destroy(stream_);
+            stream_ = nullptr;
+        }
+    }
+
+private:
+    static stream checked(rinex_stream *s, const char *what)
+    {
+        if (!s)
+        {
+            throw std::system_error(errno, std::generic_category(), what);
+        }
+        return stream(s);
+    }
+
+    rinex_stream *stream_;
+};
+
+/** error is thrown when the parser rejects its input. */
+class error : public std::runtime_error
+{
+public:
+    /** Creates an error with status \a code from parser line \a line. */
+    error(const char *what, rinex_error_t code, int line)
+        : std::runtime_error(what), code_(code), line_(line)
+    {
+    }
+
+    /** Returns the parser's status code. */
+    rinex_error_t code() const noexcept { return code_; }
+
+    /** Returns the parser source line that reported the error. */
+    int line() const noexcept { return line_; }
+
+private:
+    rinex_error_t code_;
+    int line_;
+};
+
+/** parser owns a rinex_parser and the stream it reads. */
+class parser
+{
+public:
+    /** Input iterator over records; each step calls parser::read(). */
+    class iterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = rinex_parser;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const rinex_parser *;
+        using reference = const rinex_parser &;
+
+        iterator() noexcept : parser_(nullptr) { }
+        explicit iterator(parser *p) : parser_(p) { next(); }
+
+        const rinex_parser &operator*() const noexcept { return *parser_->get(); }
+        const rinex_parser *operator->() const noexcept { return parser_->get(); }
+        iterator &operator++() { next(); return *this; }
+        bool operator==(const iterator &other) const noexcept
+        {
+            return parser_ == other.parser_;
+        }
+        bool operator!=(const iterator &other) const noexcept
+        {
+            return parser_ != other.parser_;
+        }
+
+    private:
+        void next()
+        {
+            if (!parser_->read())
+            {
+                parser_ = nullptr;
+            }
+        }
+
+        parser *parser_;
+    };
+
+    /** Range adapter returned by records(). */
+    struct range
+    {
+        parser *p;
+        iterator begin() const { return iterator(p); }
+        iterator end() const noexcept { return iterator(); }
+    };
+
+    parser() noexcept : parser_(nullptr) { }
+
+    /** Reads the header from \a s; throws on failure. */
+    explicit parser(stream s) : parser_(nullptr)
+    {
+        open(std::move(s));
+    }
+
+    /** Opens \a filename with mmap() and reads its header. */
+    explicit parser(const char *filename) : parser(stream::mmap(filename))
+    {
+    }
+
+    parser(parser &&other) noexcept
+        : stream_(std::move(other.stream_)), parser_(other.parser_)
+    {
+        other.parser_ = nullptr;
+    }
+    parser(const parser &) = delete;
+    ~parser() { close(); }
+
+    parser &operator=(parser &&other) noexcept
+    {
+        std::swap(stream_, other.stream_);
+        std::swap(parser_, other.parser_);
+        return *this;
+    }
+    parser &operator=(const parser &) = delete;
+
+    /** Reads the header from \a s, replacing any current input. */
+    void open(stream s)
+    {
+        const char *err;
+
+        close();
+        stream_ = std::move(s);
+        err = rinex_open(&parser_, stream_.get());
+        if (err)
+        {
+            throw error(err, RINEX_ERR_BAD_FORMAT, 0);
+        }
+    }
+
+    /** Releases the parser and its stream. */
+    void close() noexcept
+    {
+        if (parser_)
+        {
+            parser_->destroy(parser_);
+            parser_ = nullptr;
+        }
+        stream_.reset();
+    }
+
+    /** Returns the C parser. */
+    rinex_parser *get() const noexcept { return parser_; }
+
+    /** Returns the file header; valid until the first read(). */
+    std::string_view header() const noexcept
+    {
+        return std::string_view(parser_->buffer, parser_->buffer_len);
+    }
+
+    /** Finds the first header line with \a label; see rinex_find_header(). */
+    template <unsigned int N>
+    const char *find_header(const char (&label)[N]) const noexcept
+    {
+        return rinex_find_header(parser_, label, N);
+    }
+
+    /** Reads the next record.
+     *
+     * \returns True if a record was read, false at end of file.
+     * \throws error If the file is malformed or cannot be read.
+     */
+    bool read()
+    {
+        rinex_error_t res = parser_->read(parser_);
+        if (res == RINEX_SUCCESS)
+        {
+            return true;
+        }
+        if (res == RINEX_EOF)
+        {
+            return false;
+        }
+        throw error(res == RINEX_ERR_SYSTEM ? std::strerror(errno)
+            : "Invalid RINEX record", res, parser_->error_line);
+    }
+
+    /** Returns a single-pass range over the remaining records. */
+    range records() noexcept { return range{this}; }
+
+private:
+    stream stream_;
+    rinex_parser *parser_;
+};
+
+} /* namespace rinex */
+
+#endif /* !defined(RINEX_HPP_e2a4c7f1_5b93_4d06_8c1e_3f7b09d2a6e8) */
@@ -476,9 +476,17 @@ static int64_t read_file(struct rinex_parser *p, const char filename[])
         memcpy(&data.epoch[idx], &p->epoch, sizeof data.epoch[idx]);
         ++data.n_epoch;
 
-        /* Save the observations that are present. */
+        /* Save the observations that are present.  Parsers that do
+         * not fill p->sats leave the satellites packed in p->buffer.
+         */
         for (ii = jj = 0, buffer = p->buffer; ii < p->epoch.n_sats; ++ii)
         {
+            if (p->sats)
+            {
+                buffer = p->buffer + p->sats[ii].buffer_ofs;
+                jj = p->sats[ii].obs_ofs;
+            }
+
             /* Make sure the satellite system can hold this SVN. */
             sys_id = *buffer++ & 31;
             svn = *buffer++;
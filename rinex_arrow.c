@@ -0,0 +1,928 @@
+/** rinex_arrow.c - Apache Arrow C Data Interface export.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "rinex_arrow.h"
+#include "rinex_p.h" /* rnx_find_header() */
+#include "srnx_p.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** arrow_schema_private is the private data for exported schemas. */
+struct arrow_schema_private
+{
+    /** Copy of the field name. */
+    char *name;
+
+    /** Encoded field metadata, or NULL. */
+    char *metadata;
+
+    /** Child schemas, if any. */
+    struct ArrowSchema *child;
+};
+
+/** arrow_array_private is the private data for exported arrays. */
+struct arrow_array_private
+{
+    /** Buffers, allocated by srnx_reserve(). */
+    const void *buffer[3];
+
+    /** Child arrays, if any. */
+    struct ArrowArray *child;
+};
+
+/** rinex_arrow_builder accumulates rows of parsed RINEX records.  Each
+ * buffer has room for #rows_alloc rows.
+ */
+struct rinex_arrow_builder
+{
+    /** Non-zero to export observation values as doubles. */
+    int as_double;
+
+    /** Time system of the epoch times, from the file header. */
+    char time_system[4];
+
+    /** Number of observation columns. */
+    int n_cols;
+
+    /** Number of rows appended. */
+    int64_t n_rows;
+
+    /** Number of rows allocated; a multiple of 64. */
+    int64_t rows_alloc;
+
+    /** Epoch time of each row. */
+    int64_t *time;
+
+    /** Epoch flag of each row. */
+    uint8_t *flag;
+
+    /** Three-character satellite name of each row. */
+    char *sv;
+
+    /** Observation values, one array per column. */
+    int64_t **obs;
+
+    /** Loss-of-lock indicators, one array per column. */
+    uint8_t **lli;
+
+    /** Signal strength indicators, one array per column. */
+    uint8_t **ssi;
+
+    /** Presence bitmaps, one per column. */
+    uint64_t **valid;
+};
+
+/** Releases an exported schema and its children. */
+static void arrow_release_schema(struct ArrowSchema *schema)
+{
+    struct arrow_schema_private *priv = schema->private_data;
+    int64_t ii;
+
+    for (ii = 0; ii < schema->n_children; ++ii)
+    {
+        if (schema->children[ii]->release)
+        {
+            schema->children[ii]->release(schema->children[ii]);
+        }
+    }
+    free(schema->children);
+    free(priv->child);
+    free(priv->metadata);
+    free(priv->name);
+    free(priv);
+    schema->release = NULL;
+}
+
+/** Releases an exported array, its buffers and its children. */
+static void arrow_release_array(struct ArrowArray *array)
+{
+    struct arrow_array_private *priv = array->private_data;
+    int64_t ii;
+
+    for (ii = 0; ii < array->n_children; ++ii)
+    {
+        if (array->children[ii]->release)
+        {
+            array->children[ii]->release(array->children[ii]);
+        }
+    }
+    for (ii = 0; ii < 3; ++ii)
+    {
+        srnx_free((void *)priv->buffer[ii]);
+    }
+    free(array->children);
+    free(priv->child);
+    free(priv);
+    array->release = NULL;
+}
+
+/** Initializes an exported schema and array with empty buffers and
+ * \a n_children uninitialized children.
+ *
+ * \param[out] schema Schema to initialize.
+ * \param[out] array Array to initialize.
+ * \param[in] format Arrow format string, which must be a literal.
+ * \param[in] name Field name.
+ * \param[in] length Number of elements in the array.
+ * \param[in] n_buffers Number of buffers for the array's type.
+ * \param[in] n_children Number of children.
+ * \returns Zero on success, else ENOMEM.  On failure, neither
+ *   \a schema nor \a array needs to be released.
+ */
+static int arrow_init(
+    struct ArrowSchema *schema,
+    struct ArrowArray *array,
+    const char *format,
+    const char *name,
+    int64_t length,
+    int n_buffers,
+    int n_children
+)
+{
+    struct arrow_schema_private *s_priv;
+    struct arrow_array_private *a_priv;
+    int ii;
+
+    memset(schema, 0, sizeof *schema);
+    memset(array, 0, sizeof *array);
+    s_priv = calloc(1, sizeof *s_priv);
+    a_priv = calloc(1, sizeof *a_priv);
+    if (!s_priv || !a_priv || !(s_priv->name = strdup(name)))
+    {
+        goto fail;
+    }
+
+    if (n_children > 0)
+    {
+        s_priv->child = calloc(n_children, sizeof(*s_priv->child));
+        a_priv->child = calloc(n_children, sizeof(*a_priv->child));
+        schema->children = malloc(n_children * sizeof(*schema->children));
+        array->children = malloc(n_children * sizeof(*array->children));
+        if (!s_priv->child || !a_priv->child || !schema->children
+            || !array->children)
+        {
+            goto fail;
+        }
+        for (ii = 0; ii < n_children; ++ii)
+        {
+            schema->children[ii] = s_priv->child + ii;
+            array->children[ii] = a_priv->child + ii;
+        }
+    }
+
+    schema->format = format;
+    schema->name = s_priv->name;
+    schema->n_children = n_children;
+    schema->release = arrow_release_schema;
+    schema->private_data = s_priv;
+
+    array->length = length;
+    array->n_buffers = n_buffers;
+    array->n_children = n_children;
+    array->buffers = a_priv->buffer;
+    array->release = arrow_release_array;
+    array->private_data = a_priv;
+    return 0;
+
+fail:
+    free(schema->children);
+    free(array->children);
+    if (s_priv)
+    {
+        free(s_priv->child);
+        free(s_priv->name);
+    }
+    if (a_priv)
+    {
+        free(a_priv->child);
+    }
+    free(s_priv);
+    free(a_priv);
+    memset(schema, 0, sizeof *schema);
+    memset(array, 0, sizeof *array);
+    return ENOMEM;
+}
+
+/** Initializes an exported leaf column, taking ownership of its
+ * buffers even if it fails.
+ *
+ * \param[out] schema Schema to initialize.
+ * \param[out] array Array to initialize.
+ * \param[in] format Arrow format string, which must be a literal.
+ * \param[in] name Field name.
+ * \param[in] length Number of elements in the column.
+ * \param[in] validity Validity bitmap, or NULL if all are valid.
+ * \param[in] values Values (or offsets, for strings).
+ * \param[in] data String data, or NULL for fixed-width types.
+ * \returns Zero on success, else ENOMEM.
+ */
+static int arrow_leaf(
+    struct ArrowSchema *schema,
+    struct ArrowArray *array,
+    const char *format,
+    const char *name,
+    int64_t length,
+    uint64_t *validity,
+    void *values,
+    void *data
+)
+{
+    struct arrow_array_private *priv;
+    int64_t ii, n_valid;
+    int res;
+
+    res = arrow_init(schema, array, format, name, length, data ? 3 : 2, 0);
+    if (res)
+    {
+        srnx_free(validity);
+        srnx_free(values);
+        srnx_free(data);
+        return res;
+    }
+
+    priv = array->private_data;
+    priv->buffer[0] = validity;
+    priv->buffer[1] = values;
+    priv->buffer[2] = data;
+    if (validity)
+    {
+        schema->flags = ARROW_FLAG_NULLABLE;
+        for (ii = n_valid = 0; ii < (length >> 6); ++ii)
+        {
+            n_valid += __builtin_popcountll(validity[ii]);
+        }
+        if (length & 63)
+        {
+            n_valid += __builtin_popcountll(validity[ii]
+                & (~0ULL >> (64 - (length & 63))));
+        }
+        array->null_count = length - n_valid;
+    }
+
+    return 0;
+}
+
+/** Exports a column of epoch times.
+ *
+ * Arrow timestamps count from the Unix epoch in UTC, but the times are
+ * counted from the GPS epoch in the file's time system, which does not
+ * have leap seconds.  So the column is plain int64, and its metadata
+ * says what the numbers mean.
+ *
+ * \param[out] schema Schema to initialize.
+ * \param[out] array Array to initialize.
+ * \param[in] length Number of elements in the column.
+ * \param[in] times Epoch times, as in srnx_epoch_span.
+ * \param[in] time_system Three-letter RINEX time system identifier.
+ * \returns Zero on success, else ENOMEM.
+ */
+static int arrow_time_column(
+    struct ArrowSchema *schema,
+    struct ArrowArray *array,
+    int64_t length,
+    int64_t *times,
+    const char *time_system
+)
+{
+    const char *const kv[] = {
+        "epoch", "1980-01-06T00:00:00",
+        "unit", "ns",
+        "time_system", time_system
+    };
+    struct arrow_schema_private *priv;
+    char *metadata, *wptr;
+    int32_t i32;
+    size_t size;
+    int ii, res;
+
+    res = arrow_leaf(schema, array, "l", "time", length, NULL, times, NULL);
+    if (res)
+    {
+        return res;
+    }
+
+    /* The C Data Interface encodes metadata as an int32 count of pairs,
+     * then an int32 length and the bytes of each key and value.
+     */
+    size = sizeof i32;
+    for (ii = 0; ii < (int)(sizeof kv / sizeof kv[0]); ++ii)
+    {
+        size += sizeof i32 + strlen(kv[ii]);
+    }
+    metadata = malloc(size);
+    if (!metadata)
+    {
+        schema->release(schema);
+        array->release(array);
+        return ENOMEM;
+    }
+    i32 = sizeof kv / sizeof kv[0] / 2;
+    memcpy(metadata, &i32, sizeof i32);
+    wptr = metadata + sizeof i32;
+    for (ii = 0; ii < (int)(sizeof kv / sizeof kv[0]); ++ii)
+    {
+        i32 = strlen(kv[ii]);
+        memcpy(wptr, &i32, sizeof i32);
+        memcpy(wptr + sizeof i32, kv[ii], i32);
+        wptr += sizeof i32 + i32;
+    }
+
+    priv = schema->private_data;
+    priv->metadata = metadata;
+    schema->metadata = metadata;
+    return 0;
+}
+
+/** Finds the time system of a RINEX observation file.
+ *
+ * This is the system named in TIME OF FIRST OBS if there is one, else
+ * the time system of the file's satellite system, which RINEX makes
+ * the default for single-system files.  Mixed files without an
+ * explicit time system are taken to use GPS time.
+ *
+ * \param[in] hdr RINEX header text.
+ * \param[in] hdr_len Length of \a hdr.
+ * \param[out] time_system Receives the three-letter time system.
+ */
+static void find_time_system(
+    const char *hdr,
+    size_t hdr_len,
+    char time_system[4]
+)
+{
+    static const char time_of_first_obs[] = "TIME OF FIRST OBS";
+    static const char sys[] = "GGPSRGLOEGALCBDTJQZSIIRN";
+    int ofs, ii;
+
+    ofs = rnx_find_header(hdr, hdr_len, time_of_first_obs,
+        sizeof time_of_first_obs);
+    if (ofs >= 0 && hdr[ofs + 48] != ' ')
+    {
+        memcpy(time_system, hdr + ofs + 48, 3);
+        time_system[3] = '\0';
+        return;
+    }
+
+    strcpy(time_system, "GPS");
+    for (ii = 0; hdr_len > 40 && sys[ii]; ii += 4)
+    {
+        if (hdr[40] == sys[ii])
+        {
+            memcpy(time_system, sys + ii + 1, 3);
+        }
+    }
+}
+
+/** Returns a copy of the first \a n_bits bits of \a bitmap, or NULL if
+ * memory could not be allocated.
+ */
+static uint64_t *copy_bitmap(const uint64_t *bitmap, int64_t n_bits)
+{
+    uint64_t *copy;
+    size_t size;
+
+    size = ((n_bits + 63) >> 6) * sizeof(uint64_t);
+    copy = srnx_reserve(NULL, size);
+    if (copy)
+    {
+        memcpy(copy, bitmap, size);
+    }
+    return copy;
+}
+
+/** Converts RINEX indicator characters to numbers in place: ' ' to 0,
+ * '0' through '9' to 0 through 9, and anything else unchanged.
+ */
+static void indicators_to_uint8(char *ind, uint64_t count)
+{
+    uint64_t ii;
+    char c;
+
+    for (ii = 0; ii < count; ++ii)
+    {
+        c = ind[ii];
+        ind[ii] = (c == ' ') ? 0 : (c >= '0' && c <= '9') ? c - '0' : c;
+    }
+}
+
+/** Moves \a n_present elements of \a width bytes at the start of
+ * \a data to the positions of the set bits in \a present, zeroing the
+ * other positions below \a n_epochs.  Works backwards, so no element
+ * is overwritten before it moves.
+ */
+static void spread_present(
+    char *data,
+    size_t width,
+    const uint64_t *present,
+    uint64_t n_epochs,
+    uint64_t n_present
+)
+{
+    uint64_t ee;
+
+    for (ee = n_epochs; ee-- > 0; )
+    {
+        if ((present[ee >> 6] >> (ee & 63)) & 1)
+        {
+            memmove(data + ee * width, data + --n_present * width, width);
+        }
+        else
+        {
+            memset(data + ee * width, 0, width);
+        }
+    }
+}
+
+/* Doc comment in rinex_arrow.h. */
+int srnx_export_arrow(
+    struct srnx_reader *srnx,
+    struct srnx_satellite_name name,
+    int idx_len,
+    const int idx[],
+    int as_double,
+    struct ArrowSchema *schema,
+    struct ArrowArray *array
+)
+{
+    struct srnx_epoch_index *index;
+    const struct srnx_obs_code *code;
+    const char *rhdr;
+    size_t rhdr_len;
+    uint64_t *present, *valid[3], n_present = 0, n_epochs;
+    int64_t *times, *obs;
+    char *lli, *ssi, col_name[16], time_system[4];
+    int ii, jj, res, n_values, codes_len;
+
+    index = NULL;
+    present = NULL;
+    times = NULL;
+    schema->release = NULL;
+
+    /* Get the epoch times. */
+    res = srnx_get_epoch_index(srnx, &index);
+    if (res)
+    {
+        goto out;
+    }
+    n_epochs = srnx_epoch_index_count(index);
+    times = srnx_reserve(NULL, n_epochs * sizeof(*times));
+    if (!times)
+    {
+        res = ENOMEM;
+        goto out;
+    }
+    res = srnx_epoch_index_times(index, 0, n_epochs, times);
+    if (res)
+    {
+        goto out;
+    }
+
+    /* When was the satellite observed? */
+    res = srnx_get_sat_presence(srnx, name, n_epochs, &present, &n_present);
+    if (res)
+    {
+        goto out;
+    }
+    res = srnx_get_obs_codes(srnx, name.name[0], &code, &codes_len);
+    if (res)
+    {
+        goto out;
+    }
+    res = srnx_get_header(srnx, &rhdr, &rhdr_len);
+    if (res)
+    {
+        goto out;
+    }
+    find_time_system(rhdr, rhdr_len, time_system);
+
+    /* Create the batch and its time column. */
+    res = arrow_init(schema, array, "+s", "", n_epochs, 1, 1 + 3 * idx_len);
+    if (res)
+    {
+        goto out;
+    }
+    res = arrow_time_column(schema->children[0], array->children[0],
+        n_epochs, times, time_system);
+    times = NULL;
+    if (res)
+    {
+        goto fail;
+    }
+
+    for (ii = 0; ii < idx_len; ++ii)
+    {
+        if (idx[ii] < 0 || idx[ii] >= codes_len)
+        {
+            res = SRNX_UNKNOWN_CODE;
+            goto fail;
+        }
+
+        /* Decode the signal. */
+        obs = NULL;
+        lli = ssi = NULL;
+        res = srnx_get_obs_by_index(srnx, name, 1, (int *)idx + ii,
+            &n_values, &obs, &lli, &ssi);
+        if (!res && (uint64_t)n_values != n_present)
+        {
+            /* Each present epoch should have a value. */
+            res = SRNX_CORRUPT;
+        }
+        if (!res)
+        {
+            indicators_to_uint8(lli, n_present);
+            indicators_to_uint8(ssi, n_present);
+            if (as_double)
+            {
+                srnx_convert_s64_to_double(obs, n_present, 1);
+            }
+        }
+
+        /* Give the values a row for every epoch. */
+        if (!res && n_present < n_epochs)
+        {
+            void *p_obs = srnx_reserve(obs, n_epochs * sizeof(*obs));
+            void *p_lli = p_obs ? srnx_reserve(lli, n_epochs) : NULL;
+            void *p_ssi = p_lli ? srnx_reserve(ssi, n_epochs) : NULL;
+
+            obs = p_obs ? p_obs : obs;
+            lli = p_lli ? p_lli : lli;
+            ssi = p_ssi ? p_ssi : ssi;
+            if (!p_ssi)
+            {
+                res = ENOMEM;
+            }
+            else
+            {
+                spread_present((char *)obs, sizeof(*obs), present, n_epochs,
+                    n_present);
+                spread_present(lli, 1, present, n_epochs, n_present);
+                spread_present(ssi, 1, present, n_epochs, n_present);
+            }
+        }
+
+        for (jj = 0; jj < 3; ++jj)
+        {
+            valid[jj] = res ? NULL : copy_bitmap(present, n_epochs);
+            if (!res && !valid[jj])
+            {
+                res = ENOMEM;
+            }
+        }
+        if (res)
+        {
+            for (jj = 0; jj < 3; ++jj)
+            {
+                srnx_free(valid[jj]);
+            }
+            srnx_free(obs);
+            srnx_free(lli);
+            srnx_free(ssi);
+            goto fail;
+        }
+
+        /* Export the three columns. */
+        jj = 1 + 3 * ii;
+        snprintf(col_name, sizeof col_name, "%.3s", code[idx[ii]].name);
+        res = arrow_leaf(schema->children[jj], array->children[jj],
+            as_double ? "g" : "l", col_name, n_epochs, valid[0], obs, NULL);
+        snprintf(col_name, sizeof col_name, "%.3s_lli", code[idx[ii]].name);
+        res |= arrow_leaf(schema->children[jj + 1], array->children[jj + 1],
+            "C", col_name, n_epochs, valid[1], lli, NULL);
+        snprintf(col_name, sizeof col_name, "%.3s_ssi", code[idx[ii]].name);
+        res |= arrow_leaf(schema->children[jj + 2], array->children[jj + 2],
+            "C", col_name, n_epochs, valid[2], ssi, NULL);
+        if (res)
+        {
+            res = ENOMEM;
+            goto fail;
+        }
+    }
+    goto out;
+
+fail:
+    schema->release(schema);
+    array->release(array);
+out:
+    srnx_free_epoch_index(index);
+    srnx_free(present);
+    srnx_free(times);
+    return res;
+}
+
+/** Frees the buffers held by \a builder and empties it. */
+static void builder_reset(struct rinex_arrow_builder *builder)
+{
+    int ii;
+
+    srnx_free(builder->time);
+    srnx_free(builder->flag);
+    srnx_free(builder->sv);
+    builder->time = NULL;
+    builder->flag = NULL;
+    builder->sv = NULL;
+    for (ii = 0; ii < builder->n_cols; ++ii)
+    {
+        srnx_free(builder->obs[ii]);
+        srnx_free(builder->lli[ii]);
+        srnx_free(builder->ssi[ii]);
+        srnx_free(builder->valid[ii]);
+        builder->obs[ii] = NULL;
+        builder->lli[ii] = NULL;
+        builder->ssi[ii] = NULL;
+        builder->valid[ii] = NULL;
+    }
+    builder->n_rows = 0;
+    builder->rows_alloc = 0;
+}
+
+/** Grows a buffer pointed to by \a *p_ptr to hold \a size bytes.
+ * \returns Zero on success, else ENOMEM.
+ */
+static int builder_reserve(void *p_ptr, size_t size)
+{
+    void *ptr;
+
+    ptr = srnx_reserve(*(void **)p_ptr, size);
+    if (!ptr)
+    {
+        return ENOMEM;
+    }
+    *(void **)p_ptr = ptr;
+    return 0;
+}
+
+/** Doubles the number of rows \a builder can hold. */
+static int builder_grow(struct rinex_arrow_builder *builder)
+{
+    int64_t n;
+    int ii;
+
+    n = builder->rows_alloc ? 2 * builder->rows_alloc : 1024;
+    if (builder_reserve(&builder->time, n * sizeof(int64_t))
+        || builder_reserve(&builder->flag, n)
+        || builder_reserve(&builder->sv, 3 * n))
+    {
+        return ENOMEM;
+    }
+    for (ii = 0; ii < builder->n_cols; ++ii)
+    {
+        if (builder_reserve(&builder->obs[ii], n * sizeof(int64_t))
+            || builder_reserve(&builder->lli[ii], n)
+            || builder_reserve(&builder->ssi[ii], n)
+            || builder_reserve(&builder->valid[ii], (n >> 6) * sizeof(uint64_t)))
+        {
+            return ENOMEM;
+        }
+    }
+
+    /* Appending only sets presence bits, so clear the new words. */
+    for (ii = 0; ii < builder->n_cols; ++ii)
+    {
+        memset(builder->valid[ii] + (builder->rows_alloc >> 6), 0,
+            ((n - builder->rows_alloc) >> 6) * sizeof(uint64_t));
+    }
+    builder->rows_alloc = n;
+
+    return 0;
+}
+
+/* Doc comment in rinex_arrow.h. */
+int rinex_arrow_builder_create(
+    struct rinex_arrow_builder **p_builder,
+    const struct rinex_parser *p,
+    int as_double
+)
+{
+    struct rinex_arrow_builder *builder;
+    int ii, n_cols;
+
+    for (ii = n_cols = 0; ii < 32; ++ii)
+    {
+        if (n_cols < p->n_obs[ii])
+        {
+            n_cols = p->n_obs[ii];
+        }
+    }
+
+    builder = calloc(1, sizeof *builder);
+    if (!builder)
+    {
+        return ENOMEM;
+    }
+    builder->as_double = as_double;
+    builder->n_cols = n_cols;
+    find_time_system(p->buffer, p->buffer_len, builder->time_system);
+    builder->obs = calloc(n_cols + 1, sizeof(*builder->obs));
+    builder->lli = calloc(n_cols + 1, sizeof(*builder->lli));
+    builder->ssi = calloc(n_cols + 1, sizeof(*builder->ssi));
+    builder->valid = calloc(n_cols + 1, sizeof(*builder->valid));
+    if (!builder->obs || !builder->lli || !builder->ssi || !builder->valid)
+    {
+        rinex_arrow_builder_destroy(builder);
+        return ENOMEM;
+    }
+
+    *p_builder = builder;
+    return 0;
+}
+
+/* Doc comment in rinex_arrow.h. */
+int rinex_arrow_builder_append(
+    struct rinex_arrow_builder *builder,
+    const struct rinex_parser *p
+)
+{
+    const unsigned char *sv;
+    int64_t time, row;
+    int ii, kk, nn, n_obs;
+
+    if (p->epoch.flag >= '2' && p->epoch.flag <= '5')
+    {
+        return 0;
+    }
+
+    time = srnx_epoch_to_gps_ns(&p->epoch);
+    sv = (const unsigned char *)p->buffer;
+    for (ii = nn = 0; ii < p->epoch.n_sats; ++ii)
+    {
+        if (builder->n_rows == builder->rows_alloc && builder_grow(builder))
+        {
+            return ENOMEM;
+        }
+
+        row = builder->n_rows++;
+        builder->time[row] = time;
+        builder->flag[row] = p->epoch.flag;
+        builder->sv[3 * row] = sv[0];
+        builder->sv[3 * row + 1] = '0' + sv[1] / 10 % 10;
+        builder->sv[3 * row + 2] = '0' + sv[1] % 10;
+
+        n_obs = p->n_obs[sv[0] & 31];
+        for (kk = 0; kk < builder->n_cols; ++kk)
+        {
+            if (kk < n_obs && ((sv[2 + kk / 8] >> (kk % 8)) & 1))
+            {
+                builder->obs[kk][row] = p->obs[nn];
+                builder->lli[kk][row] = p->lli[nn];
+                builder->ssi[kk][row] = p->ssi[nn];
+                builder->valid[kk][row >> 6] |= 1ULL << (row & 63);
+                ++nn;
+            }
+            else
+            {
+                builder->obs[kk][row] = 0;
+                builder->lli[kk][row] = ' ';
+                builder->ssi[kk][row] = ' ';
+            }
+        }
+
+        sv += 2 + (n_obs + 7) / 8;
+    }
+
+    return 0;
+}
+
+/* Doc comment in rinex_arrow.h. */
+int64_t rinex_arrow_builder_rows(
+    const struct rinex_arrow_builder *builder
+)
+{
+    return builder->n_rows;
+}
+
+/* Doc comment in rinex_arrow.h. */
+int rinex_arrow_builder_finish(
+    struct rinex_arrow_builder *builder,
+    struct ArrowSchema *schema,
+    struct ArrowArray *array
+)
+{
+    uint64_t *valid[2];
+    int32_t *offsets;
+    int64_t n, ii;
+    char name[16];
+    int kk, jj, res;
+
+    n = builder->n_rows;
+    res = arrow_init(schema, array, "+s", "", n, 1, 3 + 3 * builder->n_cols);
+    if (res)
+    {
+        builder_reset(builder);
+        return res;
+    }
+
+    /* Epoch-level columns. */
+    res = arrow_time_column(schema->children[0], array->children[0], n,
+        builder->time, builder->time_system);
+    res |= arrow_leaf(schema->children[1], array->children[1], "C", "flag",
+        n, NULL, builder->flag, NULL);
+    builder->time = NULL;
+    builder->flag = NULL;
+    offsets = srnx_reserve(NULL, (n + 1) * sizeof(*offsets));
+    if (offsets)
+    {
+        for (ii = 0; ii <= n; ++ii)
+        {
+            offsets[ii] = 3 * ii;
+        }
+        res |= arrow_leaf(schema->children[2], array->children[2], "u", "sv",
+            n, NULL, offsets, builder->sv);
+    }
+    else
+    {
+        res = ENOMEM;
+        srnx_free(builder->sv);
+    }
+    builder->sv = NULL;
+
+    /* Observation columns. */
+    for (kk = 0; kk < builder->n_cols && !res; ++kk)
+    {
+        indicators_to_uint8((char *)builder->lli[kk], n);
+        indicators_to_uint8((char *)builder->ssi[kk], n);
+        if (builder->as_double)
+        {
+            srnx_convert_s64_to_double(builder->obs[kk], n, 1);
+        }
+        valid[0] = n ? copy_bitmap(builder->valid[kk], n) : NULL;
+        valid[1] = n ? copy_bitmap(builder->valid[kk], n) : NULL;
+        if (n && (!valid[0] || !valid[1]))
+        {
+            srnx_free(valid[0]);
+            srnx_free(valid[1]);
+            res = ENOMEM;
+            break;
+        }
+
+        jj = 3 + 3 * kk;
+        snprintf(name, sizeof name, "obs%d", kk);
+        res |= arrow_leaf(schema->children[jj], array->children[jj],
+            builder->as_double ? "g" : "l", name, n, builder->valid[kk],
+            builder->obs[kk], NULL);
+        snprintf(name, sizeof name, "lli%d", kk);
+        res |= arrow_leaf(schema->children[jj + 1], array->children[jj + 1],
+            "C", name, n, valid[0], builder->lli[kk], NULL);
+        snprintf(name, sizeof name, "ssi%d", kk);
+        res |= arrow_leaf(schema->children[jj + 2], array->children[jj + 2],
+            "C", name, n, valid[1], builder->ssi[kk], NULL);
+        builder->obs[kk] = NULL;
+        builder->lli[kk] = NULL;
+        builder->ssi[kk] = NULL;
+        builder->valid[kk] = NULL;
+    }
+
+    builder_reset(builder);
+    if (res)
+    {
+        schema->release(schema);
+        array->release(array);
+        return ENOMEM;
+    }
+
+    return 0;
+}
+
+/* Doc comment in rinex_arrow.h. */
+void rinex_arrow_builder_destroy(
+    struct rinex_arrow_builder *builder
+)
+{
+    if (!builder)
+    {
+        return;
+    }
+
+    if (builder->obs && builder->lli && builder->ssi && builder->valid)
+    {
+        builder_reset(builder);
+    }
+    free(builder->obs);
+    free(builder->lli);
+    free(builder->ssi);
+    free(builder->valid);
+    free(builder);
+}
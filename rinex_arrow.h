@@ -0,0 +1,187 @@
+/** rinex_arrow.h - Apache Arrow C Data Interface export.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(RINEX_ARROW_H_8f4d2b61_0c7e_4a39_b5d8_c93e1f6a2047)
+#define RINEX_ARROW_H_8f4d2b61_0c7e_4a39_b5d8_c93e1f6a2047
+
+#include "rinex.h"
+#include "srnx.h"
+
+/* These functions export data as Arrow record batches: an ArrowArray
+ * of struct type whose children are the columns.  The consumer takes
+ * ownership of the exported buffers and frees them by calling the
+ * release callbacks, as the C Data Interface requires; nothing is
+ * copied after export.
+ *
+ * Epoch times are plain int64 values ("l") holding nanoseconds since
+ * 1980-01-06 00:00:00 in the file's time system, as srnx_epoch_span
+ * describes.  They are not Arrow timestamps, which count UTC from the
+ * Unix epoch; converting would need a leap-second table.  The time
+ * column's metadata has "epoch" set to "1980-01-06T00:00:00", "unit"
+ * set to "ns", and "time_system" set to the RINEX time system, such as
+ * "GPS" or "GAL", from the file header.  Observations are
+ * int64 values times 1000, or doubles in natural units.  LLIs and SSIs
+ * are uint8, with blank indicators exported as zero.  An observation
+ * that was not present is null in its value, LLI and SSI columns.
+ */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+#if !defined(ARROW_C_DATA_INTERFACE)
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+/* These are defined by the Apache Arrow C Data Interface specification. */
+struct ArrowSchema
+{
+    const char *format;
+    const char *name;
+    const char *metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema **children;
+    struct ArrowSchema *dictionary;
+    void (*release)(struct ArrowSchema *);
+    void *private_data;
+};
+
+struct ArrowArray
+{
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void **buffers;
+    struct ArrowArray **children;
+    struct ArrowArray *dictionary;
+    void (*release)(struct ArrowArray *);
+    void *private_data;
+};
+
+#endif /* !defined(ARROW_C_DATA_INTERFACE) */
+
+/** rinex_arrow_builder accumulates parsed RINEX records for export. */
+struct rinex_arrow_builder;
+
+/** Exports observations for one satellite from a SRNX file.
+ *
+ * The batch has one row per epoch in the file.  Its columns are "time",
+ * followed by three columns for each requested observation code: the
+ * values (named by the code, such as "C1C"), then "C1C_lli" and
+ * "C1C_ssi".  Epochs where the satellite was absent, according to its
+ * SATE chunk, are null.
+ *
+ * \param[in] srnx SRNX reader object.
+ * \param[in] name Satellite name.
+ * \param[in] idx_len Number of observation codes to export.
+ * \param[in] idx Observation indices, as for srnx_get_obs_by_index().
+ * \param[in] as_double If non-zero, export values as doubles.
+ * \param[out] schema Receives the batch's schema.
+ * \param[out] array Receives the batch.
+ * \returns Zero on success, non-zero SRNX error number on error.  On
+ *   error, \a schema and \a array are not initialized.
+ */
+int srnx_export_arrow(
+    struct srnx_reader *srnx,
+    struct srnx_satellite_name name,
+    int idx_len,
+    const int idx[],
+    int as_double,
+    struct ArrowSchema *schema,
+    struct ArrowArray *array
+);
+
+/** Creates a builder for parsed RINEX observation records.
+ *
+ * The builder's batches have one row per satellite per observation
+ * record.  Their columns are "time", "flag" (the epoch flag character
+ * as uint8), "sv" (the satellite name as a string), then "obs0",
+ * "lli0", "ssi0", "obs1" and so on, up to the largest number of
+ * observation codes for any satellite system in the file.  Column
+ * "obs<n>" holds the n'th observation code in the header of the
+ * satellite's system.
+ *
+ * \param[out] p_builder Receives the builder.
+ * \param[in] p Parser whose records will be appended.  It must not
+ *   have read any records yet, since this reads its header.
+ * \param[in] as_double If non-zero, export values as doubles.
+ * \returns Zero on success, else ENOMEM.
+ */
+int rinex_arrow_builder_create(
+    struct rinex_arrow_builder **p_builder,
+    const struct rinex_parser *p,
+    int as_double
+);
+
+/** Appends the parser's current record to a builder.
+ *
+ * Special event records (epoch flags '2' through '5') are ignored.
+ *
+ * \param[in] builder Builder to append to.
+ * \param[in] p Parser that just read a record.
+ * \returns Zero on success, else ENOMEM.
+ */
+int rinex_arrow_builder_append(
+    struct rinex_arrow_builder *builder,
+    const struct rinex_parser *p
+);
+
+/** Returns the number of rows appended since the last export. */
+int64_t rinex_arrow_builder_rows(
+    const struct rinex_arrow_builder *builder
+);
+
+/** Exports the appended rows as a batch and empties the builder.
+ *
+ * \param[in] builder Builder to export from.
+ * \param[out] schema Receives the batch's schema.
+ * \param[out] array Receives the batch.
+ * \returns Zero on success, else ENOMEM.  On error, \a schema and
+ *   \a array are not initialized, and the builder's rows are discarded.
+ */
+int rinex_arrow_builder_finish(
+    struct rinex_arrow_builder *builder,
+    struct ArrowSchema *schema,
+    struct ArrowArray *array
+);
+
+/** Frees a builder and any rows it holds.
+ *
+ * \param[in] builder Builder to free; may be NULL.
+ */
+void rinex_arrow_builder_destroy(
+    struct rinex_arrow_builder *builder
+);
+
+#if defined(__cplusplus)
+}
+#endif /* defined(__cplusplus) */
+
+#endif /* !defined(RINEX_ARROW_H_8f4d2b61_0c7e_4a39_b5d8_c93e1f6a2047) */
@@ -0,0 +1,361 @@
+/** rinex_async.hpp - C++20 coroutine interface to the RINEX parser.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(RINEX_ASYNC_HPP_94c2d7a0_6e1f_4b38_a5d9_0f72e8c3b164)
+#define RINEX_ASYNC_HPP_94c2d7a0_6e1f_4b38_a5d9_0f72e8c3b164
+
+#include <fcntl.h>
+
+#include <memory>
+
+#include "rinex.hpp"
+#include "srnx_async.hpp"
+
+/* The parser pulls data through rinex_stream::advance(), which cannot
+ * suspend.  async_source keeps a read-ahead buffer that it refills
+ * through an io_ring, and next_epoch() waits for the refill before
+ * calling the parser whenever less than #async_source::low_water bytes
+ * are buffered.  The parser asks for at most about a megabyte at a
+ * time, so advance() then finds its data already buffered.  If it does
+ * not (for example, because a record is unusually long), advance()
+ * waits for the read synchronously.
+ */
+
+namespace rinex
+{
+
+using srnx::io_ring;
+using srnx::task;
+
+/** async_source is a rinex_stream that reads a file through an io_ring. */
+class async_source : public rinex_stream
+{
+public:
+    /** Size of the read-ahead buffer. */
+    static constexpr std::size_t capacity = 4u << 20;
+
+    /** Readable padding after the data in rinex_stream::buffer; this
+     * matches RINEX_EXTRA in rinex_p.h.
+     */
+    static constexpr std::size_t extra = 80;
+
+    /** Largest single read. */
+    static constexpr std::size_t max_read = 1u << 20;
+
+    /** next_epoch() waits for data when less than this is buffered. */
+    static constexpr std::size_t low_water = 3u << 19;
+
+    /** Opens \a filename; throws std::system_error on failure. */
+    async_source(io_ring &ring, const char *filename)
+        : ring_(ring), ahead_(new char[capacity])
+    {
+        advance = advance_cb;
+        destroy = destroy_cb;
+        buffer = nullptr;
+        size = 0;
+        fd_ = ::open(filename, O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0)
+        {
+            throw std::system_error(errno, std::generic_category(), filename);
+        }
+    }
+
+    async_source(const async_source &) = delete;
+    async_source &operator=(const async_source &) = delete;
+
+    ~async_source()
+    {
+        if (reading_)
+        {
+            ring_.wait(op_);
+        }
+        ::close(fd_);
+    }
+
+    /** Returns \a s as an async_source, or null if it is another kind
+     * of stream.
+     */
+    static async_source *from(rinex_stream *s) noexcept
+    {
+        return (s && s->advance == advance_cb)
+            ? static_cast<async_source *>(s) : nullptr;
+    }
+
+    /** Returns how many times advance() had to wait synchronously. */
+    std::size_t blocking_waits() const noexcept { return blocking_waits_; }
+
+    /** Checks whether at least \a want bytes are buffered ahead (or the
+     * file has ended or a read failed), starting a read if there is
+     * room.  Without io_uring, this waits for the data instead.
+     */
+    bool ready(std::size_t want)
+    {
+        for (;;)
+        {
+            start();
+            if (fill_ >= want || eof_ || error_)
+            {
+                return true;
+            }
+            if (ring_.uses_io_uring())
+            {
+                return false;
+            }
+        }
+    }
+
+    /** Waits until at least \a want bytes are buffered ahead, the file
+     * ends or a read fails.
+     */
+    task<void> fill(std::size_t want)
+    {
+        for (;;)
+        {
+            poll();
+            if (fill_ >= want || eof_ || error_)
+            {
+                break;
+            }
+            start();
+            if (reading_)
+            {
+                co_await ring_.wait_async(op_);
+            }
+        }
+        start();
+    }
+
+private:
+    static int advance_cb(rinex_stream *s, unsigned int req_size,
+        unsigned int step)
+    {
+        return static_cast<async_source *>(s)->do_advance(req_size, step);
+    }
+
+    static void destroy_cb(rinex_stream *s)
+    {
+        delete static_cast<async_source *>(s);
+    }
+
+    /** Implements rinex_stream::advance(). */
+    int do_advance(unsigned int req_size, unsigned int step)
+    {
+        std::size_t n;
+
+        if (step > size)
+        {
+            return EINVAL;
+        }
+        size -= step;
+        if (window_len_ < req_size + extra)
+        {
+            std::unique_ptr<char[]> grown(new char[req_size + extra]);
+            if (size > 0)
+            {
+                std::memcpy(grown.get(), buffer + step, size);
+            }
+            window_len_ = req_size + extra;
+            window_ = std::move(grown);
+        }
+        else
+        {
+            std::memmove(window_.get(), buffer + step, size);
+        }
+        buffer = window_.get();
+
+        while (size < req_size)
+        {
+            poll();
+            if (fill_ > 0)
+            {
+                n = req_size - size;
+                if (n > fill_)
+                {
+                    n = fill_;
+                }
+                if (n > capacity - head_)
+                {
+                    n = capacity - head_;
+                }
+                std::memcpy(buffer + size, ahead_.get() + head_, n);
+                head_ = (head_ + n) % capacity;
+                fill_ -= n;
+                size += n;
+                continue;
+            }
+            if (error_)
+            {
+                return error_;
+            }
+            if (eof_)
+            {
+                break;
+            }
+            start();
+            if (reading_)
+            {
+                ++blocking_waits_;
+                ring_.wait(op_);
+            }
+        }
+        std::memset(buffer + size, 0, extra);
+        start();
+
+        return 0;
+    }
+
+    /** Starts a read into the free part of the buffer, if there is
+     * room and no read is running.
+     */
+    void start()
+    {
+        std::size_t tail, len;
+
+        poll();
+        if (reading_ || eof_ || error_ || fill_ == capacity)
+        {
+            return;
+        }
+
+        tail = (head_ + fill_) % capacity;
+        if (fill_ == 0)
+        {
+            head_ = tail = 0;
+        }
+        len = (tail >= head_) ? capacity - tail : head_ - tail;
+        if (len > max_read)
+        {
+            len = max_read;
+        }
+        reading_ = true;
+        ring_.start_read(op_, fd_, ahead_.get() + tail, len, offset_);
+        poll();
+    }
+
+    /** Accounts for a completed read. */
+    void poll() noexcept
+    {
+        if (!reading_ || !op_.done)
+        {
+            return;
+        }
+        reading_ = false;
+        if (op_.result < 0)
+        {
+            error_ = -op_.result;
+        }
+        else if (op_.result == 0)
+        {
+            eof_ = true;
+        }
+        else
+        {
+            fill_ += op_.result;
+            offset_ += op_.result;
+        }
+    }
+
+    io_ring &ring_;
+    std::unique_ptr<char[]> ahead_;
+    std::unique_ptr<char[]> window_;
+    std::size_t window_len_ = 0;
+    std::size_t head_ = 0;
+    std::size_t fill_ = 0;
+    std::uint64_t offset_ = 0;
+    std::size_t blocking_waits_ = 0;
+    srnx::io_op op_;
+    int fd_ = -1;
+    int error_ = 0;
+    bool reading_ = false;
+    bool eof_ = false;
+};
+
+/** Opens \a filename and reads its header, reading through \a ring.
+ *
+ * \throws std::system_error If the file cannot be opened.
+ * \throws rinex::error If the file is not a supported RINEX file.
+ */
+inline task<parser> open_async(io_ring &ring, std::string filename)
+{
+    std::unique_ptr<async_source> src(new async_source(ring, filename.c_str()));
+
+    co_await src->fill(async_source::low_water);
+    co_return parser(stream(src.release()));
+}
+
+/** Awaiter returned by next_epoch(). */
+class epoch_awaiter
+{
+public:
+    explicit epoch_awaiter(parser &p) noexcept
+        : p_(p), src_(async_source::from(p.get()->stream))
+    {
+    }
+
+    bool await_ready()
+    {
+        return !src_ || src_->ready(async_source::low_water);
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> h)
+    {
+        slow_ = true;
+        fill_ = src_->fill(async_source::low_water);
+        waiter_ = fill_.operator co_await();
+        return waiter_.await_suspend(h);
+    }
+
+    bool await_resume()
+    {
+        if (slow_)
+        {
+            waiter_.await_resume();
+        }
+        return p_.read();
+    }
+
+private:
+    parser &p_;
+    async_source *src_;
+    bool slow_ = false;
+    task<void> fill_;
+    task<void>::awaiter waiter_{};
+};
+
+/** Reads the next record from \a p.  If \a p reads from an
+ * async_source, this first waits (without blocking the thread) until
+ * enough data is buffered; otherwise it is the same as p.read().
+ *
+ * \returns An awaiter that yields true if a record was read, false at
+ *   end of file, and throws rinex::error if the file is malformed or
+ *   cannot be read.
+ */
+inline epoch_awaiter next_epoch(parser &p) noexcept
+{
+    return epoch_awaiter(p);
+}
+
+} /* namespace rinex */
+
+#endif /* !defined(RINEX_ASYNC_HPP_94c2d7a0_6e1f_4b38_a5d9_0f72e8c3b164) */
@@ -0,0 +1,59 @@
+/** rinex_check.c - Reports quality statistics for RINEX files.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "driver.h"
+#include "rinex_qc.h"
+#include <stdio.h>
+#include <string.h>
+
+void process_file(struct rinex_parser *p, const char filename[])
+{
+    struct rinex_qc *qc;
+    int res;
+
+    res = rinex_qc_create(&qc, p);
+    if (res)
+    {
+        printf("Unable to check %s: %s\n", filename, strerror(res));
+        return;
+    }
+
+    while ((res = p->read(p)) > 0)
+    {
+        res = rinex_qc_add(qc, p);
+        if (res)
+        {
+            printf("Unable to check %s: %s\n", filename, strerror(res));
+            break;
+        }
+    }
+    if (res < 0)
+    {
+        printf("Error parsing %s: %d (line %d)\n", filename, res,
+            p->error_line);
+    }
+
+    rinex_qc_write_json(qc, filename, stdout);
+    rinex_qc_destroy(qc);
+}
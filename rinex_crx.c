@@ -0,0 +1,733 @@
+/** rinex_crx.c - Compact RINEX (Hatanaka) encoder.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "rinex_crx.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__AVX2__)
+# include <x86intrin.h>
+#endif
+
+/** Length of a RINEX 2 epoch line before the satellite list. */
+#define CRX_V2_EPOCH_LEN 32
+
+/** Length of a RINEX 3 epoch line before the receiver clock offset;
+ * Compact RINEX 3 puts the satellite list here.
+ */
+#define CRX_V3_EPOCH_LEN 41
+
+/** Longest text for one observation field: the "3&" prefix, a sign,
+ * nineteen digits and a separator.
+ */
+#define CRX_FIELD_MAX 24
+
+/** crx_sat holds the differential state of one satellite. */
+struct crx_sat
+{
+    /** order is a pair of entries for each observation, as in
+     * crx_v23_parser.  \a order[2*n+0] is the differential order of
+     * observation \a n, and \a order[2*n+1] is how many levels of
+     * #diff are valid for it; zero means the next value starts a new
+     * arc.
+     */
+    unsigned char *order;
+
+    /** diff holds the differential state in order-major layout, as in
+     * crx_v23_parser: \a diff[n+k*n_obs] is the \a k'th-order history
+     * for observation \a n.  Phase values times 1000 do not fit in an
+     * int, so these are 64 bits wide.
+     */
+    int64_t *diff;
+
+    /** flags holds the LLI and SSI for each observation at the last
+     * epoch, two characters per observation.
+     */
+    char *flags;
+
+    /** last_epoch is one plus the index of the last observation epoch
+     * that included this satellite, or zero.
+     */
+    uint64_t last_epoch;
+
+    /** n_obs is the number of observation codes for the satellite. */
+    int n_obs;
+};
+
+struct rinex_crx
+{
+    /** out is where the encoded records go. */
+    FILE *out;
+
+    /** text holds the encoded form of the current record. */
+    char *text;
+
+    /** epoch_line holds the previous epoch line, for text differences.
+     * It is not terminated.
+     */
+    char *epoch_line;
+
+    /** line holds the current epoch line while it is built. */
+    char *line;
+
+    /** text_alloc is the allocated length of #text. */
+    size_t text_alloc;
+
+    /** n_epochs counts the observation epochs that have been written. */
+    uint64_t n_epochs;
+
+    /** clock holds the differential state for the receiver clock. */
+    int64_t clock[RINEX_CRX_CLOCK_ORDER + 1];
+
+    /** clock_order is laid out like one pair of crx_sat.order. */
+    unsigned char clock_order[2];
+
+    /** line_alloc is the allocated length of #epoch_line and #line. */
+    int line_alloc;
+
+    /** epoch_len is the length of #epoch_line, or zero if the next
+     * epoch line must be written in full.
+     */
+    int epoch_len;
+
+    /** max_obs is the largest number of observation codes for any
+     * satellite system.
+     */
+    int max_obs;
+
+    /** version is the major RINEX version, 2 or 3. */
+    int version;
+
+    /** sat is indexed by (system & 31) * RINEX_MAX_SVN + svn. */
+    struct crx_sat *sat[32 * RINEX_MAX_SVN];
+};
+
+#if defined(__AVX2__)
+/** Writes the sixteen decimal digits of \a value, which must be less
+ * than 1e16, to \a out.
+ *
+ * This splits the value into four groups of four digits, spreads each
+ * group across four 16-bit lanes, and divides the lanes by 1000, 100,
+ * 10 and 1 with multiply-high steps; subtracting ten times the lane to
+ * the left leaves one digit per lane.
+ */
+static void crx_digits16(char out[16], uint64_t value)
+{
+    const uint64_t spread = 0x0001000100010001ull;
+    __m256i v, t, q, d;
+    __m128i r;
+    uint32_t hi, lo;
+
+    hi = value / 100000000;
+    lo = value % 100000000;
+    v = _mm256_setr_epi64x((hi / 10000) * spread, (hi % 10000) * spread,
+        (lo / 10000) * spread, (lo % 10000) * spread);
+
+    /* x/1000 = (x*0x8313)>>25, x/100 = (x*0x147B)>>19 and
+     * x/10 = (x*0xCCCD)>>19 for x < 10000.  The second multiply-high
+     * does the shift beyond 16 bits.
+     */
+    t = _mm256_mulhi_epu16(v, _mm256_setr_epi16(
+        0x8313, 0x147B, (short)0xCCCD, 0, 0x8313, 0x147B, (short)0xCCCD, 0,
+        0x8313, 0x147B, (short)0xCCCD, 0, 0x8313, 0x147B, (short)0xCCCD, 0));
+    q = _mm256_mulhi_epu16(t, _mm256_setr_epi16(
+        1 << 7, 1 << 13, 1 << 13, 0, 1 << 7, 1 << 13, 1 << 13, 0,
+        1 << 7, 1 << 13, 1 << 13, 0, 1 << 7, 1 << 13, 1 << 13, 0));
+    q = _mm256_blend_epi16(q, v, 0x88);
+    d = _mm256_sub_epi16(q, _mm256_mullo_epi16(_mm256_slli_epi64(q, 16),
+        _mm256_set1_epi16(10)));
+
+    /* Pack to bytes; each 128-bit lane holds eight digits in its low
+     * half.
+     */
+    d = _mm256_packus_epi16(d, _mm256_setzero_si256());
+    d = _mm256_permute4x64_epi64(d, 0x08);
+    r = _mm_add_epi8(_mm256_castsi256_si128(d), _mm_set1_epi8('0'));
+    _mm_storeu_si128((__m128i *)out, r);
+}
+#endif
+
+/* Doc comment in rinex_crx.h. */
+int rinex_crx_format_s64(
+    char *out,
+    int64_t value
+)
+{
+    char digits[32];
+    uint64_t mag;
+    int len, ii;
+
+    len = 0;
+    mag = (uint64_t)value;
+    if (value < 0)
+    {
+        out[len++] = '-';
+        mag = -mag;
+    }
+
+#if defined(__AVX2__)
+    if (mag < 10000000000000000ull)
+    {
+        uint32_t nonzero;
+
+        crx_digits16(digits, mag);
+        nonzero = ~_mm_movemask_epi8(_mm_cmpeq_epi8(
+            _mm_loadu_si128((const __m128i *)digits), _mm_set1_epi8('0')));
+        ii = __builtin_ctz(nonzero | 0x8000);
+        memcpy(out + len, digits + ii, 16);
+        return len + 16 - ii;
+    }
+#endif
+
+    ii = sizeof digits;
+    do
+    {
+        digits[--ii] = '0' + mag % 10;
+        mag /= 10;
+    } while (mag);
+    memcpy(out + len, digits + ii, sizeof digits - ii);
+    return len + sizeof digits - ii;
+}
+
+/** Updates a differential history with \a value.
+ *
+ * \param[in,out] diff History, with level \a k at \a diff[k*stride].
+ * \param[in] stride Distance between levels of \a diff.
+ * \param[in,out] order Order pair, as in crx_sat.order.
+ * \param[in] value New value.
+ * \returns The highest-order difference, which is what Compact RINEX
+ *   stores.
+ */
+static inline int64_t crx_difference(
+    int64_t *diff,
+    size_t stride,
+    unsigned char order[2],
+    int64_t value
+)
+{
+    int64_t prev;
+    int levels, kk;
+
+    levels = order[1] + (order[1] <= order[0]);
+    for (kk = 0; kk < levels; ++kk)
+    {
+        prev = diff[kk * stride];
+        diff[kk * stride] = value;
+        value -= prev;
+    }
+    order[1] = levels;
+
+    return diff[(levels - 1) * stride];
+}
+
+/** Writes one differenced field, or starts a new arc if \a order
+ * says to.
+ * \returns The end of the field's text.
+ */
+static inline char *crx_put_field(
+    char *out,
+    int64_t *diff,
+    size_t stride,
+    unsigned char order[2],
+    int64_t value
+)
+{
+    if (!order[1])
+    {
+        *out++ = '0' + order[0];
+        *out++ = '&';
+        diff[0] = value;
+        order[1] = 1;
+        return out + rinex_crx_format_s64(out, value);
+    }
+
+    value = crx_difference(diff, stride, order, value);
+    return out + rinex_crx_format_s64(out, value);
+}
+
+/** Writes the text difference from \a old to \a cur.
+ *
+ * Unchanged characters become spaces, characters that became spaces
+ * become '&', and others are copied.  Trailing spaces are dropped.
+ *
+ * \returns The end of the difference text.
+ */
+static char *crx_diff_text(
+    char *out,
+    const char *old,
+    int old_len,
+    const char *cur,
+    int cur_len
+)
+{
+    char *end;
+    char o, c;
+    int ii, len;
+
+    len = (old_len > cur_len) ? old_len : cur_len;
+    for (ii = 0, end = out; ii < len; ++ii)
+    {
+        o = (ii < old_len) ? old[ii] : ' ';
+        c = (ii < cur_len) ? cur[ii] : ' ';
+        if (o == c)
+        {
+            *out++ = ' ';
+            continue;
+        }
+        *out++ = (c == ' ') ? '&' : c;
+        end = out;
+    }
+
+    return end;
+}
+
+/** Maps an LLI or SSI character to its canonical form. */
+static inline char crx_indicator(char c)
+{
+    return (c >= '0' && c <= '9') ? c : ' ';
+}
+
+/** Makes sure \a crx->text can hold \a len bytes.
+ * \returns Zero on success, else ENOMEM.
+ */
+static int crx_reserve(struct rinex_crx *crx, size_t len)
+{
+    char *new_text;
+
+    if (len <= crx->text_alloc)
+    {
+        return 0;
+    }
+    len += len / 2;
+    new_text = realloc(crx->text, len);
+    if (!new_text)
+    {
+        return ENOMEM;
+    }
+    crx->text = new_text;
+    crx->text_alloc = len;
+    return 0;
+}
+
+/** Makes sure the epoch line buffers can hold \a len bytes.
+ * \returns Zero on success, else ENOMEM.
+ */
+static int crx_line_space(struct rinex_crx *crx, int len)
+{
+    char *new_epoch, *new_line;
+
+    if (len <= crx->line_alloc)
+    {
+        return 0;
+    }
+    len += len / 2;
+    new_epoch = realloc(crx->epoch_line, len);
+    if (!new_epoch)
+    {
+        return ENOMEM;
+    }
+    crx->epoch_line = new_epoch;
+    new_line = realloc(crx->line, len);
+    if (!new_line)
+    {
+        return ENOMEM;
+    }
+    crx->line = new_line;
+    crx->line_alloc = len;
+    return 0;
+}
+
+/** Finds or creates the state for a satellite.
+ * \returns The satellite state, or NULL on allocation failure.
+ */
+static struct crx_sat *crx_get_sat(
+    struct rinex_crx *crx,
+    const struct rinex_parser *p,
+    const struct rinex_sat_entry *entry
+)
+{
+    struct crx_sat *sat;
+    int idx, n_obs, ii;
+
+    idx = (entry->system & 31) * RINEX_MAX_SVN + entry->svn;
+    sat = crx->sat[idx];
+    if (sat)
+    {
+        return sat;
+    }
+
+    n_obs = p->n_obs[entry->system & 31];
+    sat = calloc(1, sizeof(*sat) + n_obs * (2 + 2 + (RINEX_CRX_ORDER + 1)
+        * sizeof(int64_t)));
+    if (!sat)
+    {
+        return NULL;
+    }
+    sat->diff = (int64_t *)(sat + 1);
+    sat->order = (unsigned char *)(sat->diff + n_obs * (RINEX_CRX_ORDER + 1));
+    sat->flags = (char *)(sat->order + 2 * n_obs);
+    sat->n_obs = n_obs;
+    for (ii = 0; ii < n_obs; ++ii)
+    {
+        sat->order[2 * ii] = RINEX_CRX_ORDER;
+    }
+    crx->sat[idx] = sat;
+    return sat;
+}
+
+/** Formats the epoch line for an observation record into \a crx->line.
+ * \returns The line length, or -ENOMEM.
+ */
+static int crx_epoch_line(
+    struct rinex_crx *crx,
+    const struct rinex_parser *p
+)
+{
+    const struct rinex_epoch *ep = &p->epoch;
+    const struct rinex_sat_entry *entry;
+    char *line;
+    int len, ii;
+
+    if (crx_line_space(crx, CRX_V3_EPOCH_LEN + 3 * ep->n_sats + 1))
+    {
+        return -ENOMEM;
+    }
+
+    line = crx->line;
+    if (crx->version == 2)
+    {
+        len = sprintf(line, " %02d %2d %2d %2d %2d%3d.%07d  %c%3d",
+            ep->yyyy_mm_dd / 10000 % 100, ep->yyyy_mm_dd / 100 % 100,
+            ep->yyyy_mm_dd % 100, ep->hh_mm / 100, ep->hh_mm % 100,
+            ep->sec_e7 / 10000000, ep->sec_e7 % 10000000, ep->flag,
+            ep->n_sats);
+    }
+    else
+    {
+        len = sprintf(line, "> %04d %02d %02d %02d %02d%3d.%07d  %c%3d      ",
+            ep->yyyy_mm_dd / 10000, ep->yyyy_mm_dd / 100 % 100,
+            ep->yyyy_mm_dd % 100, ep->hh_mm / 100, ep->hh_mm % 100,
+            ep->sec_e7 / 10000000, ep->sec_e7 % 10000000, ep->flag,
+            ep->n_sats);
+    }
+
+    for (ii = 0; ii < ep->n_sats; ++ii)
+    {
+        entry = p->sats + ii;
+        line[len++] = entry->system;
+        line[len++] = '0' + entry->svn / 10;
+        line[len++] = '0' + entry->svn % 10;
+    }
+
+    return len;
+}
+
+/** Appends the epoch line in \a crx->line to \a out, as a text
+ * difference from the previous epoch line when there is one.
+ * \returns The end of the appended text, including its newline.
+ */
+static char *crx_put_epoch_line(
+    struct rinex_crx *crx,
+    char *out,
+    int len
+)
+{
+    char *tmp;
+
+    if (crx->epoch_len > 0)
+    {
+        out = crx_diff_text(out, crx->epoch_line, crx->epoch_len, crx->line,
+            len);
+    }
+    else
+    {
+        memcpy(out, crx->line, len);
+        if (crx->version == 2)
+        {
+            out[0] = '&';
+        }
+        out += len;
+    }
+    *out++ = '\n';
+
+    tmp = crx->epoch_line;
+    crx->epoch_line = crx->line;
+    crx->line = tmp;
+    crx->epoch_len = len;
+
+    return out;
+}
+
+/** Appends the receiver clock offset line to \a out.
+ * \returns The end of the appended text, including its newline.
+ */
+static char *crx_put_clock(
+    struct rinex_crx *crx,
+    char *out,
+    int64_t clock_offset
+)
+{
+    if (!clock_offset)
+    {
+        crx->clock_order[1] = 0;
+    }
+    else
+    {
+        /* The parser keeps the offset's digits (1e-9 s units for
+         * RINEX 2 and 1e-12 s for RINEX 3), which is what CRX stores.
+         */
+        out = crx_put_field(out, crx->clock, 1, crx->clock_order,
+            clock_offset);
+    }
+    *out++ = '\n';
+
+    return out;
+}
+
+/** Encodes an observation or cycle slip record.
+ * \returns Zero on success, or ENOMEM.
+ */
+static int crx_write_obs(
+    struct rinex_crx *crx,
+    const struct rinex_parser *p
+)
+{
+    const struct rinex_sat_entry *entry;
+    const unsigned char *present;
+    struct crx_sat *sat;
+    char *out, *flags;
+    int len, ii, nn, kk, n_obs, restart;
+
+    /* Cycle slip records restart every arc, before and after. */
+    restart = (p->epoch.flag == '6');
+    if (restart)
+    {
+        crx->epoch_len = 0;
+    }
+
+    len = crx_epoch_line(crx, p);
+    if (len < 0)
+    {
+        return -len;
+    }
+    if (crx_reserve(crx, 2 * len + CRX_FIELD_MAX + 2 + (size_t)p->epoch.n_sats
+        * (crx->max_obs * (CRX_FIELD_MAX + 2) + 1) + 4 * crx->max_obs + 64))
+    {
+        return ENOMEM;
+    }
+
+    out = crx_put_epoch_line(crx, crx->text, len);
+    if (restart)
+    {
+        crx->clock_order[1] = 0;
+    }
+    out = crx_put_clock(crx, out, p->epoch.clock_offset);
+
+    /* Use the tail of crx->text as scratch space for the flags. */
+    flags = crx->text + crx->text_alloc - 2 * crx->max_obs;
+    for (ii = 0; ii < p->epoch.n_sats; ++ii)
+    {
+        entry = p->sats + ii;
+        sat = crx_get_sat(crx, p, entry);
+        if (!sat)
+        {
+            return ENOMEM;
+        }
+
+        n_obs = sat->n_obs;
+        if (restart || !sat->last_epoch || sat->last_epoch != crx->n_epochs)
+        {
+            for (nn = 0; nn < n_obs; ++nn)
+            {
+                sat->order[2 * nn + 1] = 0;
+            }
+            memset(sat->flags, ' ', 2 * n_obs);
+        }
+
+        present = (const unsigned char *)p->buffer + entry->buffer_ofs + 2;
+        for (nn = 0, kk = entry->obs_ofs; nn < n_obs; ++nn)
+        {
+            if ((present[nn >> 3] >> (nn & 7)) & 1)
+            {
+                out = crx_put_field(out, sat->diff + nn, n_obs,
+                    sat->order + 2 * nn, p->obs[kk]);
+                flags[2 * nn] = crx_indicator(p->lli[kk]);
+                flags[2 * nn + 1] = crx_indicator(p->ssi[kk]);
+                ++kk;
+            }
+            else
+            {
+                sat->order[2 * nn + 1] = 0;
+                flags[2 * nn] = flags[2 * nn + 1] = ' ';
+            }
+            *out++ = ' ';
+        }
+
+        out = crx_diff_text(out, sat->flags, 2 * n_obs, flags, 2 * n_obs);
+        memcpy(sat->flags, flags, 2 * n_obs);
+        while (out[-1] == ' ')
+        {
+            --out;
+        }
+        *out++ = '\n';
+
+        sat->last_epoch = restart ? 0 : crx->n_epochs + 1;
+    }
+
+    if (restart)
+    {
+        crx->epoch_len = 0;
+        crx->clock_order[1] = 0;
+    }
+    else
+    {
+        ++crx->n_epochs;
+    }
+
+    if (fwrite(crx->text, 1, out - crx->text, crx->out) != (size_t)(out - crx->text))
+    {
+        return errno ? errno : EIO;
+    }
+    return 0;
+}
+
+/* Doc comment in rinex_crx.h. */
+int rinex_crx_create(
+    struct rinex_crx **p_crx,
+    const struct rinex_parser *p,
+    FILE *out
+)
+{
+    struct rinex_crx *crx;
+    char date[32];
+    struct tm tm;
+    time_t now;
+    int version, ii;
+
+    if (p->buffer_len < 6)
+    {
+        return EINVAL;
+    }
+    version = p->buffer[5] - '0';
+    if (version != 2 && version != 3)
+    {
+        return EINVAL;
+    }
+
+    crx = calloc(1, sizeof(*crx));
+    if (!crx)
+    {
+        return ENOMEM;
+    }
+    crx->out = out;
+    crx->version = version;
+    crx->clock_order[0] = RINEX_CRX_CLOCK_ORDER;
+    for (ii = 0; ii < 32; ++ii)
+    {
+        if (crx->max_obs < p->n_obs[ii])
+        {
+            crx->max_obs = p->n_obs[ii];
+        }
+    }
+    if (crx_line_space(crx, 128))
+    {
+        rinex_crx_destroy(crx);
+        return ENOMEM;
+    }
+
+    now = time(NULL);
+    gmtime_r(&now, &tm);
+    strftime(date, sizeof date, "%d-%b-%y %H:%M", &tm);
+    fprintf(out, "%-20s%-40s%-20s\n%-40s%-20s%-20s\n",
+        (version == 2) ? "1.0" : "3.0", "COMPACT RINEX FORMAT",
+        "CRINEX VERS   / TYPE", "librinex rinex_crx", date,
+        "CRINEX PROG / DATE");
+    fwrite(p->buffer, 1, p->buffer_len, out);
+    if (ferror(out))
+    {
+        rinex_crx_destroy(crx);
+        return errno ? errno : EIO;
+    }
+
+    *p_crx = crx;
+    return 0;
+}
+
+/* Doc comment in rinex_crx.h. */
+int rinex_crx_write(
+    struct rinex_crx *crx,
+    const struct rinex_parser *p
+)
+{
+    const char *line;
+    size_t len;
+
+    if (p->epoch.flag == '0' || p->epoch.flag == '1'
+        || p->epoch.flag == '6')
+    {
+        return p->sats ? crx_write_obs(crx, p) : EINVAL;
+    }
+
+    /* Special events are copied, marking the epoch line as a new
+     * start, and the next epoch line is written in full.
+     */
+    line = p->buffer;
+    len = p->buffer_len;
+    if (len > 0 && crx->version == 2)
+    {
+        putc('&', crx->out);
+        ++line;
+        --len;
+    }
+    fwrite(line, 1, len, crx->out);
+    crx->epoch_len = 0;
+
+    return ferror(crx->out) ? (errno ? errno : EIO) : 0;
+}
+
+/* Doc comment in rinex_crx.h. */
+void rinex_crx_destroy(
+    struct rinex_crx *crx
+)
+{
+    int ii;
+
+    if (!crx)
+    {
+        return;
+    }
+
+    for (ii = 0; ii < 32 * RINEX_MAX_SVN; ++ii)
+    {
+        free(crx->sat[ii]);
+    }
+    free(crx->epoch_line);
+    free(crx->line);
+    free(crx->text);
+    free(crx);
+}
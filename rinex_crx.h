@@ -0,0 +1,113 @@
+/** rinex_crx.h - Compact RINEX (Hatanaka) encoder.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(RINEX_CRX_H_b2dcae85_514c_4b9f_9bb2_445e915cb465)
+#define RINEX_CRX_H_b2dcae85_514c_4b9f_9bb2_445e915cb465
+
+#include "rinex.h"
+
+#include <stdio.h>
+
+/* The encoder writes Compact RINEX 1.0 (for RINEX 2.x input) or 3.0
+ * (for RINEX 3.x input) straight from the parser's records, so the
+ * observation text is never reformatted and parsed again.  It follows
+ * the conventions of RNX2CRX: third-order differences for observations,
+ * second-order differences for the receiver clock offset, and text
+ * differences for epoch lines and LLI/SSI flags.
+ *
+ * Because the parser does not keep the original text, the output
+ * describes the same data as the input but is not always the same text
+ * after decompression: satellite numbers are zero-padded, a zero clock
+ * offset is omitted, and observation values are written with three
+ * decimal places.  Cycle slip records (epoch flag 6) are written with
+ * every field re-initialized.
+ */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/** Differential order used for observations. */
+#define RINEX_CRX_ORDER 3
+
+/** Differential order used for receiver clock offsets. */
+#define RINEX_CRX_CLOCK_ORDER 2
+
+/** rinex_crx holds the state of one Compact RINEX encoder. */
+struct rinex_crx;
+
+/** Creates an encoder and writes the Compact RINEX header, followed by
+ * the RINEX header that \a p has read.
+ *
+ * This must be called before the first call to \a p->read().
+ *
+ * \param[out] p_crx Receives the encoder.
+ * \param[in] p Parser that has just read the file header.
+ * \param[in] out Stream to write to.
+ * \returns Zero on success, EINVAL if the RINEX version is not 2 or 3,
+ *   ENOMEM, or errno from the stream.
+ */
+int rinex_crx_create(
+    struct rinex_crx **p_crx,
+    const struct rinex_parser *p,
+    FILE *out
+);
+
+/** Encodes the parser's current record.
+ *
+ * \param[in] crx Encoder to write with.
+ * \param[in] p Parser that just read a record.
+ * \returns Zero on success, EINVAL if \a p does not fill
+ *   rinex_parser.sats, ENOMEM, or errno from the stream.
+ */
+int rinex_crx_write(
+    struct rinex_crx *crx,
+    const struct rinex_parser *p
+);
+
+/** Formats a signed integer in decimal.
+ *
+ * \param[out] out Receives the text, without a terminator.  It must
+ *   have room for at least 24 bytes.
+ * \param[in] value Value to format.
+ * \returns Number of characters written.
+ */
+int rinex_crx_format_s64(
+    char *out,
+    int64_t value
+);
+
+/** Frees an encoder.
+ *
+ * \param[in] crx Encoder to free; may be NULL.
+ */
+void rinex_crx_destroy(
+    struct rinex_crx *crx
+);
+
+#if defined(__cplusplus)
+}
+#endif /* defined(__cplusplus) */
+
+#endif /* !defined(RINEX_CRX_H_b2dcae85_514c_4b9f_9bb2_445e915cb465) */
@@ -0,0 +1,136 @@
+/** rinex_ingest.cpp - Reads many RINEX or SRNX files on one thread.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* This shows the coroutine API: every file named on the command line
+ * is read by its own task, and all of the tasks share one io_ring on
+ * the main thread.  SRNX files have every signal decoded; other files
+ * are parsed as RINEX.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "rinex_async.hpp"
+
+namespace
+{
+
+srnx::task<void> ingest_srnx(srnx::io_ring &ring, srnx::reader rdr,
+    std::string filename)
+{
+    srnx::buffer<srnx_satellite_name> names;
+    srnx::epoch_index index;
+    srnx::column col;
+    std::uint64_t n_names = 0, n_values = 0, n_signals = 0;
+    srnx_reader *srnx = rdr.get();
+
+    co_await srnx::read_index(ring, rdr, index);
+    rdr.check(co_await srnx::complete(ring, srnx, [&] {
+        return srnx_get_satellites(srnx, names.out(), &n_names);
+    }));
+
+    for (std::uint64_t ii = 0; ii < n_names; ++ii)
+    {
+        srnx_satellite_name sat = names.get()[ii];
+        std::size_t n_codes = rdr.codes(sat.name[0]).size();
+
+        for (std::size_t jj = 0; jj < n_codes; ++jj)
+        {
+            co_await srnx::read_column(ring, rdr, sat, jj, col);
+            n_values += col.size();
+            n_signals += col.size() > 0;
+        }
+    }
+
+    std::printf("%s: %llu epochs, %llu satellites, %llu signals,"
+        " %llu values\n", filename.c_str(),
+        (unsigned long long)index.size(), (unsigned long long)n_names,
+        (unsigned long long)n_signals, (unsigned long long)n_values);
+}
+
+srnx::task<void> ingest_rinex(srnx::io_ring &ring, std::string filename)
+{
+    rinex::parser p = co_await rinex::open_async(ring, filename);
+    std::uint64_t n_records = 0, n_sats = 0;
+
+    while (co_await rinex::next_epoch(p))
+    {
+        ++n_records;
+        n_sats += p.get()->epoch.n_sats;
+    }
+
+    std::printf("%s: %llu records, %llu satellite-epochs\n",
+        filename.c_str(), (unsigned long long)n_records,
+        (unsigned long long)n_sats);
+}
+
+srnx::task<void> ingest(srnx::io_ring &ring, std::string filename)
+{
+    try
+    {
+        try
+        {
+            srnx::reader rdr = co_await srnx::open_async(ring, filename);
+            co_await ingest_srnx(ring, std::move(rdr), filename);
+            co_return;
+        }
+        catch (const srnx::error &e)
+        {
+            if (e.code() != SRNX_NOT_SRNX)
+            {
+                throw;
+            }
+        }
+        co_await ingest_rinex(ring, filename);
+    }
+    catch (const std::exception &e)
+    {
+        std::fprintf(stderr, "%s: %s\n", filename.c_str(), e.what());
+    }
+}
+
+} /* namespace */
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "Usage: %s file...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    srnx::io_ring ring;
+    if (!ring.uses_io_uring())
+    {
+        std::fprintf(stderr, "io_uring is not available; using pread()\n");
+    }
+
+    for (int ii = 1; ii < argc; ++ii)
+    {
+        ring.spawn(ingest(ring, argv[ii]));
+    }
+    ring.run();
+
+    return EXIT_SUCCESS;
+}
@@ -169,7 +169,7 @@ int rnx_find_header
                 break;
             }
         }
-        if (pos[ii] != '\n')
+        if (pos[ii] != '\n' && pos[ii] != '\r')
         {
             ofs = (pos - in) + ii;
             continue;
@@ -179,6 +179,168 @@ int rnx_find_header
     }
 }
 
+/** Finds the next CR or LF in \a in, starting at \a ofs.
+ * \returns The offset of the character, or \a in_len if there is none.
+ */
+static inline int rnx_find_eol
+(
+    const char in[],
+    int ofs,
+    int in_len
+)
+{
+#if defined(__AVX2__)
+    const __m256i v_cr = _mm256_set1_epi8('\r');
+    const __m256i v_lf = _mm256_set1_epi8('\n');
+    uint32_t mask;
+
+    for (; ofs < in_len; ofs += 32)
+    {
+        const __m256i v_p = _mm256_loadu_si256((__m256i const *)(in + ofs));
+        mask = _mm256_movemask_epi8(_mm256_or_si256(
+            _mm256_cmpeq_epi8(v_p, v_cr), _mm256_cmpeq_epi8(v_p, v_lf)));
+        if (mask)
+        {
+            ofs += __builtin_ctz(mask);
+            return (ofs < in_len) ? ofs : in_len;
+        }
+    }
+
+    return in_len;
+#else
+    while (ofs < in_len && in[ofs] != '\n' && in[ofs] != '\r')
+    {
+        ++ofs;
+    }
+
+    return ofs;
+#endif
+}
+
+/** Hashes a header label for rnx_header_index. */
+static inline unsigned int rnx_label_hash
+(
+    const char label[],
+    int len
+)
+{
+    unsigned int hash = 2166136261u;
+    int ii;
+
+    for (ii = 0; ii < len; ++ii)
+    {
+        hash = (hash ^ (unsigned char)label[ii]) * 16777619u;
+    }
+
+    return (hash ^ (hash >> 16)) & (RNX_HEADER_BUCKETS - 1);
+}
+
+/* Documentation comment in rinex_p.h. */
+int rnx_index_header
+(
+    struct rnx_header_index *index,
+    char out[],
+    const char in[],
+    int in_len
+)
+{
+    int tail[RNX_HEADER_BUCKETS];
+    int ii, jj, eol, len, max_lines, n_lines;
+    unsigned int hash;
+
+    /* Every line has at least 61 characters plus a newline. */
+    max_lines = in_len / 62 + 1;
+    index->line_ofs = malloc(2 * (max_lines + 1) * sizeof(int));
+    if (!index->line_ofs)
+    {
+        return RINEX_ERR_SYSTEM;
+    }
+    index->next = index->line_ofs + max_lines + 1;
+    for (ii = 0; ii < RNX_HEADER_BUCKETS; ++ii)
+    {
+        index->bucket[ii] = -1;
+    }
+
+    for (ii = jj = n_lines = 0; ii < in_len; ++n_lines)
+    {
+        /* Find the end of the line and check its length. */
+        eol = rnx_find_eol(in, ii, in_len);
+        len = eol - ii;
+        if (len < 61 || len > 80 || n_lines >= max_lines)
+        {
+            index->n_lines = n_lines;
+            return RINEX_ERR_BAD_FORMAT;
+        }
+
+        /* Copy the line without trailing spaces.  A line of spaces
+         * becomes empty; the trim must not run into the previous line.
+         */
+        memcpy(out + jj, in + ii, len);
+        while (len > 0 && out[jj + len - 1] == ' ')
+        {
+            --len;
+        }
+
+        /* Add the line to its label's chain. */
+        index->line_ofs[n_lines] = jj;
+        index->next[n_lines] = -1;
+        hash = rnx_label_hash(out + jj + 60, (len > 60) ? len - 60 : 0);
+        if (index->bucket[hash] < 0)
+        {
+            index->bucket[hash] = n_lines;
+        }
+        else
+        {
+            index->next[tail[hash]] = n_lines;
+        }
+        tail[hash] = n_lines;
+
+        /* Replace the newline sequence with '\n'. */
+        jj += len;
+        out[jj++] = '\n';
+        ii = eol + 1;
+        if (ii < in_len && in[eol] == '\r' && in[ii] == '\n')
+        {
+            ++ii;
+        }
+    }
+
+    index->line_ofs[n_lines] = jj;
+    index->n_lines = n_lines;
+    return jj;
+}
+
+/* Documentation comment in rinex_p.h. */
+int rnx_lookup_header
+(
+    const struct rnx_header_index *index,
+    const char header[],
+    const char label[],
+    size_t sizeof_label
+)
+{
+    int len, ii, ofs;
+
+    len = sizeof_label - 1;
+    while (len > 0 && label[len - 1] == ' ')
+    {
+        --len;
+    }
+
+    ii = index->bucket[rnx_label_hash(label, len)];
+    for (; ii >= 0; ii = index->next[ii])
+    {
+        ofs = index->line_ofs[ii];
+        if (index->line_ofs[ii + 1] - ofs - 61 == len
+            && !memcmp(header + ofs + 60, label, len))
+        {
+            return ofs;
+        }
+    }
+
+    return RINEX_ERR_BAD_FORMAT;
+}
+
 /** rnx_get_n_newlines tries to ensure multiple lines are in \a p->stream.
  *
  * \param[in,out] p Parser needing data to be copied.
@@ -469,3 +631,31 @@ int parse_uint
     *p_out = value;
     return 0;
 }
+
+/** Carrier pairs, keyed by satellite system; each entry gives the
+ * RINEX band numbers of its two carriers and their frequencies.
+ */
+static const struct rnx_freq rnx_freqs[] = {
+    { 'G', '1', '2', 1575.42e6, 1227.60e6 },
+    { 'J', '1', '2', 1575.42e6, 1227.60e6 },
+    { 'E', '1', '5', 1575.42e6, 1176.45e6 },
+    { 'C', '2', '7', 1561.098e6, 1207.14e6 },
+    { 'S', '1', '5', 1575.42e6, 1176.45e6 },
+    { 'I', '5', '9', 1176.45e6, 2492.028e6 },
+};
+
+/* Documentation comment in rinex_p.h. */
+const struct rnx_freq *rnx_find_freq(char system)
+{
+    int ii;
+
+    for (ii = 0; ii < (int)(sizeof rnx_freqs / sizeof rnx_freqs[0]); ++ii)
+    {
+        if (rnx_freqs[ii].system == system)
+        {
+            return &rnx_freqs[ii];
+        }
+    }
+
+    return NULL;
+}
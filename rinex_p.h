@@ -45,6 +45,29 @@
 /** page_size is the value of sysconf(_SC_PAGE_SIZE). */
 extern long page_size;
 
+/** RNX_HEADER_BUCKETS is the number of hash buckets in a header index. */
+#define RNX_HEADER_BUCKETS 64
+
+/** rnx_header_index locates the lines of a normalized RINEX header. */
+struct rnx_header_index
+{
+    /** line_ofs[n] is the offset of header line \a n.  There are
+     * #n_lines + 1 entries; the last is the length of the header.
+     */
+    int *line_ofs;
+
+    /** next[n] is the next line whose label has the same hash as line
+     * \a n, or -1.  Lines with the same label are chained in order.
+     */
+    int *next;
+
+    /** n_lines is the number of lines in the header. */
+    int n_lines;
+
+    /** bucket[h] is the first line whose label hashes to \a h, or -1. */
+    int bucket[RNX_HEADER_BUCKETS];
+};
+
 /** rnx_v23_parser is a RINEX v2.xx or v3.xx parser. */
 struct rnx_v23_parser
 {
@@ -59,11 +82,56 @@ struct rnx_v23_parser
      */
     int obs_alloc;
 
+    /** sats_alloc is the allocated length of #base.sats. */
+    int sats_alloc;
+
     /** parse_ofs is the current read offset in base.stream->buffer. */
     uint64_t parse_ofs;
+
+    /** header indexes #base.buffer until the first record is read. */
+    struct rnx_header_index header;
+};
+
+/** CRX_MAX_ORDER is the highest differential order that Compact RINEX
+ * can name for a field.
+ */
+#define CRX_MAX_ORDER 9
+
+/** crx_v23_sat is the decompression state for one satellite. */
+struct crx_v23_sat
+{
+    /** order is a pair of entries for each observation.  \a order[2*n+0]
+     * is the differential order of observation \a n, up to
+     * CRX_MAX_ORDER.  \a order[2*n+1] is how many levels of #diff are
+     * valid for it; zero means the observation has no current arc.
+     */
+    unsigned char *order;
+
+    /** diff holds the differential state in order-major layout.  That
+     * is, \a diff[obs+k*n_obs] is the \a k'th-order history for
+     * observation \a obs, and \a diff[obs] is its latest value.
+     */
+    int64_t *diff;
+
+    /** flags holds the LLI and SSI for each observation at the last
+     * epoch, two characters per observation.
+     */
+    char *flags;
+
+    /** last_epoch is one plus the index of the last observation epoch
+     * that included this satellite, or zero.
+     */
+    uint64_t last_epoch;
+
+    /** n_obs is the number of observation codes for the satellite. */
+    int n_obs;
 };
 
-/** crx_v23_parser is a CRX (Hatanaka compressed) v2.xx or v3.xx parser. */
+/** crx_v23_parser is a CRX (Hatanaka compressed) v2.xx or v3.xx parser.
+ *
+ * It rebuilds the RINEX text of each record and parses that with the
+ * RINEX parser's code, so both formats give the same results.
+ */
 struct crx_v23_parser
 {
     /** base describes the uncompressed RINEX content. */
@@ -72,29 +140,40 @@ struct crx_v23_parser
     /** epoch_alloc is the allocated length of #epoch_text. */
     int epoch_alloc;
 
-    /** max_order is the maximum differential order for any (active)
-     * observation.
+    /** epoch_len is the length of #epoch_text, or zero if the next
+     * epoch line must be an initialization line.
      */
-    int max_order;
+    int epoch_len;
 
-    /** epoch_text is the current uncompressed epoch header line, ending
-     * with a line feed ('\n') character.
+    /** epoch_text is the current uncompressed CRX epoch line, without
+     * its line feed.  It is followed by at least RINEX_EXTRA readable
+     * bytes.
      */
     char *epoch_text;
 
-    /** order is a pair of entries for each observation. \a order[2*n+0]
-     * is the differential order of each observation, up to 9.
-     * \a order[2*n+1] is how much of #diff is valid for the observation.
-     * The allocated length of `order` is 2*#base.obs_alloc.
+    /** text_alloc is the allocated length of #text. */
+    int text_alloc;
+
+    /** text holds the rebuilt RINEX text of the current record,
+     * followed by RINEX_EXTRA readable bytes.
      */
-    unsigned char *order;
+    char *text;
+
+    /** n_epochs counts the observation records read so far, not
+     * counting cycle slip records.
+     */
+    uint64_t n_epochs;
 
-    /** diff holds the differential state for each observation.  The
-     * allocated length is #base.obs_alloc * 10, in order-major layout.
-     * That is, \a diff[obs+n*base.obs_alloc] is the \a n'th-order
-     * history for observation \a obs.  Unused space is zero-filled.
+    /** clock holds the differential state for the receiver clock
+     * offset, in the same units as rinex_epoch.clock_offset.
      */
-    int *diff;
+    int64_t clock[CRX_MAX_ORDER + 1];
+
+    /** clock_order is laid out like one pair of crx_v23_sat.order. */
+    unsigned char clock_order[2];
+
+    /** sat is indexed by (system & 31) * RINEX_MAX_SVN + svn. */
+    struct crx_v23_sat *sat[32 * RINEX_MAX_SVN];
 };
 
 /** Initializes #page_size and other internal mmap state.
@@ -147,6 +226,47 @@ int rnx_find_header
     size_t sizeof_header
 );
 
+/** Copies a RINEX header and indexes its lines.
+ *
+ * This replaces each newline sequence (CR, LF or CRLF) with a single
+ * '\n' and removes trailing spaces from each line, while recording
+ * where each line starts and which lines have each header label.
+ *
+ * \param[out] index Receives the line index.  The caller must free
+ *   \a index->line_ofs.
+ * \param[out] out Receives the normalized header; must have room for
+ *   \a in_len bytes.
+ * \param[in] in Header to copy, followed by at least 32 readable bytes.
+ * \param[in] in_len Length of the header, including the final newline
+ *   sequence.
+ * \returns Length of output on success, RINEX_ERR_BAD_FORMAT on an
+ *   illegal line length, or RINEX_ERR_SYSTEM on allocation failure.
+ */
+int rnx_index_header
+(
+    struct rnx_header_index *index,
+    char out[],
+    const char in[],
+    int in_len
+);
+
+/** Looks up a header line using an index from rnx_index_header().
+ *
+ * \param[in] index Index of the header.
+ * \param[in] header Normalized header text.
+ * \param[in] label Header label to search for.
+ * \param[in] sizeof_label sizeof(label), including trailing NUL.
+ * \returns The offset of the first line with the label, or
+ *   RINEX_ERR_BAD_FORMAT if there is none.
+ */
+int rnx_lookup_header
+(
+    const struct rnx_header_index *index,
+    const char header[],
+    const char label[],
+    size_t sizeof_label
+);
+
 /** rnx_get_newlines tries to ensure multiple lines are in \a p->stream.
  *
  * \param[in,out] p Parser needing data to be copied.
@@ -227,4 +347,30 @@ int parse_uint
     int width
 );
 
+/** rnx_freq names the two carriers that dual-frequency combinations
+ * use for one satellite system, by RINEX band number, and gives their
+ * frequencies in Hz.
+ */
+struct rnx_freq
+{
+    /** Satellite system letter. */
+    char system;
+
+    /** RINEX band numbers of the first and second carriers. */
+    char band1;
+    char band2;
+
+    /** Frequencies of the first and second carriers, in Hz. */
+    double f1;
+    double f2;
+};
+
+/** Looks up the dual-frequency carrier pair for a satellite system.
+ *
+ * \param[in] system Satellite system letter, such as 'G'.
+ * 
+eturns The system's carrier pair, or NULL if it has none.
+ */
+const struct rnx_freq *rnx_find_freq(char system);
+
 #endif /* !defined(RINEX_P_H_a03d7227_442c_4822_a2d2_04bd8c5ff3e4) */
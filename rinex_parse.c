@@ -62,8 +62,11 @@ static __m256i rnx_parse_4(
     /* Accumulate adjacent (two-digit) int16_t's into int32_t's. */
     const __m256i t2_0 = _mm256_madd_epi16(t1_0, mul_1_100);
     const __m256i t2_1 = _mm256_madd_epi16(t1_1, mul_1_100);
-    /* Our int32_t's are only in the range 0..9999, so pack down. */
-    const __m256i t3 = _mm256_packus_epi32(t2_0, t2_1);
+    /* Our int32_t's are only in the range 0..9999, so pack down.  The
+     * pack works within 128-bit lanes, so put the values back in order.
+     */
+    const __m256i t3 = _mm256_permute4x64_epi64(
+        _mm256_packus_epi32(t2_0, t2_1), 0xD8);
     /* Combine adjacent (four-digit) int16_t's into int32_t's. */
     const __m256i t4 = _mm256_madd_epi16(t3, weight_3);
     /* Scale the high-order 32-bit values by 1e5. */
@@ -78,20 +81,20 @@ static __m256i rnx_parse_4(
     const __m256i v_ones = _mm256_cmpeq_epi64(v_zero, v_zero);
     __m256i mask = v_zero;
     int neg_0 = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v_minus, p_0));
-    if (neg_0 >> 16)
+    if (neg_0 & 65535)
     {
         mask = _mm256_blend_epi32(mask, v_ones, 0x03);
     }
-    if (neg_0 & 65535)
+    if (neg_0 >> 16)
     {
         mask = _mm256_blend_epi32(mask, v_ones, 0x0c);
     }
     int neg_1 = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v_minus, p_1));
-    if (neg_1 >> 16)
+    if (neg_1 & 65535)
     {
         mask = _mm256_blend_epi32(mask, v_ones, 0x30);
     }
-    if (neg_1 & 65535)
+    if (neg_1 >> 16)
     {
         mask = _mm256_blend_epi32(mask, v_ones, 0xc0);
     }
@@ -247,7 +250,7 @@ static const char *rnx_parse_obs
 )
 {
     char buf[16];
-    int kk;
+    int kk, neg = 0;
 
     /* The first 11 characters must be present: space, minus, digit or dot. */
     for (kk = 0; kk < 10; ++kk)
@@ -257,7 +260,9 @@ static const char *rnx_parse_obs
     }
     if (kk < 10 && *obs == '-')
     {
-        buf[kk++] = *obs++;
+        neg = 1;
+        buf[kk++] = ' ';
+        obs++;
     }
     for (; kk < 10; ++kk)
     {
@@ -295,6 +300,10 @@ static const char *rnx_parse_obs
         + INT64_C(100000000000) * DVAL(buf[1])
         + INT64_C(1000000000000) * DVAL(buf[0]);
 #undef DVAL
+    if (neg)
+    {
+        p->base.obs[nn] = -p->base.obs[nn];
+    }
 
     return obs;
 }
@@ -303,6 +312,72 @@ static const char *rnx_parse_obs
 
 static const char blank[] = "                ";
 
+/** rnx_grow_sats makes sure \a p->base.sats has room for every
+ * satellite in the current record.
+ */
+static rinex_error_t rnx_grow_sats(struct rnx_v23_parser *p)
+{
+    struct rinex_sat_entry *sats;
+    int new_alloc;
+
+    if (p->base.epoch.n_sats <= p->sats_alloc)
+    {
+        return RINEX_SUCCESS;
+    }
+
+    new_alloc = p->sats_alloc ? p->sats_alloc : 64;
+    while (new_alloc < p->base.epoch.n_sats)
+    {
+        new_alloc <<= 1;
+    }
+    sats = realloc(p->base.sats, new_alloc * sizeof sats[0]);
+    if (!sats)
+    {
+        p->base.error_line = __LINE__;
+        return RINEX_ERR_SYSTEM;
+    }
+    p->base.sats = sats;
+    p->sats_alloc = new_alloc;
+
+    return RINEX_SUCCESS;
+}
+
+/** rnx_sat_slot returns the index in rinex_parser.sat_slot for a
+ * satellite.  RINEX 2 allows a blank system identifier for GPS, so ' '
+ * and 'G' share slots.
+ */
+static inline int rnx_sat_slot(char system, unsigned char svn)
+{
+    return ((system == ' ' ? 'G' : system) & 31) * RINEX_MAX_SVN + svn;
+}
+
+/** rnx_add_sat fills in the directory entry for satellite \a ii,
+ * whose data starts at \a buffer_ofs in \a p->base.buffer and at
+ * \a obs_ofs in \a p->base.obs, and ends at \a obs_end.
+ */
+static inline void rnx_add_sat(
+    struct rnx_v23_parser *p,
+    int ii,
+    char system,
+    char svn,
+    int buffer_ofs,
+    int obs_ofs,
+    int obs_end
+)
+{
+    struct rinex_sat_entry *sat = p->base.sats + ii;
+
+    sat->system = system;
+    sat->svn = svn;
+    sat->n_obs = obs_end - obs_ofs;
+    sat->buffer_ofs = buffer_ofs;
+    sat->obs_ofs = obs_ofs;
+    if (p->base.sat_slot)
+    {
+        p->base.sat_slot[rnx_sat_slot(system, svn)] = ii;
+    }
+}
+
 /** rnx_read_v2_observations reads observations from \a p. */
 static rinex_error_t rnx_read_v2_observations(
     struct rnx_v23_parser *p,
@@ -319,6 +394,11 @@ static rinex_error_t rnx_read_v2_observations(
     char *buffer;
     int ii, jj, nn;
 
+    if (rnx_grow_sats(p) != RINEX_SUCCESS)
+    {
+        return RINEX_ERR_SYSTEM;
+    }
+
     /* Read observations for each satellite. */
     p->base.buffer_len = 0;
     buffer = p->base.buffer + p->base.buffer_len;
@@ -329,6 +409,7 @@ static rinex_error_t rnx_read_v2_observations(
         int n_obs = p->base.n_obs[sv_name[0] & 31];
         char svn = (sv_name[1] - '0') * 10 + sv_name[2] - '0';
         uint8_t obs_mask = 0; /* presence bitmask for observations */
+        const int obs_ofs = nn;
 
         /* There are 12 satellite names per header line. */
         if (ii % 12 == 11)
@@ -399,7 +480,7 @@ static rinex_error_t rnx_read_v2_observations(
                 __m128i lli_ssi = _mm_unpackhi_epi32(lli_ssi_03, lli_ssi_47);
                 _mm_storel_epi64((__m128i *)(p->base.lli + nn - 7), lli_ssi);
                 _mm_storel_epi64((__m128i *)(p->base.ssi + nn - 7),
-                    _mm_shuffle_epi32(lli_ssi, 0xB1));
+                    _mm_unpackhi_epi64(lli_ssi, lli_ssi));
                 _mm256_storeu_si256((__m256i *)(p->base.obs + nn - 7),
                     rnx_parse_4(v_obs));
                 _mm256_storeu_si256((__m256i *)(p->base.obs + nn - 3),
@@ -446,6 +527,7 @@ eol:
         }
 
         /* Make sure buffer_len is updated. */
+        rnx_add_sat(p, ii, sv_name[0], svn, p->base.buffer_len, obs_ofs, nn);
         p->base.buffer_len = buffer - p->base.buffer;
     }
 
@@ -494,27 +576,16 @@ static int rnx_v2_parse_time(struct rnx_v23_parser *p, const char *line)
     return 0;
 }
 
-/** rnx_read_v2 reads an observation data record from \a p_. */
-static rinex_error_t rnx_read_v2(struct rinex_parser *p_)
+/** rnx_v2_parse_epoch parses the first line of a RINEX 2 record,
+ * which is \a line_len bytes long (not counting its newline).
+ */
+static int rnx_v2_parse_epoch(
+    struct rnx_v23_parser *p,
+    const char *line,
+    int line_len
+)
 {
-    struct rnx_v23_parser *p = (struct rnx_v23_parser *)p_;
-    const char *line;
-    rinex_error_t err;
-    int res, nn, n_sats, body_ofs, line_len;
-
-    /* Make sure we have an epoch to parse. */
-    res = rnx_get_newlines(p_, &p->parse_ofs, NULL, 0, 1);
-    if (res <= RINEX_EOF)
-    {
-        return res;
-    }
-    if (res < 33)
-    {
-        p_->error_line = __LINE__;
-        return RINEX_ERR_BAD_FORMAT;
-    }
-    line_len = res - 1 - p->parse_ofs;
-    line = p->base.stream->buffer + p->parse_ofs;
+    int res;
 
     /* Parse the timestamp, epoch flag and "number of satellites" field. */
     res = rnx_v2_parse_time(p, line);
@@ -532,15 +603,44 @@ static rinex_error_t rnx_read_v2(struct rinex_parser *p_)
     {
         if (parse_fixed(&p->base.epoch.clock_offset, line+68, 12, 9))
         {
-            p_->error_line = __LINE__;
+            p->base.error_line = __LINE__;
             return RINEX_ERR_BAD_FORMAT;
         }
     }
     else
+    {
+        p->base.error_line = __LINE__;
+        return RINEX_ERR_BAD_FORMAT;
+    }
+
+    return 0;
+}
+
+/** rnx_read_v2 reads an observation data record from \a p_. */
+static rinex_error_t rnx_read_v2(struct rinex_parser *p_)
+{
+    struct rnx_v23_parser *p = (struct rnx_v23_parser *)p_;
+    const char *line;
+    rinex_error_t err;
+    int res, nn, n_sats, body_ofs;
+
+    /* Make sure we have an epoch to parse. */
+    res = rnx_get_newlines(p_, &p->parse_ofs, NULL, 0, 1);
+    if (res <= RINEX_EOF)
+    {
+        return res;
+    }
+    if (res < 33)
     {
         p_->error_line = __LINE__;
         return RINEX_ERR_BAD_FORMAT;
     }
+    line = p->base.stream->buffer + p->parse_ofs;
+    res = rnx_v2_parse_epoch(p, line, res - 1 - p->parse_ofs);
+    if (res < 0)
+    {
+        return res;
+    }
 
     /* Is it a set of observations or a special event? */
     n_sats = p->base.epoch.n_sats;
@@ -562,6 +662,8 @@ static rinex_error_t rnx_read_v2(struct rinex_parser *p_)
             return res;
         }
         line = p->base.stream->buffer + p->parse_ofs;
+        p->base.slip_text = line;
+        p->base.slip_text_len = res - p->parse_ofs;
         p->parse_ofs = res;
 
         return rnx_read_v2_observations(p, line,
@@ -612,6 +714,11 @@ static rinex_error_t rnx_read_v3_observations(
     char *buffer;
     int ii, jj, nn;
 
+    if (rnx_grow_sats(p) != RINEX_SUCCESS)
+    {
+        return RINEX_ERR_SYSTEM;
+    }
+
     /* Read observations for each satellite. */
     p->base.buffer_len = 0;
     buffer = p->base.buffer + p->base.buffer_len;
@@ -622,6 +729,7 @@ static rinex_error_t rnx_read_v3_observations(
         short n_obs = p->base.n_obs[sv_name[0] & 31];
         char svn = (sv_name[1] - '0') * 10 + sv_name[2] - '0';
         uint8_t obs_mask = 0; /* presence bitmask for observations */
+        const int obs_ofs = nn;
         obs += 3;
 
         /* Grow buffer if needed. */
@@ -690,7 +798,7 @@ static rinex_error_t rnx_read_v3_observations(
                 __m128i lli_ssi = _mm_unpackhi_epi32(lli_ssi_03, lli_ssi_47);
                 _mm_storel_epi64((__m128i *)(p->base.lli + nn - 7), lli_ssi);
                 _mm_storel_epi64((__m128i *)(p->base.ssi + nn - 7),
-                    _mm_shuffle_epi32(lli_ssi, 0xB1));
+                    _mm_unpackhi_epi64(lli_ssi, lli_ssi));
                 _mm256_storeu_si256((__m256i *)(p->base.obs + nn - 7),
                     rnx_parse_4(v_obs));
                 _mm256_storeu_si256((__m256i *)(p->base.obs + nn - 3),
@@ -732,6 +840,7 @@ static rinex_error_t rnx_read_v3_observations(
         }
 
         /* Make sure buffer_len is updated. */
+        rnx_add_sat(p, ii, sv_name[0], svn, p->base.buffer_len, obs_ofs, nn);
         p->base.buffer_len = buffer - p->base.buffer;
 
         if (*obs != '\n')
@@ -759,85 +868,120 @@ static rinex_error_t rnx_read_v3_observations(
     return RINEX_SUCCESS;
 }
 
-/** rnx_read_v3 reads an observation data record from \a p_. */
-static rinex_error_t rnx_read_v3(struct rinex_parser *p_)
+/** rnx_v3_parse_epoch parses the first line of a RINEX 3 record,
+ * which is \a line_len bytes long (not counting its newline).
+ */
+static int rnx_v3_parse_epoch(
+    struct rnx_v23_parser *p,
+    const char *line,
+    int line_len
+)
 {
-    struct rnx_v23_parser *p = (struct rnx_v23_parser *)p_;
-    const char *line;
     int64_t i64;
-    int res, yy, mm, dd, hh, min, n_sats, line_len;
+    int yy, mm, dd, hh, min, n_sats;
 
-    /* Make sure we have an epoch to parse. */
-    res = rnx_get_newlines(p_, &p->parse_ofs, NULL, 0, 1);
-    if (res <= RINEX_EOF)
-    {
-        return res;
-    }
-    if (res < 35)
+    /* Parse the timestamp, epoch flag and "number of satellites" field.
+     * As in RINEX 2, special events may leave the time blank.
+     */
+    i64 = 0;
+    yy = mm = dd = hh = min = n_sats = 0;
+    if (line_len < 35 || line[0] != '>' || line[31] < '0' || line[31] > '6')
     {
-        p_->error_line = __LINE__;
+        p->base.error_line = __LINE__;
         return RINEX_ERR_BAD_FORMAT;
     }
-    line_len = res - p->parse_ofs;
-    line = p->base.stream->buffer + p->parse_ofs;
-    p->parse_ofs = res;
-
-    /* Parse the timestamp, epoch flag and "number of satellites" field. */
-    if ((line[0] != '>' || line[31] < '0' || line[31] > '6')
-        || parse_uint(&yy, line+2, 4) || parse_uint(&mm, line+7, 2)
+    if (parse_uint(&yy, line+2, 4) || parse_uint(&mm, line+7, 2)
         || parse_uint(&dd, line+10, 2) || parse_uint(&hh, line+13, 2)
         || parse_uint(&min, line+16, 2) || parse_uint(&n_sats, line+32, 3)
         || parse_fixed(&i64, line+18, 11, 7))
     {
-        p_->error_line = __LINE__;
-        return RINEX_ERR_BAD_FORMAT;
+        if (line[31] < '2' || line[31] == '6')
+        {
+            p->base.error_line = __LINE__;
+            return RINEX_ERR_BAD_FORMAT;
+        }
     }
     p->base.epoch.yyyy_mm_dd = (yy * 100 + mm) * 100 + dd;
     p->base.epoch.hh_mm = hh * 100 + min;
     p->base.epoch.sec_e7 = i64;
-    p->base.epoch.flag = line[28];
+    p->base.epoch.flag = line[31];
     p->base.epoch.n_sats = n_sats;
 
-    /* Is there a receiver clock offset? */
-    if (line_len <= 44)
+    /* Is there a receiver clock offset?  It follows six reserved
+     * columns.
+     */
+    if (line_len <= 41)
     {
         p->base.epoch.clock_offset = 0;
     }
-    else if (line_len == 59)
+    else if (line_len == 56)
     {
-        if (parse_fixed(&p->base.epoch.clock_offset, line+44, 15, 12))
+        if (parse_fixed(&p->base.epoch.clock_offset, line+41, 15, 12))
         {
-            p_->error_line = __LINE__;
+            p->base.error_line = __LINE__;
             return RINEX_ERR_BAD_FORMAT;
         }
     }
     else
     {
-        p_->error_line = __LINE__;
+        p->base.error_line = __LINE__;
         return RINEX_ERR_BAD_FORMAT;
     }
 
-    /* Get enough data. */
-    res = rnx_get_newlines(p_, &p->parse_ofs, NULL, 0, n_sats);
+    return 0;
+}
+
+/** rnx_read_v3 reads an observation data record from \a p_. */
+static rinex_error_t rnx_read_v3(struct rinex_parser *p_)
+{
+    struct rnx_v23_parser *p = (struct rnx_v23_parser *)p_;
+    const char *line;
+    rinex_error_t err;
+    int res;
+
+    /* Make sure we have an epoch to parse. */
+    res = rnx_get_newlines(p_, &p->parse_ofs, NULL, 0, 1);
     if (res <= RINEX_EOF)
     {
         return res;
     }
-    line_len = res - p->parse_ofs;
     line = p->base.stream->buffer + p->parse_ofs;
-    p->parse_ofs = res;
+    res = rnx_v3_parse_epoch(p, line, res - 1 - p->parse_ofs);
+    if (res < 0)
+    {
+        return res;
+    }
+
+    /* Get the whole record, starting from its epoch line. */
+    res = rnx_get_newlines(p_, &p->parse_ofs, NULL, 0,
+        p->base.epoch.n_sats + 1);
+    if (res <= RINEX_EOF)
+    {
+        if (res == RINEX_EOF)
+        {
+            res = RINEX_ERR_BAD_FORMAT;
+        }
+        p_->error_line = __LINE__;
+        return res;
+    }
+    line = p->base.stream->buffer + p->parse_ofs;
 
     /* Is it a set of observations or a special event? */
     switch (p->base.epoch.flag)
     {
     case '0': case '1': case '6':
-        return rnx_read_v3_observations(p, line);
+        p->base.slip_text = line;
+        p->base.slip_text_len = res - p->parse_ofs;
+        p->parse_ofs = res;
+        return rnx_read_v3_observations(p, strchr(line, '\n') + 1);
 
     case '2': case '3': case '4': case '5':
-        /* We already did most of the work. */
-        memcpy(p->base.buffer, line, line_len);
-        p->base.buffer_len = line_len;
-        return RINEX_SUCCESS;
+        err = rnx_copy_text(p, res);
+        if (err == RINEX_SUCCESS)
+        {
+            p->parse_ofs = res;
+        }
+        return err;
     }
 
     p_->error_line = __LINE__;
@@ -854,274 +998,605 @@ static void rnx_free_v23(struct rinex_parser *p_)
     free(p->base.lli);
     free(p->base.ssi);
     free(p->base.obs);
+    free(p->base.sats);
+    free(p->base.sat_slot);
+    free(p->header.line_ofs);
     free(p);
 }
 
-/** crx_line_space ensures \a crx->epoch_text >= \a line_len. */
-static int crx_line_space(struct crx_v23_parser *crx, int line_len)
+/** crx_reserve makes sure \a *p_buf can hold \a len bytes plus
+ * RINEX_EXTRA readable bytes after them.  New bytes are spaces.
+ * \returns Zero on success, else RINEX_ERR_SYSTEM.
+ */
+static int crx_reserve(char **p_buf, int *p_alloc, int len)
 {
-    if (crx->epoch_alloc <= line_len)
+    char *buf;
+    int alloc;
+
+    len += RINEX_EXTRA;
+    if (*p_alloc >= len)
     {
-        int new_len = crx->epoch_alloc * 2;
-        if (new_len <= line_len)
-            new_len = line_len + 1;
-        crx->epoch_text = realloc(crx->epoch_text, new_len);
-        if (!crx->epoch_text)
-            return RINEX_ERR_SYSTEM;
+        return 0;
     }
 
+    alloc = *p_alloc ? *p_alloc : 256;
+    while (alloc < len)
+    {
+        alloc <<= 1;
+    }
+    buf = realloc(*p_buf, alloc);
+    if (!buf)
+    {
+        return RINEX_ERR_SYSTEM;
+    }
+    memset(buf + *p_alloc, ' ', alloc - *p_alloc);
+    *p_buf = buf;
+    *p_alloc = alloc;
     return 0;
 }
 
-/** crx_read_v2_move_sv moves a satellite. */
-static int crx_read_v2_move_sv(
+/** crx_get_sat finds or creates the state for a satellite.
+ * \returns The satellite state, or NULL on allocation failure.
+ */
+static struct crx_v23_sat *crx_get_sat(
     struct crx_v23_parser *crx,
-    int idx,
-    int n_obs,
-    const char sv[2]
+    char system,
+    int svn,
+    int n_obs
 )
 {
-    int jj, kk;
+    struct crx_v23_sat *sat;
+    int idx;
 
-    /* We found a change.  If the satelite already has history, it will
-     * be later in the array, so we swap the two.
-     */
-    for (jj = idx + 1; jj < crx->base.base.epoch.n_sats; ++jj)
+    idx = (system & 31) * RINEX_MAX_SVN + svn;
+    sat = crx->sat[idx];
+    if (sat)
     {
-        if (crx->base.base.buffer[2*jj+0] == sv[0]
-            && crx->base.base.buffer[2*jj+1] == sv[1])
-        {
-            break;
-        }
+        return sat;
     }
 
-    /* Is the satellite new? */
-    if (jj == crx->base.base.epoch.n_sats)
+    sat = calloc(1, sizeof(*sat) + n_obs * (2 + 2 + (CRX_MAX_ORDER + 1)
+        * sizeof(int64_t)));
+    if (!sat)
     {
-        /* TODO: May need to increase buffer sizes. */
+        return NULL;
     }
-    else /* "Swap" satellites idx and jj. */
+    sat->diff = (int64_t *)(sat + 1);
+    sat->order = (unsigned char *)(sat->diff + n_obs * (CRX_MAX_ORDER + 1));
+    sat->flags = (char *)(sat->order + 2 * n_obs);
+    sat->n_obs = n_obs;
+    crx->sat[idx] = sat;
+    return sat;
+}
+
+/** crx_parse_int parses a signed decimal integer at \a *p_pos.
+ * \returns Zero on success, else -1 if there are no digits.
+ */
+static int crx_parse_int(const char **p_pos, const char *end, int64_t *p_out)
+{
+    const char *pos = *p_pos;
+    uint64_t accum;
+    int neg;
+
+    neg = (pos < end && *pos == '-');
+    pos += neg;
+    if (pos >= end || !isdigit(*pos))
     {
-        /* In practice, we have to shift the observations from idx+1
-         * through jj (inclusive) down to idx.
-         */
-        for (kk = 0; kk < n_obs; ++kk) ;
-        /* crx->base.base.lli[...] */
+        return -1;
+    }
+    for (accum = 0; pos < end && isdigit(*pos); ++pos)
+    {
+        accum = accum * 10 + (*pos - '0');
     }
 
-    /* cf. mty22000.20d line 1774 vs mty22000.20o line 8080,
-     * then .20d line 1818 vs .20o line 8284,
-     * or .20d line 10499 vs .20o line 48673
-     */
-
+    *p_out = neg ? -(int64_t)accum : (int64_t)accum;
+    *p_pos = pos;
     return 0;
 }
 
-/** crx_read_v2_sv_list checks an updated CRX satellite list. */
-static int crx_read_v2_sv_list(struct crx_v23_parser *crx)
+/** crx_get_field decodes the differenced field at \a *p_pos, which
+ * starts a new arc if it looks like "n&value".
+ *
+ * \param[in,out] p_pos Start of the field; receives its end.
+ * \param[in] end End of the line.
+ * \param[in,out] diff History, with level \a k at \a diff[k*stride].
+ * \param[in] stride Distance between levels of \a diff.
+ * \param[in,out] order Order pair, as in crx_v23_sat.order.
+ * \returns Zero on success, else -1 if the field is invalid.
+ */
+static int crx_get_field(
+    const char **p_pos,
+    const char *end,
+    int64_t *diff,
+    size_t stride,
+    unsigned char order[2]
+)
 {
-    char *old, *pos;
-    int n_sat, n_obs, ii;
-    char sv[2];
+    const char *pos = *p_pos;
+    int64_t value;
+    int levels, kk;
 
-    /* How many satellites are listed now? */
-    if (parse_uint(&n_sat, crx->epoch_text + 30, 2))
+    if (end - pos >= 2 && pos[1] == '&')
     {
-        crx->base.base.error_line = __LINE__;
-        return RINEX_ERR_BAD_FORMAT;
+        if (!isdigit(pos[0]) || pos[0] - '0' > CRX_MAX_ORDER)
+        {
+            return -1;
+        }
+        *p_pos = pos + 2;
+        if (crx_parse_int(p_pos, end, &value))
+        {
+            return -1;
+        }
+        order[0] = pos[0] - '0';
+        order[1] = 1;
+        diff[0] = value;
+        return 0;
+    }
+
+    if (!order[1] || crx_parse_int(p_pos, end, &value))
+    {
+        return -1;
     }
 
-    /* Check for changes in the SV list. */
-    old = crx->base.base.buffer;
-    pos = crx->epoch_text + 32;
-    n_obs = crx->base.base.n_obs[old[0] & 31]; /* constant for RINEX v2 */
-    for (ii = 0; ii < n_sat; ++ii)
+    /* The field is the highest difference so far; sum back down to
+     * the value itself.
+     */
+    levels = order[1] + (order[1] <= order[0]);
+    diff[(levels - 1) * stride] = value;
+    for (kk = levels - 2; kk >= 0; --kk)
     {
-        sv[0] =  pos[0];
-        sv[1] = (pos[1] - '0') * 10 + (pos[2] - '0');
-        if (sv[0] != old[0] || sv[1] != old[1])
+        diff[kk * stride] += diff[(kk + 1) * stride];
+    }
+    order[1] = levels;
+    return 0;
+}
+
+/** crx_apply_diff applies the \a len byte text difference at \a line
+ * to \a text: spaces keep the old character, '&' makes a space, and
+ * anything else replaces the old character.
+ */
+static void crx_apply_diff(char *text, const char *line, int len)
+{
+    int ii;
+
+    for (ii = 0; ii < len; ++ii)
+    {
+        if (line[ii] == '&')
         {
-            crx_read_v2_move_sv(crx, ii, n_obs, sv);
+            text[ii] = ' ';
+        }
+        else if (line[ii] != ' ')
+        {
+            text[ii] = line[ii];
         }
-
-        old += 2 + (n_obs + 7) / 8;
-        pos += 3;
     }
+}
+
+/** crx_put_fixed writes \a value, in units of 10**-\a frac, as a
+ * \a width character fixed-point field.
+ * \returns The end of the field, or NULL if \a value does not fit.
+ */
+static char *crx_put_fixed(char *out, int64_t value, int width, int frac)
+{
+    uint64_t mag;
+    int ii;
 
-    /* Did the number of satellites go down? */
-    if (n_sat < crx->base.base.epoch.n_sats)
+    mag = (value < 0) ? -(uint64_t)value : (uint64_t)value;
+    for (ii = width; ii > width - frac; mag /= 10)
+    {
+        out[--ii] = '0' + mag % 10;
+    }
+    out[--ii] = '.';
+    do
+    {
+        out[--ii] = '0' + mag % 10;
+        mag /= 10;
+    } while (mag && ii > 0);
+    if (mag || (value < 0 && ii == 0))
     {
-        crx->base.base.epoch.n_sats = n_sat;
+        return NULL;
+    }
+    if (value < 0)
+    {
+        out[--ii] = '-';
     }
+    memset(out, ' ', ii);
+    return out + width;
+}
 
-    return 0;
+/** crx_end_line trims trailing spaces from the line that starts at
+ * \a line and ends at \a out, then appends a newline.
+ * \returns The start of the next line.
+ */
+static char *crx_end_line(const char *line, char *out)
+{
+    while (out > line && out[-1] == ' ')
+    {
+        --out;
+    }
+    *out++ = '\n';
+    return out;
 }
 
-/** crx_read_v2 reads an observation data record from \a p_. */
-static rinex_error_t crx_read_v2(struct rinex_parser *p_)
+/** crx_read_event copies a special event record, whose epoch line is
+ * in \a crx->epoch_text and is followed by \a n_lines lines, to
+ * \a crx->base.base.buffer.
+ */
+static rinex_error_t crx_read_event(struct crx_v23_parser *crx, int n_lines)
 {
-    struct crx_v23_parser *crx = (struct crx_v23_parser *)p_;
     struct rnx_v23_parser *p = &crx->base;
-    const char *line;
-    int res, err, line_len, ii;
+    int res, len;
 
-    /* CRXv2 epoch headers have date+time & SV list, then clock offset. */
-    res = rnx_get_newlines(p_, &p->parse_ofs, NULL, 0, 2);
-    if (res < 21)
+    res = rnx_get_newlines(&p->base, &p->parse_ofs, NULL, 0, n_lines);
+    if (n_lines > 0 && res <= RINEX_EOF)
     {
-        if (res <= RINEX_EOF)
+        p->base.error_line = __LINE__;
+        return (res == RINEX_EOF) ? RINEX_ERR_BAD_FORMAT : res;
+    }
+    if (n_lines == 0)
+    {
+        res = p->parse_ofs;
+    }
+
+    len = crx->epoch_len + 1 + (res - p->parse_ofs);
+    while (p->buffer_alloc < len)
+    {
+        p->buffer_alloc <<= 1;
+    }
+    p->base.buffer = realloc(p->base.buffer, p->buffer_alloc);
+    if (!p->base.buffer)
+    {
+        p->base.error_line = __LINE__;
+        return RINEX_ERR_SYSTEM;
+    }
+    memcpy(p->base.buffer, crx->epoch_text, crx->epoch_len);
+    p->base.buffer[crx->epoch_len] = '\n';
+    memcpy(p->base.buffer + crx->epoch_len + 1,
+        p->base.stream->buffer + p->parse_ofs, res - p->parse_ofs);
+    p->base.buffer_len = len;
+    p->parse_ofs = res;
+
+    /* The next epoch line is written in full. */
+    crx->epoch_len = 0;
+    return RINEX_SUCCESS;
+}
+
+/** crx_read_sat decodes one satellite's data line, \a line to \a end,
+ * and appends its RINEX observation text to \a out.
+ *
+ * \param[in,out] crx Parser state.
+ * \param[in] sv Satellite identifier from the epoch line.
+ * \param[in] line Start of the Compact RINEX data line.
+ * \param[in] end End of the data line.
+ * \param[in] out Where to write the RINEX text.
+ * \param[in] version Major RINEX version, 2 or 3.
+ * \param[in] restart Non-zero for a cycle slip record.
+ * \returns The end of the RINEX text, or NULL on error.
+ */
+static char *crx_read_sat(
+    struct crx_v23_parser *crx,
+    const char *sv,
+    const char *line,
+    const char *end,
+    char *out,
+    int version,
+    int restart
+)
+{
+    struct crx_v23_sat *sat;
+    const char *pos;
+    char *obs_line;
+    int nn, n_obs, svn;
+
+    n_obs = crx->base.base.n_obs[sv[0] & 31];
+    if (n_obs < 1 || !isdigit(sv[1]) || !isdigit(sv[2]))
+    {
+        crx->base.base.error_line = __LINE__;
+        return NULL;
+    }
+    svn = (sv[1] - '0') * 10 + sv[2] - '0';
+    sat = crx_get_sat(crx, sv[0], svn, n_obs);
+    if (!sat)
+    {
+        crx->base.base.error_line = __LINE__;
+        return NULL;
+    }
+
+    /* A satellite that was not in the last epoch starts over. */
+    if (restart || !sat->last_epoch || sat->last_epoch != crx->n_epochs)
+    {
+        for (nn = 0; nn < n_obs; ++nn)
         {
-            return res;
+            sat->order[2 * nn + 1] = 0;
         }
+        memset(sat->flags, ' ', 2 * n_obs);
+    }
 
-        /* At EOF, try getting a single line instead. */
-        if ((res > RINEX_EOF)
-            || ((res = rnx_get_newlines(p_, &p->parse_ofs, NULL, 0, 1)) < 20))
+    /* Each field is followed by one space, and an empty field is a
+     * missing observation.  The LLI/SSI text difference comes last.
+     */
+    for (nn = 0, pos = line; nn < n_obs; ++nn)
+    {
+        if (pos < end && *pos != ' ')
         {
-            /* error_line already set by rnx_get_newlines() */
+            if (crx_get_field(&pos, end, sat->diff + nn, n_obs,
+                    sat->order + 2 * nn)
+                || (pos < end && *pos != ' '))
+            {
+                crx->base.base.error_line = __LINE__;
+                return NULL;
+            }
         }
-        /* Getting here should mean a single-line special event at EOF.
-        * These are represented as full initialization lines, but
-        * with an epoch flag of 2 through 5 inclusive.
-        */
         else
         {
-           line = p_->stream->buffer + p->parse_ofs;
-            if (line[0] == '&' && line[28] >= '2' && line[28] <= '5')
-            {
-crx_v2_copy_text:
-                res = rnx_copy_text(p, res);
-                if (res == RINEX_SUCCESS)
-                {
-                    /* Replace leading '&' with a space to be RINEX. */
-                    p->base.buffer[0] = ' ';
-                    p->parse_ofs = res;
-                }
-                return res;
-            }
-            else /* The file looks corrupt or truncated. */
-            {
-                p_->error_line = __LINE__;
-            }
+            sat->order[2 * nn + 1] = 0;
         }
-
-        return RINEX_ERR_BAD_FORMAT;
+        pos += (pos < end);
     }
-    line = p_->stream->buffer + p->parse_ofs;
-    line_len = strchr(line, '\n') - line;
+    crx_apply_diff(sat->flags, pos,
+        (end - pos < 2 * n_obs) ? end - pos : 2 * n_obs);
+    sat->last_epoch = restart ? 0 : crx->n_epochs + 1;
 
-    /* A valid event header has at least event type and line count. */
-    if (line_len < 32)
+    /* RINEX 2 puts five observations on each line; RINEX 3 starts the
+     * line with the satellite identifier.
+     */
+    obs_line = out;
+    if (version == 3)
     {
-        p_->error_line = __LINE__;
-        return RINEX_ERR_BAD_FORMAT;
+        memcpy(out, sv, 3);
+        out += 3;
     }
-
-    /* What is the line format? */
-    if (line[0] == ' ') /* delta header line */
+    for (nn = 0; nn < n_obs; ++nn)
     {
-        crx_line_space(crx, res);
-
-        /* Apply the update(s) to the header line. */
-        for (ii = 1; ii < res; ++ii)
+        if (!sat->order[2 * nn + 1])
         {
-            if (line[ii] == ' ')
-            {
-                /* leave the existing character */
-            }
-            else if (line[ii] == '&')
-            {
-                crx->epoch_text[ii] = ' ';
-            }
-            else
-            {
-                crx->epoch_text[ii] = line[ii];
-            }
+            memset(out, ' ', 16);
         }
-
-        /* Discard any residual trailing spaces. */
-        while (crx->epoch_text[ii-1] == ' ')
-            ii--;
-        crx->epoch_text[ii] = '\0';
-
-        /* Parse the timestamp, epoch flag, etc. */
-        err = rnx_v2_parse_time(p, crx->epoch_text);
-        if (err == 0 && ii > 33)
+        else if (!crx_put_fixed(out, sat->diff[nn], 14, 3))
         {
-            err = crx_read_v2_sv_list(crx);
+            crx->base.base.error_line = __LINE__;
+            return NULL;
         }
-        if (err < 0)
+        else
         {
-            return err;
+            out[14] = sat->flags[2 * nn];
+            out[15] = sat->flags[2 * nn + 1];
         }
+        out += 16;
 
-        /* TODO: Handle the compressed data record.  The first line is
-         * mandatorily blank.
-         */
-        return RINEX_SUCCESS;
+        if (version == 2 && (nn % 5 == 4 || nn + 1 == n_obs))
+        {
+            out = crx_end_line(obs_line, out);
+            obs_line = out;
+        }
     }
-    else if (line[0] != '&') /* otherwise should be a full initialization header line */
+
+    return (version == 3) ? crx_end_line(obs_line, out) : out;
+}
+
+/** crx_read_v23 reads a Compact RINEX 1.0 or 3.0 record from \a crx.
+ *
+ * Observation records are rebuilt as RINEX text in \a crx->text and
+ * then parsed like a RINEX file.
+ *
+ * \param[in,out] crx Parser to read from.
+ * \param[in] version Major RINEX version, 2 or 3.
+ * \returns A rinex_error_t status code.
+ */
+static rinex_error_t crx_read_v23(struct crx_v23_parser *crx, int version)
+{
+    struct rnx_v23_parser *p = &crx->base;
+    const char *line, *end, *pos;
+    char *out;
+    int res, len, ii, nn, n_sats, n_obs, sat_col, first_len, restart;
+    char flag;
+
+    /* The epoch line is either in full or a text difference. */
+    res = rnx_get_newlines(&p->base, &p->parse_ofs, NULL, 0, 1);
+    if (res <= RINEX_EOF)
     {
-        p_->error_line = __LINE__;
+        return res;
+    }
+    line = p->base.stream->buffer + p->parse_ofs;
+    len = res - 1 - p->parse_ofs;
+    p->parse_ofs = res;
+    if (crx_reserve(&crx->epoch_text, &crx->epoch_alloc, len))
+    {
+        p->base.error_line = __LINE__;
+        return RINEX_ERR_SYSTEM;
+    }
+    if (line[0] == ((version == 2) ? '&' : '>'))
+    {
+        memcpy(crx->epoch_text, line, len);
+        crx->epoch_text[0] = (version == 2) ? ' ' : '>';
+        crx->epoch_len = len;
+    }
+    else if (crx->epoch_len > 0)
+    {
+        if (crx->epoch_len < len)
+        {
+            memset(crx->epoch_text + crx->epoch_len, ' ',
+                len - crx->epoch_len);
+            crx->epoch_len = len;
+        }
+        crx_apply_diff(crx->epoch_text, line, len);
+    }
+    else
+    {
+        p->base.error_line = __LINE__;
         return RINEX_ERR_BAD_FORMAT;
     }
-    else if (line[28] == '0' || line[28] == '1') /* epoch flag 0 or 1 */
+
+    /* Special events are copied as they are. */
+    sat_col = (version == 2) ? 32 : 41;
+    len = (crx->epoch_len < sat_col) ? crx->epoch_len : sat_col;
+    res = (version == 2)
+        ? rnx_v2_parse_epoch(p, crx->epoch_text, len)
+        : rnx_v3_parse_epoch(p, crx->epoch_text, len);
+    if (res < 0)
+    {
+        return res;
+    }
+    flag = p->base.epoch.flag;
+    n_sats = p->base.epoch.n_sats;
+    if (flag >= '2' && flag <= '5')
     {
-        crx_line_space(crx, res);
+        return crx_read_event(crx, n_sats);
+    }
 
-        /* Copy the initialization header line. */
-        memcpy(crx->epoch_text + 1, line + 1, res - 1);
-        crx->epoch_text[0] = ' ';
-        crx->epoch_text[res] = '\0';
+    /* Otherwise the epoch line ends with the satellite list. */
+    if (crx_reserve(&crx->epoch_text, &crx->epoch_alloc, sat_col + 3 * n_sats))
+    {
+        p->base.error_line = __LINE__;
+        return RINEX_ERR_SYSTEM;
+    }
+    if (crx->epoch_len < sat_col + 3 * n_sats)
+    {
+        memset(crx->epoch_text + crx->epoch_len, ' ',
+            sat_col + 3 * n_sats - crx->epoch_len);
+    }
+    crx->epoch_len = sat_col + 3 * n_sats;
 
-        /* Parse the timestamp, epoch flag, etc. */
-        err = rnx_v2_parse_time(p, crx->epoch_text);
-        if (err < 0)
-        {
-            return err;
-        }
+    /* Get the clock offset line and a data line per satellite. */
+    res = rnx_get_newlines(&p->base, &p->parse_ofs, NULL, 0, n_sats + 1);
+    if (res <= RINEX_EOF)
+    {
+        p->base.error_line = __LINE__;
+        return (res == RINEX_EOF) ? RINEX_ERR_BAD_FORMAT : res;
+    }
+    line = p->base.stream->buffer + p->parse_ofs;
+    p->parse_ofs = res;
 
-        /* TODO: Fully initialize decompression state.
-         * The next line is mandatorily blank.
-         */
-        return RINEX_SUCCESS;
+    /* Make room for the RINEX text. */
+    for (ii = len = 0; ii < n_sats; ++ii)
+    {
+        n_obs = p->base.n_obs[crx->epoch_text[sat_col + 3 * ii] & 31];
+        len += (version == 2) ? 81 * ((n_obs + 4) / 5) : 4 + 16 * n_obs;
     }
-    else /* epoch flag > 1, a special event record */
+    len += 81 * (n_sats / 12 + 1);
+    if (crx_reserve(&crx->text, &crx->text_alloc, len))
     {
-        int n_lines;
+        p->base.error_line = __LINE__;
+        return RINEX_ERR_SYSTEM;
+    }
+
+    /* Cycle slip records restart every arc, before and after. */
+    restart = (flag == '6');
+    if (restart)
+    {
+        crx->clock_order[1] = 0;
+    }
 
-        /* How many lines in this special event record? */
-        if (parse_uint(&n_lines, line + 29, 3))
+    /* Rebuild the first epoch line, with any receiver clock offset. */
+    out = crx->text;
+    nn = (version == 2 && n_sats > 12) ? 12 : n_sats;
+    memcpy(out, crx->epoch_text, (version == 2) ? 32 + 3 * nn : 35);
+    out += (version == 2) ? 32 + 3 * nn : 35;
+    end = memchr(line, '\n', p->base.stream->buffer + res - line);
+    if (end == line)
+    {
+        crx->clock_order[1] = 0;
+    }
+    else
+    {
+        pos = line;
+        if (crx_get_field(&pos, end, crx->clock, 1, crx->clock_order)
+            || pos != end)
         {
-            p_->error_line = __LINE__;
+            p->base.error_line = __LINE__;
             return RINEX_ERR_BAD_FORMAT;
         }
-        res = rnx_get_newlines(p_, &p->parse_ofs, NULL, 0, n_lines);
-        if (res <= RINEX_EOF)
+        len = (version == 2) ? 68 : 41;
+        memset(out, ' ', crx->text + len - out);
+        out = crx_put_fixed(crx->text + len, crx->clock[0],
+            (version == 2) ? 12 : 15, (version == 2) ? 9 : 12);
+        if (!out)
         {
+            p->base.error_line = __LINE__;
             return RINEX_ERR_BAD_FORMAT;
         }
-        goto crx_v2_copy_text;
     }
+    first_len = out - crx->text;
+    *out++ = '\n';
+
+    /* RINEX 2 continues the satellite list on more lines. */
+    for (ii = 12; version == 2 && ii < n_sats; ii += 12)
+    {
+        nn = (n_sats - ii < 12) ? n_sats - ii : 12;
+        memset(out, ' ', 32);
+        memcpy(out + 32, crx->epoch_text + 32 + 3 * ii, 3 * nn);
+        out += 32 + 3 * nn;
+        *out++ = '\n';
+    }
+
+    /* Decode each satellite's observations. */
+    for (ii = 0; ii < n_sats; ++ii)
+    {
+        line = end + 1;
+        end = memchr(line, '\n', p->base.stream->buffer + res - line);
+        out = crx_read_sat(crx, crx->epoch_text + sat_col + 3 * ii, line,
+            end, out, version, restart);
+        if (!out)
+        {
+            return RINEX_ERR_BAD_FORMAT;
+        }
+    }
+
+    if (restart)
+    {
+        crx->epoch_len = 0;
+        crx->clock_order[1] = 0;
+    }
+    else
+    {
+        ++crx->n_epochs;
+    }
+
+    /* Parse the RINEX text. */
+    p->base.slip_text = crx->text;
+    p->base.slip_text_len = out - crx->text;
+    res = (version == 2)
+        ? rnx_v2_parse_epoch(p, crx->text, first_len)
+        : rnx_v3_parse_epoch(p, crx->text, first_len);
+    if (res < 0)
+    {
+        return res;
+    }
+    line = crx->text + first_len + 1;
+    if (version == 3)
+    {
+        return rnx_read_v3_observations(p, line);
+    }
+    for (ii = 12; ii < n_sats; ii += 12)
+    {
+        line = strchr(line, '\n') + 1;
+    }
+    return rnx_read_v2_observations(p, crx->text, line);
+}
+
+/** crx_read_v2 reads an observation data record from \a p_. */
+static rinex_error_t crx_read_v2(struct rinex_parser *p_)
+{
+    return crx_read_v23((struct crx_v23_parser *)p_, 2);
 }
 
 /** crx_read_v3 reads an observation data record from \a p_. */
 static rinex_error_t crx_read_v3(struct rinex_parser *p_)
 {
-    struct crx_v23_parser *crx = (struct crx_v23_parser *)p_;
-    struct rnx_v23_parser *p = &crx->base;
-
-    (void)p;
-    return RINEX_SUCCESS;
+    return crx_read_v23((struct crx_v23_parser *)p_, 3);
 }
 
 /** crx_free_v23 deallocates \a p_, which must be a crx_v23_parser. */
 static void crx_free_v23(struct rinex_parser *p_)
 {
     struct crx_v23_parser *p = (struct crx_v23_parser *)p_;
+    int ii;
 
-    free(p->diff);
-    free(p->order);
+    for (ii = 0; ii < 32 * RINEX_MAX_SVN; ++ii)
+    {
+        free(p->sat[ii]);
+    }
+    free(p->text);
     free(p->epoch_text);
     rnx_free_v23(p_);
 }
@@ -1134,9 +1609,20 @@ const char *rinex_find_header
     unsigned int sizeof_label
 )
 {
+    const struct rnx_v23_parser *rp = (const struct rnx_v23_parser *)p;
     int ofs;
 
-    ofs = rnx_find_header(p->buffer, p->buffer_len, label, sizeof_label);
+    /* Until the first record is read, the header index describes
+     * p->buffer.
+     */
+    if (!p->epoch.flag && rp->header.line_ofs)
+    {
+        ofs = rnx_lookup_header(&rp->header, p->buffer, label, sizeof_label);
+    }
+    else
+    {
+        ofs = rnx_find_header(p->buffer, p->buffer_len, label, sizeof_label);
+    }
     if (ofs < 0)
     {
         return NULL;
@@ -1145,6 +1631,78 @@ const char *rinex_find_header
     return p->buffer + ofs;
 }
 
+/* Doc comment in rinex.h. */
+int rinex_enable_sat_lookup(struct rinex_parser *p)
+{
+    int ii;
+
+    if (!p->sat_slot)
+    {
+        p->sat_slot = calloc(32 * RINEX_MAX_SVN, sizeof p->sat_slot[0]);
+        if (!p->sat_slot)
+        {
+            return ENOMEM;
+        }
+
+        /* Index the current record, in case it has observations. */
+        if (p->sats && (p->epoch.flag == '0' || p->epoch.flag == '1'
+            || p->epoch.flag == '6'))
+        {
+            for (ii = 0; ii < p->epoch.n_sats; ++ii)
+            {
+                p->sat_slot[rnx_sat_slot(p->sats[ii].system,
+                    p->sats[ii].svn)] = ii;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* Doc comment in rinex.h. */
+const struct rinex_sat_entry *rinex_find_sat(
+    const struct rinex_parser *p,
+    char system,
+    int svn
+)
+{
+    const struct rinex_sat_entry *sat;
+    int ii;
+
+    if (svn < 0 || svn >= RINEX_MAX_SVN || !p->sats
+        || (p->epoch.flag != '0' && p->epoch.flag != '1'
+            && p->epoch.flag != '6'))
+    {
+        return NULL;
+    }
+
+    if (system == ' ')
+    {
+        system = 'G';
+    }
+
+    if (p->sat_slot)
+    {
+        ii = p->sat_slot[rnx_sat_slot(system, svn)];
+        sat = p->sats + ii;
+        return (ii < p->epoch.n_sats && sat->svn == svn
+            && (sat->system == system
+                || (sat->system == ' ' && system == 'G'))) ? sat : NULL;
+    }
+
+    for (ii = 0; ii < p->epoch.n_sats; ++ii)
+    {
+        sat = p->sats + ii;
+        if (sat->svn == svn && (sat->system == system
+            || (sat->system == ' ' && system == 'G')))
+        {
+            return sat;
+        }
+    }
+
+    return NULL;
+}
+
 /** rnx_open_v2 reads the observation codes in \a p->base.header. */
 static const char *rnx_open_v2(struct rnx_v23_parser *p)
 {
@@ -1256,56 +1814,6 @@ static const char *rnx_open_v3(struct rnx_v23_parser *p)
     return NULL;
 }
 
-/** Copy \a in_len bytes of header from \a in to \a out.
- *
- * Replace each newline sequences (CR, LF, CRLF) with a single '\n'.
- * Remove trailing spaces from each header line.
- *
- * \param[out] out Receives cleaned-up header.
- * \param[in] in Input header to copy from.
- * \param[in] in_len Length of header to copy, including the final
- *   newline sequence.
- * \returns Length of output on success, RINEX_ERR_BAD_FORMAT on illegal
- *   line length.
- */
-static rinex_error_t rnx_copy_header
-(
-    char out[],
-    const char in[],
-    int in_len
-)
-{
-    int ii, jj, last_eol, line_len;
-
-    for (ii = jj = last_eol = 0; ii < in_len; ++ii)
-    {
-        /* Convert CRLF to '\n'. */
-        out[jj] = in[ii];
-
-        /* Are we at an EOL? */
-        if (out[jj] == '\n')
-        {
-            /* Check total line length. */
-            line_len = jj - last_eol;
-            if (line_len < 61 || line_len > 80)
-            {
-                return RINEX_ERR_BAD_FORMAT;
-            }
-
-            /* Trim trailing whitespace. */
-            while (out[jj-1] == ' ')
-            {
-                jj--;
-            }
-            out[jj] = '\n';
-            last_eol = jj+1;
-        }
-        ++jj;
-    }
-
-    return jj;
-}
-
 const char *rnx_open_v23
 (
     struct rnx_v23_parser *p,
@@ -1335,28 +1843,35 @@ const char *rnx_open_v23
     /* Allocate the parser structure. */
     p->base.stream = stream;
 
-    /* Copy the header. */
+    /* Copy the header, starting from RINEX VERSION / TYPE (after any
+     * Compact RINEX header lines).
+     */
     p->parse_ofs = res;
-    p->buffer_alloc = res;
+    p->buffer_alloc = res - hdr_ofs;
     p->base.buffer = calloc(p->buffer_alloc, 1);
     if (!p->base.buffer)
     {
         return "Memory allocation failed";
     }
 
-    /* Copy the header for the caller's use. */
-    res = rnx_copy_header(p->base.buffer, stream->buffer, res);
+    /* Copy and index the header for the caller's use. */
+    res = rnx_index_header(&p->header, p->base.buffer,
+        stream->buffer + hdr_ofs, res - hdr_ofs);
     p->base.buffer_len = res;
-    if (res < 0)
+    if (res == RINEX_ERR_SYSTEM)
+    {
+        err = "Memory allocation failed";
+    }
+    else if (res < 0)
     {
         err = "Invalid header line detected";
     }
-    else if (!memcmp("     2.", stream->buffer, 7))
+    else if (!memcmp("     2.", stream->buffer + hdr_ofs, 7))
     {
         p->base.read = rnx_read_v2;
         err = rnx_open_v2(p);
     }
-    else if (!memcmp("      3.x", stream->buffer, 7))
+    else if (!memcmp("     3.", stream->buffer + hdr_ofs, 7))
     {
         p->base.read = rnx_read_v3;
         err = rnx_open_v3(p);
@@ -1387,7 +1902,8 @@ const char *crx_open_v23
     }
 
     /* Find the RINEX VERSION / TYPE line to get the RINEX version. */
-    ofs = rnx_find_header(stream->buffer, stream->size, rinex_version_type, 20);
+    ofs = rnx_find_header(stream->buffer, stream->size, rinex_version_type,
+        sizeof rinex_version_type);
     if (ofs < 1)
     {
         return "Could not find RINEX VERSION / TYPE";
@@ -1420,17 +1936,12 @@ const char *crx_open_v23
             crx->base.base.read = crx_read_v3;
         }
     }
-    else
+
+    /* Allocate RINEX decompression fields. */
+    if (!err && (crx_reserve(&crx->epoch_text, &crx->epoch_alloc, 200)
+        || crx_reserve(&crx->text, &crx->text_alloc, 4096)))
     {
-        /* Allocate RINEX decompression fields. */
-        crx->epoch_alloc = 200;
-        crx->epoch_text = calloc(crx->epoch_alloc, 1);
-        crx->order = calloc(crx->base.obs_alloc, 2);
-        crx->diff = calloc(crx->base.obs_alloc, 10 * sizeof(int));
-        if (!crx->epoch_text || !crx->order || !crx->diff)
-        {
-            err = "Memory allocation failed";
-        }
+        err = "Memory allocation failed";
     }
 
     return err;
@@ -1494,8 +2005,7 @@ const char *rinex_open
         p->base.ssi = NULL;
         p->base.obs = NULL;
         crx->epoch_text = NULL;
-        crx->order = NULL;
-        crx->diff = NULL;
+        crx->text = NULL;
         p->base.destroy = crx_free_v23;
 
         *p_parser = &p->base;
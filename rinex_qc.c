@@ -0,0 +1,1116 @@
+/** rinex_qc.c - Single-pass quality checks for RINEX observations.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "rinex_qc.h"
+#include "rinex_p.h"
+#include "srnx.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Speed of light, in meters per second. */
+#define QC_C_LIGHT 299792458.0
+
+/** Largest satellite number plus one. */
+#define QC_MAX_SATS 100
+
+/** qc_system describes one satellite system's observation codes. */
+struct qc_system
+{
+    /** Observation codes, NUL-padded to four bytes. */
+    char (*code)[4];
+
+    /** Number of entries in #code. */
+    int n_codes;
+
+    /** Non-zero if MP1, MP2 and ionospheric rate can be computed. */
+    int has_mp;
+
+    /** Indices of the P1, L1, P2 and L2 codes, if #has_mp. */
+    int mp_code[4];
+
+    /** Bitmask of the codes in #mp_code. */
+    uint64_t mp_mask;
+
+    /** Bitmask of signal-strength codes. */
+    uint64_t snr_mask;
+
+    /** Coefficients of L1 and L2 in MP1 and MP2, and of L1 and L2 in
+     * the L1 ionospheric delay.  These take phases as the parser
+     * stores them, in thousandths of a cycle, and give meters.
+     */
+    double mp_l1[2], mp_l2[2];
+    double iono_l1, iono_l2;
+};
+
+/** qc_arc accumulates a satellite's current MP1 and MP2 arcs, relative
+ * to their first values so that the sums keep their precision.  Both
+ * arcs start and end together.
+ */
+struct qc_arc
+{
+    double ref[2];
+    double sum[2];
+    double sumsq[2];
+    uint64_t n;
+};
+
+/** qc_signal holds statistics for one satellite and observation code.
+ * #n_obs does not include the satellite's current run of epochs.
+ */
+struct qc_signal
+{
+    uint64_t n_obs;
+    uint64_t n_lli;
+};
+
+/** qc_sat holds statistics for one satellite.
+ *
+ * Most receivers report the same signals epoch after epoch, so rather
+ * than counting each observation, this counts the epochs with the
+ * current presence mask and adds them to the signals' counts when the
+ * mask changes.
+ */
+struct qc_sat
+{
+    /** Signals present in the current run of epochs. */
+    uint64_t mask;
+
+    /** Number of epochs in the current run. */
+    uint64_t mask_epochs;
+
+    /** Non-zero if #mask has all of qc_system::mp_mask. */
+    unsigned char has_mp;
+
+    /** Offsets of the P1, L1, P2 and L2 observations from the
+     * satellite's first observation, if #has_mp.
+     */
+    unsigned char mp_ofs[4];
+
+    /** Number of signal-strength codes in #mask. */
+    unsigned char n_snr;
+
+    /** For each signal-strength code in #mask, the offset of its
+     * observation and the offset of its histogram from the first one.
+     */
+    unsigned char snr_ofs[64];
+    unsigned short snr_hist[64];
+
+    /** Time of the last epoch with this satellite. */
+    int64_t last_ns;
+
+    /** Number of epochs with this satellite, not counting the current
+     * run.
+     */
+    uint64_t n_epochs;
+
+    /** Number of gaps in tracking. */
+    uint64_t n_gaps;
+
+    /** Current MP1 and MP2 arcs. */
+    struct qc_arc arc;
+
+    /** Completed MP1 and MP2 arcs: residual sums of squares and their
+     * degrees of freedom.
+     */
+    double mp_ss[2];
+    uint64_t mp_dof[2];
+
+    /** Previous L1 ionospheric delay, in meters, and its time.  These
+     * are valid while #arc is not empty.
+     */
+    double iono;
+    int64_t iono_ns;
+
+    /** Sum of squared ionospheric rates, in (cm/min)^2. */
+    double iod_ss;
+
+    /** Number of ionospheric rates over #RINEX_QC_IOD_SLIP_CM_MIN. */
+    uint64_t iod_slips;
+
+    /** Per-signal statistics, one per observation code.  These are
+     * followed by a histogram for each signal-strength code; see
+     * qc_snr().
+     */
+    struct qc_signal sig[];
+};
+
+/** qc_entry locates one satellite of an observation record. */
+struct qc_entry
+{
+    /** Satellite's statistics. */
+    struct qc_sat *sat;
+
+    /** Satellite's system. */
+    const struct qc_system *sys;
+
+    /** Index of the satellite's first observation in rinex_parser::obs. */
+    int obs_ofs;
+};
+
+struct rinex_qc
+{
+    /** Systems, indexed by system identifier & 31. */
+    struct qc_system sys[32];
+
+    /** Satellites, indexed by system identifier & 31 and number. */
+    struct qc_sat *sat[32][QC_MAX_SATS];
+
+    /** First and last observation epochs. */
+    struct rinex_epoch first, last;
+
+    /** Time of #last. */
+    int64_t last_ns;
+
+    /** Most recent step between epochs, and 6e12 divided by it, which
+     * converts meters per step to cm/min.
+     */
+    int64_t rate_step_ns;
+    double rate_scale;
+
+    /** Nominal interval: from the header, or the shortest step seen. */
+    int64_t interval_ns;
+
+    /** Non-zero if #interval_ns came from the header. */
+    int fixed_interval;
+
+    /** Number of observation epochs. */
+    uint64_t n_epochs;
+
+    /** Number of gaps between observation epochs. */
+    uint64_t n_gaps;
+
+    /** Satellite names and presence bitfields of the last observation
+     * record, as in rinex_parser::buffer, or NULL.  Receivers usually
+     * report the same satellites and signals for many epochs in a row,
+     * and then the next record can use #entry without looking up each
+     * satellite again.  #layout_len is negative if #entry is not valid.
+     */
+    char *layout;
+    int layout_len;
+    int layout_alloc;
+
+    /** Satellites in #layout that have statistics. */
+    struct qc_entry *entry;
+    int n_entries;
+    int entry_alloc;
+};
+
+/** Returns the slot that holds statistics for system slot \a s. */
+static int qc_slot(int s)
+{
+    /* RINEX 2 allows a blank system identifier for GPS. */
+    return (s == (' ' & 31)) ? ('G' & 31) : s;
+}
+
+/** Returns the system letter for slot \a s. */
+static char qc_letter(int s)
+{
+    return (char)(s | 64);
+}
+
+/** Assigns qc_role values and multipath coefficients for \a sys. */
+static void qc_setup_system(struct qc_system *sys, char letter)
+{
+    const struct rnx_freq *freq;
+    int p1 = -1, l1 = -1, p2 = -1, l2 = -1;
+    double alpha, iono_k, lambda1, lambda2;
+    int ii;
+    char type, band;
+
+    freq = rnx_find_freq(letter);
+    for (ii = 0; ii < sys->n_codes; ++ii)
+    {
+        type = sys->code[ii][0];
+        band = sys->code[ii][1];
+        if (type == 'S' && ii < 64)
+        {
+            sys->snr_mask |= UINT64_C(1) << ii;
+        }
+        if (!freq)
+        {
+            continue;
+        }
+
+        /* Take the first phase code for each band, and the first code
+         * pseudorange, preferring RINEX 2's P codes to C codes.
+         */
+        if (type == 'L' && band == freq->band1 && l1 < 0)
+        {
+            l1 = ii;
+        }
+        if (type == 'L' && band == freq->band2 && l2 < 0)
+        {
+            l2 = ii;
+        }
+        if ((type == 'C' || type == 'P') && band == freq->band1
+            && (p1 < 0 || (type == 'P' && sys->code[p1][0] == 'C')))
+        {
+            p1 = ii;
+        }
+        if ((type == 'C' || type == 'P') && band == freq->band2
+            && (p2 < 0 || (type == 'P' && sys->code[p2][0] == 'C')))
+        {
+            p2 = ii;
+        }
+    }
+
+    if (p1 < 0 || l1 < 0 || p2 < 0 || l2 < 0
+        || p1 >= 64 || l1 >= 64 || p2 >= 64 || l2 >= 64)
+    {
+        return;
+    }
+    sys->mp_code[0] = p1;
+    sys->mp_code[1] = l1;
+    sys->mp_code[2] = p2;
+    sys->mp_code[3] = l2;
+    sys->mp_mask = (UINT64_C(1) << p1) | (UINT64_C(1) << l1)
+        | (UINT64_C(1) << p2) | (UINT64_C(1) << l2);
+
+    alpha = (freq->f1 / freq->f2) * (freq->f1 / freq->f2);
+    iono_k = 1.0 / (alpha - 1.0);
+    lambda1 = QC_C_LIGHT / freq->f1 * 0.001;
+    lambda2 = QC_C_LIGHT / freq->f2 * 0.001;
+    sys->has_mp = 1;
+    sys->mp_l1[0] = -(1.0 + 2.0 * iono_k) * lambda1;
+    sys->mp_l2[0] = 2.0 * iono_k * lambda2;
+    sys->mp_l1[1] = -2.0 * alpha * iono_k * lambda1;
+    sys->mp_l2[1] = (2.0 * alpha * iono_k - 1.0) * lambda2;
+    sys->iono_l1 = iono_k * lambda1;
+    sys->iono_l2 = iono_k * lambda2;
+}
+
+/** Allocates the code arrays for \a sys. */
+static int qc_alloc_system(struct qc_system *sys, int n_codes)
+{
+    sys->code = calloc(n_codes, sizeof sys->code[0]);
+    if (!sys->code)
+    {
+        return ENOMEM;
+    }
+    sys->n_codes = n_codes;
+
+    return 0;
+}
+
+/** Reads RINEX 2 "# / TYPES OF OBSERV" lines, nine codes per line. */
+static int qc_read_codes_v2(struct rinex_qc *qc, const struct rinex_parser *p)
+{
+    static const char types[] = "# / TYPES OF OBSERV";
+    struct qc_system *sys;
+    const char *line;
+    int n_codes, ii, s, res;
+
+    line = rinex_find_header(p, types, sizeof types);
+    n_codes = p->n_obs[' ' & 31];
+    if (!line || n_codes < 1)
+    {
+        return EINVAL;
+    }
+
+    sys = &qc->sys[' ' & 31];
+    res = qc_alloc_system(sys, n_codes);
+    if (res)
+    {
+        return res;
+    }
+    for (ii = 0; ii < n_codes; ++ii)
+    {
+        if (ii > 0 && ii % 9 == 0)
+        {
+            line = strchr(line, '\n');
+            if (!line || memcmp(line + 61, types, sizeof(types) - 1))
+            {
+                return EINVAL;
+            }
+            ++line;
+        }
+        memcpy(sys->code[ii], line + 10 + 6 * (ii % 9), 2);
+    }
+
+    /* Every system in a RINEX 2 file uses the same codes. */
+    for (s = 1; s < 32; ++s)
+    {
+        if (p->n_obs[s] != n_codes)
+        {
+            continue;
+        }
+        res = qc_alloc_system(&qc->sys[s], n_codes);
+        if (res)
+        {
+            return res;
+        }
+        memcpy(qc->sys[s].code, sys->code, n_codes * sizeof sys->code[0]);
+    }
+
+    return 0;
+}
+
+/** Reads RINEX 3 "SYS / # / OBS TYPES" lines, 13 codes per line. */
+static int qc_read_codes_v3(struct rinex_qc *qc, const struct rinex_parser *p)
+{
+    static const char types[] = "SYS / # / OBS TYPES";
+    struct qc_system *sys;
+    const char *line;
+    int n_codes, ii, res;
+
+    line = rinex_find_header(p, types, sizeof types);
+    if (!line)
+    {
+        return EINVAL;
+    }
+
+    while (!memcmp(line + 60, types, sizeof(types) - 1))
+    {
+        sys = &qc->sys[line[0] & 31];
+        n_codes = p->n_obs[line[0] & 31];
+        if (sys->code || n_codes < 1)
+        {
+            return EINVAL;
+        }
+        res = qc_alloc_system(sys, n_codes);
+        if (res)
+        {
+            return res;
+        }
+        for (ii = 0; ii < n_codes; ++ii)
+        {
+            if (ii > 0 && ii % 13 == 0)
+            {
+                line = strchr(line, '\n') + 1;
+            }
+            memcpy(sys->code[ii], line + 7 + 4 * (ii % 13), 3);
+        }
+        line = strchr(line, '\n') + 1;
+    }
+
+    return 0;
+}
+
+/* Doc comment in rinex_qc.h. */
+int rinex_qc_create(
+    struct rinex_qc **p_qc,
+    const struct rinex_parser *p
+)
+{
+    static const char interval[] = "INTERVAL";
+    struct rinex_qc *qc;
+    const char *line;
+    int res, s;
+
+    qc = calloc(1, sizeof *qc);
+    if (!qc)
+    {
+        return ENOMEM;
+    }
+    qc->layout_len = -1;
+
+    res = (p->buffer[5] == '2') ? qc_read_codes_v2(qc, p)
+        : qc_read_codes_v3(qc, p);
+    if (res)
+    {
+        rinex_qc_destroy(qc);
+        return res;
+    }
+    for (s = 0; s < 32; ++s)
+    {
+        if (qc->sys[s].code)
+        {
+            qc_setup_system(&qc->sys[s], qc_letter(qc_slot(s)));
+        }
+    }
+
+    line = rinex_find_header(p, interval, sizeof interval);
+    if (line)
+    {
+        qc->interval_ns = llround(strtod(line, NULL) * 1e9);
+        qc->fixed_interval = qc->interval_ns > 0;
+    }
+
+    *p_qc = qc;
+    return 0;
+}
+
+/** Adds MP1 and MP2 values \a mp to \a arc. */
+static void qc_arc_add(struct qc_arc *arc, const double mp[2])
+{
+    double d;
+    int ii;
+
+    if (arc->n == 0)
+    {
+        memcpy(arc->ref, mp, sizeof arc->ref);
+    }
+    for (ii = 0; ii < 2; ++ii)
+    {
+        d = mp[ii] - arc->ref[ii];
+        arc->sum[ii] += d;
+        arc->sumsq[ii] += d * d;
+    }
+    arc->n++;
+}
+
+/** Adds the residuals of arc \a ii (0 for MP1, 1 for MP2), after
+ * removing its mean, to a total.
+ */
+static void qc_arc_fold(const struct qc_arc *arc, int ii, double *ss,
+    uint64_t *dof)
+{
+    if (arc->n > 1)
+    {
+        *ss += arc->sumsq[ii] - arc->sum[ii] * arc->sum[ii] / arc->n;
+        *dof += arc->n - 1;
+    }
+}
+
+/** Ends \a sat's multipath arcs and ionospheric rate sequence. */
+__attribute__((noinline))
+static void qc_end_arcs(struct qc_sat *sat)
+{
+    int ii;
+
+    for (ii = 0; ii < 2; ++ii)
+    {
+        qc_arc_fold(&sat->arc, ii, &sat->mp_ss[ii], &sat->mp_dof[ii]);
+    }
+    memset(&sat->arc, 0, sizeof sat->arc);
+}
+
+/** Updates multipath and ionospheric statistics for one satellite.
+ *
+ * \param[in] qc Accumulator that holds \a sat.
+ * \param[in] sys Satellite's system.
+ * \param[in,out] sat Satellite to update.
+ * \param[in] t Epoch time, in nanoseconds.
+ * \param[in] obs Satellite's observations, as the parser stores them.
+ * \param[in] slip Non-zero if either phase reported loss of lock.
+ */
+static void qc_combine(const struct rinex_qc *qc,
+    const struct qc_system *sys, struct qc_sat *sat, int64_t t,
+    const int64_t *obs, int slip)
+{
+    double l1, l2, iono, rate, mp[2];
+    int64_t dt;
+    int ii;
+
+    if (slip)
+    {
+        qc_end_arcs(sat);
+    }
+
+    l1 = (double)obs[sat->mp_ofs[1]];
+    l2 = (double)obs[sat->mp_ofs[3]];
+    iono = l1 * sys->iono_l1 - l2 * sys->iono_l2;
+    if (sat->arc.n > 0)
+    {
+        dt = t - sat->iono_ns;
+        rate = (iono - sat->iono) * ((dt == qc->rate_step_ns)
+            ? qc->rate_scale : 6e12 / (double)dt);
+        if (fabs(rate) > RINEX_QC_IOD_SLIP_CM_MIN)
+        {
+            sat->iod_slips++;
+            qc_end_arcs(sat);
+        }
+        else
+        {
+            sat->iod_ss += rate * rate;
+        }
+    }
+    sat->iono = iono;
+    sat->iono_ns = t;
+
+    for (ii = 0; ii < 2; ++ii)
+    {
+        mp[ii] = (double)obs[sat->mp_ofs[2 * ii]] * 0.001
+            + sys->mp_l1[ii] * l1 + sys->mp_l2[ii] * l2;
+    }
+    qc_arc_add(&sat->arc, mp);
+}
+
+/** Returns the signal-strength histogram of code \a nn for \a sat. */
+static uint32_t *qc_snr(const struct qc_system *sys, const struct qc_sat *sat,
+    int nn)
+{
+    uint32_t *hist = (uint32_t *)(sat->sig + sys->n_codes);
+
+    return hist + RINEX_QC_SNR_BINS
+        * __builtin_popcountll(sys->snr_mask & ((UINT64_C(1) << nn) - 1));
+}
+
+/** Returns the number of observations of code \a nn for \a sat. */
+static uint64_t qc_count(const struct qc_sat *sat, int nn)
+{
+    return sat->sig[nn].n_obs
+        + ((nn < 64 && (sat->mask >> nn & 1)) ? sat->mask_epochs : 0);
+}
+
+/** Returns the index in rinex_parser::obs of code \a nn, for a
+ * satellite whose first observation is at \a kk and whose signals
+ * are \a mask.
+ */
+static inline int qc_obs_index(int kk, uint64_t mask, int nn)
+{
+    return kk + __builtin_popcountll(mask & ((UINT64_C(1) << nn) - 1));
+}
+
+/** Starts a new run of epochs for \a sat with the signals in \a mask.
+ *
+ * This adds the previous run to the signals' counts and finds where
+ * the multipath and signal-strength observations sit in the parser's
+ * packed observations, so each epoch of the run can load them
+ * directly.
+ */
+__attribute__((noinline))
+static void qc_start_run(const struct qc_system *sys, struct qc_sat *sat,
+    uint64_t mask)
+{
+    uint64_t bits;
+    int nn, jj;
+
+    for (bits = sat->mask; bits; bits &= bits - 1)
+    {
+        sat->sig[__builtin_ctzll(bits)].n_obs += sat->mask_epochs;
+    }
+    sat->n_epochs += sat->mask_epochs;
+    sat->mask = mask;
+    sat->mask_epochs = 0;
+
+    sat->has_mp = sys->has_mp && (mask & sys->mp_mask) == sys->mp_mask;
+    if (sat->has_mp)
+    {
+        for (jj = 0; jj < 4; ++jj)
+        {
+            sat->mp_ofs[jj] = qc_obs_index(0, mask, sys->mp_code[jj]);
+        }
+    }
+
+    sat->n_snr = 0;
+    for (bits = mask & sys->snr_mask; bits; bits &= bits - 1)
+    {
+        nn = __builtin_ctzll(bits);
+        sat->snr_ofs[sat->n_snr] = qc_obs_index(0, mask, nn);
+        sat->snr_hist[sat->n_snr] = RINEX_QC_SNR_BINS
+            * __builtin_popcountll(sys->snr_mask & ((UINT64_C(1) << nn) - 1));
+        sat->n_snr++;
+    }
+}
+
+/** Counts loss of lock for \a sat, whose signals are \a mask and
+ * whose LLIs start at \a lli.  This is only called for records where
+ * qc_any_lli() found a possible loss of lock.
+ *
+ * \returns Non-zero if either multipath phase lost lock.
+ */
+__attribute__((noinline))
+static int qc_count_lli(const struct qc_system *sys, struct qc_sat *sat,
+    const char *lli, uint64_t mask)
+{
+    uint64_t bits;
+    int nn, slip;
+
+    for (bits = mask, slip = 0; bits; bits &= bits - 1, ++lli)
+    {
+        if (*lli & 1)
+        {
+            nn = __builtin_ctzll(bits);
+            sat->sig[nn].n_lli++;
+            slip |= sys->has_mp
+                && (nn == sys->mp_code[1] || nn == sys->mp_code[3]);
+        }
+    }
+
+    return slip;
+}
+
+/** Allocates statistics for a satellite of system \a sys. */
+__attribute__((noinline))
+static struct qc_sat *qc_new_sat(const struct qc_system *sys)
+{
+    return calloc(1, sizeof(struct qc_sat)
+        + sys->n_codes * sizeof(struct qc_signal)
+        + __builtin_popcountll(sys->snr_mask) * RINEX_QC_SNR_BINS
+        * sizeof(uint32_t));
+}
+
+/** Returns non-zero if any observation in \a p's current record might
+ * report loss of lock.
+ *
+ * Loss of lock is rare, so this checks the whole record at once; a set
+ * LLI bit 0 makes the character odd.  Without rinex_parser::sats, the
+ * number of observations is not known, so this returns 1.
+ */
+static int qc_any_lli(const struct rinex_parser *p)
+{
+    const struct rinex_sat_entry *last;
+    uint64_t word, any_lli;
+    int ii, n;
+
+    if (!p->sats)
+    {
+        return 1;
+    }
+    if (p->epoch.n_sats < 1)
+    {
+        return 0;
+    }
+
+    last = p->sats + p->epoch.n_sats - 1;
+    n = last->obs_ofs + last->n_obs;
+    for (ii = 0, any_lli = 0; ii + 8 <= n; ii += 8)
+    {
+        memcpy(&word, p->lli + ii, sizeof word);
+        any_lli |= word;
+    }
+    for (; ii < n; ++ii)
+    {
+        any_lli |= (unsigned char)p->lli[ii];
+    }
+
+    return (any_lli & UINT64_C(0x0101010101010101)) != 0;
+}
+
+/** Adds one satellite's observations from an observation record.
+ *
+ * \param[in] qc Accumulator that holds \a sat.
+ * \param[in] e Satellite to update, which has already counted the
+ *   epoch in its current run.
+ * \param[in] p Parser that read the record.
+ * \param[in] t Epoch time, in nanoseconds.
+ * \param[in] record_lli Result of qc_any_lli() for the record.
+ */
+static inline void qc_add_sat(const struct rinex_qc *qc,
+    const struct qc_entry *e, const struct rinex_parser *p, int64_t t,
+    int record_lli)
+{
+    const struct qc_system *sys = e->sys;
+    struct qc_sat *sat = e->sat;
+    const int64_t *obs = p->obs + e->obs_ofs;
+    uint32_t *hist;
+    int64_t snr;
+    int jj, bin, slip;
+
+    slip = record_lli
+        ? qc_count_lli(sys, sat, p->lli + e->obs_ofs, sat->mask) : 0;
+
+    hist = (uint32_t *)(sat->sig + sys->n_codes);
+    for (jj = 0; jj < sat->n_snr; ++jj)
+    {
+        snr = obs[sat->snr_ofs[jj]];
+        bin = ((uint64_t)snr < RINEX_QC_SNR_BINS * 5000)
+            ? (int)((uint32_t)snr / 5000)
+            : (snr < 0) ? 0 : RINEX_QC_SNR_BINS - 1;
+        hist[sat->snr_hist[jj] + bin]++;
+    }
+
+    if (sat->has_mp)
+    {
+        qc_combine(qc, sys, sat, t, obs, slip);
+    }
+    else if (slip)
+    {
+        qc_end_arcs(sat);
+    }
+}
+
+/** Finds the satellites of an observation record, counts their gaps
+ * and presence, and rebuilds rinex_qc::layout and rinex_qc::entry.
+ *
+ * \param[in,out] qc Accumulator to update.
+ * \param[in] p Parser that read the record.
+ * \param[in] t Epoch time, in nanoseconds.
+ * \param[in] max_step Longest step between epochs that is not a gap.
+ * \returns Zero on success, else ENOMEM.
+ */
+static int qc_find_sats(struct rinex_qc *qc, const struct rinex_parser *p,
+    int64_t t, int64_t max_step)
+{
+    const unsigned char *buf;
+    const struct qc_system *sys;
+    struct qc_entry *entry;
+    struct qc_sat *sat;
+    uint64_t mask;
+    unsigned int s, num;
+    int ii, jj, kk, n_bytes, n_here;
+    char *layout;
+
+    qc->layout_len = -1;
+    qc->n_entries = 0;
+    if (qc->layout_alloc < p->buffer_len)
+    {
+        layout = realloc(qc->layout, p->buffer_len);
+        if (!layout)
+        {
+            return ENOMEM;
+        }
+        qc->layout = layout;
+        qc->layout_alloc = p->buffer_len;
+    }
+    if (qc->entry_alloc < p->epoch.n_sats)
+    {
+        entry = realloc(qc->entry, p->epoch.n_sats * sizeof *entry);
+        if (!entry)
+        {
+            return ENOMEM;
+        }
+        qc->entry = entry;
+        qc->entry_alloc = p->epoch.n_sats;
+    }
+
+    buf = (const unsigned char *)p->buffer;
+    for (ii = kk = 0; ii < p->epoch.n_sats; ++ii, buf += 2 + n_bytes,
+        kk += n_here)
+    {
+        /* Gather the presence bitfield; only the first 64 codes of a
+         * system are checked.
+         */
+        n_bytes = (p->n_obs[buf[0] & 31] + 7) >> 3;
+        for (jj = 0, mask = 0; jj < n_bytes && jj < 8; ++jj)
+        {
+            mask |= (uint64_t)buf[2 + jj] << (8 * jj);
+        }
+        if (p->sats)
+        {
+            n_here = p->sats[ii].n_obs;
+        }
+        else
+        {
+            for (jj = n_here = 0; jj < n_bytes; ++jj)
+            {
+                n_here += __builtin_popcount(buf[2 + jj]);
+            }
+        }
+
+        s = qc_slot(buf[0] & 31);
+        num = buf[1];
+        sys = &qc->sys[s];
+        if (num >= QC_MAX_SATS || !sys->code)
+        {
+            continue;
+        }
+
+        sat = qc->sat[s][num];
+        if (!sat)
+        {
+            sat = qc_new_sat(sys);
+            if (!sat)
+            {
+                return ENOMEM;
+            }
+            qc->sat[s][num] = sat;
+        }
+        else if (t - sat->last_ns > max_step)
+        {
+            sat->n_gaps++;
+            qc_end_arcs(sat);
+        }
+        if (mask != sat->mask)
+        {
+            qc_start_run(sys, sat, mask);
+        }
+
+        entry = &qc->entry[qc->n_entries++];
+        entry->sat = sat;
+        entry->sys = sys;
+        entry->obs_ofs = kk;
+    }
+
+    memcpy(qc->layout, p->buffer, p->buffer_len);
+    qc->layout_len = p->buffer_len;
+    return 0;
+}
+
+/* Doc comment in rinex_qc.h. */
+int rinex_qc_add(
+    struct rinex_qc *qc,
+    const struct rinex_parser *p
+)
+{
+    struct qc_entry *e;
+    int64_t t, step, max_step;
+    int ii, res, record_lli, same_sats;
+
+    if (p->epoch.flag != '0' && p->epoch.flag != '1')
+    {
+        return 0;
+    }
+
+    /* Epochs within one minute need no calendar arithmetic. */
+    if (qc->n_epochs > 0 && p->epoch.yyyy_mm_dd == qc->last.yyyy_mm_dd
+        && p->epoch.hh_mm == qc->last.hh_mm)
+    {
+        t = qc->last_ns + (int64_t)(p->epoch.sec_e7 - qc->last.sec_e7) * 100;
+    }
+    else
+    {
+        t = srnx_epoch_to_gps_ns(&p->epoch);
+    }
+    step = 0;
+    if (qc->n_epochs == 0)
+    {
+        qc->first = p->epoch;
+    }
+    else
+    {
+        step = t - qc->last_ns;
+        if (step > 0 && !qc->fixed_interval
+            && (qc->interval_ns == 0 || step < qc->interval_ns))
+        {
+            qc->interval_ns = step;
+        }
+        if (qc->interval_ns > 0 && step > qc->interval_ns * 3 / 2)
+        {
+            qc->n_gaps++;
+        }
+        if (step > 0 && step != qc->rate_step_ns)
+        {
+            qc->rate_step_ns = step;
+            qc->rate_scale = 6e12 / (double)step;
+        }
+    }
+    qc->last = p->epoch;
+    qc->last_ns = t;
+    qc->n_epochs++;
+    max_step = (qc->interval_ns > 0) ? qc->interval_ns * 3 / 2 : INT64_MAX;
+
+    /* If the record has the same satellites and signals as the last
+     * one, and is not after a gap, each satellite just extends its
+     * current run.
+     */
+    same_sats = step <= max_step && p->buffer_len == qc->layout_len
+        && !memcmp(p->buffer, qc->layout, p->buffer_len);
+    if (!same_sats)
+    {
+        res = qc_find_sats(qc, p, t, max_step);
+        if (res)
+        {
+            return res;
+        }
+    }
+
+    record_lli = qc_any_lli(p);
+    for (ii = 0; ii < qc->n_entries; ++ii)
+    {
+        e = &qc->entry[ii];
+        e->sat->last_ns = t;
+        e->sat->mask_epochs++;
+        qc_add_sat(qc, e, p, t, record_lli);
+    }
+
+    return 0;
+}
+
+/** Writes \a epoch as an ISO 8601 date and time. */
+static void qc_write_epoch(FILE *out, const char *key,
+    const struct rinex_epoch *epoch)
+{
+    fprintf(out, ",\"%s\":\"%04d-%02d-%02dT%02d:%02d:%02d.%07d\"", key,
+        epoch->yyyy_mm_dd / 10000, epoch->yyyy_mm_dd / 100 % 100,
+        epoch->yyyy_mm_dd % 100, epoch->hh_mm / 100, epoch->hh_mm % 100,
+        epoch->sec_e7 / 10000000, epoch->sec_e7 % 10000000);
+}
+
+/** Writes one satellite's statistics. */
+static void qc_write_sat(FILE *out, const struct qc_system *sys,
+    const struct qc_sat *sat, char letter, int num)
+{
+    static const char *const mp_key[2] = { "mp1", "mp2" };
+    const uint32_t *hist;
+    double ss;
+    uint64_t dof = 0;
+    int ii, jj, first;
+
+    fprintf(out, "{\"sv\":\"%c%02d\",\"epochs\":%llu,\"gaps\":%llu",
+        letter, num, (unsigned long long)(sat->n_epochs + sat->mask_epochs),
+        (unsigned long long)sat->n_gaps);
+
+    /* Include the open arcs without ending them. */
+    for (ii = 0; sys->has_mp && ii < 2; ++ii)
+    {
+        ss = sat->mp_ss[ii];
+        dof = sat->mp_dof[ii];
+        qc_arc_fold(&sat->arc, ii, &ss, &dof);
+        if (dof > 0)
+        {
+            fprintf(out, ",\"%s\":%.4f", mp_key[ii], sqrt(ss / dof));
+        }
+    }
+    /* Each accepted rate extends an arc by one epoch, so the arcs'
+     * degrees of freedom also count the rates.
+     */
+    if (sys->has_mp && dof > 0)
+    {
+        fprintf(out, ",\"iod\":%.3f", sqrt(sat->iod_ss / dof));
+    }
+    if (sys->has_mp)
+    {
+        fprintf(out, ",\"iod_slips\":%llu",
+            (unsigned long long)sat->iod_slips);
+    }
+
+    fputs(",\"obs\":[", out);
+    for (ii = 0; ii < sys->n_codes; ++ii)
+    {
+        fprintf(out, ii ? ",%llu" : "%llu",
+            (unsigned long long)qc_count(sat, ii));
+    }
+    fputs("],\"lli\":[", out);
+    for (ii = 0; ii < sys->n_codes; ++ii)
+    {
+        fprintf(out, ii ? ",%llu" : "%llu",
+            (unsigned long long)sat->sig[ii].n_lli);
+    }
+    fputs("],\"snr\":{", out);
+    for (ii = 0, first = 1; ii < sys->n_codes; ++ii)
+    {
+        if (ii >= 64 || !(sys->snr_mask >> ii & 1) || !qc_count(sat, ii))
+        {
+            continue;
+        }
+        hist = qc_snr(sys, sat, ii);
+        fprintf(out, "%s\"%s\":[", first ? "" : ",", sys->code[ii]);
+        for (jj = 0; jj < RINEX_QC_SNR_BINS; ++jj)
+        {
+            fprintf(out, jj ? ",%lu" : "%lu", (unsigned long)hist[jj]);
+        }
+        fputc(']', out);
+        first = 0;
+    }
+    fputs("}}", out);
+}
+
+/* Doc comment in rinex_qc.h. */
+int rinex_qc_write_json(
+    const struct rinex_qc *qc,
+    const char *filename,
+    FILE *out
+)
+{
+    const char *ch;
+    uint64_t expected;
+    int s, num, ii, first;
+
+    fputs("{\"file\":\"", out);
+    for (ch = filename ? filename : ""; *ch; ++ch)
+    {
+        if (*ch == '"' || *ch == '\\')
+        {
+            fputc('\\', out);
+        }
+        if ((unsigned char)*ch < 32)
+        {
+            fprintf(out, "\\u%04x", *ch);
+            continue;
+        }
+        fputc(*ch, out);
+    }
+    fprintf(out, "\",\"epochs\":%llu", (unsigned long long)qc->n_epochs);
+
+    if (qc->n_epochs > 0)
+    {
+        qc_write_epoch(out, "first", &qc->first);
+        qc_write_epoch(out, "last", &qc->last);
+    }
+    expected = qc->n_epochs;
+    if (qc->interval_ns > 0)
+    {
+        expected = (uint64_t)((qc->last_ns - srnx_epoch_to_gps_ns(&qc->first)
+            + qc->interval_ns / 2) / qc->interval_ns) + 1;
+        fprintf(out, ",\"interval\":%.3f", qc->interval_ns * 1e-9);
+    }
+    fprintf(out, ",\"expected\":%llu,\"gaps\":%llu",
+        (unsigned long long)expected, (unsigned long long)qc->n_gaps);
+
+    fputs(",\"codes\":{", out);
+    for (s = 1, first = 1; s < 32; ++s)
+    {
+        if (!qc->sys[s].code)
+        {
+            continue;
+        }
+        for (num = 0; num < QC_MAX_SATS && !qc->sat[s][num]; ++num)
+        {
+        }
+        if (num == QC_MAX_SATS)
+        {
+            continue;
+        }
+        fprintf(out, "%s\"%c\":[", first ? "" : ",", qc_letter(s));
+        for (ii = 0; ii < qc->sys[s].n_codes; ++ii)
+        {
+            fprintf(out, "%s\"%s\"", ii ? "," : "", qc->sys[s].code[ii]);
+        }
+        fputc(']', out);
+        first = 0;
+    }
+
+    fputs("},\"sats\":[", out);
+    for (s = 1, first = 1; s < 32; ++s)
+    {
+        for (num = 0; num < QC_MAX_SATS; ++num)
+        {
+            if (!qc->sat[s][num])
+            {
+                continue;
+            }
+            if (!first)
+            {
+                fputc(',', out);
+            }
+            qc_write_sat(out, &qc->sys[s], qc->sat[s][num], qc_letter(s),
+                num);
+            first = 0;
+        }
+    }
+    fputs("]}\n", out);
+
+    return ferror(out) ? errno : 0;
+}
+
+/* Doc comment in rinex_qc.h. */
+void rinex_qc_destroy(
+    struct rinex_qc *qc
+)
+{
+    int s, num;
+
+    if (!qc)
+    {
+        return;
+    }
+
+    free(qc->layout);
+    free(qc->entry);
+    for (s = 0; s < 32; ++s)
+    {
+        free(qc->sys[s].code);
+        for (num = 0; num < QC_MAX_SATS; ++num)
+        {
+            free(qc->sat[s][num]);
+        }
+    }
+    free(qc);
+}
@@ -0,0 +1,130 @@
+/** rinex_qc.h - Single-pass quality checks for RINEX observations.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(RINEX_QC_H_890f67ea_4696_4543_b0cc_4f16c1c12d4c)
+#define RINEX_QC_H_890f67ea_4696_4543_b0cc_4f16c1c12d4c
+
+#include "rinex.h"
+
+#include <stdio.h>
+
+/* The QC accumulator sees each record once, right after the parser
+ * reads it, so a file can be checked without a second pass.  It keeps
+ * these statistics:
+ *
+ * - For the file: epoch count, first and last epoch, nominal interval,
+ *   expected epochs and gaps.
+ * - For each satellite: epochs tracked, gaps, and RMS multipath (MP1
+ *   and MP2) and ionospheric rate when the satellite system has two
+ *   known carrier frequencies and both code and phase are observed on
+ *   each.  GLONASS has no fixed frequencies, so it has no multipath or
+ *   ionospheric statistics.
+ * - For each signal: observation count, loss-of-lock count (LLI bit 0)
+ *   and, for signal-strength codes (S1, S2C and so on), a histogram in
+ *   5 dB-Hz bins.
+ *
+ * Multipath is computed per arc and the arc's mean is removed, as teqc
+ * does.  An arc ends at a gap, at a loss of lock on either phase, or
+ * when the ionospheric rate exceeds #RINEX_QC_IOD_SLIP_CM_MIN.
+ */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/** Number of bins in each signal-strength histogram.  Bin n counts
+ * values from 5n to 5n+5 dB-Hz; the last bin counts everything higher.
+ */
+#define RINEX_QC_SNR_BINS 13
+
+/** Ionospheric rates above this many cm/min are counted as slips. */
+#define RINEX_QC_IOD_SLIP_CM_MIN 400
+
+/** rinex_qc accumulates quality statistics for one RINEX file. */
+struct rinex_qc;
+
+/** Creates a QC accumulator for the file that \a p is reading.
+ *
+ * This reads the observation codes and interval from the header, so
+ * it must be called before the first call to \a p->read().
+ *
+ * \param[out] p_qc Receives the accumulator.
+ * \param[in] p Parser that has just read the file header.
+ * \returns Zero on success, EINVAL if the header's observation codes
+ *   cannot be read, or ENOMEM.
+ */
+int rinex_qc_create(
+    struct rinex_qc **p_qc,
+    const struct rinex_parser *p
+);
+
+/** Adds the parser's current record to an accumulator.
+ *
+ * Records other than observations (epoch flags '0' and '1') are
+ * ignored.
+ *
+ * \param[in] qc Accumulator to update.
+ * \param[in] p Parser that just read a record.
+ * \returns Zero on success, else ENOMEM.
+ */
+int rinex_qc_add(
+    struct rinex_qc *qc,
+    const struct rinex_parser *p
+);
+
+/** Writes the accumulated statistics as one line of JSON.
+ *
+ * The object has file-level keys ("file", "epochs", "first", "last",
+ * "interval", "expected", "gaps"), then "codes", which maps each
+ * satellite system to its observation codes, and "sats", which holds
+ * one object per satellite.  Per-signal arrays in a satellite object
+ * ("obs" and "lli") follow the order of the system's codes; "snr"
+ * maps each signal-strength code to its histogram.  RMS values are in
+ * meters (multipath) or cm/min (ionospheric rate), and are omitted when
+ * there was not enough data.  Writing does not reset the statistics.
+ *
+ * \param[in] qc Accumulator to report.
+ * \param[in] filename Name to report for the file; may be NULL.
+ * \param[in] out Stream to write to.
+ * \returns Zero on success, else errno from the stream.
+ */
+int rinex_qc_write_json(
+    const struct rinex_qc *qc,
+    const char *filename,
+    FILE *out
+);
+
+/** Frees an accumulator.
+ *
+ * \param[in] qc Accumulator to free; may be NULL.
+ */
+void rinex_qc_destroy(
+    struct rinex_qc *qc
+);
+
+#if defined(__cplusplus)
+}
+#endif /* defined(__cplusplus) */
+
+#endif /* !defined(RINEX_QC_H_890f67ea_4696_4543_b0cc_4f16c1c12d4c) */
@@ -27,8 +27,9 @@
 
 void process_file(struct rinex_parser *p, const char filename[])
 {
-    int count, max_obs, max_sats, ii, jj, n_obs, sys_obs;
+    const struct rinex_sat_entry *last;
     const char *buffer;
+    int count, max_obs, max_sats, ii, jj, n_obs, sys_obs;
 
     for (count = max_obs = max_sats = 0; ; ++count)
     {
@@ -53,15 +54,27 @@ void process_file(struct rinex_parser *p, const char filename[])
             max_sats = p->epoch.n_sats;
         }
 
-        buffer = p->buffer;
-        for (ii = n_obs = 0; ii < p->epoch.n_sats; ++ii)
+        /* Satellites' observations are stored consecutively.  Parsers
+         * that do not fill p->sats need the presence bits counted.
+         */
+        n_obs = 0;
+        if (p->sats && p->epoch.n_sats > 0)
+        {
+            last = p->sats + p->epoch.n_sats - 1;
+            n_obs = last->obs_ofs + last->n_obs;
+        }
+        else if (!p->sats)
         {
-            sys_obs = p->n_obs[buffer[0] & 31];
-            for (jj = 0; jj < (sys_obs + 7) >> 3; ++jj)
+            buffer = p->buffer;
+            for (ii = 0; ii < p->epoch.n_sats; ++ii)
             {
-                n_obs += __builtin_popcount(buffer[2+jj] & 255);
+                sys_obs = p->n_obs[buffer[0] & 31];
+                for (jj = 0; jj < (sys_obs + 7) >> 3; ++jj)
+                {
+                    n_obs += __builtin_popcount(buffer[2+jj] & 255);
+                }
+                buffer += 2 + jj;
             }
-            buffer += 2 + jj;
         }
 
         if (max_obs < n_obs)
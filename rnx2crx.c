@@ -0,0 +1,163 @@
+/** rnx2crx.c - Converts RINEX observation files to Compact RINEX.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "rinex_crx.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Picks an output name: "x.rnx" becomes "x.crx", RINEX 2 "x.21o"
+ * becomes "x.21d", and anything else gets ".crx" appended.
+ * \returns A newly allocated name, or NULL on allocation failure.
+ */
+static char *crx_file_name(const char input_name[])
+{
+    size_t name_len;
+    char *output_name;
+
+    name_len = strlen(input_name);
+    output_name = malloc(name_len + 5);
+    if (!output_name)
+    {
+        return NULL;
+    }
+    memcpy(output_name, input_name, name_len + 1);
+
+    if (name_len > 4 && !strcmp(input_name + name_len - 4, ".rnx"))
+    {
+        strcpy(output_name + name_len - 4, ".crx");
+    }
+    else if (name_len > 4 && input_name[name_len - 4] == '.'
+        && isdigit(input_name[name_len - 3])
+        && isdigit(input_name[name_len - 2])
+        && tolower(input_name[name_len - 1]) == 'o')
+    {
+        output_name[name_len - 1] += 'd' - 'o';
+    }
+    else
+    {
+        strcpy(output_name + name_len, ".crx");
+    }
+
+    return output_name;
+}
+
+static int rnx2crx(const char input_name[], const char output_name[])
+{
+    struct rinex_parser *parser;
+    struct rinex_stream *stream;
+    struct rinex_crx *crx;
+    const char *err;
+    FILE *fout;
+    int res;
+
+    /* Open the input file. */
+    stream = rinex_mmap_stream(input_name);
+    if (!stream)
+    {
+        fprintf(stderr, "Unable to open %s: %s\n", input_name, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    parser = NULL;
+    err = rinex_open(&parser, stream);
+    if (err)
+    {
+        fprintf(stderr, "Unable to open %s: %s\n", input_name, err);
+        stream->destroy(stream);
+        return EXIT_FAILURE;
+    }
+
+    /* Open the output file. */
+    fout = strcmp(output_name, "-") ? fopen(output_name, "w") : stdout;
+    if (!fout)
+    {
+        fprintf(stderr, "Unable to create %s: %s\n", output_name, strerror(errno));
+        parser->destroy(parser);
+        stream->destroy(stream);
+        return EXIT_FAILURE;
+    }
+
+    /* Convert each record. */
+    res = rinex_crx_create(&crx, parser, fout);
+    if (res)
+    {
+        fprintf(stderr, "Unable to write %s: %s\n", output_name, strerror(res));
+    }
+    else
+    {
+        while ((res = parser->read(parser)) == RINEX_SUCCESS)
+        {
+            res = rinex_crx_write(crx, parser);
+            if (res)
+            {
+                fprintf(stderr, "Unable to write %s: %s\n", output_name,
+                    strerror(res));
+                break;
+            }
+        }
+        if (res < 0)
+        {
+            fprintf(stderr, "Error on line %d while reading %s\n",
+                parser->error_line, input_name);
+        }
+        rinex_crx_destroy(crx);
+    }
+
+    if (fout != stdout && fclose(fout) && !res)
+    {
+        fprintf(stderr, "Unable to write %s: %s\n", output_name, strerror(errno));
+        res = errno;
+    }
+    parser->destroy(parser);
+    stream->destroy(stream);
+
+    return res ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    char *output_name;
+    int res;
+
+    if (argc < 2 || argc > 3)
+    {
+        fprintf(stderr, "Usage: %s <input.rnx> [output.crx|-]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    output_name = (argc > 2) ? strdup(argv[2]) : crx_file_name(argv[1]);
+    if (!output_name)
+    {
+        fprintf(stderr, "%s\n", strerror(ENOMEM));
+        return EXIT_FAILURE;
+    }
+
+    res = rnx2crx(argv[1], output_name);
+
+    free(output_name);
+    return res;
+}
@@ -22,18 +22,21 @@
  * SOFTWARE.
  */
 
-#include "srnx.h"
+#include "srnx_p.h"
 #include "rinex_p.h" /* page_size, rnx_find_header(), etc. */
 #include "transpose.h"
 
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <math.h>
+#include <pthread.h>
 #include <string.h>
 #include <stdlib.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 #ifdef __x86_64__
@@ -51,6 +54,29 @@
 #define BLOCK_ZERO 0xFE
 #define BLOCK_SLEB128 0xFF
 
+/** Log2 of the usual granularity of reads by the pread backend. */
+#define SRNX_LOAD_SHIFT 16
+
+/** Maximum number of free observation readers kept per thread. */
+#define OBS_POOL_MAX 8
+
+/** Largest decoded-segment buffer that a pooled observation reader
+ * keeps; bigger ones are freed when the reader is released.
+ */
+#define OBS_POOL_UNPACKED_MAX 65536
+
+/** srnx_pending_read describes the first range of a file that an
+ * asynchronous reader found missing.
+ */
+struct srnx_pending_read
+{
+    /** File offset of the range. */
+    uint64_t offset;
+
+    /** Length of the range; zero if no read is pending. */
+    uint64_t len;
+};
+
 /** srnx_system_info holds information about a satellite system's
  * observations in a file.
  */
@@ -78,6 +104,54 @@ struct srnx_reader
     /** Mapped length of #data. */
     size_t data_mapped;
 
+    /** Length of the file. */
+    size_t file_size;
+
+    /** Identity of the file, for the decoded-observation cache. */
+    struct srnx_file_id file_id;
+
+    /** File descriptor for the pread backend, or -1 if #data is a
+     * mapping of the file.
+     */
+    int fd;
+
+    /** For the pread backend, a bitmap of which blocks of #data have
+     * been read from the file.  Bits are only set, with release
+     * ordering, after their blocks have been read.
+     */
+    uint8_t *loaded;
+
+    /** For the pread backend, a bitmap of which blocks some thread has
+     * claimed and is reading.  Protected by #load_lock.
+     */
+    uint8_t *loading;
+
+    /** For the pread backend, protects #loading, so that two threads
+     * never fill the same block.  Buffered reads run without it held.
+     * Only valid if #loaded is not NULL.
+     */
+    pthread_mutex_t load_lock;
+
+    /** For the pread backend, signaled when a thread finishes (or
+     * fails) reading blocks it claimed in #loading.
+     */
+    pthread_cond_t load_cond;
+
+    /** Log2 of the size of the blocks in #loaded: #SRNX_LOAD_SHIFT, or
+     * smaller for files with small chunk group alignment.
+     */
+    unsigned int load_shift;
+
+    /** Non-zero if #fd reads with direct I/O, so reads must cover whole
+     * pages.
+     */
+    int direct;
+
+    /** For the asynchronous backend, the read that the caller must do
+     * before retrying; NULL for other backends.
+     */
+    struct srnx_pending_read *pending;
+
     /** Holds the last line number that generated an error. */
     int error_line;
 
@@ -87,6 +161,11 @@ struct srnx_reader
     /** SRNX minor version number. */
     int minor;
 
+    /** Log2 of the alignment of satellite chunk groups, or zero if the
+     * file does not align them.
+     */
+    int align_log2;
+
     /** Enumerated identifier for chunk digests. */
     int chunk_digest;
 
@@ -125,11 +204,13 @@ struct srnx_obs_reader
     /** Number of valid elements in #obs. */
     unsigned short obs_valid;
 
-    /* Manually control the location of padding. */
-    unsigned char pad[3];
+    /** Read pointer within #obs.  This can equal the length of #obs,
+     * so it must be wider than a byte.
+     */
+    unsigned short obs_idx;
 
-    /** Read pointer within #obs. */
-    unsigned char obs_idx;
+    /** Index of the next unused value in \a ref->obs. */
+    unsigned short ref_pos;
 
     /** Order of delta coding (0 to 7 inclusive). */
     unsigned char order;
@@ -148,15 +229,73 @@ struct srnx_obs_reader
     /** Number of observation values in the SOCD chunk. */
     uint64_t n_values;
 
+    /** Reader for the reference signal if this signal is predicted
+     * from another one, else NULL.
+     */
+    struct srnx_obs_reader *ref;
+
+    /** Numerator of the scale applied to reference values. */
+    int64_t ref_num;
+
+    /** Denominator of the scale applied to reference values. */
+    int64_t ref_den;
+
     /** Offset of (RLE-compressed) LLI indicator block, relative to \a parent->data. */
     uint64_t lli_offset;
 
-    /** Offset of next observation read position, relative to \a parent->data. */
+    /** Block data: \a parent->data, or #unpacked if the blocks are
+     * entropy coded.
+     */
+    const char *base;
+
+    /** The current entropy-coded segment's decoded blocks, from
+     * srnx_reserve().  A small buffer is kept when a reader is reused.
+     */
+    char *unpacked;
+
+    /** Offset of the first entropy-coded segment, relative to
+     * \a parent->data.
+     */
+    uint64_t coded_start;
+
+    /** Offset of the next entropy-coded segment to decode, relative to
+     * \a parent->data.
+     */
+    uint64_t coded_offset;
+
+    /** End of the entropy-coded segments, relative to \a parent->data,
+     * or zero if the blocks are not entropy coded.
+     */
+    uint64_t coded_end;
+
+    /** Offset of next observation read position, relative to #base. */
     uint64_t data_offset;
 
-    /** End of SOCD payload. */
+    /** End of SOCD packed observation data, relative to #base. */
     uint64_t data_end;
 
+    /** Offset of the first block header, relative to #base, if the
+     * blocks are not entropy coded.
+     */
+    uint64_t blocks_offset;
+
+    /** Offset of the zone map, relative to \a parent->data, or zero if
+     * the SOCD chunk has no zone map.
+     */
+    uint64_t zone_offset;
+
+    /** End of the SOCD payload (and of any zone map). */
+    uint64_t zone_end;
+
+    /** Offset of zone entry #zone_cursor, relative to \a parent->data,
+     * or zero if no zone entry has been located yet.  This lets
+     * sequential zone seeks avoid re-walking the zone map.
+     */
+    uint64_t zone_cursor_offset;
+
+    /** Index of the zone entry at #zone_cursor_offset. */
+    uint64_t zone_cursor;
+
     /** Delta coding state vector.
      *
      * \a delta[0] is the last raw value to be written to \a obs,
@@ -170,25 +309,167 @@ struct srnx_obs_reader
     int64_t obs[256];
 };
 
-/* Negative SRNX error numbers. */
-enum srnx_errno
-{
-    SRNX_NOT_SRNX = -1,
-    SRNX_CORRUPT = -2,
-    SRNX_BAD_MAJOR = -3,
-    SRNX_BAD_STATE = -4,
-    SRNX_NO_CHUNK = -5,
-    SRNX_UNKNOWN_SYSTEM = -6,
-    SRNX_UNKNOWN_CODE = -7,
-    SRNX_UNKNOWN_SATELLITE = -8,
-    SRNX_END_OF_DATA = -9,
-    SRNX_IMPLEMENTATION_ERROR = -10
+/** srnx_buffer_header precedes each buffer from srnx_reserve(). */
+union srnx_buffer_header
+{
+    /** Allocated length of the buffer, not counting this header. */
+    size_t alloc;
+
+    /** Keeps the buffer aligned. */
+    char pad[SRNX_ALIGN];
+};
+
+/** srnx_obs_pool holds a thread's free observation readers. */
+struct srnx_obs_pool
+{
+    /** Number of readers in #rdr. */
+    int count;
+
+    /** Free readers. */
+    struct srnx_obs_reader *rdr[OBS_POOL_MAX];
 };
 
+/** Thread-specific data key for each thread's srnx_obs_pool. */
+static pthread_key_t obs_pool_key;
+
+/** Ensures #obs_pool_key is created once. */
+static pthread_once_t obs_pool_once = PTHREAD_ONCE_INIT;
+
+/** Non-zero if #obs_pool_key was created successfully. */
+static int obs_pool_ok;
+
+/** Frees a thread's observation reader pool when the thread exits. */
+static void obs_pool_destroy(void *arg)
+{
+    struct srnx_obs_pool *pool = arg;
+
+    while (pool->count > 0)
+    {
+        --pool->count;
+        srnx_free(pool->rdr[pool->count]->unpacked);
+        free(pool->rdr[pool->count]);
+    }
+    free(pool);
+}
+
+/** Creates #obs_pool_key. */
+static void obs_pool_init(void)
+{
+    obs_pool_ok = !pthread_key_create(&obs_pool_key, obs_pool_destroy);
+}
+
+/** Returns the calling thread's observation reader pool, creating it
+ * if necessary, or NULL if it cannot be created.
+ */
+static struct srnx_obs_pool *obs_pool_get(void)
+{
+    struct srnx_obs_pool *pool;
+
+    pthread_once(&obs_pool_once, obs_pool_init);
+    if (!obs_pool_ok)
+    {
+        return NULL;
+    }
+
+    pool = pthread_getspecific(obs_pool_key);
+    if (!pool)
+    {
+        pool = calloc(1, sizeof *pool);
+        if (pool && pthread_setspecific(obs_pool_key, pool))
+        {
+            free(pool);
+            pool = NULL;
+        }
+    }
+
+    return pool;
+}
+
+/** Allocates an observation reader, reusing one from the calling
+ * thread's pool if possible.
+ */
+static struct srnx_obs_reader *obs_reader_alloc(void)
+{
+    struct srnx_obs_reader *rdr;
+    struct srnx_obs_pool *pool;
+
+    pool = obs_pool_get();
+    if (pool && pool->count > 0)
+    {
+        return pool->rdr[--pool->count];
+    }
+
+    rdr = aligned_alloc(SRNX_ALIGN, (sizeof(struct srnx_obs_reader)
+        + SRNX_ALIGN - 1) & -SRNX_ALIGN);
+    if (rdr)
+    {
+        rdr->ref = NULL;
+        rdr->unpacked = NULL;
+    }
+    return rdr;
+}
+
+/* Doc comment in srnx_p.h. */
+void *srnx_reserve(void *ptr, size_t size)
+{
+    union srnx_buffer_header *hdr, *old;
+    size_t alloc;
+
+    old = ptr ? (union srnx_buffer_header *)ptr - 1 : NULL;
+    if (old && old->alloc >= size)
+    {
+        return ptr;
+    }
+
+    /* Round up to whole cache lines, and grow by at least half of the
+     * old size, so arrays that grow one element at a time do not copy
+     * every time.
+     */
+    alloc = (size + SRNX_ALIGN - 1) & -SRNX_ALIGN;
+    if (old && alloc < old->alloc + old->alloc / 2)
+    {
+        alloc = (old->alloc + old->alloc / 2 + SRNX_ALIGN - 1) & -SRNX_ALIGN;
+    }
+    if (alloc < size || alloc + sizeof *hdr < alloc)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    hdr = aligned_alloc(SRNX_ALIGN, sizeof *hdr + alloc);
+    if (!hdr)
+    {
+        return NULL;
+    }
+    hdr->alloc = alloc;
+    if (old)
+    {
+        memcpy(hdr + 1, ptr, old->alloc);
+        free(old);
+    }
+
+    return hdr + 1;
+}
+
+/* Doc comment in srnx_p.h. */
+size_t srnx_reserved(const void *ptr)
+{
+    return ptr ? ((const union srnx_buffer_header *)ptr - 1)->alloc : 0;
+}
+
 /* Doc comment in srnx.h. */
 void srnx_free(void *ptr)
 {
-    free(ptr);
+    if (ptr)
+    {
+        free((union srnx_buffer_header *)ptr - 1);
+    }
+}
+
+/* Doc comment in srnx.h. */
+int srnx_error_line(const struct srnx_reader *srnx)
+{
+    return srnx->error_line;
 }
 
 /* Doc comment in srnx.h. */
@@ -221,6 +502,10 @@ const char *srnx_strerror(int err)
         return "End of observation data";
     case SRNX_IMPLEMENTATION_ERROR:
         return "Implementation error";
+    case SRNX_IO_ERROR:
+        return "Error reading SRNX file";
+    case SRNX_WOULD_BLOCK:
+        return "SRNX file data has not been read yet";
     }
 
     return "Unknown SRNX error code";
@@ -232,10 +517,10 @@ static uint64_t uleb128(const char **d)
     uint64_t accum = **d & 127;
     int shift = 0;
 
-    while (**d & 128)
+    while (*(*d)++ & 128)
     {
         shift += 7;
-        accum = (uint64_t)((*++*d) & 127) << shift;
+        accum |= (uint64_t)(**d & 127) << shift;
     }
 
     return accum;
@@ -245,11 +530,9 @@ static uint64_t uleb128(const char **d)
 static int64_t sleb128(const char **d)
 {
     uint64_t ul;
-    int64_t mag;
 
     ul = uleb128(d);
-    mag = ul >> 1;
-    return (ul & 1) ? -mag : mag;
+    return (int64_t)(ul >> 1) ^ -(int64_t)(ul & 1);
 }
 
 /** Returns the length of digests for digest \a digest_id. */
@@ -258,6 +541,55 @@ static int srnx_digest_length(int digest_id)
     return digest_id ? (1 << (digest_id & 7)) : 0;
 }
 
+/* Doc comment in srnx_p.h. */
+uint64_t srnx_padding_chunk(
+    char out[16],
+    uint64_t offset,
+    int align_log2,
+    int chunk_digest,
+    int *p_head_len
+)
+{
+    uint64_t align, gap, payload_len;
+    int digest_len, width, ii;
+
+    align = (uint64_t)1 << align_log2;
+    gap = -offset & (align - 1);
+    if (!gap)
+    {
+        *p_head_len = 0;
+        return 0;
+    }
+
+    /* The smallest chunk is a FOURCC, a one-byte length and a digest.
+     * The length may take more bytes than it needs, so that the chunk
+     * exactly fills the gap.
+     */
+    digest_len = srnx_digest_length(chunk_digest);
+    if (gap < 5u + digest_len)
+    {
+        gap += align;
+    }
+    for (width = 1; ; ++width)
+    {
+        payload_len = gap - 4 - width - digest_len;
+        if (payload_len >> (7 * width) == 0)
+        {
+            break;
+        }
+    }
+
+    memcpy(out, "PADD", 4);
+    for (ii = 0; ii < width; ++ii)
+    {
+        out[4 + ii] = (payload_len & 127) | ((ii + 1 < width) ? 128 : 0);
+        payload_len >>= 7;
+    }
+    *p_head_len = 4 + width;
+
+    return gap;
+}
+
 /* Doc comment in srnx.h */
 void srnx_convert_s64_to_double(
     void *s64,
@@ -494,1049 +826,3086 @@ static int srnx_parse_rhdr(
     return SRNX_BAD_MAJOR;
 }
 
-/* Doc comment in srnx.h. */
-/* TODO: Optionally check file and chunk digests.
- * (Default to checking chunk digests, but allow the app to disable
- * that.  Provide a function to check the whole-file digest.)
+/** Checks whether block \a blk of a pread or asynchronous reader's
+ * file has been loaded into \a srnx->data.
  */
-int srnx_open(struct srnx_reader **p_srnx, const char filename[])
+static int srnx_block_loaded(const struct srnx_reader *srnx, uint64_t blk)
 {
-    struct stat sbuf;
-    void *addr;
-    const char *chunk, *rptr, *payload_start;
-    size_t file_size, tot_len;
-    uint64_t ul, payload_len;
-    int fd, res, chunk_digest_length, file_digest, file_digest_length;
+    return __atomic_load_n(srnx->loaded + (blk >> 3), __ATOMIC_ACQUIRE)
+        & (1 << (blk & 7));
+}
 
-    /* Either clean up old srnx_reader, or allocate a new one. */
-    if (*p_srnx)
+/** Marks blocks \a first through \a last (inclusive) of \a srnx as
+ * loaded, publishing their contents to other threads.
+ */
+static void srnx_mark_loaded(
+    const struct srnx_reader *srnx,
+    uint64_t first,
+    uint64_t last
+)
+{
+    for (; first <= last; ++first)
+    {
+        __atomic_fetch_or(srnx->loaded + (first >> 3), 1 << (first & 7),
+            __ATOMIC_RELEASE);
+    }
+}
+
+/** Sets or clears the #srnx_reader::loading bits for blocks \a first
+ * through \a last (inclusive).  The caller must hold
+ * #srnx_reader::load_lock.
+ */
+static void srnx_mark_loading(
+    const struct srnx_reader *srnx,
+    uint64_t first,
+    uint64_t last,
+    int set
+)
+{
+    for (; first <= last; ++first)
     {
-        if ((*p_srnx)->data)
+        if (set)
         {
-            munmap((void *)(*p_srnx)->data, (*p_srnx)->data_mapped);
+            srnx->loading[first >> 3] |= 1 << (first & 7);
         }
-
-        for (ul = 0; ul < 33; ++ul)
+        else
         {
-            free((*p_srnx)->sys_info[ul].code);
-            (*p_srnx)->sys_info[ul].code = NULL;
-            (*p_srnx)->sys_info[ul].codes_len = 0;
+            srnx->loading[first >> 3] &= ~(1 << (first & 7));
         }
-
-        memset(*p_srnx, 0, sizeof **p_srnx);
     }
-    else
+}
+
+/** Makes sure [\a offset, \a offset + \a len) of \a srnx->data holds
+ * the file's contents.
+ *
+ * For the mmap backend this is a no-op.  For the pread backend, this
+ * reads any missing blocks (see #srnx_reader::load_shift) that overlap
+ * the range, coalescing consecutive missing blocks into one read.  A
+ * thread claims the blocks it reads in #srnx_reader::loading and does
+ * buffered reads without holding #srnx_reader::load_lock, so threads
+ * that need different blocks read concurrently; a thread that needs a
+ * block another thread is reading waits for that read.  Direct reads
+ * stay under the lock, because they round up to whole pages and may
+ * switch the descriptor back to buffered I/O.  For the asynchronous
+ * backend, this records the first run of missing blocks in
+ * #srnx_reader::pending instead of reading it.
+ *
+ * \param[in] srnx SRNX reader object.
+ * \param[in] offset Start of the range to load.
+ * \param[in] len Length of the range to load.
+ * \returns Zero on success, \a SRNX_WOULD_BLOCK if the asynchronous
+ *   backend must read data first, else \a SRNX_IO_ERROR (with errno
+ *   set).  After an error, the blocks that failed to load are still
+ *   missing, so a later call retries them.
+ */
+static int srnx_load(
+    const struct srnx_reader *srnx,
+    uint64_t offset,
+    uint64_t len
+)
+{
+    pthread_mutex_t *lock;
+    pthread_cond_t *cond;
+    uint64_t end, blk, first, last, start, stop, count;
+    unsigned int shift;
+    ssize_t res;
+    int err, direct;
+
+    if (srnx->fd < 0 || offset >= srnx->file_size || len == 0)
     {
-        *p_srnx = calloc(1, sizeof **p_srnx);
-        if (!*p_srnx)
-        {
-            return ENOMEM;
-        }
+        return 0;
     }
-    (*p_srnx)->data = NULL;
-    (*p_srnx)->sdir_offset = -1;
-    (*p_srnx)->epoc_offset = -1;
-    (*p_srnx)->evtf_offset = -1;
 
-    /* Open the requested file. */
-    fd = open(filename, O_RDONLY | O_CLOEXEC);
-    if (fd < 0)
+    end = offset + len;
+    if (end > srnx->file_size || end < offset)
     {
-        (*p_srnx)->error_line = __LINE__;
-        return errno;
+        end = srnx->file_size;
     }
 
-    /* Find its size. */
-    res = fstat(fd, &sbuf);
-    if (res < 0)
+    shift = srnx->load_shift;
+    last = (end - 1) >> shift;
+    for (blk = offset >> shift; blk <= last; ++blk)
     {
-        (*p_srnx)->error_line = __LINE__;
-        return errno;
+        if (srnx_block_loaded(srnx, blk))
+        {
+            continue;
+        }
+
+        /* Ask the caller to read this and any following missing blocks. */
+        start = blk << shift;
+        if (srnx->pending)
+        {
+            while (blk < last && !srnx_block_loaded(srnx, blk + 1))
+            {
+                ++blk;
+            }
+            stop = (blk + 1) << shift;
+            srnx->pending->offset = start;
+            srnx->pending->len = ((stop < srnx->file_size) ? stop
+                : srnx->file_size) - start;
+            if (srnx->direct)
+            {
+                srnx->pending->len = (srnx->pending->len + page_size - 1)
+                    & -page_size;
+            }
+            return SRNX_WOULD_BLOCK;
+        }
+
+        /* Another thread may be reading the block, or have read it
+         * while we waited.  If its read failed, try again ourselves.
+         */
+        lock = (pthread_mutex_t *)&srnx->load_lock;
+        cond = (pthread_cond_t *)&srnx->load_cond;
+        pthread_mutex_lock(lock);
+        while (srnx->loading[blk >> 3] & (1 << (blk & 7)))
+        {
+            pthread_cond_wait(cond, lock);
+        }
+        if (srnx_block_loaded(srnx, blk))
+        {
+            pthread_mutex_unlock(lock);
+            continue;
+        }
+
+        /* Claim this and any following missing blocks that no other
+         * thread is reading, and read them at once.
+         */
+        first = blk;
+        while (blk < last && !srnx_block_loaded(srnx, blk + 1)
+            && !(srnx->loading[(blk + 1) >> 3] & (1 << ((blk + 1) & 7))))
+        {
+            ++blk;
+        }
+        srnx_mark_loading(srnx, first, blk, 1);
+        direct = srnx->direct;
+        if (!direct)
+        {
+            pthread_mutex_unlock(lock);
+        }
+        stop = (blk + 1) << shift;
+        if (stop > srnx->file_size)
+        {
+            stop = srnx->file_size;
+        }
+
+        for (err = 0; start < stop && !err; )
+        {
+            /* Direct reads must cover whole pages, even at the end of
+             * the file; #srnx_reader::data has room for that.
+             */
+            count = stop - start;
+            if (srnx->direct)
+            {
+                count = (count + page_size - 1) & -page_size;
+            }
+            res = pread(srnx->fd, (char *)srnx->data + start, count, start);
+            if (res > 0 && srnx->direct && start + res < stop
+                && (res & (page_size - 1)))
+            {
+                /* The next direct read must start on a page boundary,
+                 * so read the partial page again.  If not even one page
+                 * arrived, go back to buffered reads.
+                 */
+                if (res >= page_size)
+                {
+                    res &= -page_size;
+                }
+                else if ((err = srnx_set_direct_io(srnx->fd, 0)) == 0)
+                {
+                    ((struct srnx_reader *)srnx)->direct = 0;
+                }
+            }
+            if (res > 0)
+            {
+                start += res;
+            }
+            else if (res == 0)
+            {
+                err = EIO;
+            }
+            else if (errno != EINTR)
+            {
+                err = errno;
+            }
+        }
+
+        /* Only publish the blocks once all of them are present. */
+        if (!direct)
+        {
+            pthread_mutex_lock(lock);
+        }
+        if (!err)
+        {
+            srnx_mark_loaded(srnx, first, blk);
+        }
+        srnx_mark_loading(srnx, first, blk, 0);
+        pthread_cond_broadcast(cond);
+        pthread_mutex_unlock(lock);
+        if (err)
+        {
+            errno = err;
+            return SRNX_IO_ERROR;
+        }
     }
-    file_size = sbuf.st_size;
 
-    /* Memory-map the file. */
-    if (!page_size && rnx_mmap_init())
+    return 0;
+}
+
+/** Releases the file data and backend state held by \a srnx. */
+static void srnx_release(struct srnx_reader *srnx)
+{
+    if (srnx->data)
     {
-        (*p_srnx)->error_line = __LINE__;
-        return errno;
+        munmap((void *)srnx->data, srnx->data_mapped);
+        srnx->data = NULL;
     }
-    tot_len = (file_size + RINEX_EXTRA + page_size - 1) & -page_size;
-    addr = rnx_mmap_padded(fd, 0, file_size, tot_len);
-    if (addr == MAP_FAILED)
+    if (srnx->fd >= 0)
     {
-        (*p_srnx)->error_line = __LINE__;
-        res = errno;
-        close(fd);
-        return res;
+        close(srnx->fd);
+        srnx->fd = -1;
     }
-    close(fd);
-
-    /* Check that first chunk is SRNX. */
-    chunk = addr;
-    if (memcmp(chunk, "SRNX", 4))
+    if (srnx->loaded)
     {
-        (*p_srnx)->error_line = __LINE__;
-        res = SRNX_NOT_SRNX;
-late_failure:
-        munmap(addr, tot_len);
-        return res;
+        pthread_cond_destroy(&srnx->load_cond);
+        pthread_mutex_destroy(&srnx->load_lock);
+        free(srnx->loaded);
+        srnx->loaded = NULL;
+    }
+    free(srnx->loading);
+    srnx->loading = NULL;
+    free(srnx->pending);
+    srnx->pending = NULL;
+}
+
+/* Doc comment in srnx_p.h. */
+uint8_t *srnx_split_loaded(
+    const uint8_t *loaded,
+    uint64_t file_size,
+    unsigned int old_shift,
+    unsigned int new_shift
+)
+{
+    uint64_t blk, old, n_blocks;
+    uint8_t *split;
+
+    n_blocks = (file_size >> new_shift) + 1;
+    split = calloc((n_blocks + 7) >> 3, 1);
+    if (!split)
+    {
+        return NULL;
+    }
+    for (blk = 0; blk < n_blocks; ++blk)
+    {
+        old = blk >> (old_shift - new_shift);
+        if (loaded[old >> 3] & (1 << (old & 7)))
+        {
+            split[blk >> 3] |= 1 << (blk & 7);
+        }
+    }
+
+    return split;
+}
+
+/** Switches the pread or asynchronous backend to direct I/O for a
+ * file whose satellite chunk groups are aligned.
+ *
+ * Each group then takes whole pages, so reading it with O_DIRECT
+ * neither bounces through the page cache nor pulls in its neighbours.
+ * If the group alignment is smaller than #SRNX_LOAD_SHIFT, this also
+ * shrinks the read granularity to match, so a group is read alone.
+ * Failures are not errors: the reader just keeps reading as before,
+ * for example on filesystems that do not support O_DIRECT.
+ *
+ * \param[in,out] srnx SRNX reader object using the pread or
+ *   asynchronous backend.
+ */
+static void srnx_use_direct_io(struct srnx_reader *srnx)
+{
+    uint8_t *loaded, *loading;
+    unsigned int shift;
+
+    if (srnx_set_direct_io(srnx->fd, 1))
+    {
+        return;
+    }
+    srnx->direct = 1;
+
+    /* Direct reads must still be whole pages. */
+    shift = srnx->align_log2;
+    while (((long)1 << shift) < page_size)
+    {
+        ++shift;
+    }
+    if (shift >= srnx->load_shift)
+    {
+        return;
+    }
+
+    /* Split each block we already read into smaller ones. */
+    loaded = srnx_split_loaded(srnx->loaded, srnx->file_size,
+        srnx->load_shift, shift);
+    loading = srnx_split_loaded(srnx->loading, srnx->file_size,
+        srnx->load_shift, shift);
+    if (!loaded || !loading)
+    {
+        free(loaded);
+        free(loading);
+        return;
+    }
+    free(srnx->loaded);
+    free(srnx->loading);
+    srnx->loaded = loaded;
+    srnx->loading = loading;
+    srnx->load_shift = shift;
+}
+
+/** Reads the SRNX and RHDR chunks at the start of a file.
+ *
+ * For the asynchronous backend, this may be called again after
+ * \a SRNX_WOULD_BLOCK, once the pending read is complete.
+ *
+ * \param[in,out] srnx SRNX reader object with #srnx_reader::data set.
+ * \returns Zero on success, non-zero SRNX error number on error.
+ */
+static int srnx_parse_head(struct srnx_reader *srnx)
+{
+    const char *addr, *chunk, *rptr, *payload_start;
+    size_t file_size;
+    uint64_t ul, payload_len;
+    int res, chunk_digest_length, file_digest, file_digest_length;
+
+    addr = srnx->data;
+    file_size = srnx->file_size;
+    res = srnx_load(srnx, 0, (uint64_t)1 << srnx->load_shift);
+    if (res)
+    {
+        srnx->error_line = __LINE__;
+        return res;
+    }
+
+    /* Check that first chunk is SRNX. */
+    chunk = addr;
+    if (memcmp(chunk, "SRNX", 4))
+    {
+        srnx->error_line = __LINE__;
+        return SRNX_NOT_SRNX;
     }
     rptr = chunk + 4;
 
     /* Read SRNX chunk length. */
     payload_len = uleb128(&rptr);
-    if (rptr - (const char *)addr + payload_len >= file_size)
+    if (rptr - addr + payload_len >= file_size)
     {
-        (*p_srnx)->error_line = __LINE__;
-srnx_corrupt:
-        munmap(addr, tot_len);
+        srnx->error_line = __LINE__;
         return SRNX_CORRUPT;
     }
     payload_start = rptr;
+    res = srnx_load(srnx, 0, rptr - addr + payload_len);
+    if (res)
+    {
+        srnx->error_line = __LINE__;
+        return res;
+    }
 
     /* Read file major version number. */
     ul = uleb128(&rptr);
     if (ul != 1)
     {
-        (*p_srnx)->error_line = __LINE__;
-        munmap(addr, tot_len);
-        res = SRNX_BAD_MAJOR;
-        goto late_failure;
+        srnx->error_line = __LINE__;
+        return SRNX_BAD_MAJOR;
     }
-    (*p_srnx)->major = ul;
+    srnx->major = ul;
 
     /* Read file minor version number. */
     ul = uleb128(&rptr);
     if (ul > INT_MAX)
     {
-        (*p_srnx)->error_line = __LINE__;
-        goto srnx_corrupt;
+        srnx->error_line = __LINE__;
+        return SRNX_CORRUPT;
     }
-    (*p_srnx)->minor = ul;
+    srnx->minor = ul;
 
     /* Read per-chunk digest identifer. */
     ul = uleb128(&rptr);
     if (ul > INT_MAX)
     {
-        (*p_srnx)->error_line = __LINE__;
-        goto srnx_corrupt;
+        srnx->error_line = __LINE__;
+        return SRNX_CORRUPT;
     }
-    (*p_srnx)->chunk_digest = ul;
-    chunk_digest_length = srnx_digest_length((*p_srnx)->chunk_digest);
+    srnx->chunk_digest = ul;
+    chunk_digest_length = srnx_digest_length(srnx->chunk_digest);
 
     /* Read file digest identifer. */
     ul = uleb128(&rptr);
     if (ul > INT_MAX)
     {
-        (*p_srnx)->error_line = __LINE__;
-        goto srnx_corrupt;
+        srnx->error_line = __LINE__;
+        return SRNX_CORRUPT;
     }
     file_digest = ul;
     file_digest_length = srnx_digest_length(file_digest);
-    if ((uint64_t)(rptr - (const char *)addr + file_digest_length
+    if ((uint64_t)(rptr - addr + file_digest_length
         + chunk_digest_length) > file_size)
     {
-        (*p_srnx)->error_line = __LINE__;
-        goto srnx_corrupt;
+        srnx->error_line = __LINE__;
+        return SRNX_CORRUPT;
     }
     file_size -= file_digest_length + chunk_digest_length;
 
+    /* Minor version 4 puts the chunk group alignment after the SDIR
+     * offset, where older files may have padding.  We find the SDIR
+     * chunk (if any) when it is first needed.
+     */
+    if (srnx->minor >= 4)
+    {
+        (void)uleb128(&rptr);
+        ul = uleb128(&rptr);
+        if (ul && (ul < 9 || ul > 30))
+        {
+            srnx->error_line = __LINE__;
+            return SRNX_CORRUPT;
+        }
+        srnx->align_log2 = ul;
+    }
+
     /* Check that we didn't walk past the end of the chunk payload. */
     if ((uint64_t)(rptr - payload_start) > payload_len)
     {
-        (*p_srnx)->error_line = __LINE__;
-        goto srnx_corrupt;
+        srnx->error_line = __LINE__;
+        return SRNX_CORRUPT;
     }
 
     /* Check that the next chunk is RHDR. */
     chunk = payload_start + payload_len + chunk_digest_length;
+    res = srnx_load(srnx, chunk - addr, 16);
+    if (res)
+    {
+        srnx->error_line = __LINE__;
+        return res;
+    }
     if (memcmp(chunk, "RHDR", 4))
     {
-        (*p_srnx)->error_line = __LINE__;
-        goto srnx_corrupt;
+        srnx->error_line = __LINE__;
+        return SRNX_CORRUPT;
     }
-    (*p_srnx)->rhdr_offset = chunk - (const char *)addr;
+    srnx->rhdr_offset = chunk - addr;
     rptr = chunk + 4;
 
     /* Read RHDR chunk length. */
     payload_len = uleb128(&rptr);
-    if (rptr - (const char *)addr + payload_len > file_size)
+    if (rptr - addr + payload_len > file_size)
+    {
+        srnx->error_line = __LINE__;
+        return SRNX_CORRUPT;
+    }
+    res = srnx_load(srnx, rptr - addr, payload_len);
+    if (res)
     {
-        (*p_srnx)->error_line = __LINE__;
-        goto srnx_corrupt;
+        srnx->error_line = __LINE__;
+        return res;
     }
 
     /* Parse the RINEX header. */
-    res = srnx_parse_rhdr(*p_srnx, rptr, payload_len);
+    res = srnx_parse_rhdr(srnx, rptr, payload_len);
     if (res)
     {
-        goto srnx_corrupt;
+        return SRNX_CORRUPT;
     }
 
-    (*p_srnx)->data = addr;
-    (*p_srnx)->data_size = file_size;
-    (*p_srnx)->data_mapped = tot_len;
-    (*p_srnx)->next_offset = (rptr - (const char *)addr)
-        + payload_len + chunk_digest_length;
-
-    return 0;
-}
+    srnx->data_size = file_size;
+    srnx->next_offset = (rptr - addr) + payload_len + chunk_digest_length;
 
-/* Doc comment in srnx.h. */
-int srnx_get_header(
-    struct srnx_reader *srnx,
-    const char **p_rhdr,
-    size_t *rhdr_len
-)
-{
-    if (!srnx->rhdr_offset)
+    if (srnx->fd >= 0 && srnx->align_log2)
     {
-        srnx->error_line = __LINE__;
-        return SRNX_BAD_STATE;
+        srnx_use_direct_io(srnx);
     }
 
-    *p_rhdr = srnx->data + srnx->rhdr_offset;
-    *rhdr_len = uleb128(p_rhdr);
     return 0;
 }
 
-/** Return the next \a fourcc chunk after \a offset in \a srnx.
- *
- * \warning On error, the caller is responsible for setting \a srnx->error_line.
+/** Selects how srnx_open_backend() reads a file. */
+enum srnx_backend
+{
+    SRNX_BACKEND_MMAP,
+    SRNX_BACKEND_PREAD,
+    SRNX_BACKEND_ASYNC
+};
+
+/** Opens a SRNX file using the mmap, pread or asynchronous backend.
  *
- * \param[in] srnx SRNX file to read.
- * \param[in] fourcc Four-character code identifying the chunk type.
- * \param[in] whence Starting offset to search at.  Must be a chunk start.
- * \param[out] p_payload Receives pointer to target chunk's payload.
- * \param[out] p_len Receives length of chunk's payload.
- * \param[out] p_start If not NULL, receives the offset of the chunk start.
- * \param[out] p_next If not NULL, receives the offset of the next chunk.
- * \returns Zero on success, else \a SRNX_CORRUPT or \a SRNX_NO_CHUNK.
+ * \param[in,out] p_srnx Pointer to SRNX reader object, as for srnx_open().
+ * \param[in] filename Name of SRNX file on a local filesystem.
+ * \param[in] backend Backend to read the file with.
+ * \returns Zero on success, non-zero SRNX error number on error.
  */
-static int srnx_find_chunk(
-    const struct srnx_reader *srnx,
-    const char fourcc[4],
-    uint64_t whence,
-    const char **p_payload,
-    uint64_t *p_len,
-    int64_t *p_start,
-    uint64_t *p_next
+static int srnx_open_backend(
+    struct srnx_reader **p_srnx,
+    const char filename[],
+    enum srnx_backend backend
 )
 {
-    const char *chunk, *rptr;
-    uint64_t payload_len;
-    int chunk_digest_length;
+    struct srnx_reader *srnx;
+    struct stat sbuf;
+    void *addr;
+    size_t file_size, tot_len;
+    int ii, fd, res;
 
-    chunk_digest_length = srnx_digest_length(srnx->chunk_digest);
-    while (whence + 4 < srnx->data_size)
+    /* Either clean up old srnx_reader, or allocate a new one. */
+    if (*p_srnx)
     {
-        chunk = srnx->data + whence;
-        rptr = chunk + 4;
-        payload_len = uleb128(&rptr);
-        if ((rptr - srnx->data) + payload_len > srnx->data_size)
+        srnx_release(*p_srnx);
+
+        for (ii = 0; ii < 33; ++ii)
         {
-            return SRNX_CORRUPT;
+            free((*p_srnx)->sys_info[ii].code);
+            (*p_srnx)->sys_info[ii].code = NULL;
+            (*p_srnx)->sys_info[ii].codes_len = 0;
         }
-        if (!memcmp(chunk, fourcc, 4))
+
+        memset(*p_srnx, 0, sizeof **p_srnx);
+    }
+    else
+    {
+        *p_srnx = calloc(1, sizeof **p_srnx);
+        if (!*p_srnx)
         {
-            *p_payload = rptr;
-            *p_len = payload_len;
-            if (p_start)
-            {
-                *p_start = whence;
-            }
-            if (p_next)
-            {
-                *p_next = rptr - srnx->data + payload_len + chunk_digest_length;
-            }
-            return 0;
+            return ENOMEM;
         }
-        whence = rptr - srnx->data + payload_len + chunk_digest_length;
     }
+    srnx = *p_srnx;
+    srnx->data = NULL;
+    srnx->fd = -1;
+    srnx->sdir_offset = -1;
+    srnx->epoc_offset = -1;
+    srnx->evtf_offset = -1;
 
-    return SRNX_NO_CHUNK;
-}
-
-/** Return the first \a fourcc chunk in in \a srnx, which may be at \a *p_start.
- *
- * \warning On error, the caller is responsible for setting \a srnx->error_line.
- *
- * \param[in] srnx SRNX file to read.
- * \param[in] fourcc Four-character code identifying the chunk type.
- * \param[in,out] p_start Pointer to the offset of the chunk start.
- * \param[out] p_payload Receives pointer to target chunk's payload.
- * \param[out] p_len Receives length of chunk's payload.
- * \param[out] p_next If not NULL, receives the offset of the next chunk.
- * \returns Zero on success, else \a SRNX_CORRUPT or \a SRNX_NO_CHUNK.
- */
-static int srnx_find_chunk_cached(
-    const struct srnx_reader *srnx,
-    const char fourcc[4],
-    int64_t *p_start,
-    const char **p_payload,
-    uint64_t *p_len,
-    uint64_t *p_next
-)
-{
-    /* Is it known to be absent? */
-    if (*p_start == 0)
+    /* Open the requested file. */
+    fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
     {
-        return SRNX_NO_CHUNK;
+        srnx->error_line = __LINE__;
+        return errno;
     }
 
-    /* Do we know where it is? */
-    if (*p_start > 0)
+    /* Find its size. */
+    res = fstat(fd, &sbuf);
+    if (res < 0)
     {
-        const char *chunk;
-
-        if ((uint64_t)*p_start >= srnx->data_size)
+        srnx->error_line = __LINE__;
+        res = errno;
+        close(fd);
+        return res;
+    }
+    file_size = sbuf.st_size;
+    srnx->file_id.dev = sbuf.st_dev;
+    srnx->file_id.ino = sbuf.st_ino;
+    srnx->file_id.size = sbuf.st_size;
+    srnx->file_id.mtime_ns = sbuf.st_mtim.tv_sec * (int64_t)1000000000
+        + sbuf.st_mtim.tv_nsec;
+
+    /* Memory-map the file, or reserve zero-filled address space that
+     * the pread and asynchronous backends fill in as chunks are needed.
+     */
+    if (!page_size && rnx_mmap_init())
+    {
+        srnx->error_line = __LINE__;
+        res = errno;
+        close(fd);
+        return res;
+    }
+    tot_len = (file_size + RINEX_EXTRA + page_size - 1) & -page_size;
+    if (backend != SRNX_BACKEND_MMAP)
+    {
+        addr = mmap(NULL, tot_len, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    }
+    else
+    {
+        addr = rnx_mmap_padded(fd, 0, file_size, tot_len);
+    }
+    if (addr == MAP_FAILED)
+    {
+        srnx->error_line = __LINE__;
+        res = errno;
+        close(fd);
+        return res;
+    }
+    srnx->data = addr;
+    srnx->data_mapped = tot_len;
+    srnx->file_size = file_size;
+    if (backend != SRNX_BACKEND_MMAP)
+    {
+        srnx->fd = fd;
+        srnx->load_shift = SRNX_LOAD_SHIFT;
+        srnx->loaded = calloc(((file_size >> SRNX_LOAD_SHIFT) + 8) >> 3, 1);
+        srnx->loading = calloc(((file_size >> SRNX_LOAD_SHIFT) + 8) >> 3, 1);
+        if (srnx->loaded && (!srnx->loading
+            || pthread_mutex_init(&srnx->load_lock, NULL)))
         {
-            return SRNX_NO_CHUNK;
+            free(srnx->loaded);
+            srnx->loaded = NULL;
         }
-
-        chunk = srnx->data + *p_start;
-        if (memcmp(chunk, fourcc, 4))
+        else if (srnx->loaded
+            && pthread_cond_init(&srnx->load_cond, NULL))
         {
-            return SRNX_BAD_STATE;
+            pthread_mutex_destroy(&srnx->load_lock);
+            free(srnx->loaded);
+            srnx->loaded = NULL;
         }
-        *p_len = uleb128(&chunk);
-        if ((chunk - srnx->data) + *p_len > srnx->data_size)
+        if (backend == SRNX_BACKEND_ASYNC)
         {
-            return SRNX_CORRUPT;
+            srnx->pending = calloc(1, sizeof *srnx->pending);
         }
-
-        if (p_next)
+        if (!srnx->loaded
+            || (backend == SRNX_BACKEND_ASYNC && !srnx->pending))
         {
-            *p_next = chunk - srnx->data + *p_len
-                + srnx_digest_length(srnx->chunk_digest);
+            srnx->error_line = __LINE__;
+            srnx_release(srnx);
+            return ENOMEM;
         }
-        *p_payload = chunk;
-        return 0;
+    }
+    else
+    {
+        close(fd);
     }
 
-    /* Search for it starting at \a srnx->next_offset. */
-    return srnx_find_chunk(srnx, fourcc, srnx->next_offset, p_payload,
-        p_len, p_start, p_next);
-}
+    res = srnx_parse_head(srnx);
+    if (res && res != SRNX_WOULD_BLOCK)
+    {
+        srnx_release(srnx);
+    }
+
+    return res;
+}
 
 /* Doc comment in srnx.h. */
-int srnx_get_epochs(
-    struct srnx_reader *srnx,
-    struct rinex_epoch **p_epoch,
-    size_t *p_epochs_len
-)
+/* TODO: Optionally check file and chunk digests.
+ * (Default to checking chunk digests, but allow the app to disable
+ * that.  Provide a function to check the whole-file digest.)
+ */
+int srnx_open(struct srnx_reader **p_srnx, const char filename[])
 {
-    uint64_t len, idx, n_epoch, date, time;
-    int64_t i64;
-    struct rinex_epoch *new_epochs, *epoch;
-    const char *epoc, *end;
-    int res, sec_e7;
-    short hh_mm, mm;
+    return srnx_open_backend(p_srnx, filename, SRNX_BACKEND_MMAP);
+}
 
-    /* Search for the EPOC chunk. */
-    res = srnx_find_chunk_cached(srnx, "EPOC", &srnx->epoc_offset, &epoc, &len, NULL);
-    if (res)
+/* Doc comment in srnx.h. */
+int srnx_open_pread(struct srnx_reader **p_srnx, const char filename[])
+{
+    return srnx_open_backend(p_srnx, filename, SRNX_BACKEND_PREAD);
+}
+
+/* Doc comment in srnx.h. */
+int srnx_open_async(struct srnx_reader **p_srnx, const char filename[])
+{
+    return srnx_open_backend(p_srnx, filename, SRNX_BACKEND_ASYNC);
+}
+
+/* Doc comment in srnx.h. */
+int srnx_continue_open(struct srnx_reader *srnx)
+{
+    int res;
+
+    if (!srnx->data)
     {
         srnx->error_line = __LINE__;
-        return res;
+        return SRNX_BAD_STATE;
+    }
+    if (srnx->data_size)
+    {
+        return 0;
     }
-    end = epoc + len;
 
-    /* How many epochs are in this file? */
-    n_epoch = uleb128(&epoc);
-    if (epoc > end)
+    res = srnx_parse_head(srnx);
+    if (res && res != SRNX_WOULD_BLOCK)
+    {
+        srnx_release(srnx);
+    }
+
+    return res;
+}
+
+/* Doc comment in srnx.h. */
+int srnx_pending_read(
+    const struct srnx_reader *srnx,
+    int *p_fd,
+    void **p_buf,
+    uint64_t *p_offset,
+    size_t *p_len
+)
+{
+    if (!srnx->pending || !srnx->pending->len)
+    {
+        return SRNX_BAD_STATE;
+    }
+
+    *p_fd = srnx->fd;
+    *p_buf = (char *)srnx->data + srnx->pending->offset;
+    *p_offset = srnx->pending->offset;
+    *p_len = srnx->pending->len;
+    return 0;
+}
+
+/* Doc comment in srnx.h. */
+int srnx_complete_read(
+    struct srnx_reader *srnx,
+    uint64_t offset,
+    size_t len
+)
+{
+    uint64_t blk, end;
+
+    if (!srnx->pending || (offset & (((uint64_t)1 << srnx->load_shift) - 1))
+        || offset >= srnx->file_size)
     {
         srnx->error_line = __LINE__;
-        return SRNX_CORRUPT;
+        return SRNX_BAD_STATE;
     }
 
-    /* Allocate memory for the epochs array.
-     * XXX: Separately track used vs alloc'ed lengths?
+    /* Only mark whole blocks (or the file's last, short block) loaded,
+     * so a short read just leaves the rest pending.
      */
-    new_epochs = *p_epoch
-        ? realloc(*p_epoch, n_epoch * sizeof(**p_epoch))
-        : calloc(n_epoch, sizeof(**p_epoch));
-    if (!new_epochs)
+    end = offset + len;
+    if (end > srnx->file_size)
+    {
+        end = srnx->file_size;
+    }
+    for (blk = offset >> srnx->load_shift; blk << srnx->load_shift < end; ++blk)
+    {
+        if ((blk + 1) << srnx->load_shift > end && end < srnx->file_size)
+        {
+            break;
+        }
+        srnx_mark_loaded(srnx, blk, blk);
+    }
+    srnx->pending->len = 0;
+
+    return 0;
+}
+
+/* Doc comment in srnx.h. */
+void srnx_close(struct srnx_reader *srnx)
+{
+    int ii;
+
+    if (!srnx)
+    {
+        return;
+    }
+
+    srnx_release(srnx);
+
+    for (ii = 0; ii < 33; ++ii)
+    {
+        free(srnx->sys_info[ii].code);
+    }
+
+    free(srnx);
+}
+
+/* Doc comment in srnx.h. */
+int srnx_get_header(
+    struct srnx_reader *srnx,
+    const char **p_rhdr,
+    size_t *rhdr_len
+)
+{
+    if (!srnx->rhdr_offset)
     {
         srnx->error_line = __LINE__;
-        return ENOMEM;
+        return SRNX_BAD_STATE;
     }
-    *p_epoch = new_epochs;
-    *p_epochs_len = n_epoch;
 
-    /* Walk over the epoch spans. */
-    for (idx = 0; (idx < n_epoch) && (epoc < end); )
+    /* Skip the FOURCC; #rhdr_offset is the start of the chunk. */
+    *p_rhdr = srnx->data + srnx->rhdr_offset + 4;
+    *rhdr_len = uleb128(p_rhdr);
+    return 0;
+}
+
+/** Return the next \a fourcc chunk after \a offset in \a srnx.
+ *
+ * \warning On error, the caller is responsible for setting \a srnx->error_line.
+ *
+ * \param[in] srnx SRNX file to read.
+ * \param[in] fourcc Four-character code identifying the chunk type.
+ * \param[in] whence Starting offset to search at.  Must be a chunk start.
+ * \param[out] p_payload Receives pointer to target chunk's payload.
+ * \param[out] p_len Receives length of chunk's payload.
+ * \param[out] p_start If not NULL, receives the offset of the chunk start.
+ * \param[out] p_next If not NULL, receives the offset of the next chunk.
+ * \returns Zero on success, else \a SRNX_CORRUPT, \a SRNX_NO_CHUNK or
+ *   \a SRNX_IO_ERROR.
+ */
+static int srnx_find_chunk(
+    const struct srnx_reader *srnx,
+    const char fourcc[4],
+    uint64_t whence,
+    const char **p_payload,
+    uint64_t *p_len,
+    int64_t *p_start,
+    uint64_t *p_next
+)
+{
+    const char *chunk, *rptr;
+    uint64_t payload_len;
+    int chunk_digest_length, res;
+
+    chunk_digest_length = srnx_digest_length(srnx->chunk_digest);
+    while (whence + 4 < srnx->data_size)
     {
-        i64 = sleb128(&epoc);
-        if (epoc >= end)
+        res = srnx_load(srnx, whence, 16);
+        if (res)
+        {
+            return res;
+        }
+        chunk = srnx->data + whence;
+        rptr = chunk + 4;
+        payload_len = uleb128(&rptr);
+        if ((rptr - srnx->data) + payload_len > srnx->data_size)
         {
-            srnx->error_line = __LINE__;
             return SRNX_CORRUPT;
         }
-        /* Convert to whole seconds? */
-        if (i64 < 0)
+        if (!memcmp(chunk, fourcc, 4))
         {
-            i64 *= -10000000;
+            res = srnx_load(srnx, rptr - srnx->data, payload_len);
+            if (res)
+            {
+                return res;
+            }
+            *p_payload = rptr;
+            *p_len = payload_len;
+            if (p_start)
+            {
+                *p_start = whence;
+            }
+            if (p_next)
+            {
+                *p_next = rptr - srnx->data + payload_len + chunk_digest_length;
+            }
+            return 0;
         }
+        whence = rptr - srnx->data + payload_len + chunk_digest_length;
+    }
 
-        len = uleb128(&epoc);
-        if (epoc >= end || idx + len > n_epoch)
+    return SRNX_NO_CHUNK;
+}
+
+/** Return the first \a fourcc chunk in in \a srnx, which may be at \a *p_start.
+ *
+ * \warning On error, the caller is responsible for setting \a srnx->error_line.
+ *
+ * \param[in] srnx SRNX file to read.
+ * \param[in] fourcc Four-character code identifying the chunk type.
+ * \param[in,out] p_start Pointer to the offset of the chunk start.
+ * \param[out] p_payload Receives pointer to target chunk's payload.
+ * \param[out] p_len Receives length of chunk's payload.
+ * \param[out] p_next If not NULL, receives the offset of the next chunk.
+ * \returns Zero on success, else \a SRNX_CORRUPT or \a SRNX_NO_CHUNK.
+ */
+static int srnx_find_chunk_cached(
+    const struct srnx_reader *srnx,
+    const char fourcc[4],
+    int64_t *p_start,
+    const char **p_payload,
+    uint64_t *p_len,
+    uint64_t *p_next
+)
+{
+    /* Is it known to be absent? */
+    if (*p_start == 0)
+    {
+        return SRNX_NO_CHUNK;
+    }
+
+    /* Do we know where it is? */
+    if (*p_start > 0)
+    {
+        const char *chunk;
+        int res;
+
+        if ((uint64_t)*p_start >= srnx->data_size)
         {
-            srnx->error_line = __LINE__;
-            return SRNX_CORRUPT;
+            return SRNX_NO_CHUNK;
         }
 
-        date = uleb128(&epoc);
-        if (epoc >= end || date > INT_MAX)
+        res = srnx_load(srnx, *p_start, 16);
+        if (res)
         {
-            srnx->error_line = __LINE__;
-            return SRNX_CORRUPT;
+            return res;
         }
-        /* Convert two-digit year? */
-        if (date < 1000000)
+        chunk = srnx->data + *p_start;
+        if (memcmp(chunk, fourcc, 4))
         {
-            date += (date < 800000) ? 20000000 : 19000000;
+            return SRNX_BAD_STATE;
         }
-
-        time = uleb128(&epoc);
-        if (epoc >= end || time > 2460610000000)
+        chunk += 4;
+        *p_len = uleb128(&chunk);
+        if ((chunk - srnx->data) + *p_len > srnx->data_size)
         {
-            srnx->error_line = __LINE__;
             return SRNX_CORRUPT;
         }
-        sec_e7 = time % 1000000000;
-        hh_mm = time / 1000000000;
-        mm = hh_mm % 60;
+        res = srnx_load(srnx, chunk - srnx->data, *p_len);
+        if (res)
+        {
+            return res;
+        }
 
-        /* Unpack this epoch span. */
-        for (; len > 0; ++idx, --len)
+        if (p_next)
         {
-            epoch = (*p_epoch) + idx;
-            epoch->yyyy_mm_dd = date;
-            epoch->hh_mm = hh_mm;
-            epoch->sec_e7 = sec_e7;
+            *p_next = chunk - srnx->data + *p_len
+                + srnx_digest_length(srnx->chunk_digest);
+        }
+        *p_payload = chunk;
+        return 0;
+    }
 
-            /* Advance seconds count and check for minute rollover.
-             * Comparison of previous sec_e7 is needed for leap seconds.
-             */
-            sec_e7 += i64;
-            if (sec_e7 >= 600000000 && epoch->sec_e7 < 600000000)
-            {
-                sec_e7 -= 600000000;
-                hh_mm += 1;
-                mm += 1;
-                if (mm >= 60)
-                {
-                    hh_mm += 40; /* increment to next "hour" */
-                    mm = 0;
-                }
-            }
+    /* Search for it starting at \a srnx->next_offset. */
+    return srnx_find_chunk(srnx, fourcc, srnx->next_offset, p_payload,
+        p_len, p_start, p_next);
+}
+
+/** Reads one epoch span from an EPOC payload.
+ *
+ * \param[in] srnx SRNX reader object.
+ * \param[in,out] p_epoc Read pointer within the EPOC payload.
+ * \param[in] end End of the EPOC payload.
+ * \param[out] p_step_e7 Receives the interval between epochs, in
+ *   seconds times 1e7.
+ * \param[out] p_len Receives the number of epochs in the span.
+ * \param[out] p_date Receives the decimal-coded date of the first epoch,
+ *   with a four-digit year.
+ * \param[out] p_time Receives the time of the first epoch, as
+ *   hh_mm * 1e9 + sec_e7.
+ * \returns Zero on success, else \a SRNX_CORRUPT.
+ */
+static int read_epoch_span(
+    struct srnx_reader *srnx,
+    const char **p_epoc,
+    const char *end,
+    int64_t *p_step_e7,
+    uint64_t *p_len,
+    uint64_t *p_date,
+    uint64_t *p_time
+)
+{
+    int64_t i64;
+    uint64_t date;
+
+    i64 = sleb128(p_epoc);
+    if (*p_epoc >= end)
+    {
+        srnx->error_line = __LINE__;
+        return SRNX_CORRUPT;
+    }
+    /* Convert to whole seconds? */
+    if (i64 < 0)
+    {
+        i64 *= -10000000;
+    }
+    *p_step_e7 = i64;
+
+    *p_len = uleb128(p_epoc);
+    if (*p_epoc >= end)
+    {
+        srnx->error_line = __LINE__;
+        return SRNX_CORRUPT;
+    }
+
+    date = uleb128(p_epoc);
+    if (*p_epoc >= end || date > INT_MAX)
+    {
+        srnx->error_line = __LINE__;
+        return SRNX_CORRUPT;
+    }
+    /* Convert two-digit year? */
+    if (date < 1000000)
+    {
+        date += (date < 800000) ? 20000000 : 19000000;
+    }
+    *p_date = date;
+
+    *p_time = uleb128(p_epoc);
+    if (*p_epoc > end || *p_time > 2460610000000)
+    {
+        srnx->error_line = __LINE__;
+        return SRNX_CORRUPT;
+    }
+
+    return 0;
+}
+
+/* Doc comment in srnx.h. */
+int srnx_get_epochs(
+    struct srnx_reader *srnx,
+    struct rinex_epoch **p_epoch,
+    size_t *p_epochs_len
+)
+{
+    uint64_t len, idx, n_epoch, date, time;
+    int64_t i64;
+    struct rinex_epoch *new_epochs, *epoch;
+    const char *epoc, *end;
+    int res, sec_e7;
+    short hh_mm, mm;
+
+    /* Search for the EPOC chunk. */
+    res = srnx_find_chunk_cached(srnx, "EPOC", &srnx->epoc_offset, &epoc, &len, NULL);
+    if (res)
+    {
+        srnx->error_line = __LINE__;
+        return res;
+    }
+    end = epoc + len;
+
+    /* How many epochs are in this file? */
+    n_epoch = uleb128(&epoc);
+    if (epoc > end)
+    {
+        srnx->error_line = __LINE__;
+        return SRNX_CORRUPT;
+    }
+
+    /* Allocate memory for the epochs array. */
+    new_epochs = srnx_reserve(*p_epoch, n_epoch * sizeof(**p_epoch));
+    if (!new_epochs)
+    {
+        srnx->error_line = __LINE__;
+        return ENOMEM;
+    }
+    *p_epoch = new_epochs;
+    *p_epochs_len = n_epoch;
+
+    /* Walk over the epoch spans. */
+    for (idx = 0; (idx < n_epoch) && (epoc < end); )
+    {
+        res = read_epoch_span(srnx, &epoc, end, &i64, &len, &date, &time);
+        if (res)
+        {
+            /* read_epoch_span() sets \a srnx->error_line. */
+            return res;
+        }
+        if (idx + len > n_epoch)
+        {
+            srnx->error_line = __LINE__;
+            return SRNX_CORRUPT;
+        }
+        sec_e7 = time % 1000000000;
+        hh_mm = time / 1000000000;
+        mm = hh_mm % 60;
+
+        /* Unpack this epoch span. */
+        for (; len > 0; ++idx, --len)
+        {
+            epoch = (*p_epoch) + idx;
+            epoch->yyyy_mm_dd = date;
+            epoch->hh_mm = hh_mm;
+            epoch->sec_e7 = sec_e7;
+
+            /* Advance seconds count and check for minute rollover.
+             * Comparison of previous sec_e7 is needed for leap seconds.
+             */
+            sec_e7 += i64;
+            if (sec_e7 >= 600000000 && epoch->sec_e7 < 600000000)
+            {
+                sec_e7 -= 600000000;
+                hh_mm += 1;
+                mm += 1;
+                if (mm >= 60)
+                {
+                    hh_mm += 40; /* increment to next "hour" */
+                    mm = 0;
+                }
+            }
+        }
+    }
+
+    /* Walk over the receiver clock offset spans. */
+    for (idx = 0; (epoc < end) && (idx < n_epoch); )
+    {
+        i64 = sleb128(&epoc);
+        if (epoc >= end)
+        {
+            srnx->error_line = __LINE__;
+            return SRNX_CORRUPT;
+        }
+
+        len = uleb128(&epoc);
+        if (epoc > end || idx + len > n_epoch)
+        {
+            srnx->error_line = __LINE__;
+            return SRNX_CORRUPT;
+        }
+
+        for (; len > 0; len--)
+        {
+            (*p_epoch)[idx++].clock_offset = i64;
+        }
+    }
+
+    /* Zero the remaining receiver clock offsets. */
+    for (; idx < n_epoch; ++idx)
+    {
+        (*p_epoch)[idx].clock_offset = 0;
+    }
+
+    return 0;
+}
+
+/** Days from 1970-01-01 to 1980-01-06, the start of GPS time. */
+#define GPS_EPOCH_DAYS 3657
+
+/** srnx_epoch_index is the compact form of a file's epoch times. */
+struct srnx_epoch_index
+{
+    /** Epoch spans, in file order. */
+    struct srnx_epoch_span *span;
+
+    /** Number of elements in #span. */
+    size_t spans_len;
+
+    /** Total number of epochs in #span. */
+    uint64_t n_epochs;
+
+    /** For each group of 2**#bucket_shift epochs, the index of the span
+     * that contains the group's first epoch.
+     */
+    uint32_t *bucket;
+
+    /** Number of elements in #bucket. */
+    size_t n_buckets;
+
+    /** log2 of the number of epochs per element of #bucket. */
+    int bucket_shift;
+};
+
+/** Counts days from 1970-01-01 to the given proleptic Gregorian date. */
+static int64_t days_from_civil(int64_t y, int m, int d)
+{
+    int64_t era, yoe, doy;
+
+    y -= m <= 2;
+    era = (y >= 0 ? y : y - 399) / 400;
+    yoe = y - era * 400;
+    doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    return era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468;
+}
+
+/** Converts a date and time to nanoseconds since the start of GPS time.
+ *
+ * \param[in] yyyy_mm_dd Decimal-coded date.
+ * \param[in] hh_mm Decimal-coded minute of day.
+ * \param[in] sec_e7 Seconds of minute times 1e7.
+ * \returns Nanoseconds since 1980-01-06 00:00:00 in the same time scale.
+ */
+static int64_t civil_to_gps_ns(int yyyy_mm_dd, int hh_mm, int64_t sec_e7)
+{
+    int64_t days;
+
+    days = days_from_civil(yyyy_mm_dd / 10000, yyyy_mm_dd / 100 % 100,
+        yyyy_mm_dd % 100) - GPS_EPOCH_DAYS;
+    return (days * 86400 + (hh_mm / 100) * 3600 + (hh_mm % 100) * 60)
+        * (int64_t)1000000000 + sec_e7 * 100;
+}
+
+/* Doc comment in srnx.h. */
+int64_t srnx_epoch_to_gps_ns(const struct rinex_epoch *epoch)
+{
+    return civil_to_gps_ns(epoch->yyyy_mm_dd, epoch->hh_mm, epoch->sec_e7);
+}
+
+/* Doc comment in srnx.h. */
+int srnx_get_epoch_index(
+    struct srnx_reader *srnx,
+    struct srnx_epoch_index **p_index
+)
+{
+    struct srnx_epoch_index *index;
+    struct srnx_epoch_span *span;
+    uint32_t *bucket;
+    uint64_t len, n_epoch, date, time, first;
+    int64_t step_e7;
+    const char *epoc, *end;
+    size_t spans_alloc, n_spans, ii, jj;
+    int res;
+
+    /* Search for the EPOC chunk. */
+    res = srnx_find_chunk_cached(srnx, "EPOC", &srnx->epoc_offset, &epoc, &len, NULL);
+    if (res)
+    {
+        srnx->error_line = __LINE__;
+        return res;
+    }
+    end = epoc + len;
+
+    n_epoch = uleb128(&epoc);
+    if (epoc > end)
+    {
+        srnx->error_line = __LINE__;
+        return SRNX_CORRUPT;
+    }
+
+    /* Allocate *p_index if necessary. */
+    index = *p_index;
+    if (!index)
+    {
+        index = calloc(1, sizeof *index);
+        if (!index)
+        {
+            srnx->error_line = __LINE__;
+            return ENOMEM;
+        }
+        *p_index = index;
+    }
+    index->spans_len = 0;
+    index->n_epochs = 0;
+    index->n_buckets = 0;
+
+    /* Copy the epoch spans, converting them to GPS nanoseconds.  The
+     * index stays empty unless the whole EPOC chunk is valid.
+     */
+    n_spans = 0;
+    spans_alloc = srnx_reserved(index->span) / sizeof(*span);
+    for (first = 0; (first < n_epoch) && (epoc < end); first += len)
+    {
+        res = read_epoch_span(srnx, &epoc, end, &step_e7, &len, &date, &time);
+        if (res)
+        {
+            /* read_epoch_span() sets \a srnx->error_line. */
+            return res;
+        }
+        if (first + len > n_epoch)
+        {
+            srnx->error_line = __LINE__;
+            return SRNX_CORRUPT;
+        }
+        if (len == 0)
+        {
+            continue;
+        }
+
+        if (n_spans >= spans_alloc)
+        {
+            spans_alloc = spans_alloc ? 2 * spans_alloc : 16;
+            span = srnx_reserve(index->span, spans_alloc * sizeof(*span));
+            if (!span)
+            {
+                srnx->error_line = __LINE__;
+                return ENOMEM;
+            }
+            index->span = span;
+        }
+
+        span = index->span + n_spans++;
+        span->start_ns = civil_to_gps_ns(date, time / 1000000000,
+            time % 1000000000);
+        span->step_ns = step_e7 * 100;
+        span->first = first;
+        span->count = len;
+    }
+    if (n_spans == 0)
+    {
+        return 0;
+    }
+
+    /* Build the bucket table, with at most two buckets per span. */
+    for (index->bucket_shift = 0;
+        (first - 1) >> index->bucket_shift >= 2 * n_spans;
+        ++index->bucket_shift)
+    {
+    }
+    index->n_buckets = ((first - 1) >> index->bucket_shift) + 1;
+    bucket = srnx_reserve(index->bucket,
+        index->n_buckets * sizeof(index->bucket[0]));
+    if (!bucket)
+    {
+        index->n_buckets = 0;
+        srnx->error_line = __LINE__;
+        return ENOMEM;
+    }
+    index->bucket = bucket;
+    index->spans_len = n_spans;
+    index->n_epochs = first;
+    for (ii = jj = 0; ii < index->n_buckets; ++ii)
+    {
+        first = (uint64_t)ii << index->bucket_shift;
+        while (index->span[jj].first + index->span[jj].count <= first)
+        {
+            ++jj;
+        }
+        bucket[ii] = jj;
+    }
+
+    return 0;
+}
+
+/* Doc comment in srnx.h. */
+void srnx_free_epoch_index(struct srnx_epoch_index *index)
+{
+    if (index)
+    {
+        srnx_free(index->span);
+        srnx_free(index->bucket);
+        free(index);
+    }
+}
+
+/* Doc comment in srnx.h. */
+uint64_t srnx_epoch_index_count(const struct srnx_epoch_index *index)
+{
+    return index->n_epochs;
+}
+
+/* Doc comment in srnx.h. */
+const struct srnx_epoch_span *srnx_epoch_index_spans(
+    const struct srnx_epoch_index *index,
+    size_t *p_spans_len
+)
+{
+    *p_spans_len = index->spans_len;
+    return index->span;
+}
+
+/** Returns the index of the span that holds epoch \a epoch, which must
+ * be less than \a index->n_epochs.
+ */
+static size_t find_epoch_span(
+    const struct srnx_epoch_index *index,
+    uint64_t epoch
+)
+{
+    size_t ii;
+
+    ii = index->bucket[epoch >> index->bucket_shift];
+    while (index->span[ii].first + index->span[ii].count <= epoch)
+    {
+        ++ii;
+    }
+
+    return ii;
+}
+
+/* Doc comment in srnx.h. */
+int64_t srnx_epoch_index_time(
+    const struct srnx_epoch_index *index,
+    uint64_t epoch
+)
+{
+    const struct srnx_epoch_span *span;
+
+    if (epoch >= index->n_epochs)
+    {
+        return INT64_MIN;
+    }
+
+    span = index->span + find_epoch_span(index, epoch);
+    return span->start_ns + (int64_t)(epoch - span->first) * span->step_ns;
+}
+
+/* Doc comment in srnx.h. */
+uint64_t srnx_epoch_index_find(
+    const struct srnx_epoch_index *index,
+    int64_t time_ns
+)
+{
+    const struct srnx_epoch_span *span;
+    size_t lo, hi, mid;
+    uint64_t offset, kk;
+
+    /* Find the last span that starts at or before time_ns. */
+    lo = 0;
+    hi = index->spans_len;
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if (index->span[mid].start_ns <= time_ns)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    if (lo == 0)
+    {
+        return 0;
+    }
+    span = index->span + lo - 1;
+
+    /* Find the first epoch in that span at or after time_ns. */
+    offset = time_ns - span->start_ns;
+    if (offset == 0)
+    {
+        return span->first;
+    }
+    if (span->step_ns <= 0)
+    {
+        return span->first + span->count;
+    }
+    kk = (offset + span->step_ns - 1) / span->step_ns;
+    return span->first + (kk < span->count ? kk : span->count);
+}
+
+/* Doc comment in srnx.h. */
+int srnx_epoch_index_times(
+    const struct srnx_epoch_index *index,
+    uint64_t first,
+    uint64_t count,
+    int64_t time_ns[]
+)
+{
+    const struct srnx_epoch_span *span;
+    uint64_t kk, n, jj;
+    int64_t start, step;
+    size_t ii;
+
+    if (first > index->n_epochs || count > index->n_epochs - first)
+    {
+        return SRNX_END_OF_DATA;
+    }
+
+    for (ii = count ? find_epoch_span(index, first) : 0; count > 0; ++ii)
+    {
+        span = index->span + ii;
+        kk = first - span->first;
+        n = span->count - kk;
+        if (n > count)
+        {
+            n = count;
+        }
+
+        /* This loop is simple enough for the compiler to vectorize. */
+        step = span->step_ns;
+        start = span->start_ns + (int64_t)kk * step;
+        for (jj = 0; jj < n; ++jj)
+        {
+            time_ns[jj] = start + (int64_t)jj * step;
+        }
+
+        time_ns += n;
+        first += n;
+        count -= n;
+    }
+
+    return 0;
+}
+
+/* Doc comment in srnx.h. */
+int srnx_next_special_event(
+    struct srnx_reader *srnx,
+    const char **p_event,
+    size_t *event_len,
+    uint64_t *epoch_index
+)
+{
+    uint64_t payload_len, whence;
+    const char *payload;
+    int res;
+
+    /* Search for the next EVTF chunk, after the previous event's text
+     * and digest.
+     */
+    if (*p_event)
+    {
+        whence = *p_event - srnx->data + *event_len
+            + srnx_digest_length(srnx->chunk_digest);
+        res = srnx_find_chunk(srnx, "EVTF", whence, &payload, &payload_len,
+            NULL, NULL);
+    }
+    else
+    {
+        res = srnx_find_chunk_cached(srnx, "EVTF", &srnx->evtf_offset,
+            &payload, &payload_len, NULL);
+    }
+    if (res)
+    {
+        srnx->error_line = __LINE__;
+        return res;
+    }
+
+    /* Decode the epoch index at the start of the chunk. */
+    *p_event = payload;
+    *epoch_index = uleb128(p_event);
+    if ((uint64_t)(*p_event - payload) >= payload_len)
+    {
+        srnx->error_line = __LINE__;
+        return SRNX_CORRUPT;
+    }
+
+    /* Report the event length (remaining payload). */
+    *event_len = payload_len - (*p_event - payload);
+    return 0;
+}
+
+/* Doc comment in srnx.h. */
+int srnx_get_satellites(
+    struct srnx_reader *srnx,
+    struct srnx_satellite_name **p_name,
+    uint64_t *p_names_len
+)
+{
+    uint64_t names_alloc, payload_len, whence;
+    struct srnx_satellite_name *next;
+    const char *payload, *rptr;
+    int res, chunk_digest_length;
+
+    *p_names_len = 0;
+    names_alloc = srnx_reserved(*p_name) / sizeof(**p_name);
+    if (names_alloc < 32)
+    {
+        names_alloc = 32;
+        next = srnx_reserve(*p_name, names_alloc * sizeof(**p_name));
+        if (!next)
+        {
+            srnx->error_line = __LINE__;
+            return ENOMEM;
+        }
+        *p_name = next;
+    }
+
+    /* Can we look in the satellite directory? */
+    res = srnx_find_chunk_cached(srnx, "SDIR", &srnx->sdir_offset,
+        &payload, &payload_len, NULL);
+    if (res == 0)
+    {
+        rptr = payload;
+
+        /* Read the EPOC and EVTF offsets at the start of SDIR. */
+        srnx->epoc_offset = uleb128(&rptr);
+        srnx->evtf_offset = uleb128(&rptr);
+        if (rptr > payload + payload_len)
+        {
+            srnx->error_line = __LINE__;
+            return SRNX_CORRUPT;
+        }
+
+        while (rptr + 4 < payload + payload_len)
+        {
+            /* Do we need to grow the names list? */
+            if (*p_names_len >= names_alloc)
+            {
+                names_alloc <<= 1;
+                next = srnx_reserve(*p_name, names_alloc * sizeof(**p_name));
+                if (!next)
+                {
+                    srnx->error_line = __LINE__;
+                    return ENOMEM;
+                }
+                *p_name = next;
+            }
+
+            next = (*p_name) + (*p_names_len)++;
+            memcpy(next->name, rptr, 3);
+            next->name[3] = '\0';
+            rptr += 3;
+            uleb128(&rptr); /* skip (actually signed) file offset */
+            if (rptr > payload + payload_len)
+            {
+                srnx->error_line = __LINE__;
+                return SRNX_CORRUPT;
+            }
+        }
+
+        return 0;
+    }
+
+    /* No satellite directory; must scan SATE chunks. */
+    whence = srnx->next_offset;
+    chunk_digest_length = srnx_digest_length(srnx->chunk_digest);
+    while (!srnx_find_chunk(srnx, "SATE", whence, &payload, &payload_len, NULL, &whence))
+    {
+        if (payload_len < 4)
+        {
+                srnx->error_line = __LINE__;
+                return SRNX_CORRUPT;
+        }
+
+        /* Do we need to grow the names list? */
+        if (*p_names_len >= names_alloc)
+        {
+            names_alloc <<= 1;
+            next = srnx_reserve(*p_name, names_alloc * sizeof(**p_name));
+            if (!next)
+            {
+                srnx->error_line = __LINE__;
+                return ENOMEM;
+            }
+            *p_name = next;
+        }
+
+        /* Save this satellite name. */
+        next = (*p_name) + (*p_names_len)++;
+        memcpy(next->name, payload, sizeof next->name);
+
+        /* Continue searching at next chunk in file. */
+        whence = (payload - srnx->data) + payload_len + chunk_digest_length;
+    }
+
+    return 0;
+}
+
+/** Find the SATE chunk for \a name.
+ *
+ * \param[in] srnx SRNX reader to read from.
+ * \param[in] name Name of satellite to search for.
+ * \returns The positive offset of the SATE chunk in \a srnx->data, or
+ *   a negative \a srnx_errno on failure.
+ */
+static int64_t srnx_find_sate(
+    const struct srnx_reader *srnx,
+    struct srnx_satellite_name name
+)
+{
+    uint64_t whence, next, u64;
+    int64_t start;
+    const char *payload, *rptr;
+    int res;
+
+    /* Do we have a satellite directory?  (A negative offset means
+     * nobody has looked for one yet.)
+     */
+    if (srnx->sdir_offset > 0)
+    {
+        /* Read payload length. */
+        res = srnx_load(srnx, srnx->sdir_offset, 16);
+        if (res)
+        {
+            return res;
+        }
+        rptr = payload = srnx->data + srnx->sdir_offset + 4;
+        u64 = uleb128(&rptr);
+        if ((int64_t)(srnx->sdir_offset + u64) < srnx->sdir_offset
+            || srnx->sdir_offset + u64 > srnx->data_size)
+        {
+            return SRNX_CORRUPT;
+        }
+        res = srnx_load(srnx, rptr - srnx->data, u64);
+        if (res)
+        {
+            return res;
+        }
+        payload += u64;
+
+        /* Skip the EPOC and EVTF chunk offsets. */
+        uleb128(&rptr);
+        uleb128(&rptr);
+
+        /* Scan through the satellite directory. */
+        while (rptr < payload)
+        {
+            res = !memcmp(rptr, name.name, sizeof name.name);
+            u64 = uleb128(&rptr);
+            if (res)
+            {
+                /* Is the offset too large, or not pointing to a SATE? */
+                if ((u64 + 9 >= srnx->data_size)
+                    || (res = srnx_load(srnx, u64, 16))
+                    || memcmp(srnx->data + u64, "SATE", 4))
+                {
+                    return res ? res : SRNX_CORRUPT;
+                }
+
+                /* Does the SATE payload start with this satellite name? */
+                payload = rptr = srnx->data + u64 + 4;
+                next = uleb128(&rptr);
+                res = srnx_load(srnx, rptr - srnx->data, next);
+                if (res)
+                {
+                    return res;
+                }
+                if ((next < 4) || memcmp(rptr, name.name, sizeof name.name))
+                {
+                    return SRNX_CORRUPT;
+                }
+
+                /* We found our winner. */
+                return u64;
+            }
+        }
+    }
+    else
+    {
+        /* Scan through SATE chunks to find the right one. */
+        for (whence = srnx->next_offset; whence < srnx->data_size; whence = next)
+        {
+            /* Find the next SATE chunk. */
+            res = srnx_find_chunk(srnx, "SATE", whence, &payload, &u64,
+                &start, &next);
+            if (res)
+            {
+                return res;
+            }
+            if (u64 < 4)
+            {
+                return SRNX_CORRUPT;
+            }
+
+            /* Is this the right SATE chunk? */
+            if (!memcmp(payload, name.name, sizeof name.name))
+            {
+                return start;
+            }
+        }
+    }
+
+    return SRNX_UNKNOWN_SATELLITE;
+}
+
+/** Find the SOCD chunk for \a name and \a code.
+ *
+ * \param[in] srnx SRNX reader to read from.
+ * \param[in] name Name of satellite to search for.
+ * \param[in] code Observation code to search for.
+ * \returns The positive offset of the SOCD chunk in \a srnx->data, or a
+ *   negative \a srnx_errno on failure.
+ */
+static int64_t srnx_find_socd(
+    struct srnx_reader *srnx,
+    struct srnx_satellite_name name,
+    struct srnx_obs_code code
+)
+{
+    uint64_t u64;
+    int64_t sate_offset, s64;
+    const char *rptr, *payload;
+    int s_idx, n_codes, ii, res;
+
+    /* Do we have a SATE entry for this satellite? */
+    sate_offset = srnx_find_sate(srnx, name);
+    if (sate_offset < 0)
+    {
+        srnx->error_line = __LINE__;
+        return sate_offset;
+    }
+    payload = srnx->data + sate_offset + 4;
+    u64 = uleb128(&payload);
+    rptr = payload + 4; /* srnx_find_sate() confirms satellite name */
+    payload += u64 - 4; /* and that payload length >= 4 */
+
+    /* How many codes for this satellite? */
+    s_idx = srnx->sys_idx[name.name[0] & 31];
+    if (!s_idx)
+    {
+        srnx->error_line = __LINE__;
+        return SRNX_UNKNOWN_SYSTEM;
+    }
+    n_codes = srnx->sys_info[s_idx].codes_len;
+
+    /* Search for the desired code. */
+    for (ii = 0; ii < n_codes; ++ii)
+    {
+        s64 = sleb128(&rptr);
+
+        /* If the observation is */
+        if (memcmp(&code, srnx->sys_info[s_idx].code + ii, sizeof code))
+        {
+            continue;
+        }
+
+        /* If the offset was zero, the observation is absent. */
+        if (!s64)
+        {
+            srnx->error_line = __LINE__;
+            return SRNX_UNKNOWN_CODE;
+        }
+
+        /* Validate SOCD block is for the expected SV and observation.
+         * Only load enough to check that and read the value count;
+         * srnx_open_obs_by_index() loads the rest.
+         */
+        s64 += sate_offset;
+        res = srnx_load(srnx, s64, 32);
+        if (res)
+        {
+            srnx->error_line = __LINE__;
+            return res;
+        }
+        payload = srnx->data + s64 + 4;
+        if (memcmp(payload - 4, "SOCD", 4)
+            || (uleb128(&payload) < 8)
+            || memcmp(payload, name.name, sizeof name)
+            || memcmp(payload + 4, code.name, sizeof code))
+        {
+            srnx->error_line = __LINE__;
+            return SRNX_CORRUPT;
+        }
+
+        return s64;
+    }
+
+    srnx->error_line = __LINE__;
+    return SRNX_UNKNOWN_CODE;
+}
+
+/* Doc comment in srnx.h. */
+int srnx_get_obs_codes(
+    struct srnx_reader *srnx,
+    char system,
+    const struct srnx_obs_code **p_code,
+    int *p_codes_len
+)
+{
+    int s_idx;
+
+    s_idx = srnx->sys_idx[system & 31];
+    if (!s_idx)
+    {
+        srnx->error_line = __LINE__;
+        return SRNX_UNKNOWN_SYSTEM;
+    }
+
+    *p_code = srnx->sys_info[s_idx].code;
+    *p_codes_len = srnx->sys_info[s_idx].codes_len;
+    return 0;
+}
+
+/* Doc comment in srnx.h. */
+int srnx_get_obs_info(
+    struct srnx_reader *srnx,
+    struct srnx_satellite_name name,
+    int obs_idx,
+    uint64_t *p_n_values,
+    uint64_t *p_socd_offset
+)
+{
+    struct srnx_obs_code code;
+    const char *rptr;
+    int64_t socd_offset;
+    int s_idx;
+
+    s_idx = srnx->sys_idx[name.name[0] & 31];
+    if (!s_idx)
+    {
+        srnx->error_line = __LINE__;
+        return SRNX_UNKNOWN_SYSTEM;
+    }
+    if (obs_idx < 0 || obs_idx >= srnx->sys_info[s_idx].codes_len)
+    {
+        srnx->error_line = __LINE__;
+        return SRNX_UNKNOWN_CODE;
+    }
+    memcpy(&code, srnx->sys_info[s_idx].code + obs_idx, sizeof code);
+
+    socd_offset = srnx_find_socd(srnx, name, code);
+    if (socd_offset < 0)
+    {
+        /* srnx_find_socd() sets \a srnx->error_line. */
+        return socd_offset;
+    }
+
+    /* Skip the FOURCC, payload length and observation name. */
+    rptr = srnx->data + socd_offset + 4;
+    uleb128(&rptr);
+    rptr += 8;
+    *p_n_values = 1 + uleb128(&rptr);
+    *p_socd_offset = socd_offset;
+    return 0;
+}
+
+/** Reads the initial delta decoder state in \a *p_socd.
+ *
+ * This reads the first \a p_socd->order delta decoder values into
+ * \a p_socd->delta, so that #undelta_and_scale() can be called.
+ *
+ * \param[in,out] p_socd Observation reader object to initialize.
+ */
+static int prime_delta_decoder(
+    struct srnx_obs_reader *p_socd
+)
+{
+    const char *end;
+    const char *rptr;
+    int ii;
+
+    end = p_socd->parent->data + p_socd->data_end;
+    rptr = p_socd->parent->data + p_socd->data_offset;
+    for (ii = 0; ii < p_socd->order; ++ii)
+    {
+        p_socd->delta[ii] = sleb128(&rptr);
+        if (rptr > end)
+        {
+            return SRNX_CORRUPT;
+        }
+    }
+
+    /* Update data_offset and report success. */
+    p_socd->data_offset = rptr - p_socd->parent->data;
+    return 0;
+}
+
+/** Prepares to read a satellite's observations by index.
+ *
+ * This implements srnx_open_obs_by_index().  A predicted signal's
+ * reference signal is opened with \a allow_ref equal to zero, so that
+ * a reference that is itself predicted is reported as corrupt rather
+ * than followed.
+ *
+ * \param[in] srnx SRNX reader object.
+ * \param[in] name Name of the satellite to read from.
+ * \param[in] obs_idx Index of the observation to read.
+ * \param[in,out] p_rdr Receives a pointer to the signal reader object.
+ * \param[in] allow_ref Non-zero if the signal may be predicted.
+ * \returns Zero on success, non-zero SRNX error number on error.
+ */
+static int open_obs(
+    struct srnx_reader *srnx,
+    struct srnx_satellite_name name,
+    int obs_idx,
+    struct srnx_obs_reader **p_rdr,
+    int allow_ref
+)
+{
+    const char *rptr;
+    uint64_t u64, n_values, lli_offset, data_end, socd_end, scale_order, scale;
+    uint64_t ref_idx, ref_den;
+    int64_t socd_offset, ref_num;
+    struct srnx_obs_code code;
+    struct srnx_obs_reader *ref;
+    char *unpacked;
+    int sys_idx, err, res;
+
+    /* Is the satellite system known for this file? */
+    sys_idx = srnx->sys_idx[name.name[0] & 31];
+    if (!sys_idx)
+    {
+        srnx->error_line = __LINE__;
+        return SRNX_UNKNOWN_SYSTEM;
+    }
+
+    /* Is the observation index valid for the satellite system? */
+    if (obs_idx < 0 || obs_idx >= srnx->sys_info[sys_idx].codes_len)
+    {
+        srnx->error_line = __LINE__;
+        return SRNX_UNKNOWN_CODE;
+    }
+
+    /* Grab the name of the observation code. */
+    memcpy(&code, srnx->sys_info[sys_idx].code + obs_idx, sizeof code);
+
+    /* Try to find the SOCD chunk. */
+    socd_offset = srnx_find_socd(srnx, name, code);
+    if (socd_offset < 0)
+    {
+        /* srnx_find_socd() sets \a srnx->error_line. */
+        return socd_offset;
+    }
+
+    /* How big is the SOCD payload? */
+    rptr = srnx->data + socd_offset + 4;
+    u64 = uleb128(&rptr);
+    if (u64 > (uint64_t)(srnx->data + srnx->data_size - rptr))
+    {
+        srnx->error_line = __LINE__;
+        return SRNX_CORRUPT;
+    }
+    socd_end = rptr - srnx->data + u64;
+    res = srnx_load(srnx, socd_offset, socd_end - socd_offset);
+    if (res)
+    {
+        srnx->error_line = __LINE__;
+        return res;
+    }
+    rptr += 8; /* srnx_find_socd() verifies observation name */
+
+    /* Read number of observations. */
+    n_values = 1 + uleb128(&rptr);
+
+    /* Skip LLI indicators. */
+    lli_offset = rptr - srnx->data;
+    u64 = uleb128(&rptr);
+    if (u64 > (uint64_t)(srnx->data + srnx->data_size - rptr))
+    {
+        srnx->error_line = __LINE__;
+        return SRNX_CORRUPT;
+    }
+    rptr += u64;
+
+    /* Then skip SSI indicators. */
+    u64 = uleb128(&rptr);
+    if (u64 > (uint64_t)(srnx->data + srnx->data_size - rptr))
+    {
+        srnx->error_line = __LINE__;
+        return SRNX_CORRUPT;
+    }
+    rptr += u64;
+
+    /* How long is the packed observation data? */
+    u64 = uleb128(&rptr);
+    if (u64 > (uint64_t)(srnx->data + srnx->data_size - rptr))
+    {
+        srnx->error_line = __LINE__;
+        return SRNX_CORRUPT;
+    }
+    data_end = rptr - srnx->data + u64;
+    if (data_end > socd_end)
+    {
+        srnx->error_line = __LINE__;
+        return SRNX_CORRUPT;
+    }
+
+    /* Read the scale-presence and order value. */
+    scale_order = uleb128(&rptr);
+    if (scale_order > (srnx->minor >= 3 ? 63u : srnx->minor >= 2 ? 31u : 15u)
+        || rptr > srnx->data + srnx->data_size)
+    {
+        srnx->error_line = __LINE__;
+        return SRNX_CORRUPT;
+    }
+
+    /* Is there a scale value? */
+    scale = 1;
+    if (scale_order & 8)
+    {
+        scale = uleb128(&rptr);
+        if (scale > 1000000000 || rptr > srnx->data + srnx->data_size)
+        {
+            srnx->error_line = __LINE__;
+            return SRNX_CORRUPT;
         }
     }
 
-    /* Walk over the receiver clock offset spans. */
-    for (idx = 0; (epoc < end) && (idx < n_epoch); )
+    /* Is the signal predicted from a reference signal? */
+    ref_idx = ref_num = ref_den = 0;
+    if (scale_order & 16)
     {
-        i64 = sleb128(&epoc);
-        if (epoc >= end)
+        ref_idx = uleb128(&rptr);
+        ref_num = sleb128(&rptr);
+        u64 = uleb128(&rptr);
+        if (!allow_ref || ref_idx == (uint64_t)obs_idx
+            || ref_idx >= (uint64_t)srnx->sys_info[sys_idx].codes_len
+            || ref_num < -1000000000 || ref_num > 1000000000
+            || u64 > 1000000000 || rptr > srnx->data + srnx->data_size)
         {
             srnx->error_line = __LINE__;
             return SRNX_CORRUPT;
         }
+        ref_den = u64 + 1;
+    }
 
-        len = uleb128(&epoc);
-        if (epoc >= end)
+    /* Allocate *p_rdr if necessary. */
+    if (!*p_rdr)
+    {
+        *p_rdr = obs_reader_alloc();
+        if (!*p_rdr)
         {
             srnx->error_line = __LINE__;
-            return SRNX_CORRUPT;
+            return ENOMEM;
         }
+    }
+    ref = (*p_rdr)->ref;
+    unpacked = (*p_rdr)->unpacked;
 
-        for (; len > 0; len--)
+    /* Open or release the reference signal's reader. */
+    if (scale_order & 16)
+    {
+        res = open_obs(srnx, name, ref_idx, &ref, 0);
+        if (!res && ref->n_values != n_values)
         {
-            (*p_epoch)[idx++].clock_offset = i64;
+            srnx->error_line = __LINE__;
+            res = SRNX_CORRUPT;
+        }
+        if (res)
+        {
+            /* open_obs() sets \a srnx->error_line. */
+            srnx_free_obs_reader(ref);
+            (*p_rdr)->ref = NULL;
+            return res;
         }
     }
+    else
+    {
+        srnx_free_obs_reader(ref);
+        ref = NULL;
+    }
 
-    /* Zero the remaining receiver clock offsets. */
-    for (; idx < n_epoch; ++idx)
+    /* Store everything we need to keep. */
+    memset(*p_rdr, 0, sizeof **p_rdr);
+    (*p_rdr)->ref = ref;
+    (*p_rdr)->unpacked = unpacked;
+    (*p_rdr)->base = srnx->data;
+    (*p_rdr)->ref_num = ref_num;
+    (*p_rdr)->ref_den = ref_den;
+    (*p_rdr)->order = scale_order & 7;
+    (*p_rdr)->parent = srnx;
+    (*p_rdr)->n_values = n_values;
+    (*p_rdr)->scale = scale;
+    (*p_rdr)->lli_offset = lli_offset;
+    (*p_rdr)->data_offset = rptr - srnx->data;
+    (*p_rdr)->data_end = data_end;
+    if (srnx->minor >= 1 && data_end < socd_end)
     {
-        (*p_epoch)[idx].clock_offset = 0;
+        (*p_rdr)->zone_offset = data_end;
+        (*p_rdr)->zone_end = socd_end;
     }
 
+    /* Initialize the delta decoder. */
+    err = prime_delta_decoder(*p_rdr);
+    if (err)
+    {
+        srnx->error_line = __LINE__;
+        return err;
+    }
+
+    /* Entropy-coded segments are decoded as decode_observations()
+     * reaches them, so there are no blocks to read yet.
+     */
+    if (scale_order & 32)
+    {
+        (*p_rdr)->coded_start = (*p_rdr)->data_offset;
+        (*p_rdr)->coded_offset = (*p_rdr)->data_offset;
+        (*p_rdr)->coded_end = data_end;
+        (*p_rdr)->data_offset = 0;
+        (*p_rdr)->data_end = 0;
+    }
+    (*p_rdr)->blocks_offset = (*p_rdr)->data_offset;
+
     return 0;
 }
 
-/* Doc comment in srnx.h. */
-int srnx_next_special_event(
-    struct srnx_reader *srnx,
-    const char **p_event,
-    size_t *event_len,
-    uint64_t *epoch_index
-)
+/** Decodes the next entropy-coded segment of \a p_socd into
+ * \a p_socd->unpacked and points the block reader at it.
+ *
+ * \param[in,out] p_socd Observation reader with entropy-coded blocks.
+ * \returns Zero on success, else ENOMEM or a negative \a srnx_errno.
+ */
+static int load_segment(struct srnx_obs_reader *p_socd)
 {
-    uint64_t payload_len, whence;
-    const char *payload;
+    const char *rptr, *end;
+    uint64_t n_bytes, coded_len;
+    char *unpacked;
     int res;
 
-    /* Search for the next EVTF chunk. */
-    if (*p_event)
+    /* Until a segment is decoded, there are no blocks to read. */
+    p_socd->data_offset = 0;
+    p_socd->data_end = 0;
+
+    /* No block takes more than 12 bytes per observation. */
+    rptr = p_socd->parent->data + p_socd->coded_offset;
+    end = p_socd->parent->data + p_socd->coded_end;
+    n_bytes = uleb128(&rptr);
+    coded_len = uleb128(&rptr);
+    if (rptr > end || coded_len > (uint64_t)(end - rptr)
+        || n_bytes / 12 > p_socd->n_values)
     {
-        res = srnx_find_chunk(srnx, "EVTF", *p_event - srnx->data,
-            &payload, &payload_len, NULL, &whence);
+        return SRNX_CORRUPT;
     }
-    else
+
+    unpacked = srnx_reserve(p_socd->unpacked, n_bytes + SRNX_ALIGN);
+    if (!unpacked)
     {
-        res = srnx_find_chunk_cached(srnx, "EVTF", &srnx->evtf_offset,
-            &payload, &payload_len, &whence);
+        return ENOMEM;
     }
+    p_socd->unpacked = unpacked;
+    p_socd->base = unpacked;
+    res = srnx_rans_decode(unpacked, n_bytes, rptr, coded_len);
     if (res)
     {
-        srnx->error_line = __LINE__;
         return res;
     }
+    memset(unpacked + n_bytes, 0, SRNX_ALIGN);
 
-    /* Decode the epoch index at the start of the chunk. */
-    *p_event = payload;
-    *epoch_index = uleb128(p_event);
-    if ((uint64_t)(*p_event - payload) >= payload_len)
+    p_socd->data_end = n_bytes;
+    p_socd->coded_offset = rptr + coded_len - p_socd->parent->data;
+    return 0;
+}
+
+/* Doc comment in srnx.h. */
+int srnx_open_obs_by_index(
+    struct srnx_reader *srnx,
+    struct srnx_satellite_name name,
+    int obs_idx,
+    struct srnx_obs_reader **p_rdr
+)
+{
+    return open_obs(srnx, name, obs_idx, p_rdr, 1);
+}
+
+/* Doc comment in srnx.h. */
+void srnx_free_obs_reader(struct srnx_obs_reader *p_socd)
+{
+    struct srnx_obs_pool *pool;
+
+    if (!p_socd)
+    {
+        return;
+    }
+    srnx_free_obs_reader(p_socd->ref);
+    p_socd->ref = NULL;
+
+    pool = obs_pool_get();
+    if (pool && pool->count < OBS_POOL_MAX)
+    {
+        if (srnx_reserved(p_socd->unpacked) > OBS_POOL_UNPACKED_MAX)
+        {
+            srnx_free(p_socd->unpacked);
+            p_socd->unpacked = NULL;
+        }
+        pool->rdr[pool->count++] = p_socd;
+        return;
+    }
+
+    srnx_free(p_socd->unpacked);
+    free(p_socd);
+}
+
+/** Decompresses indicators from [\a in, \a end) into \a out.
+ *
+ * \param[out] out Receives decompressed indicators.
+ * \param[in] n_values Number of indicators to decompress.
+ * \param[in] in Start of RLE-compressed indicators.
+ * \param[in] end End-plus-1 of RLE-compressed indicators.
+ * \returns Zero on success, else negative \a srnx_errno on failure.
+ */
+static int decompress_indicators(
+    char *out,
+    uint64_t n_values,
+    const char *in,
+    const char *end
+)
+{
+    uint64_t ii, count;
+    char ind;
+
+    /* Decompress the RLE-compressed data. */
+    for (ii = 0; in < end; )
+    {
+        ind = *in++;
+        count = uleb128(&in) + 1;
+        if (ii + count > n_values)
+        {
+            return SRNX_CORRUPT;
+        }
+        memset(out + ii, ind, count);
+        ii += count;
+    }
+    if (in > end)
     {
-        srnx->error_line = __LINE__;
         return SRNX_CORRUPT;
     }
 
-    /* Report the event length (remaining payload). */
-    *event_len = payload_len - (*p_event - payload);
-    *p_event = srnx->data + whence;
+    /* Fill any remaining indicators with spaces. */
+    memset(out + ii, ' ', n_values - ii);
     return 0;
 }
 
+/** Finds the RLE-compressed LLIs (\a which == 0) or SSIs (\a which
+ * == 1) for \a p_socd.
+ *
+ * \param[in] p_socd Observation reader object.
+ * \param[in] which Zero for LLIs, one for SSIs.
+ * \param[out] p_end Receives end-plus-1 of the compressed indicators.
+ * \returns Start of the compressed indicators.
+ */
+static const char *find_indicators(
+    const struct srnx_obs_reader *p_socd,
+    int which,
+    const char **p_end
+)
+{
+    const char *inds;
+    uint64_t u64;
+
+    inds = p_socd->parent->data + p_socd->lli_offset;
+    u64 = uleb128(&inds);
+    if (which)
+    {
+        inds += u64; /* bounds-checked by srnx_open_obs_by_index() */
+        u64 = uleb128(&inds);
+    }
+    *p_end = inds + u64;
+    return inds;
+}
+
 /* Doc comment in srnx.h. */
-int srnx_get_satellites(
-    struct srnx_reader *srnx,
-    struct srnx_satellite_name **p_name,
-    uint64_t *p_names_len
+int srnx_read_obs_ssi_lli(
+    struct srnx_obs_reader *p_socd,
+    int *p_n_values,
+    char **p_lli,
+    char **p_ssi
 )
 {
-    uint64_t names_alloc, payload_len, whence;
-    struct srnx_satellite_name *next;
-    const char *payload, *rptr;
-    int res, chunk_digest_length;
+    uint64_t n_values;
+    const char *inds, *end;
+    char *cp;
+    int res;
+
+    n_values = p_socd->n_values;
+    *p_n_values = n_values;
 
-    if (*p_name)
+    /* (Re-)Allocate and decompress the LLIs. */
+    if (p_lli)
     {
-        names_alloc = *p_names_len;
+        cp = srnx_reserve(*p_lli, n_values);
+        if (!cp)
+        {
+            return ENOMEM;
+        }
+        *p_lli = cp;
+
+        inds = find_indicators(p_socd, 0, &end);
+        res = decompress_indicators(*p_lli, n_values, inds, end);
+        if (res)
+        {
+            return res;
+        }
     }
-    else
+
+    /* Likewise for the SSIs. */
+    if (p_ssi)
     {
-        *p_names_len = 0;
-        names_alloc = 32;
-        *p_name = calloc(names_alloc, sizeof **p_name);
-        if (!*p_name)
+        cp = srnx_reserve(*p_ssi, n_values);
+        if (!cp)
         {
-            srnx->error_line = __LINE__;
             return ENOMEM;
         }
+        *p_ssi = cp;
+
+        inds = find_indicators(p_socd, 1, &end);
+        return decompress_indicators(*p_ssi, n_values, inds, end);
     }
 
-    /* Can we look in the satellite directory? */
-    res = srnx_find_chunk_cached(srnx, "SDIR", &srnx->sdir_offset,
-        &payload, &payload_len, NULL);
-    if (res == 0)
+    return 0;
+}
+
+/** Reads the indicator runs selected by \a which (as for
+ * find_indicators()) into \a *p_runs.
+ *
+ * \param[in] p_socd Observation reader object.
+ * \param[in] which Zero for LLIs, one for SSIs.
+ * \param[in,out] p_runs Receives pointer to indicator runs.
+ * \param[out] p_runs_len Receives number of runs at \a *p_runs.
+ * \returns Zero on success, else ENOMEM or negative \a srnx_errno.
+ */
+static int read_indicator_runs(
+    struct srnx_obs_reader *p_socd,
+    int which,
+    struct srnx_indicator_run **p_runs,
+    size_t *p_runs_len
+)
+{
+    struct srnx_indicator_run *runs;
+    const char *inds, *end, *rptr;
+    uint64_t total, count;
+    size_t n_runs, ii;
+
+    /* Count the runs so we only allocate once.  There may be one more
+     * run to cover epochs that were not explicitly encoded.
+     */
+    inds = find_indicators(p_socd, which, &end);
+    for (rptr = inds, n_runs = 1; rptr < end; ++n_runs)
     {
-        rptr = payload;
+        ++rptr;
+        (void)uleb128(&rptr);
+    }
+    if (rptr > end)
+    {
+        return SRNX_CORRUPT;
+    }
 
-        /* Read the EPOC and EVTF offsets at the start of SDIR. */
-        srnx->epoc_offset = uleb128(&rptr);
-        srnx->evtf_offset = uleb128(&rptr);
-        if (rptr > payload + payload_len)
+    runs = srnx_reserve(*p_runs, n_runs * sizeof(runs[0]));
+    if (!runs)
+    {
+        return ENOMEM;
+    }
+    *p_runs = runs;
+
+    /* Copy the runs. */
+    for (rptr = inds, ii = 0, total = 0; rptr < end; ++ii)
+    {
+        runs[ii].value = *rptr++;
+        count = uleb128(&rptr) + 1;
+        if (total + count > p_socd->n_values)
         {
-            srnx->error_line = __LINE__;
             return SRNX_CORRUPT;
         }
+        runs[ii].count = count;
+        total += count;
+    }
 
-        while (rptr + 4 < payload + payload_len)
-        {
-            /* Do we need to grow the names list? */
-            if (*p_names_len >= names_alloc)
-            {
-                names_alloc <<= 1;
-                next = realloc(*p_name, names_alloc * sizeof(**p_name));
-                if (!next)
-                {
-                    srnx->error_line = __LINE__;
-                    return ENOMEM;
-                }
-                *p_name = next;
-            }
+    /* Add the implicit run of spaces, if needed. */
+    if (total < p_socd->n_values)
+    {
+        runs[ii].value = ' ';
+        runs[ii].count = p_socd->n_values - total;
+        ++ii;
+    }
 
-            next = (*p_name) + *p_names_len++;
-            memcpy(next->name, rptr, 3);
-            next->name[3] = '\0';
-            rptr += 3;
-            uleb128(&rptr); /* skip (actually signed) file offset */
-            if (rptr > payload + payload_len)
-            {
-                srnx->error_line = __LINE__;
-                return SRNX_CORRUPT;
-            }
-        }
+    *p_runs_len = ii;
+    return 0;
+}
+
+/* Doc comment in srnx.h. */
+int srnx_read_obs_lli_runs(
+    struct srnx_obs_reader *p_socd,
+    struct srnx_indicator_run **p_runs,
+    size_t *p_runs_len
+)
+{
+    return read_indicator_runs(p_socd, 0, p_runs, p_runs_len);
+}
+
+/* Doc comment in srnx.h. */
+int srnx_read_obs_ssi_runs(
+    struct srnx_obs_reader *p_socd,
+    struct srnx_indicator_run **p_runs,
+    size_t *p_runs_len
+)
+{
+    return read_indicator_runs(p_socd, 1, p_runs, p_runs_len);
+}
 
-        return 0;
+/** Sets \a count bits in \a bitmap, starting at bit \a start.
+ *
+ * Whole words are filled at once, so a long run costs about as much as
+ * a memset() of its packed size.
+ */
+static void set_bit_range(
+    uint64_t *bitmap,
+    uint64_t start,
+    uint64_t count
+)
+{
+    uint64_t end, first, last;
+
+    if (count == 0)
+    {
+        return;
     }
 
-    /* No satellite directory; must scan SATE chunks. */
-    whence = srnx->next_offset;
-    chunk_digest_length = srnx_digest_length(srnx->chunk_digest);
-    while (!srnx_find_chunk(srnx, "SATE", whence, &payload, &payload_len, NULL, &whence))
+    end = start + count;
+    first = start >> 6;
+    last = (end - 1) >> 6;
+    if (first == last)
     {
-        if (payload_len < 4)
-        {
-                srnx->error_line = __LINE__;
-                return SRNX_CORRUPT;
-        }
+        bitmap[first] |= (~0ULL >> (64 - count)) << (start & 63);
+        return;
+    }
 
-        /* Do we need to grow the names list? */
-        if (*p_names_len >= names_alloc)
-        {
-            names_alloc <<= 1;
-            next = realloc(*p_name, names_alloc * sizeof(**p_name));
-            if (!next)
-            {
-                srnx->error_line = __LINE__;
-                return ENOMEM;
-            }
-            *p_name = next;
-        }
+    bitmap[first] |= ~0ULL << (start & 63);
+    if (last > first + 1)
+    {
+        memset(bitmap + first + 1, 0xff, (last - first - 1) * sizeof(bitmap[0]));
+    }
+    bitmap[last] |= ~0ULL >> (63 - ((end - 1) & 63));
+}
 
-        /* Save this satellite name. */
-        next = (*p_name) + *p_names_len++;
-        memcpy(next->name, payload, sizeof next->name);
+/** (Re-)Allocates and clears a bitmap with \a n_words words.
+ *
+ * \param[in,out] p_bitmap Bitmap to allocate, or NULL to skip it.
+ * \param[in] n_words Number of 64-bit words to allocate.
+ * \returns Zero on success, else ENOMEM.
+ */
+static int alloc_bitmap(
+    uint64_t **p_bitmap,
+    uint64_t n_words
+)
+{
+    uint64_t *bitmap;
 
-        /* Continue searching at next chunk in file. */
-        whence = (payload - srnx->data) + payload_len + chunk_digest_length;
+    if (!p_bitmap)
+    {
+        return 0;
     }
 
+    bitmap = srnx_reserve(*p_bitmap, n_words * sizeof(bitmap[0]));
+    if (!bitmap)
+    {
+        return ENOMEM;
+    }
+    memset(bitmap, 0, n_words * sizeof(bitmap[0]));
+    *p_bitmap = bitmap;
     return 0;
 }
 
-/** Find the SATE chunk for \a name.
- *
- * \param[in] srnx SRNX reader to read from.
- * \param[in] name Name of satellite to search for.
- * \returns The positive offset of the SATE chunk in \a srnx->data, or
- *   a negative \a srnx_errno on failure.
- */
-static int64_t srnx_find_sate(
-    const struct srnx_reader *srnx,
-    struct srnx_satellite_name name
+/* Doc comment in srnx.h. */
+int srnx_read_obs_flags(
+    struct srnx_obs_reader *p_socd,
+    int ssi_min,
+    uint64_t **p_slip,
+    uint64_t **p_half_cycle,
+    uint64_t **p_strong
 )
 {
-    uint64_t whence, next, u64;
-    const char *payload, *rptr;
+    const char *inds, *end;
+    uint64_t n_words, ii, count;
     int res;
+    char ind;
 
-    /* Do we have a satellite directory? */
-    if (srnx->sdir_offset)
+    n_words = (p_socd->n_values + 63) >> 6;
+    if ((res = alloc_bitmap(p_slip, n_words))
+        || (res = alloc_bitmap(p_half_cycle, n_words))
+        || (res = alloc_bitmap(p_strong, n_words)))
     {
-        /* Read payload length. */
-        rptr = payload = srnx->data + srnx->sdir_offset + 4;
-        u64 = uleb128(&rptr);
-        if ((int64_t)(srnx->sdir_offset + u64) < srnx->sdir_offset
-            || srnx->sdir_offset + u64 > srnx->data_size)
-        {
-            return SRNX_CORRUPT;
-        }
-        payload += u64;
-
-        /* Skip the EPOC and EVTF chunk offsets. */
-        uleb128(&rptr);
-        uleb128(&rptr);
+        return res;
+    }
 
-        /* Scan through the satellite directory. */
-        while (rptr < payload)
+    /* Walk the LLI runs.  Unencoded epochs have blank LLIs. */
+    if (p_slip || p_half_cycle)
+    {
+        inds = find_indicators(p_socd, 0, &end);
+        for (ii = 0; inds < end; ii += count)
         {
-            res = !memcmp(rptr, name.name, sizeof name.name);
-            u64 = uleb128(&rptr);
-            if (res)
+            ind = *inds++;
+            count = uleb128(&inds) + 1;
+            if (ii + count > p_socd->n_values)
             {
-                /* Is the offset too large, or not pointing to a SATE? */
-                if ((u64 + 9 >= srnx->data_size)
-                    || memcmp(srnx->data + u64, "SATE", 4))
-                {
-                    return SRNX_CORRUPT;
-                }
-
-                /* Does the SATE payload start with this satellite name? */
-                payload = rptr = srnx->data + u64 + 4;
-                next = uleb128(&rptr);
-                if ((next < 4) || memcmp(rptr, name.name, sizeof name.name))
-                {
-                    return SRNX_CORRUPT;
-                }
-
-                /* We found our winner. */
-                return u64;
+                return SRNX_CORRUPT;
+            }
+            if (ind < '0' || ind > '7')
+            {
+                continue;
+            }
+            if (p_slip && ((ind - '0') & 1))
+            {
+                set_bit_range(*p_slip, ii, count);
+            }
+            if (p_half_cycle && ((ind - '0') & 2))
+            {
+                set_bit_range(*p_half_cycle, ii, count);
             }
         }
+        if (inds > end)
+        {
+            return SRNX_CORRUPT;
+        }
     }
-    else
+
+    /* Walk the SSI runs. */
+    if (p_strong)
     {
-        /* Scan through SATE chunks to find the right one. */
-        for (whence = srnx->next_offset; whence < srnx->data_size; whence = next)
+        inds = find_indicators(p_socd, 1, &end);
+        for (ii = 0; inds < end; ii += count)
         {
-            /* Find the next SATE chunk. */
-            res = srnx_find_chunk(srnx, "SATE", whence, &payload, &u64,
-                NULL, &next);
-            if (res < 0)
-            {
-                return res;
-            }
-            if (u64 < 4)
+            ind = *inds++;
+            count = uleb128(&inds) + 1;
+            if (ii + count > p_socd->n_values)
             {
                 return SRNX_CORRUPT;
             }
-
-            /* Is this the right SATE chunk? */
-            if (!memcmp(payload, name.name, sizeof name.name))
+            if (ind >= '0' + ssi_min && ind <= '9')
             {
-                return whence;
+                set_bit_range(*p_strong, ii, count);
             }
         }
+        if (inds > end)
+        {
+            return SRNX_CORRUPT;
+        }
     }
 
-    return SRNX_UNKNOWN_SATELLITE;
+    return 0;
 }
 
-/** Find the SOCD chunk for \a name and \a code.
- *
- * \param[in] srnx SRNX reader to read from.
- * \param[in] name Name of satellite to search for.
- * \param[in] code Observation code to search for.
- * \returns The positive offset of the SOCD chunk in \a srnx->data, or a
- *   negative \a srnx_errno on failure.
- */
-static int64_t srnx_find_socd(
+/* Doc comment in srnx.h. */
+int srnx_get_sat_presence(
     struct srnx_reader *srnx,
     struct srnx_satellite_name name,
-    struct srnx_obs_code code
+    uint64_t n_epochs,
+    uint64_t **p_bitmap,
+    uint64_t *p_n_present
 )
 {
-    uint64_t u64;
-    int64_t sate_offset, s64;
-    const char *rptr, *payload;
-    int s_idx, n_codes, ii;
+    const char *rptr, *end;
+    uint64_t u64, n_runs, start, count, n_present;
+    int64_t sate_offset;
+    int s_idx, ii;
 
-    /* Do we have a SATE entry for this satellite? */
+    /* Find the satellite's SATE chunk. */
     sate_offset = srnx_find_sate(srnx, name);
     if (sate_offset < 0)
     {
         srnx->error_line = __LINE__;
         return sate_offset;
     }
-    payload = srnx->data + sate_offset + 4;
-    u64 = uleb128(&payload);
-    rptr = payload + 4; /* srnx_find_sate() confirms satellite name */
-    payload += u64 - 4; /* and that payload length >= 4 */
-
-    /* How many codes for this satellite? */
     s_idx = srnx->sys_idx[name.name[0] & 31];
     if (!s_idx)
     {
         srnx->error_line = __LINE__;
         return SRNX_UNKNOWN_SYSTEM;
     }
-    n_codes = srnx->sys_info[s_idx].codes_len;
+    rptr = srnx->data + sate_offset + 4;
+    u64 = uleb128(&rptr);
+    end = rptr + u64;
+    rptr += 4; /* srnx_find_sate() confirms satellite name */
 
-    /* Search for the desired code. */
-    for (ii = 0; ii < n_codes; ++ii)
+    /* Skip the SOCD offsets. */
+    for (ii = 0; ii < srnx->sys_info[s_idx].codes_len; ++ii)
     {
-        s64 = sleb128(&rptr);
-
-        /* If the observation is */
-        if (memcmp(&code, srnx->sys_info[s_idx].code + ii, sizeof code))
-        {
-            continue;
-        }
+        (void)sleb128(&rptr);
+    }
 
-        /* If the offset was zero, the observation is absent. */
-        if (!s64)
-        {
-            srnx->error_line = __LINE__;
-            return SRNX_UNKNOWN_CODE;
-        }
+    if (alloc_bitmap(p_bitmap, (n_epochs + 63) >> 6))
+    {
+        srnx->error_line = __LINE__;
+        return ENOMEM;
+    }
 
-        /* Validate SOCD block is for the expected SV and observation. */
-        s64 += sate_offset;
-        payload = srnx->data + s64;
-        if (memcmp(payload, "SOCD", 4)
-            || (uleb128(&payload) < 8)
-            || memcmp(payload, name.name, sizeof name)
-            || memcmp(payload + 4, code.name, sizeof code))
+    /* Mark each run of epochs where the satellite was present.  The
+     * first absent count is where the first run starts; later ones are
+     * gaps between runs, which are at least one epoch long.
+     */
+    n_runs = uleb128(&rptr) + 1;
+    for (start = n_present = 0; n_runs > 0; --n_runs)
+    {
+        u64 = uleb128(&rptr);
+        start += u64 + (n_present ? 1 : 0);
+        count = uleb128(&rptr) + 1;
+        if (rptr > end || start > n_epochs || count > n_epochs - start)
         {
             srnx->error_line = __LINE__;
             return SRNX_CORRUPT;
         }
+        set_bit_range(*p_bitmap, start, count);
+        start += count;
+        n_present += count;
+    }
 
-        return s64;
+    if (p_n_present)
+    {
+        *p_n_present = n_present;
     }
+    return 0;
+}
 
-    srnx->error_line = __LINE__;
-    return SRNX_UNKNOWN_CODE;
+/** Reads a zone-map summary entry from \a *p_rptr.
+ *
+ * \param[in,out] p_rptr Read pointer, advanced past the entry.
+ * \param[in] end End of the zone map.
+ * \param[out] p_zone Receives the summary.
+ * \returns Zero on success, else \a SRNX_CORRUPT.
+ */
+static int read_zone_summary(
+    const char **p_rptr,
+    const char *end,
+    struct srnx_obs_zone *p_zone
+)
+{
+    p_zone->min_value = sleb128(p_rptr);
+    p_zone->max_value = p_zone->min_value + uleb128(p_rptr);
+    p_zone->n_lli = uleb128(p_rptr);
+    p_zone->first_epoch = uleb128(p_rptr);
+    p_zone->last_epoch = p_zone->first_epoch + uleb128(p_rptr);
+
+    return (*p_rptr > end) ? SRNX_CORRUPT : 0;
 }
 
-/** Reads the initial delta decoder state in \a *p_socd.
+/** Walks the zone map of \a p_socd.
  *
- * This reads the first \a p_socd->order delta decoder values into
- * \a p_socd->delta, so that #undelta_and_scale() can be called.
+ * Reads the zone size and the whole-signal summary.  If \a n_zones is
+ * non-zero, also reads up to \a n_zones zone entries into \a zones
+ * (which may be NULL to only skip them).  If \a p_block and \a delta
+ * are not NULL, they receive the block offset and delta coder state
+ * from the last zone entry read.
  *
- * \param[in,out] p_socd Observation reader object to initialize.
+ * \param[in] p_socd Observation reader object.
+ * \param[out] p_summary Receives the whole-signal summary.
+ * \param[in] n_zones Number of zone entries to read.
+ * \param[out] zones If not NULL, receives \a n_zones zone entries.
+ * \param[out] p_block Receives the last zone's block offset.
+ * \param[out] delta Receives the last zone's delta coder state.
+ * \returns Zero on success, \a SRNX_NO_CHUNK if there is no zone map,
+ *   \a SRNX_END_OF_DATA if there are fewer than \a n_zones zones, or
+ *   \a SRNX_CORRUPT.
  */
-static int prime_delta_decoder(
-    struct srnx_obs_reader *p_socd
+static int walk_zone_map(
+    const struct srnx_obs_reader *p_socd,
+    struct srnx_obs_zone *p_summary,
+    uint64_t n_zones,
+    struct srnx_obs_zone *zones,
+    uint64_t *p_block,
+    int64_t delta[8]
 )
 {
-    const char *end;
-    const char *rptr;
-    int ii;
+    struct srnx_obs_zone zone;
+    const char *rptr, *end;
+    uint64_t zone_size, ii, block;
+    int res, jj;
 
-    end = p_socd->parent->data + p_socd->data_end;
-    rptr = p_socd->parent->data + p_socd->data_offset;
-    for (ii = 0; ii < p_socd->order; ++ii)
+    if (!p_socd->zone_offset)
     {
-        p_socd->delta[ii] = sleb128(&rptr);
+        return SRNX_NO_CHUNK;
+    }
+
+    rptr = p_socd->parent->data + p_socd->zone_offset;
+    end = p_socd->parent->data + p_socd->zone_end;
+    zone_size = uleb128(&rptr) + 1;
+    res = read_zone_summary(&rptr, end, p_summary);
+    if (res)
+    {
+        return res;
+    }
+    p_summary->first_obs = 0;
+    p_summary->n_obs = p_socd->n_values;
+
+    for (ii = 0; ii < n_zones; ++ii)
+    {
+        if (ii * zone_size >= p_socd->n_values)
+        {
+            return SRNX_END_OF_DATA;
+        }
+
+        res = read_zone_summary(&rptr, end, &zone);
+        if (res)
+        {
+            return res;
+        }
+        zone.first_obs = ii * zone_size;
+        zone.n_obs = p_socd->n_values - zone.first_obs;
+        if (zone.n_obs > zone_size)
+        {
+            zone.n_obs = zone_size;
+        }
+        if (zones)
+        {
+            zones[ii] = zone;
+        }
+
+        block = uleb128(&rptr);
+        for (jj = 0; jj < p_socd->order; ++jj)
+        {
+            int64_t s64 = sleb128(&rptr);
+
+            if (delta)
+            {
+                delta[jj] = s64;
+            }
+        }
         if (rptr > end)
         {
             return SRNX_CORRUPT;
         }
+        if (p_block)
+        {
+            *p_block = block;
+        }
     }
 
-    /* Update data_offset and report success. */
-    p_socd->data_offset = rptr - p_socd->parent->data;
     return 0;
 }
 
-/* Doc comment in srnx.h. */
-int srnx_open_obs_by_index(
-    struct srnx_reader *srnx,
-    struct srnx_satellite_name name,
-    int obs_idx,
-    struct srnx_obs_reader **p_rdr
+/* Doc comment in srnx.h. */
+int srnx_get_obs_summary(
+    struct srnx_obs_reader *p_socd,
+    struct srnx_obs_zone *p_zone
+)
+{
+    return walk_zone_map(p_socd, p_zone, 0, NULL, NULL, NULL);
+}
+
+/* Doc comment in srnx.h. */
+int srnx_get_obs_zones(
+    struct srnx_obs_reader *p_socd,
+    struct srnx_obs_zone **p_zones,
+    size_t *p_zones_len
+)
+{
+    struct srnx_obs_zone summary, *zones;
+    const char *rptr;
+    uint64_t zone_size, n_zones;
+
+    if (!p_socd->zone_offset)
+    {
+        return SRNX_NO_CHUNK;
+    }
+
+    /* How many zones are there? */
+    rptr = p_socd->parent->data + p_socd->zone_offset;
+    zone_size = uleb128(&rptr) + 1;
+    n_zones = (p_socd->n_values + zone_size - 1) / zone_size;
+
+    zones = srnx_reserve(*p_zones, n_zones * sizeof(zones[0]));
+    if (!zones)
+    {
+        return ENOMEM;
+    }
+    *p_zones = zones;
+    *p_zones_len = n_zones;
+
+    return walk_zone_map(p_socd, &summary, n_zones, zones, NULL, NULL);
+}
+
+/** Reads the zone entry at \a *p_rptr and moves the zone cursor of
+ * \a p_socd past it.
+ *
+ * \param[in,out] p_socd Observation reader object.
+ * \param[in] zone_size Number of observations per zone.
+ * \param[in,out] p_rptr Read pointer, at the start of entry \a zone_idx.
+ * \param[in] zone_idx Index of the entry at \a *p_rptr.
+ * \param[out] p_zone Receives the zone's statistics.
+ * \param[out] p_block Receives the zone's block offset.
+ * \param[out] delta Receives the zone's delta coder state.
+ * \returns Zero on success, \a SRNX_END_OF_DATA if \a zone_idx is past
+ *   the last zone, or \a SRNX_CORRUPT.
+ */
+static int read_zone_entry(
+    struct srnx_obs_reader *p_socd,
+    uint64_t zone_size,
+    const char **p_rptr,
+    uint64_t zone_idx,
+    struct srnx_obs_zone *p_zone,
+    uint64_t *p_block,
+    int64_t delta[8]
 )
 {
-    const char *rptr;
-    uint64_t u64, n_values, lli_offset, data_end, scale_order, scale;
-    int64_t socd_offset;
-    struct srnx_obs_code code;
-    int sys_idx, err;
+    const char *end = p_socd->parent->data + p_socd->zone_end;
+    uint64_t n_zones;
+    int res, jj;
 
-    /* Is the satellite system known for this file? */
-    sys_idx = srnx->sys_idx[name.name[0] & 31];
-    if (!sys_idx)
+    n_zones = p_socd->n_values / zone_size
+        + (p_socd->n_values % zone_size != 0);
+    if (zone_idx >= n_zones)
     {
-        srnx->error_line = __LINE__;
-        return SRNX_UNKNOWN_SYSTEM;
+        return SRNX_END_OF_DATA;
     }
 
-    /* Is the observation index valid for the satellite system? */
-    if (obs_idx < 0 || obs_idx >= srnx->sys_info[sys_idx].codes_len)
+    res = read_zone_summary(p_rptr, end, p_zone);
+    if (res)
     {
-        srnx->error_line = __LINE__;
-        return SRNX_UNKNOWN_CODE;
+        return res;
     }
-
-    /* Grab the name of the observation code. */
-    memcpy(&code, srnx->sys_info[sys_idx].code + obs_idx, sizeof code);
-
-    /* Try to find the SOCD chunk. */
-    socd_offset = srnx_find_socd(srnx, name, code);
-    if (socd_offset < 0)
+    p_zone->first_obs = zone_idx * zone_size;
+    p_zone->n_obs = p_socd->n_values - p_zone->first_obs;
+    if (p_zone->n_obs > zone_size)
     {
-        /* srnx_find_socd() sets \a srnx->error_line. */
-        return socd_offset;
+        p_zone->n_obs = zone_size;
     }
 
-    /* How big is the SOCD payload? */
-    rptr = srnx->data + socd_offset + 4;
-    u64 = uleb128(&rptr);
-    if (u64 > (uint64_t)(srnx->data + srnx->data_size - rptr))
+    *p_block = uleb128(p_rptr);
+    for (jj = 0; jj < p_socd->order; ++jj)
+    {
+        delta[jj] = sleb128(p_rptr);
+    }
+    if (*p_rptr > end)
     {
-        srnx->error_line = __LINE__;
         return SRNX_CORRUPT;
     }
-    rptr += 8; /* srnx_find_socd() verifies observation name */
 
-    /* Read number of observations. */
-    n_values = 1 + uleb128(&rptr);
+    p_socd->zone_cursor = zone_idx + 1;
+    p_socd->zone_cursor_offset = *p_rptr - p_socd->parent->data;
+    return 0;
+}
 
-    /* Skip LLI indicators. */
-    lli_offset = rptr - srnx->data;
-    u64 = uleb128(&rptr);
-    if (u64 > (uint64_t)(srnx->data + srnx->data_size - rptr))
+/** Locates zone entry \a zone_idx in the zone map of \a p_socd.
+ *
+ * Starts from the reader's zone cursor when that is not past
+ * \a zone_idx, so a sequence of increasing zone indices walks the
+ * zone map only once.
+ *
+ * \param[in,out] p_socd Observation reader object.
+ * \param[in] zone_idx Index of the zone entry to find.
+ * \param[out] p_zone_size Receives the number of observations per zone.
+ * \param[out] p_rptr Receives a pointer to the zone entry.
+ * \returns Zero on success, \a SRNX_NO_CHUNK if there is no zone map,
+ *   \a SRNX_END_OF_DATA if \a zone_idx is past the last zone, or
+ *   \a SRNX_CORRUPT.
+ */
+static int find_zone_entry(
+    struct srnx_obs_reader *p_socd,
+    uint64_t zone_idx,
+    uint64_t *p_zone_size,
+    const char **p_rptr
+)
+{
+    struct srnx_obs_zone zone;
+    const char *rptr, *end;
+    int64_t delta[8];
+    uint64_t ii, block;
+    int res;
+
+    if (!p_socd->zone_offset)
     {
-        srnx->error_line = __LINE__;
-        return SRNX_CORRUPT;
+        return SRNX_NO_CHUNK;
     }
-    rptr += u64;
 
-    /* Then skip SSI indicators. */
-    u64 = uleb128(&rptr);
-    if (u64 > (uint64_t)(srnx->data + srnx->data_size - rptr))
+    rptr = p_socd->parent->data + p_socd->zone_offset;
+    end = p_socd->parent->data + p_socd->zone_end;
+    *p_zone_size = uleb128(&rptr) + 1;
+    if (p_socd->zone_cursor_offset && p_socd->zone_cursor <= zone_idx)
     {
-        srnx->error_line = __LINE__;
-        return SRNX_CORRUPT;
+        ii = p_socd->zone_cursor;
+        rptr = p_socd->parent->data + p_socd->zone_cursor_offset;
+    }
+    else
+    {
+        res = read_zone_summary(&rptr, end, &zone);
+        if (res)
+        {
+            return res;
+        }
+        ii = 0;
     }
-    rptr += u64;
 
-    /* How long is the packed observation data? */
-    u64 = uleb128(&rptr);
-    if (u64 > (uint64_t)(srnx->data + srnx->data_size - rptr))
+    for (; ii < zone_idx; ++ii)
     {
-        srnx->error_line = __LINE__;
-        return SRNX_CORRUPT;
+        res = read_zone_entry(p_socd, *p_zone_size, &rptr, ii, &zone,
+            &block, delta);
+        if (res)
+        {
+            return res;
+        }
     }
-    data_end = rptr - srnx->data + u64;
 
-    /* Read the scale-presence and order value. */
-    scale_order = uleb128(&rptr);
-    if (scale_order > 15 || rptr > srnx->data + srnx->data_size)
+    *p_rptr = rptr;
+    return 0;
+}
+
+/** Repositions \a p_socd at a zone whose entry has already been read.
+ *
+ * \param[in,out] p_socd Observation reader object.
+ * \param[in] zone_idx Index of the zone.
+ * \param[in] block Block offset from the zone entry.
+ * \param[in] delta Delta coder state from the zone entry.
+ * \returns Zero on success, else a non-zero SRNX error number.
+ */
+static int seek_to_zone_entry(
+    struct srnx_obs_reader *p_socd,
+    uint64_t zone_idx,
+    uint64_t block,
+    const int64_t delta[8]
+)
+{
+    int res;
+
+    /* For entropy-coded blocks, \a block locates the zone's segment. */
+    if (p_socd->coded_end
+        ? block > p_socd->coded_end - p_socd->coded_start
+        : block > p_socd->data_end - p_socd->blocks_offset)
     {
-        srnx->error_line = __LINE__;
         return SRNX_CORRUPT;
     }
 
-    /* Is there a scale value? */
-    scale = 1;
-    if (scale_order & 8)
+    /* A predicted signal's reference must have the same zone size, so
+     * that it can seek to the same observation.
+     */
+    if (p_socd->ref)
     {
-        scale = uleb128(&rptr);
-        if (scale > 1000000000 || rptr > srnx->data + srnx->data_size)
+        const char *rptr = p_socd->parent->data + p_socd->zone_offset;
+        const char *ref_rptr = p_socd->parent->data + p_socd->ref->zone_offset;
+        if (!p_socd->ref->zone_offset || uleb128(&rptr) != uleb128(&ref_rptr))
         {
-            srnx->error_line = __LINE__;
             return SRNX_CORRUPT;
         }
-    }
-
-    /* Allocate *p_rdr if necessary. */
-    if (!*p_rdr)
-    {
-        *p_rdr = malloc(sizeof **p_rdr);
-        if (!*p_rdr)
+        res = srnx_seek_obs_zone(p_socd->ref, zone_idx);
+        if (res)
         {
-            srnx->error_line = __LINE__;
-            return ENOMEM;
+            return res;
         }
+        p_socd->ref_pos = 0;
     }
 
-    /* Store everything we need to keep. */
-    memset(*p_rdr, 0, sizeof **p_rdr);
-    (*p_rdr)->order = scale_order & 7;
-    (*p_rdr)->parent = srnx;
-    (*p_rdr)->n_values = n_values;
-    (*p_rdr)->scale = scale;
-    (*p_rdr)->lli_offset = lli_offset;
-    (*p_rdr)->data_offset = rptr - srnx->data;
-    (*p_rdr)->data_end = data_end;
-
-    /* Initialize the delta decoder. */
-    err = prime_delta_decoder(*p_rdr);
-    if (err)
+    /* Discard any decoded state and start over at the zone. */
+    memcpy(p_socd->delta, delta, p_socd->order * sizeof(delta[0]));
+    if (p_socd->coded_end)
     {
-        srnx->error_line = __LINE__;
-        return err;
+        p_socd->coded_offset = p_socd->coded_start + block;
+        p_socd->data_end = 0;
+        block = 0;
     }
-
+    p_socd->data_offset = p_socd->blocks_offset + block;
+    p_socd->obs_valid = 0;
+    p_socd->obs_idx = 0;
+    p_socd->block_left = 0;
     return 0;
 }
 
 /* Doc comment in srnx.h. */
-void srnx_free_obs_reader(struct srnx_obs_reader *p_socd)
+int srnx_seek_obs_zone(
+    struct srnx_obs_reader *p_socd,
+    uint64_t zone_idx
+)
 {
-    free(p_socd);
+    struct srnx_obs_zone zone;
+    const char *rptr;
+    int64_t delta[8];
+    uint64_t zone_size, block;
+    int res;
+
+    res = find_zone_entry(p_socd, zone_idx, &zone_size, &rptr);
+    if (!res)
+    {
+        res = read_zone_entry(p_socd, zone_size, &rptr, zone_idx, &zone,
+            &block, delta);
+    }
+    if (res)
+    {
+        return res;
+    }
+
+    return seek_to_zone_entry(p_socd, zone_idx, block, delta);
 }
 
-/** Decompresses indicators from [\a in, \a end) into \a out.
- *
- * \param[out] out Receives decompressed indicators.
- * \param[in] n_values Number of indicators to decompress.
- * \param[in] in Start of RLE-compressed indicators.
- * \param[in] end End-plus-1 of RLE-compressed indicators.
- * \returns Zero on success, else negative \a srnx_errno on failure.
- */
-static int decompress_indicators(
-    char *out,
-    uint64_t n_values,
-    const char *in,
-    const char *end
+/* Doc comment in srnx.h. */
+int srnx_obs_zone_may_match(
+    const struct srnx_obs_zone *p_zone,
+    const struct srnx_obs_predicate *p_pred
 )
 {
-    uint64_t ii, count;
-    char ind;
-
-    /* Decompress the RLE-compressed data. */
-    for (ii = 0; in < end; )
+    if (p_zone->max_value < p_pred->min_value
+        || p_zone->min_value > p_pred->max_value)
     {
-        ind = *in++;
-        count = uleb128(&in) + 1;
-        if (ii + count > n_values)
-        {
-            return SRNX_CORRUPT;
-        }
-        memset(out + ii, ind, count);
-        ii += count;
+        return 0;
     }
-    if (in > end)
+
+    if (p_pred->need_lli && !p_zone->n_lli)
     {
-        return SRNX_CORRUPT;
+        return 0;
     }
 
-    /* Fill any remaining indicators with spaces. */
-    memset(out + ii, ' ', n_values - ii);
-    return 0;
+    return 1;
 }
 
 /* Doc comment in srnx.h. */
-int srnx_read_obs_ssi_lli(
+int srnx_next_matching_zone(
     struct srnx_obs_reader *p_socd,
-    int *p_n_values,
-    char **p_lli,
-    char **p_ssi
+    const struct srnx_obs_predicate *p_pred,
+    uint64_t *p_zone_idx,
+    struct srnx_obs_zone *p_zone
 )
 {
-    uint64_t u64, n_values;
-    const char *inds;
-    char *cp;
+    struct srnx_obs_zone summary, zone;
+    const char *rptr;
+    int64_t delta[8];
+    uint64_t zone_size, block, ii;
     int res;
 
-    /* (Re-)Allocate the LLI and SSI arrays. */
-    n_values = p_socd->n_values;
-    cp = realloc(*p_lli, n_values);
-    if (!cp)
+    /* Can we skip the whole signal? */
+    res = walk_zone_map(p_socd, &summary, 0, NULL, NULL, NULL);
+    if (res)
     {
-        return ENOMEM;
+        return res;
     }
-    *p_lli = cp;
-    cp = realloc(*p_ssi, n_values);
-    if (!cp)
+    if (!srnx_obs_zone_may_match(&summary, p_pred))
     {
-        return ENOMEM;
+        return SRNX_END_OF_DATA;
     }
-    *p_ssi = cp;
-    *p_n_values = n_values;
 
-    /* Decompress the LLIs. */
-    inds = p_socd->parent->data + p_socd->lli_offset;
-    u64 = uleb128(&inds);
-    res = decompress_indicators(*p_lli, n_values, inds, inds + u64);
-    if (res)
+    /* Scan the zone entries, starting at the caller's zone, for a
+     * candidate.  The zone cursor makes repeated calls with increasing
+     * zone indices linear in the size of the zone map.
+     */
+    res = find_zone_entry(p_socd, *p_zone_idx, &zone_size, &rptr);
+    for (ii = *p_zone_idx; !res; ++ii)
     {
-        return res;
+        res = read_zone_entry(p_socd, zone_size, &rptr, ii, &zone, &block,
+            delta);
+        if (res || !srnx_obs_zone_may_match(&zone, p_pred))
+        {
+            continue;
+        }
+
+        res = seek_to_zone_entry(p_socd, ii, block, delta);
+        if (res)
+        {
+            return res;
+        }
+        *p_zone_idx = ii;
+        if (p_zone)
+        {
+            *p_zone = zone;
+        }
+        return 0;
     }
-    inds += u64; /* bounds-checked by srnx_open_obs_by_index() */
 
-    /* Decompress the SSIs. */
-    u64 = uleb128(&inds);
-    return decompress_indicators(*p_ssi, n_values, inds, inds + u64);
+    return res;
 }
 
 /** Reverses delta filtering and scales the outputs in \a p_socd.
@@ -1654,6 +4023,86 @@ static void undelta_and_scale(
     }
 }
 
+/* add_predictions() and decode_observations() call each other. */
+static int decode_observations(
+    struct srnx_obs_reader *p_socd
+);
+
+/** Adds the predictions from \a p_socd->ref to observations
+ * \a first up to \a idx of \a p_socd.
+ *
+ * Each prediction is the reference value times \a p_socd->ref_num
+ * divided by \a p_socd->ref_den, rounded to the nearest integer (with
+ * halves rounded up).  Blanks need no special case: a blank reference
+ * value is zero, which predicts zero, and a blank predicted value is
+ * stored as minus its prediction.
+ *
+ * \param[in,out] p_socd Observation reader whose values to update.
+ * \param[in] first First observation to update.
+ * \param[in] idx One past the last observation to update.
+ * \returns Zero on success, \a SRNX_CORRUPT if the reference signal
+ *   has too few values, or another negative \a srnx_errno.
+ */
+static int add_predictions(
+    struct srnx_obs_reader *p_socd,
+    int first,
+    int idx
+)
+{
+    struct srnx_obs_reader *ref = p_socd->ref;
+    const int64_t num = p_socd->ref_num, den = p_socd->ref_den;
+    __int128 prod;
+    int64_t pred;
+    int count, ii, res;
+
+    while (first < idx)
+    {
+        /* Refill the reference values if they are used up. */
+        if (p_socd->ref_pos >= ref->obs_valid)
+        {
+            res = decode_observations(ref);
+            if (res)
+            {
+                return res;
+            }
+            if (!ref->obs_valid)
+            {
+                return SRNX_CORRUPT;
+            }
+            p_socd->ref_pos = 0;
+        }
+
+        count = ref->obs_valid - p_socd->ref_pos;
+        if (count > idx - first)
+        {
+            count = idx - first;
+        }
+
+        if (den == 1)
+        {
+            for (ii = 0; ii < count; ++ii)
+            {
+                p_socd->obs[first + ii] += num * ref->obs[p_socd->ref_pos + ii];
+            }
+        }
+        else
+        {
+            for (ii = 0; ii < count; ++ii)
+            {
+                prod = (__int128)num * ref->obs[p_socd->ref_pos + ii] * 2 + den;
+                pred = prod / (2 * den);
+                pred -= (prod % (2 * den)) < 0;
+                p_socd->obs[first + ii] += pred;
+            }
+        }
+
+        first += count;
+        p_socd->ref_pos += count;
+    }
+
+    return 0;
+}
+
 /** Attempts to decode observations from the SRNX file into \a p_socd.
  *
  * This reads observations from \a p_socd->data_offset into
@@ -1687,12 +4136,13 @@ static int decode_observations(
     idx = p_socd->obs_valid;
 
     /* Try to read more until we cannot read any more. */
-    data = p_socd->parent->data + p_socd->data_offset;
-    end = p_socd->parent->data + p_socd->data_end;
-    while (data < end)
+    data = p_socd->base + p_socd->data_offset;
+    end = p_socd->base + p_socd->data_end;
+    while (data < end || p_socd->block_left > 0
+        || p_socd->coded_offset < p_socd->coded_end)
     {
         /* How many observations can we read right now? */
-        avail = sizeof(p_socd->obs) / sizeof(p_socd->obs[0]) - p_socd->obs_valid;
+        avail = sizeof(p_socd->obs) / sizeof(p_socd->obs[0]) - idx;
 
         /* Do we have block-coded observations to read? */
     try_block:
@@ -1722,6 +4172,7 @@ static int decode_observations(
             {
                 ii = count;
                 memset(p_socd->obs + idx, 0, ii * sizeof(p_socd->obs[0]));
+                idx += ii;
             }
             else
             {
@@ -1732,26 +4183,48 @@ static int decode_observations(
             /* Update bookkeeping. */
             p_socd->block_left -= ii;
             avail -= ii;
+            if (p_socd->block_left > 0)
+            {
+                break;
+            }
         }
 
-        /* The next byte indicates the encoding scheme. */
+        /* The next byte indicates the encoding scheme.  Blocks do not
+         * span entropy-coded segments, so this is where the next
+         * segment, if any, starts.
+         */
+        if (data >= end)
+        {
+            if (p_socd->coded_offset >= p_socd->coded_end)
+            {
+                break;
+            }
+            res = load_segment(p_socd);
+            data = p_socd->base + p_socd->data_offset;
+            end = p_socd->base + p_socd->data_end;
+            if (res)
+            {
+                goto out;
+            }
+            continue;
+        }
         ch = *data++;
         if ((unsigned char)ch == BLOCK_ZERO
             || (unsigned char)ch == BLOCK_SLEB128)
         {
             u64 = uleb128(&data);
-            if (u64 > INT_MAX || data > end)
+            if (u64 >= INT_MAX || data > end)
             {
                 res = SRNX_CORRUPT;
                 goto out;
             }
-            p_socd->block_left = u64;
+            p_socd->block_left = u64 + 1;
             p_socd->block_code = ch;
             goto try_block;
         }
 
         /* It looks like a transposed bit matrix. */
-        count = 8 << (ch >> 5); /* number of output values */
+        count = 8 << ((unsigned char)ch >> 5); /* number of output values */
         bits = (ch & 31) + 1; /* bits per output value */
 
         /* Is the word count valid?  Do we have enough data? */
@@ -1761,232 +4234,795 @@ static int decode_observations(
             goto out;
         }
 
-        /* Would this overflow the observation buffer? */
-        if (avail < (size_t)count)
+        /* Would this overflow the observation buffer?  If so, leave the
+         * block header for the next call.
+         */
+        if (avail < (size_t)count)
+        {
+            --data;
+            break;
+        }
+
+        /* Transpose the matrix.  The count check above means ch < 96. */
+        transpose_kernel[(unsigned char)ch](p_socd->obs + idx, data, bits, count);
+
+        /* Update bookkeeping. */
+        data += (count >> 3) * bits;
+        idx += count;
+    }
+
+    /* Decode deltas and scale observations, then add any predictions. */
+    ii = p_socd->obs_valid;
+    undelta_and_scale(p_socd, idx);
+    res = p_socd->ref ? add_predictions(p_socd, ii, idx) : 0;
+
+out:
+    p_socd->data_offset = data - p_socd->base;
+    p_socd->obs_idx = idx;
+    return res;
+}
+
+/* Doc comment in srnx.h. */
+int srnx_read_obs_value(
+    struct srnx_obs_reader *p_socd,
+    int64_t *p_value
+)
+{
+    int res;
+
+    /* Do we need more observations? */
+    if (p_socd->obs_idx >= p_socd->obs_valid)
+    {
+        /* decode_observations() marks what it decodes as consumed, so
+         * rewind to the start of the new values.
+         */
+        p_socd->obs_valid = 0;
+        p_socd->obs_idx = 0;
+        if (p_socd->data_offset < p_socd->data_end || p_socd->block_left > 0
+            || p_socd->coded_offset < p_socd->coded_end)
+        {
+            res = decode_observations(p_socd);
+            p_socd->obs_idx = 0;
+            if (res)
+            {
+                return res;
+            }
+        }
+
+        if (!p_socd->obs_valid)
+        {
+            return SRNX_END_OF_DATA;
+        }
+    }
+
+    *p_value = p_socd->obs[p_socd->obs_idx++];
+    return 0;
+}
+
+/** Looks up the index for a satellite and observation code combination.
+ *
+ * \warning On failure, the caller must set \a srnx->error_line.
+ * \param[in] srnx SRNX reader to use.
+ * \param[in] name Satellite name to look up.
+ * \param[in] code Observation code name to look up.
+ * \returns Non-negative index on success, or else \a SRNX_UNKNOWN_NAME
+ *   or \a SRNX_UNKNOWN_SYSTEM on failure.
+ */
+static int srnx_obs_name_to_idx(
+    const struct srnx_reader *srnx,
+    struct srnx_satellite_name name,
+    struct srnx_obs_code code
+)
+{
+    int ii, sys_idx, n_codes;
+
+    /* Find the satellite's system index. */
+    sys_idx = srnx->sys_idx[name.name[0] & 31];
+    if (!sys_idx || !(n_codes = srnx->sys_info[sys_idx].codes_len))
+    {
+        return SRNX_UNKNOWN_SYSTEM;
+    }
+
+    for (ii = 0; ii < n_codes; ++ii)
+    {
+        if (!memcmp(srnx->sys_info[sys_idx].code[ii].name, code.name, sizeof code.name))
+        {
+            break;
+        }
+    }
+
+    if (ii == n_codes)
+    {
+        return SRNX_UNKNOWN_CODE;
+    }
+
+    return ii;
+}
+
+/* Doc comment in srnx.h. */
+int srnx_get_obs_by_name(
+    struct srnx_reader *srnx,
+    struct srnx_satellite_name name,
+    int codes_len,
+    struct srnx_obs_code code[],
+    int n_values[],
+    int64_t **p_obs,
+    char **p_lli,
+    char **p_ssi
+)
+{
+    int ii, c_idx, *idx;
+
+    /* Allocate an index for each requested name. */
+    idx = alloca(codes_len * sizeof(*idx));
+    if (!idx)
+    {
+        srnx->error_line = __LINE__;
+        return ENOMEM;
+    }
+
+    /* Translate names to indices. */
+    for (ii = 0; ii < codes_len; ++ii)
+    {
+        c_idx = srnx_obs_name_to_idx(srnx, name, code[ii]);
+        if (c_idx < 0)
+        {
+            srnx->error_line = __LINE__;
+            return c_idx;
+        }
+        idx[ii] = c_idx;
+    }
+
+    return srnx_get_obs_by_index(srnx, name, codes_len, idx, n_values,
+        p_obs, p_lli, p_ssi);
+}
+
+/* Doc comment in srnx.h. */
+int srnx_open_obs_by_name(
+    struct srnx_reader *srnx,
+    struct srnx_satellite_name name,
+    struct srnx_obs_code code,
+    struct srnx_obs_reader **p_rdr
+)
+{
+    int c_idx;
+
+    /* Translate name to index. */
+    c_idx = srnx_obs_name_to_idx(srnx, name, code);
+    if (c_idx < 0)
+    {
+        srnx->error_line = __LINE__;
+        return c_idx;
+    }
+
+    return srnx_open_obs_by_index(srnx, name, c_idx, p_rdr);
+}
+
+/** srnx_range is a byte range of a SRNX file to prefetch. */
+struct srnx_range
+{
+    /** Offset of the start of the range. */
+    uint64_t start;
+
+    /** Offset of the end (plus one) of the range. */
+    uint64_t end;
+};
+
+/** Orders byte ranges by their start offsets. */
+static int compare_range(const void *a, const void *b)
+{
+    const struct srnx_range *ra = a, *rb = b;
+
+    return (ra->start > rb->start) - (ra->start < rb->start);
+}
+
+/* Doc comment in srnx.h. */
+int srnx_prefetch_obs(
+    struct srnx_reader *srnx,
+    int n_requests,
+    const struct srnx_obs_request request[]
+)
+{
+    struct srnx_range *range;
+    struct srnx_obs_code code;
+    const char *rptr;
+    uint64_t u64;
+    int64_t socd_offset;
+    int ii, jj, n_ranges, s_idx, res;
+
+    if (n_requests < 1)
+    {
+        return 0;
+    }
+
+    range = malloc(n_requests * sizeof(*range));
+    if (!range)
+    {
+        srnx->error_line = __LINE__;
+        return ENOMEM;
+    }
+
+    /* Resolve each signal's SOCD chunk. */
+    for (ii = n_ranges = 0; ii < n_requests; ++ii)
+    {
+        s_idx = srnx->sys_idx[request[ii].name.name[0] & 31];
+        if (!s_idx || request[ii].obs_idx < 0
+            || request[ii].obs_idx >= srnx->sys_info[s_idx].codes_len)
+        {
+            continue;
+        }
+        memcpy(&code, srnx->sys_info[s_idx].code + request[ii].obs_idx,
+            sizeof code);
+
+        socd_offset = srnx_find_socd(srnx, request[ii].name, code);
+        if (socd_offset < 0)
+        {
+            continue;
+        }
+
+        rptr = srnx->data + socd_offset + 4;
+        u64 = uleb128(&rptr);
+        range[n_ranges].start = socd_offset & -page_size;
+        range[n_ranges].end = rptr - srnx->data + u64;
+        if (range[n_ranges].end > srnx->data_size)
+        {
+            range[n_ranges].end = srnx->data_size;
+        }
+        ++n_ranges;
+    }
+
+    /* Merge ranges that touch the same or adjacent pages, and issue
+     * the requests in file order.
+     */
+    qsort(range, n_ranges, sizeof(*range), compare_range);
+    for (ii = jj = 0; ii < n_ranges; ++jj)
+    {
+        struct srnx_range merged = range[ii];
+
+        while (++ii < n_ranges
+            && range[ii].start <= ((merged.end + page_size - 1) & -page_size))
+        {
+            if (merged.end < range[ii].end)
+            {
+                merged.end = range[ii].end;
+            }
+        }
+        range[jj] = merged;
+
+        /* This is only advice, so ignore failures. */
+        if (srnx->fd >= 0)
+        {
+            (void)posix_fadvise(srnx->fd, merged.start,
+                merged.end - merged.start, POSIX_FADV_WILLNEED);
+        }
+        else
+        {
+            (void)madvise((void *)(srnx->data + merged.start),
+                merged.end - merged.start, MADV_WILLNEED);
+        }
+    }
+
+    /* The pread backend has to copy the data in.  These reads are
+     * still synchronous and one at a time; the advice above only lets
+     * the kernel start fetching later ranges into the page cache while
+     * earlier ones are copied.  (With direct I/O, it does nothing.)
+     */
+    for (ii = res = 0; ii < jj && !res; ++ii)
+    {
+        res = srnx_load(srnx, range[ii].start, range[ii].end - range[ii].start);
+        if (res)
+        {
+            srnx->error_line = __LINE__;
+        }
+    }
+
+    free(range);
+    return res;
+}
+
+/** Decodes one signal for srnx_get_obs_by_index().
+ *
+ * \param[in] srnx SRNX reader object.
+ * \param[in] name Satellite name.
+ * \param[in] idx Observation index.
+ * \param[in,out] p_socd Observation reader to reuse.
+ * \param[out] p_n_values Receives the number of observations.
+ * \param[in,out] p_obs Observation value buffer.
+ * \param[in,out] p_lli If not NULL, loss-of-lock indicator buffer.
+ * \param[in,out] p_ssi If not NULL, signal strength indicator buffer.
+ * \returns Zero on success, non-zero SRNX error number on error.
+ */
+static int read_obs_column(
+    struct srnx_reader *srnx,
+    struct srnx_satellite_name name,
+    int idx,
+    struct srnx_obs_reader **p_socd,
+    int *p_n_values,
+    int64_t **p_obs,
+    char **p_lli,
+    char **p_ssi
+)
+{
+    int64_t count, *obs;
+    int jj, res;
+
+    /* Open the observation. */
+    res = srnx_open_obs_by_index(srnx, name, idx, p_socd);
+    if (res)
+    {
+        /* srnx_open_obs_by_index sets \a srnx->error_line. */
+        return res;
+    }
+
+    /* Read the SSIs and LLIs. */
+    res = srnx_read_obs_ssi_lli(*p_socd, p_n_values, p_lli, p_ssi);
+    if (res)
+    {
+        srnx->error_line = __LINE__;
+        return res;
+    }
+
+    /* Reallocate memory for the observations. */
+    obs = srnx_reserve(*p_obs, *p_n_values * (size_t)8);
+    if (!obs)
+    {
+        srnx->error_line = __LINE__;
+        return ENOMEM;
+    }
+    *p_obs = obs;
+
+    /* Read observation values into *p_obs. */
+    for (jj = 0; jj < *p_n_values; )
+    {
+        res = decode_observations(*p_socd);
+        if (res)
+        {
+            srnx->error_line = __LINE__;
+            return res;
+        }
+
+        if ((*p_socd)->obs_valid < *p_n_values - jj)
         {
-            break;
+            count = (*p_socd)->obs_valid;
         }
-
-        /* Transpose the matrix. */
-        transpose(p_socd->obs + idx, data, bits, count);
-
-        /* Update bookkeeping. */
-        data += bits;
-        idx += count;
+        else
+        {
+            count = *p_n_values - jj;
+        }
+        memcpy(obs + jj, (*p_socd)->obs, sizeof(int64_t) * count);
+        jj += count;
     }
 
-    /* Decode deltas and scale observations. */
-    undelta_and_scale(p_socd, idx);
-    res = 0;
-
-out:
-    p_socd->data_offset = data - p_socd->parent->data;
-    p_socd->obs_idx = idx;
-    return res;
+    return 0;
 }
 
 /* Doc comment in srnx.h. */
-int srnx_read_obs_value(
-    struct srnx_obs_reader *p_socd,
-    int64_t *p_value
+int srnx_get_obs_by_index(
+    struct srnx_reader *srnx,
+    struct srnx_satellite_name name,
+    int idx_len,
+    int idx[],
+    int n_values[],
+    int64_t **p_obs,
+    char **p_lli,
+    char **p_ssi
 )
 {
-    int res;
+    struct srnx_obs_reader *p_socd;
+    struct srnx_obs_request *request;
+    struct srnx_cache_key *key;
+    struct timespec t0, t1;
+    char **lli, **ssi, *tmp_lli, *tmp_ssi, *state;
+    int ii, n_requests, res, s_idx;
+
+    /* Serve what we can from the cache.  state[ii] is 0 if signal ii
+     * bypasses the cache (because the cache is disabled, or because the
+     * index is invalid, which srnx_open_obs_by_index() reports), 1 if
+     * it missed, or 2 if it hit.
+     */
+    key = alloca(idx_len * sizeof(*key));
+    state = alloca(idx_len);
+    request = alloca(idx_len * sizeof(*request));
+    s_idx = srnx->sys_idx[name.name[0] & 31];
+    for (ii = n_requests = 0; ii < idx_len; ++ii)
+    {
+        state[ii] = srnx_cache_enabled() && s_idx && idx[ii] >= 0
+            && idx[ii] < srnx->sys_info[s_idx].codes_len;
+        if (state[ii])
+        {
+            key[ii].file = srnx->file_id;
+            memset(&key[ii].name, 0, sizeof key[ii].name);
+            memcpy(key[ii].name.name, name.name, 3);
+            memcpy(&key[ii].code, srnx->sys_info[s_idx].code + idx[ii],
+                sizeof key[ii].code);
+            if (srnx_cache_get(key + ii, n_values + ii, p_obs + ii,
+                p_lli ? p_lli + ii : NULL, p_ssi ? p_ssi + ii : NULL))
+            {
+                state[ii] = 2;
+                continue;
+            }
+        }
+        request[n_requests].name = name;
+        request[n_requests].obs_idx = idx[ii];
+        ++n_requests;
+    }
 
-    /* Do we need more observations? */
-    if (p_socd->obs_idx >= p_socd->obs_valid)
+    /* Start reading the signals we must decode before we decode any of
+     * them.
+     */
+    if (n_requests > 1)
     {
-        p_socd->obs_valid = 0;
-        if (p_socd->data_offset < p_socd->data_end)
+        res = srnx_prefetch_obs(srnx, n_requests, request);
+        if (res)
         {
-            res = decode_observations(p_socd);
+            /* srnx_prefetch_obs() sets srnx->error_line. */
+            return res;
+        }
+    }
+
+    p_socd = NULL;
+    for (ii = 0; ii < idx_len; ++ii)
+    {
+        lli = p_lli ? p_lli + ii : NULL;
+        ssi = p_ssi ? p_ssi + ii : NULL;
+
+        if (state[ii] == 2)
+        {
+            continue;
+        }
+
+        /* Without the cache, just decode the signal. */
+        if (!state[ii])
+        {
+            res = read_obs_column(srnx, name, idx[ii], &p_socd,
+                n_values + ii, p_obs + ii, lli, ssi);
             if (res)
             {
+                /* read_obs_column() sets \a srnx->error_line. */
+                srnx_free_obs_reader(p_socd);
                 return res;
             }
+            continue;
         }
 
-        if (!p_socd->obs_valid)
+        /* Decode it, including both indicators so the cache entry can
+         * serve any later request.
+         */
+        tmp_lli = tmp_ssi = NULL;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        res = read_obs_column(srnx, name, idx[ii], &p_socd, n_values + ii,
+            p_obs + ii, lli ? lli : &tmp_lli, ssi ? ssi : &tmp_ssi);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        if (!res)
         {
-            return SRNX_END_OF_DATA;
+            srnx_cache_put(key + ii, n_values[ii], p_obs[ii],
+                lli ? *lli : tmp_lli, ssi ? *ssi : tmp_ssi,
+                (t1.tv_sec - t0.tv_sec) * (uint64_t)1000000000
+                + t1.tv_nsec - t0.tv_nsec);
+        }
+        srnx_free(tmp_lli);
+        srnx_free(tmp_ssi);
+        if (res)
+        {
+            /* read_obs_column() sets \a srnx->error_line. */
+            srnx_free_obs_reader(p_socd);
+            return res;
         }
     }
 
-    *p_value = p_socd->obs[p_socd->obs_idx++];
+    /* Deallocate the reader. */
+    srnx_free_obs_reader(p_socd);
+
     return 0;
 }
 
-/** Looks up the index for a satellite and observation code combination.
+/** combo_term holds srnx_get_combination()'s state for one term. */
+struct combo_term
+{
+    /** Reader for the term's signal. */
+    struct srnx_obs_reader *rdr;
+
+    /** Bitmap of epochs where the term's satellite was observed. */
+    uint64_t *present;
+
+    /** Weight of each decoded value (which is times 1000). */
+    double weight;
+
+    /** Index of the next unused value in \a rdr->obs. */
+    int pos;
+};
+
+/** Makes sure that \a ct has at least one unused decoded value.
  *
- * \warning On failure, the caller must set \a srnx->error_line.
- * \param[in] srnx SRNX reader to use.
- * \param[in] name Satellite name to look up.
- * \param[in] code Observation code name to look up.
- * \returns Non-negative index on success, or else \a SRNX_UNKNOWN_NAME
- *   or \a SRNX_UNKNOWN_SYSTEM on failure.
+ * \param[in,out] ct Term to refill.
+ * \returns Zero on success, \a SRNX_CORRUPT if the signal has no more
+ *   values, or another non-zero SRNX error number on error.
  */
-static int srnx_obs_name_to_idx(
-    const struct srnx_reader *srnx,
-    struct srnx_satellite_name name,
-    struct srnx_obs_code code
+static int combo_fill(
+    struct combo_term *ct
 )
 {
-    int ii, sys_idx, n_codes;
-
-    /* Find the satellite's system index. */
-    sys_idx = srnx->sys_idx[name.name[0] & 31];
-    if (!sys_idx || !(n_codes = srnx->sys_info[sys_idx].codes_len))
-    {
-        return SRNX_UNKNOWN_SYSTEM;
-    }
+    int res;
 
-    for (ii = 0; ii < n_codes; ++ii)
+    if (ct->pos < ct->rdr->obs_valid)
     {
-        if (!memcmp(srnx->sys_info[sys_idx].code[ii].name, code.name, sizeof code.name))
-        {
-            break;
-        }
+        return 0;
     }
 
-    if (ii == n_codes)
+    res = decode_observations(ct->rdr);
+    if (res)
     {
-        return SRNX_UNKNOWN_CODE;
+        return res;
     }
+    ct->pos = 0;
 
-    return ii;
+    return ct->rdr->obs_valid ? 0 : SRNX_CORRUPT;
 }
 
-/* Doc comment in srnx.h. */
-int srnx_get_obs_by_name(
-    struct srnx_reader *srnx,
-    struct srnx_satellite_name name,
-    int codes_len,
-    struct srnx_obs_code code[],
-    int n_values[],
-    int64_t **p_obs,
-    char **p_lli,
-    char **p_ssi
+/** Skips \a count values of \a ct.
+ *
+ * \param[in,out] ct Term to advance.
+ * \param[in] count Number of values to skip.
+ * \returns Zero on success, non-zero SRNX error number on error.
+ */
+static int combo_skip(
+    struct combo_term *ct,
+    uint64_t count
 )
 {
-    int ii, c_idx, *idx;
-
-    /* Allocate an index for each requested name. */
-    idx = alloca(codes_len * sizeof(*idx));
-    if (!idx)
-    {
-        srnx->error_line = __LINE__;
-        return ENOMEM;
-    }
+    uint64_t avail;
+    int res;
 
-    /* Translate names to indices. */
-    for (ii = 0; ii < codes_len; ++ii)
+    while (count > 0)
     {
-        c_idx = srnx_obs_name_to_idx(srnx, name, code[ii]);
-        if (c_idx < 0)
+        res = combo_fill(ct);
+        if (res)
         {
-            srnx->error_line = __LINE__;
-            return c_idx;
+            return res;
         }
-        idx[ii] = c_idx;
+        avail = ct->rdr->obs_valid - ct->pos;
+        if (avail > count)
+        {
+            avail = count;
+        }
+        ct->pos += avail;
+        count -= avail;
     }
 
-    return srnx_get_obs_by_index(srnx, name, codes_len, idx, n_values,
-        p_obs, p_ssi, p_lli);
+    return 0;
 }
 
-/* Doc comment in srnx.h. */
-int srnx_open_obs_by_name(
-    struct srnx_reader *srnx,
-    struct srnx_satellite_name name,
-    struct srnx_obs_code code,
-    struct srnx_obs_reader **p_rdr
+/** Adds \a weight times each of \a count values from \a in to
+ * \a out, or stores the products if \a first is non-zero.  A zero
+ * input makes the output NaN.
+ */
+static void combo_accumulate(
+    double out[],
+    const int64_t in[],
+    int count,
+    double weight,
+    int first
 )
 {
-    int c_idx;
+    double yy;
+    int ii;
 
-    /* Translate name to index. */
-    c_idx = srnx_obs_name_to_idx(srnx, name, code);
-    if (c_idx < 0)
+    ii = 0;
+#if defined(__AVX2__)
+    const __m256d hh = _mm256_set1_pd(0x0018000000000000);
+    const __m256d v_weight = _mm256_set1_pd(weight);
+    const __m256d v_nan = _mm256_set1_pd(NAN);
+    for (; ii + 4 <= count; ii += 4)
     {
-        srnx->error_line = __LINE__;
-        return c_idx;
+        __m256i xx = _mm256_loadu_si256((const __m256i *)(in + ii));
+        __m256d blank = _mm256_castsi256_pd(
+            _mm256_cmpeq_epi64(xx, _mm256_setzero_si256()));
+        xx = _mm256_add_epi64(xx, _mm256_castpd_si256(hh));
+        __m256d vy = _mm256_mul_pd(
+            _mm256_sub_pd(_mm256_castsi256_pd(xx), hh), v_weight);
+        if (!first)
+        {
+            vy = _mm256_add_pd(vy, _mm256_loadu_pd(out + ii));
+        }
+        _mm256_storeu_pd(out + ii, _mm256_blendv_pd(vy, v_nan, blank));
     }
+#endif
 
-    return srnx_open_obs_by_index(srnx, name, c_idx, p_rdr);
+    for (; ii < count; ++ii)
+    {
+        yy = in[ii] ? in[ii] * weight : NAN;
+        out[ii] = first ? yy : out[ii] + yy;
+    }
 }
 
 /* Doc comment in srnx.h. */
-int srnx_get_obs_by_index(
+int srnx_get_combination(
     struct srnx_reader *srnx,
-    struct srnx_satellite_name name,
-    int idx_len,
-    int idx[],
-    int n_values[],
-    int64_t **p_obs,
-    char **p_lli,
-    char **p_ssi
+    int n_terms,
+    const struct srnx_combo_term term[],
+    uint64_t n_epochs,
+    uint64_t **p_bitmap,
+    double **p_value,
+    uint64_t *p_n_values
 )
 {
-    struct srnx_obs_reader *p_socd;
-    int64_t count, *obs;
-    int ii, jj, res;
+    struct srnx_obs_request request[SRNX_COMBO_MAX];
+    struct combo_term ct[SRNX_COMBO_MAX];
+    uint64_t rest[SRNX_COMBO_MAX], *tmp_bitmap, **pp_bitmap, *bitmap;
+    uint64_t n_words, n_present, n_out, word, bit, ii, jj;
+    double *value, scale;
+    int kk, count, aligned, res;
+
+    if (n_terms < 1 || n_terms > SRNX_COMBO_MAX)
+    {
+        srnx->error_line = __LINE__;
+        return EINVAL;
+    }
 
-    p_socd = NULL;
-    for (ii = 0; ii < idx_len; ++ii)
+    /* Start reading all the signals before we decode any of them. */
+    for (kk = 0; kk < n_terms; ++kk)
+    {
+        request[kk].name = term[kk].name;
+        request[kk].obs_idx = term[kk].obs_idx;
+    }
+    res = srnx_prefetch_obs(srnx, n_terms, request);
+    if (res)
+    {
+        /* srnx_prefetch_obs() sets srnx->error_line. */
+        return res;
+    }
+
+    /* Open each signal and find where its satellite was observed. */
+    memset(ct, 0, sizeof ct);
+    tmp_bitmap = NULL;
+    pp_bitmap = p_bitmap ? p_bitmap : &tmp_bitmap;
+    for (kk = 0; kk < n_terms; ++kk)
     {
-        /* Open the ii'th observation. */
-        res = srnx_open_obs_by_index(srnx, name, idx[ii], &p_socd);
+        res = srnx_open_obs_by_index(srnx, term[kk].name, term[kk].obs_idx,
+            &ct[kk].rdr);
         if (res)
         {
-            /* srnx_open_obs_by_index sets \a srnx->error_line. */
-            return res;
+            /* srnx_open_obs_by_index() sets srnx->error_line. */
+            goto out;
         }
-
-        /* Read the SSIs and LLIs. */
-        res = srnx_read_obs_ssi_lli(p_socd, n_values + ii, p_lli + ii, p_ssi + ii);
+        res = srnx_get_sat_presence(srnx, term[kk].name, n_epochs,
+            &ct[kk].present, &n_present);
         if (res)
+        {
+            /* srnx_get_sat_presence() sets srnx->error_line. */
+            goto out;
+        }
+        if (ct[kk].rdr->n_values != n_present)
         {
             srnx->error_line = __LINE__;
-            srnx_free_obs_reader(p_socd);
-            return res;
+            res = SRNX_CORRUPT;
+            goto out;
         }
+        scale = (term[kk].wavelength != 0.0) ? term[kk].wavelength : 1.0;
+        ct[kk].weight = term[kk].coeff * scale * 0.001;
+    }
 
-        /* Reallocate memory for the observations. */
-        obs = realloc(p_obs[ii], n_values[ii] * (size_t)8);
-        if (!obs)
+    /* Output epochs are those where every satellite was observed. */
+    n_words = (n_epochs + 63) >> 6;
+    if (alloc_bitmap(pp_bitmap, n_words))
+    {
+        srnx->error_line = __LINE__;
+        res = ENOMEM;
+        goto out;
+    }
+    bitmap = *pp_bitmap;
+    memcpy(bitmap, ct[0].present, n_words * sizeof(bitmap[0]));
+    for (kk = 1; kk < n_terms; ++kk)
+    {
+        for (ii = 0; ii < n_words; ++ii)
         {
-            srnx->error_line = __LINE__;
-            srnx_free_obs_reader(p_socd);
-            return ENOMEM;
+            bitmap[ii] &= ct[kk].present[ii];
         }
-        p_obs[ii] = obs;
+    }
+    for (ii = n_out = 0; ii < n_words; ++ii)
+    {
+        n_out += __builtin_popcountll(bitmap[ii]);
+    }
+    for (kk = 0, aligned = 1; kk < n_terms && aligned; ++kk)
+    {
+        aligned = !memcmp(bitmap, ct[kk].present, n_words * sizeof(bitmap[0]));
+    }
+
+    value = srnx_reserve(*p_value, n_out * sizeof(*value));
+    if (!value)
+    {
+        srnx->error_line = __LINE__;
+        res = ENOMEM;
+        goto out;
+    }
+    *p_value = value;
 
-        /* Read observation values into p_obs[ii]. */
-        for (jj = 0; jj < n_values[ii]; )
+    if (aligned)
+    {
+        /* Every term has a value at every output epoch, so combine
+         * as much as all of the readers have decoded at once.
+         */
+        for (jj = 0; jj < n_out; jj += count)
         {
-            res = decode_observations(p_socd);
-            if (res)
+            count = (n_out - jj < 256) ? n_out - jj : 256;
+            for (kk = 0; kk < n_terms; ++kk)
             {
-                srnx->error_line = __LINE__;
-                srnx_free_obs_reader(p_socd);
-                return res;
+                res = combo_fill(&ct[kk]);
+                if (res)
+                {
+                    srnx->error_line = __LINE__;
+                    goto out;
+                }
+                if (count > ct[kk].rdr->obs_valid - ct[kk].pos)
+                {
+                    count = ct[kk].rdr->obs_valid - ct[kk].pos;
+                }
             }
-
-            if (p_socd->obs_valid < n_values[ii] - jj)
+            for (kk = 0; kk < n_terms; ++kk)
             {
-                count = p_socd->obs_valid;
+                combo_accumulate(value + jj, ct[kk].rdr->obs + ct[kk].pos,
+                    count, ct[kk].weight, kk == 0);
+                ct[kk].pos += count;
             }
-            else
+        }
+    }
+    else
+    {
+        /* Each term skips its values at epochs that some other
+         * satellite lacks.  rest[kk] holds the bits of the current
+         * word for which term kk has not yet used or skipped a value.
+         */
+        for (ii = jj = 0; ii < n_words; ++ii)
+        {
+            for (kk = 0; kk < n_terms; ++kk)
+            {
+                rest[kk] = ct[kk].present[ii];
+            }
+            for (word = bitmap[ii]; word; word &= word - 1, ++jj)
+            {
+                bit = word & -word;
+                for (kk = 0; kk < n_terms; ++kk)
+                {
+                    res = combo_skip(&ct[kk],
+                        __builtin_popcountll(rest[kk] & (bit - 1)));
+                    if (!res)
+                    {
+                        res = combo_fill(&ct[kk]);
+                    }
+                    if (res)
+                    {
+                        srnx->error_line = __LINE__;
+                        goto out;
+                    }
+                    combo_accumulate(value + jj, ct[kk].rdr->obs + ct[kk].pos,
+                        1, ct[kk].weight, kk == 0);
+                    ct[kk].pos++;
+                    rest[kk] &= -(bit << 1);
+                }
+            }
+            if (jj == n_out)
+            {
+                break;
+            }
+            for (kk = 0; kk < n_terms; ++kk)
             {
-                count = n_values[ii] - jj;
+                res = combo_skip(&ct[kk], __builtin_popcountll(rest[kk]));
+                if (res)
+                {
+                    srnx->error_line = __LINE__;
+                    goto out;
+                }
             }
-            memcpy(p_obs[ii] + jj, p_socd->obs, sizeof(int64_t) * count);
-            jj += count;
         }
     }
+    *p_n_values = n_out;
 
-    /* Deallocate the reader. */
-    srnx_free_obs_reader(p_socd);
-
-    return 0;
+out:
+    for (kk = 0; kk < n_terms; ++kk)
+    {
+        srnx_free_obs_reader(ct[kk].rdr);
+        srnx_free(ct[kk].present);
+    }
+    srnx_free(tmp_bitmap);
+    return res;
 }
@@ -23,6 +23,7 @@
  */
 
 #if !defined(SRNX_H_a2b6e4a7_3fda_4ba2_8ed1_67b906d55b2c)
+#define SRNX_H_a2b6e4a7_3fda_4ba2_8ed1_67b906d55b2c
 
 #include <stddef.h>
 
@@ -33,8 +34,34 @@
  * library may use a different heap than the rest of the process.  This
  * implies that most pointers passed by address to the library must be
  * initialized to NULL before the first library call.
+ *
+ * Output arrays remember how much memory was allocated for them, apart
+ * from how many elements are valid, so passing the same pointer to
+ * later calls reuses the array unless it needs to grow.  Such arrays
+ * must be released with srnx_free(), not free().
  */
 
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/** Negative SRNX error numbers. */
+enum srnx_errno
+{
+    SRNX_NOT_SRNX = -1,
+    SRNX_CORRUPT = -2,
+    SRNX_BAD_MAJOR = -3,
+    SRNX_BAD_STATE = -4,
+    SRNX_NO_CHUNK = -5,
+    SRNX_UNKNOWN_SYSTEM = -6,
+    SRNX_UNKNOWN_CODE = -7,
+    SRNX_UNKNOWN_SATELLITE = -8,
+    SRNX_END_OF_DATA = -9,
+    SRNX_IMPLEMENTATION_ERROR = -10,
+    SRNX_IO_ERROR = -11,
+    SRNX_WOULD_BLOCK = -12
+};
+
 /** srnx_reader represents a SRNX stream reader. */
 struct srnx_reader;
 
@@ -44,6 +71,9 @@ struct srnx_reader;
  */
 struct srnx_obs_reader;
 
+/** srnx_epoch_index holds a file's epoch times in compact form. */
+struct srnx_epoch_index;
+
 /** Contains a RINEX satellite name. */
 struct srnx_satellite_name
 {
@@ -70,9 +100,142 @@ struct srnx_obs_code
     char name[4];
 };
 
-/** Deallocates an object allocated by the library.
+/** Describes a run of epochs at a constant interval.
+ *
+ * Times are nanoseconds since 1980-01-06 00:00:00 in the file's time
+ * system; for GPS time, this is GPS time.  For time systems with leap
+ * seconds, a leap second has the same time as the following second.
+ */
+struct srnx_epoch_span
+{
+    /** Time of the first epoch in the span. */
+    int64_t start_ns;
+
+    /** Interval between consecutive epochs. */
+    int64_t step_ns;
+
+    /** Index of the first epoch in the span. */
+    uint64_t first;
+
+    /** Number of epochs in the span. */
+    uint64_t count;
+};
+
+/** Describes a run of identical loss-of-lock or signal-strength
+ * indicators for consecutive epochs of one observation code.
+ */
+struct srnx_indicator_run
+{
+    /** Number of consecutive epochs with this indicator. */
+    uint64_t count;
+
+    /** Indicator character, as it appears in RINEX (' ' if blank). */
+    char value;
+};
+
+/** Holds zone-map statistics for a signal, or one zone of a signal.
+ *
+ * Observation values are in the same units that observation readers
+ * return: the observation value times 1000.
+ */
+struct srnx_obs_zone
+{
+    /** Smallest observation value. */
+    int64_t min_value;
+
+    /** Largest observation value. */
+    int64_t max_value;
+
+    /** Index (within the signal) of the first observation. */
+    uint64_t first_obs;
+
+    /** Number of observations. */
+    uint64_t n_obs;
+
+    /** Number of observations with an LLI other than ' ' or '0'. */
+    uint64_t n_lli;
+
+    /** Epoch index of the first observation. */
+    uint64_t first_epoch;
+
+    /** Epoch index of the last observation. */
+    uint64_t last_epoch;
+};
+
+/** Describes which observations a query is interested in. */
+struct srnx_obs_predicate
+{
+    /** Smallest observation value of interest. */
+    int64_t min_value;
+
+    /** Largest observation value of interest. */
+    int64_t max_value;
+
+    /** If non-zero, only observations with a non-blank, non-zero LLI
+     * are of interest.
+     */
+    int need_lli;
+};
+
+/** Reports the activity of the decoded-observation cache. */
+struct srnx_cache_stats
+{
+    /** Number of signals served from the cache. */
+    uint64_t hits;
+
+    /** Number of signals that had to be decoded. */
+    uint64_t misses;
+
+    /** Number of signals added to the cache. */
+    uint64_t insertions;
+
+    /** Number of signals removed from the cache. */
+    uint64_t evictions;
+
+    /** Number of signals currently in the cache. */
+    uint64_t n_entries;
+
+    /** Memory currently used by the cache, in bytes. */
+    uint64_t bytes_used;
+
+    /** Memory budget of the cache, in bytes. */
+    uint64_t budget;
+};
+
+/** Identifies one signal (satellite and observation index) to read. */
+struct srnx_obs_request
+{
+    /** Name of the satellite. */
+    struct srnx_satellite_name name;
+
+    /** Index of the observation code, as for srnx_open_obs_by_index(). */
+    int obs_idx;
+};
+
+/** Most terms in one srnx_get_combination() call. */
+#define SRNX_COMBO_MAX 8
+
+/** Describes one term of a linear combination of signals. */
+struct srnx_combo_term
+{
+    /** Name of the satellite. */
+    struct srnx_satellite_name name;
+
+    /** Index of the observation code, as for srnx_open_obs_by_index(). */
+    int obs_idx;
+
+    /** Coefficient of the term. */
+    double coeff;
+
+    /** Wavelength to scale the observation by, such as to convert
+     * phase in cycles to meters; zero means no scaling.
+     */
+    double wavelength;
+};
+
+/** Deallocates an output array allocated by the library.
  *
- * \param[in] ptr Pointer to dyanmically allocated object.
+ * \param[in] ptr Pointer to dyanmically allocated array; may be NULL.
  */
 void srnx_free(void *ptr);
 
@@ -91,6 +254,106 @@ int srnx_error_line(const struct srnx_reader *srnx);
  */
 int srnx_open(struct srnx_reader **p_srnx, const char filename[]);
 
+/** Opens a new SRNX reader that reads the file with pread() instead of
+ * memory-mapping it.
+ *
+ * The reader reserves (but does not commit) address space for the whole
+ * file and copies chunks into it as they are first used, so it behaves
+ * exactly like a reader from srnx_open().  This suits filesystems where
+ * page faults on a mapping are slow, such as network filesystems.
+ * If the file aligns its satellite chunk groups, the reader switches
+ * to direct I/O (O_DIRECT) where the filesystem supports it, and reads
+ * whole aligned groups instead of larger fixed-size blocks.
+ * Errors reading the file after it is opened are reported as
+ * \a SRNX_IO_ERROR, with errno describing the cause, and a later call
+ * that needs the same data tries to read it again.
+ * Reads are synchronous and happen in the calling thread.  Threads
+ * sharing the reader never read the same block twice: one that needs a
+ * block another thread is reading waits for it, while threads needing
+ * different blocks read in parallel (except with direct I/O, where
+ * reads are one at a time).
+ *
+ * \param[in,out] p_srnx Pointer to SRNX reader object, as for srnx_open().
+ * \param[in] filename Name of SRNX file on a local filesystem.
+ * \returns Zero on success, non-zero SRNX error number on error.
+ */
+int srnx_open_pread(struct srnx_reader **p_srnx, const char filename[]);
+
+/** Opens a new SRNX reader that leaves reading the file to the caller.
+ *
+ * This is the pread backend without the pread() calls, for callers that
+ * schedule their own I/O (for example, through io_uring).  Whenever a
+ * function needs file data that has not been read yet, it fails with
+ * \a SRNX_WOULD_BLOCK.  The caller then gets the missing range from
+ * srnx_pending_read(), reads it into the buffer given there, reports it
+ * with srnx_complete_read(), and calls the function again with the same
+ * arguments.  This function itself usually returns \a SRNX_WOULD_BLOCK;
+ * after completing each read, call srnx_continue_open() until it
+ * returns zero.  A reader in this mode should be used by one thread at
+ * a time.
+ *
+ * \param[in,out] p_srnx Pointer to SRNX reader object, as for srnx_open().
+ *   On \a SRNX_WOULD_BLOCK, \a *p_srnx is only usable by
+ *   srnx_pending_read(), srnx_complete_read(), srnx_continue_open() and
+ *   srnx_close().
+ * \param[in] filename Name of SRNX file on a local filesystem.
+ * \returns Zero on success, \a SRNX_WOULD_BLOCK if data must be read
+ *   first, else another non-zero SRNX error number.
+ */
+int srnx_open_async(struct srnx_reader **p_srnx, const char filename[]);
+
+/** Continues opening a reader from srnx_open_async().
+ *
+ * \param[in] srnx SRNX reader object.
+ * \returns Zero once the reader is open, \a SRNX_WOULD_BLOCK if more
+ *   data must be read first, else another non-zero SRNX error number.
+ */
+int srnx_continue_open(struct srnx_reader *srnx);
+
+/** Describes the read a reader from srnx_open_async() is waiting for.
+ *
+ * \param[in] srnx SRNX reader object.
+ * \param[out] p_fd Receives the file descriptor to read from.
+ * \param[out] p_buf Receives where to store the data.
+ * \param[out] p_offset Receives the file offset to read from.
+ * \param[out] p_len Receives the number of bytes to read.  If the
+ *   reader uses direct I/O (see srnx_open_pread()), this is a multiple
+ *   of the page size and may extend past the end of the file, and
+ *   \a *p_fd has O_DIRECT set.
+ * \returns Zero on success, or \a SRNX_BAD_STATE if no read is
+ *   pending.
+ */
+int srnx_pending_read(
+    const struct srnx_reader *srnx,
+    int *p_fd,
+    void **p_buf,
+    uint64_t *p_offset,
+    size_t *p_len
+);
+
+/** Tells a reader from srnx_open_async() that a read has finished.
+ *
+ * A short read is allowed; the unread part is requested again when
+ * the caller retries.
+ *
+ * \param[in] srnx SRNX reader object.
+ * \param[in] offset File offset the read started at, as given by
+ *   srnx_pending_read().
+ * \param[in] len Number of bytes that were read.
+ * \returns Zero on success, non-zero SRNX error number on error.
+ */
+int srnx_complete_read(
+    struct srnx_reader *srnx,
+    uint64_t offset,
+    size_t len
+);
+
+/** Closes a SRNX reader and releases its resources.
+ *
+ * \param[in] srnx SRNX reader object to close; may be NULL.
+ */
+void srnx_close(struct srnx_reader *srnx);
+
 /** Loads the RINEX header from a SRNX file.
  *
  * \param[in] srnx SRNX reader object.
@@ -117,12 +380,107 @@ int srnx_get_epochs(
     size_t *p_epochs_len
 );
 
+/** Converts a RINEX epoch to nanoseconds since the start of GPS time,
+ * as in srnx_epoch_span.
+ */
+int64_t srnx_epoch_to_gps_ns(const struct rinex_epoch *epoch);
+
+/** Loads the epoch times from a SRNX file without expanding them.
+ *
+ * This keeps the file's epoch spans, so the index is much smaller than
+ * the array from srnx_get_epochs() and can map between epoch indices
+ * and times without visiting each epoch.  It does not hold epoch flags
+ * or receiver clock offsets.
+ *
+ * \param[in] srnx SRNX reader object.
+ * \param[in,out] p_index Receives the epoch index.  If not NULL on
+ *   entry, the old index is reused.
+ * \returns Zero on success, non-zero SRNX error number on error.
+ */
+int srnx_get_epoch_index(
+    struct srnx_reader *srnx,
+    struct srnx_epoch_index **p_index
+);
+
+/** Releases an epoch index.
+ *
+ * \param[in] index Epoch index to free; may be NULL.
+ */
+void srnx_free_epoch_index(
+    struct srnx_epoch_index *index
+);
+
+/** Returns the number of epochs in \a index. */
+uint64_t srnx_epoch_index_count(
+    const struct srnx_epoch_index *index
+);
+
+/** Returns the spans in \a index.
+ *
+ * \param[in] index Epoch index.
+ * \param[out] p_spans_len Receives the number of spans.
+ * \returns A pointer to the spans, valid until \a index is reused or
+ *   freed.
+ */
+const struct srnx_epoch_span *srnx_epoch_index_spans(
+    const struct srnx_epoch_index *index,
+    size_t *p_spans_len
+);
+
+/** Returns the time of one epoch.
+ *
+ * This takes constant time for files whose spans are not unusually
+ * uneven in length.
+ *
+ * \param[in] index Epoch index.
+ * \param[in] epoch Index of the epoch.
+ * \returns The epoch's time in nanoseconds, as in srnx_epoch_span, or
+ *   INT64_MIN if \a epoch is out of range.
+ */
+int64_t srnx_epoch_index_time(
+    const struct srnx_epoch_index *index,
+    uint64_t epoch
+);
+
+/** Finds the first epoch at or after a time.
+ *
+ * This takes O(log n) time for n spans.  It assumes epoch times
+ * increase through the file.
+ *
+ * \param[in] index Epoch index.
+ * \param[in] time_ns Time to search for, as in srnx_epoch_span.
+ * \returns Index of the first epoch whose time is at least \a time_ns,
+ *   or srnx_epoch_index_count(\a index) if there is no such epoch.
+ */
+uint64_t srnx_epoch_index_find(
+    const struct srnx_epoch_index *index,
+    int64_t time_ns
+);
+
+/** Writes the times of a range of epochs.
+ *
+ * \param[in] index Epoch index.
+ * \param[in] first Index of the first epoch to write.
+ * \param[in] count Number of epochs to write.
+ * \param[out] time_ns Receives \a count times, as in srnx_epoch_span.
+ * \returns Zero on success, or \a SRNX_END_OF_DATA if the range extends
+ *   past the last epoch.
+ */
+int srnx_epoch_index_times(
+    const struct srnx_epoch_index *index,
+    uint64_t first,
+    uint64_t count,
+    int64_t time_ns[]
+);
+
 /* Loads the next special event from a SRNX file.
  *
  * \param[in] srnx SRNX reader object.
  * \param[in,out] p_event Receives pointer to special event text.
  *   Must be initialized to \a NULL to (re-)start iteration over events.
- * \param[out] event_len Number of bytes valid at \a *p_event.
+ * \param[in,out] event_len Receives the number of bytes valid at
+ *   \a *p_event.  When \a *p_event is not NULL, this must hold the
+ *   length from the previous call.
  * \param[out] epoch_event Receives index of "before epoch" counter.
  * \returns Zero on success, non-zero SRNX error number on error.
  */
@@ -182,6 +540,10 @@ int srnx_get_obs_by_name(
  * array having length \a idx_len, which become jagged matrices with
  * column \a ii having length \a n_values[ii].
  *
+ * Signals in the decoded-observation cache are copied from it first.
+ * When more than one of the rest must be decoded, this calls
+ * srnx_prefetch_obs() for all of them before decoding any of them.
+ *
  * \param[in] srnx SRNX reader object.
  * \param[in] name Name of the satellite to load.
  * \param[in] idx_len Number of observation codes to load.
@@ -209,6 +571,120 @@ int srnx_get_obs_by_index(
     char **p_ssi
 );
 
+/** Evaluates a linear combination of signals, such as an
+ * ionosphere-free or wide-lane combination, without storing the
+ * signals themselves.
+ *
+ * The signals are decoded together, a block at a time, and each block
+ * is combined while it is still in cache.  The result has a value for
+ * each epoch where every term's satellite was observed, in epoch
+ * order.  Value \a ii is the sum over terms of coeff * wavelength *
+ * the term's observation at that epoch, in the units of the RINEX
+ * file (not times 1000).  If any term's observation at an epoch is
+ * zero (blank in RINEX), that epoch's value is NaN.
+ *
+ * \param[in] srnx SRNX reader object.
+ * \param[in] n_terms Number of elements in \a term, from 1 through
+ *   #SRNX_COMBO_MAX.
+ * \param[in] term Signals and coefficients to combine.
+ * \param[in] n_epochs Number of epochs in the file.
+ * \param[in,out] p_bitmap If not NULL, receives a bitmap of the epochs
+ *   that have values, as for srnx_get_sat_presence().
+ * \param[in,out] p_value Receives a pointer to the combined values.
+ * \param[out] p_n_values Receives the number of values at \a *p_value.
+ * \returns Zero on success, \a SRNX_UNKNOWN_CODE if a term's signal is
+ *   not in the file, \a SRNX_CORRUPT if a signal does not have one
+ *   observation per epoch of its satellite, or another non-zero SRNX
+ *   error number on error.
+ */
+int srnx_get_combination(
+    struct srnx_reader *srnx,
+    int n_terms,
+    const struct srnx_combo_term term[],
+    uint64_t n_epochs,
+    uint64_t **p_bitmap,
+    double **p_value,
+    uint64_t *p_n_values
+);
+
+/** Retrieves the observation codes for a satellite system.
+ *
+ * \param[in] srnx SRNX reader object.
+ * \param[in] system Satellite system letter, such as 'G'.
+ * \param[out] p_code Receives a pointer to the observation codes,
+ *   which remains valid until \a srnx is closed.
+ * \param[out] p_codes_len Receives the number of codes at \a *p_code.
+ * \returns Zero on success, non-zero SRNX error number on error.
+ */
+int srnx_get_obs_codes(
+    struct srnx_reader *srnx,
+    char system,
+    const struct srnx_obs_code **p_code,
+    int *p_codes_len
+);
+
+/** Locates a satellite's observations by index without preparing to
+ * decode them.
+ *
+ * \param[in] srnx SRNX reader object.
+ * \param[in] name Name of the satellite.
+ * \param[in] obs_idx Index of the observation code.
+ * \param[out] p_n_values Receives the number of observation values.
+ * \param[out] p_socd_offset Receives the file offset of the SOCD chunk.
+ * \returns Zero on success, \a SRNX_UNKNOWN_CODE if the satellite has
+ *   no such observations, or another non-zero SRNX error number.
+ */
+int srnx_get_obs_info(
+    struct srnx_reader *srnx,
+    struct srnx_satellite_name name,
+    int obs_idx,
+    uint64_t *p_n_values,
+    uint64_t *p_socd_offset
+);
+
+/** Reads the epochs at which a satellite was observed.
+ *
+ * \param[in] srnx SRNX reader object.
+ * \param[in] name Satellite name.
+ * \param[in] n_epochs Number of epochs in the file.
+ * \param[in,out] p_bitmap Receives a bitmap with one bit per epoch: bit
+ *   \a (ii % 64) of word \a (ii / 64) is set if the satellite was
+ *   present at epoch \a ii.
+ * \param[out] p_n_present If not NULL, receives the number of epochs
+ *   at which the satellite was present.
+ * \returns Zero on success, non-zero SRNX error number on error.
+ */
+int srnx_get_sat_presence(
+    struct srnx_reader *srnx,
+    struct srnx_satellite_name name,
+    uint64_t n_epochs,
+    uint64_t **p_bitmap,
+    uint64_t *p_n_present
+);
+
+/** Asks the operating system to start reading the SOCD chunks for a
+ * set of signals.
+ *
+ * This resolves the file range of each requested signal, merges ranges
+ * that are adjacent at page granularity, and issues the readahead
+ * requests in file order, so that decoding the signals afterwards does
+ * not wait on one page fault at a time.  Requests for signals that are
+ * not present in the file are ignored.  For a reader opened with
+ * srnx_open_pread(), this also reads the ranges into memory, one
+ * pread() at a time; the readahead advice only overlaps those reads
+ * with the kernel's fetching of later ranges.
+ *
+ * \param[in] srnx SRNX reader object.
+ * \param[in] n_requests Number of elements in \a request.
+ * \param[in] request Signals that will be read.
+ * \returns Zero on success, non-zero SRNX error number on error.
+ */
+int srnx_prefetch_obs(
+    struct srnx_reader *srnx,
+    int n_requests,
+    const struct srnx_obs_request request[]
+);
+
 /** Prepares to read from a satellite's observations by name.
  *
  * \param[in] srnx SRNX reader object.
@@ -226,6 +702,9 @@ int srnx_open_obs_by_name(
 );
 
 /** Prepares to read from a satellite's observations by index.
+ *
+ * If the signal is predicted from another of the satellite's signals,
+ * this also opens the reference signal, and \a *p_rdr decodes both.
  *
  * \param[in] srnx SRNX reader object.
  * \param[in] name Name of the satellite to read from.
@@ -256,6 +735,137 @@ int srnx_read_obs_ssi_lli(
     char **p_ssi
 );
 
+/** Reads the run-length encoded LLIs from an observation reader
+ * without expanding them.
+ *
+ * The run counts add up to the number of observations; a final run of
+ * blank indicators is added if the file does not encode all of them.
+ *
+ * \param[in] p_socd Pointer to satellite-observation reader object.
+ * \param[in,out] p_runs Receives pointer to indicator runs.
+ * \param[out] p_runs_len Receives number of runs at \a *p_runs.
+ * \returns Zero on success, non-zero SRNX error number on error.
+ */
+int srnx_read_obs_lli_runs(
+    struct srnx_obs_reader *p_socd,
+    struct srnx_indicator_run **p_runs,
+    size_t *p_runs_len
+);
+
+/** Reads the run-length encoded SSIs from an observation reader
+ * without expanding them.  See srnx_read_obs_lli_runs().
+ *
+ * \param[in] p_socd Pointer to satellite-observation reader object.
+ * \param[in,out] p_runs Receives pointer to indicator runs.
+ * \param[out] p_runs_len Receives number of runs at \a *p_runs.
+ * \returns Zero on success, non-zero SRNX error number on error.
+ */
+int srnx_read_obs_ssi_runs(
+    struct srnx_obs_reader *p_socd,
+    struct srnx_indicator_run **p_runs,
+    size_t *p_runs_len
+);
+
+/** Reads packed indicator flags from an observation reader.
+ *
+ * Each bitmap has one bit per observation: bit \a (ii % 64) of word
+ * \a (ii / 64) is for observation \a ii.  The bitmaps are filled run
+ * by run, so the LLIs and SSIs are never expanded to characters.
+ *
+ * \param[in] p_socd Pointer to satellite-observation reader object.
+ * \param[in] ssi_min Minimum signal strength (1 through 9) to flag.
+ * \param[in,out] p_slip If not NULL, receives a bitmap of observations
+ *   with LLI bit 0 (loss of lock, possible cycle slip) set.
+ * \param[in,out] p_half_cycle If not NULL, receives a bitmap of
+ *   observations with LLI bit 1 (half-cycle ambiguity) set.
+ * \param[in,out] p_strong If not NULL, receives a bitmap of
+ *   observations with SSI of at least \a ssi_min.
+ * \returns Zero on success, non-zero SRNX error number on error.
+ */
+int srnx_read_obs_flags(
+    struct srnx_obs_reader *p_socd,
+    int ssi_min,
+    uint64_t **p_slip,
+    uint64_t **p_half_cycle,
+    uint64_t **p_strong
+);
+
+/** Reads the whole-signal summary from an observation reader's zone map.
+ *
+ * \param[in] p_socd Pointer to satellite-observation reader object.
+ * \param[out] p_zone Receives the summary for the signal.
+ * \returns Zero on success, \a SRNX_NO_CHUNK if the signal has no zone
+ *   map, or another non-zero SRNX error number on error.
+ */
+int srnx_get_obs_summary(
+    struct srnx_obs_reader *p_socd,
+    struct srnx_obs_zone *p_zone
+);
+
+/** Reads the per-zone statistics from an observation reader's zone map.
+ *
+ * \param[in] p_socd Pointer to satellite-observation reader object.
+ * \param[in,out] p_zones Receives pointer to zone statistics.
+ * \param[out] p_zones_len Receives number of zones at \a *p_zones.
+ * \returns Zero on success, \a SRNX_NO_CHUNK if the signal has no zone
+ *   map, or another non-zero SRNX error number on error.
+ */
+int srnx_get_obs_zones(
+    struct srnx_obs_reader *p_socd,
+    struct srnx_obs_zone **p_zones,
+    size_t *p_zones_len
+);
+
+/** Repositions an observation reader to the start of a zone, so that
+ * the next srnx_read_obs_value() returns the zone's first observation.
+ *
+ * \param[in] p_socd Pointer to satellite-observation reader object.
+ * \param[in] zone_idx Index of the zone to seek to.
+ * \returns Zero on success, \a SRNX_NO_CHUNK if the signal has no zone
+ *   map, \a SRNX_END_OF_DATA if \a zone_idx is past the last zone, or
+ *   another non-zero SRNX error number on error.
+ */
+int srnx_seek_obs_zone(
+    struct srnx_obs_reader *p_socd,
+    uint64_t zone_idx
+);
+
+/** Checks whether any observation summarized by \a p_zone might
+ * satisfy \a p_pred.
+ *
+ * \param[in] p_zone Zone or signal summary to check.
+ * \param[in] p_pred Predicate to evaluate.
+ * \returns Non-zero if the zone may hold matching observations, zero
+ *   if it cannot.
+ */
+int srnx_obs_zone_may_match(
+    const struct srnx_obs_zone *p_zone,
+    const struct srnx_obs_predicate *p_pred
+);
+
+/** Positions an observation reader at the next zone that may satisfy
+ * a predicate, skipping zones (or the whole signal) that cannot.
+ *
+ * Typical use starts with \a *p_zone_idx set to zero, decodes the
+ * zone's observations after each successful call, and then increments
+ * \a *p_zone_idx before calling this again.
+ *
+ * \param[in] p_socd Pointer to satellite-observation reader object.
+ * \param[in] p_pred Predicate to evaluate.
+ * \param[in,out] p_zone_idx On input, the first zone to consider.  On
+ *   success, receives the index of the zone the reader is positioned at.
+ * \param[out] p_zone If not NULL, receives that zone's statistics.
+ * \returns Zero on success, \a SRNX_END_OF_DATA if no remaining zone
+ *   may match, \a SRNX_NO_CHUNK if the signal has no zone map (so the
+ *   caller must decode all of it), or another non-zero SRNX error number.
+ */
+int srnx_next_matching_zone(
+    struct srnx_obs_reader *p_socd,
+    const struct srnx_obs_predicate *p_pred,
+    uint64_t *p_zone_idx,
+    struct srnx_obs_zone *p_zone
+);
+
 /** Reads the next observation from an observation reader.
  *
  * \param[in] p_socd Pointer to observation-reader object.
@@ -269,7 +879,11 @@ int srnx_read_obs_value(
 
 /** Unallocates resources used by \a p_socd.
  *
- * \param[in] p_socd Pointer to observation-reader object to free.
+ * A few freed readers are kept for reuse by the calling thread, so
+ * opening and freeing many small signals does not stress the heap.
+ *
+ * \param[in] p_socd Pointer to observation-reader object to free; may
+ *   be NULL.
  */
 void srnx_free_obs_reader(
     struct srnx_obs_reader *p_socd
@@ -295,4 +909,34 @@ void srnx_convert_s64_to_double(
     int scale
 );
 
+/** Sets the memory budget of the decoded-observation cache.
+ *
+ * The cache is shared by all readers in the process.  When enabled,
+ * srnx_get_obs_by_index() (and thus srnx_get_obs_by_name()) looks up
+ * each signal by file identity (device, inode, size and modification
+ * time), satellite and observation code before decoding it, and adds
+ * signals it decodes.  When the cache is over budget, it evicts the
+ * signals that were least recently used and quickest to decode per
+ * byte.  The cache is disabled by default.
+ *
+ * \param[in] bytes Maximum memory for cached signals; zero disables the
+ *   cache and releases its contents.
+ */
+void srnx_cache_set_budget(size_t bytes);
+
+/** Removes all signals from the decoded-observation cache.
+ * They are counted as evictions.
+ */
+void srnx_cache_clear(void);
+
+/** Reads the decoded-observation cache counters.
+ *
+ * \param[out] stats Receives the current counters.
+ */
+void srnx_cache_get_stats(struct srnx_cache_stats *stats);
+
+#if defined(__cplusplus)
+}
+#endif /* defined(__cplusplus) */
+
 #endif /* !defined(SRNX_H_a2b6e4a7_3fda_4ba2_8ed1_67b906d55b2c) */
@@ -0,0 +1,712 @@
+/** srnx.hpp - C++17 interface to the Succinct RINEX reader.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(SRNX_HPP_7d3e91c2_4f08_4a6b_9e15_c0a8b2d64f73)
+#define SRNX_HPP_7d3e91c2_4f08_4a6b_9e15_c0a8b2d64f73
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "srnx.h"
+
+/* This is a header-only layer over the C API in srnx.h.  It adds no
+ * state beyond the C objects it owns: handles free their C object when
+ * destroyed, output arrays are reused between calls exactly as the C
+ * API reuses them, and views convert values as they are read instead
+ * of copying them.  Errors are reported by throwing srnx::error.
+ */
+
+namespace srnx
+{
+
+/** error is thrown when a C API call fails. */
+class error : public std::runtime_error
+{
+public:
+    /** Creates an error for SRNX error number \a code, which was
+     * detected at source line \a line of the library.
+     */
+    explicit error(int code, int line = 0)
+        : std::runtime_error(srnx_strerror(code)), code_(code), line_(line)
+    {
+    }
+
+    /** Returns the SRNX (or errno) error number. */
+    int code() const noexcept { return code_; }
+
+    /** Returns the library source line that reported the error. */
+    int line() const noexcept { return line_; }
+
+private:
+    int code_;
+    int line_;
+};
+
+/** span is a non-owning view of contiguous elements.
+ *
+ * This is a subset of C++20's std::span, for C++17 callers.
+ */
+template <typename T>
+class span
+{
+public:
+    using element_type = T;
+    using value_type = std::remove_cv_t<T>;
+    using iterator = T *;
+
+    constexpr span() noexcept : data_(nullptr), size_(0) { }
+    constexpr span(T *data, std::size_t size) noexcept
+        : data_(data), size_(size) { }
+
+    constexpr T *data() const noexcept { return data_; }
+    constexpr std::size_t size() const noexcept { return size_; }
+    constexpr bool empty() const noexcept { return size_ == 0; }
+    constexpr T &operator[](std::size_t idx) const { return data_[idx]; }
+    constexpr T *begin() const noexcept { return data_; }
+    constexpr T *end() const noexcept { return data_ + size_; }
+
+    /** Returns the \a count elements starting at \a offset. */
+    constexpr span subspan(std::size_t offset, std::size_t count) const
+    {
+        return span(data_ + offset, count);
+    }
+
+private:
+    T *data_;
+    std::size_t size_;
+};
+
+/** buffer owns an output array allocated by the library.
+ *
+ * Passing out() to a C function lets the library reuse the array, as
+ * described at the top of srnx.h.
+ */
+template <typename T>
+class buffer
+{
+public:
+    buffer() noexcept : ptr_(nullptr) { }
+    buffer(buffer &&other) noexcept : ptr_(other.ptr_) { other.ptr_ = nullptr; }
+    buffer(const buffer &) = delete;
+    ~buffer() { srnx_free(ptr_); }
+
+    buffer &operator=(buffer &&other) noexcept
+    {
+        std::swap(ptr_, other.ptr_);
+        return *this;
+    }
+    buffer &operator=(const buffer &) = delete;
+
+    /** Returns the array, which may be null. */
+    T *get() const noexcept { return ptr_; }
+
+    /** Returns the address to pass as a C output array. */
+    T **out() noexcept { return &ptr_; }
+
+private:
+    T *ptr_;
+};
+
+/** Converts a stored observation value (the RINEX value times 1000)
+ * to \a T.  Integer types get the stored value; floating-point types
+ * get the RINEX value.
+ */
+template <typename T>
+constexpr T scale_obs(std::int64_t value) noexcept
+{
+    static_assert(std::is_arithmetic_v<T>, "observations are numbers");
+    if constexpr (std::is_floating_point_v<T>)
+    {
+        return static_cast<T>(value) * static_cast<T>(0.001);
+    }
+    else
+    {
+        return static_cast<T>(value);
+    }
+}
+
+/** column_view presents stored observation values as type \a T.
+ *
+ * The conversion is selected at compile time and done as each element
+ * is read, so a loop over a column_view compiles to the same loop as
+ * one written directly over the int64_t array.
+ */
+template <typename T>
+class column_view
+{
+public:
+    /** Random-access iterator over converted values. */
+    class iterator
+    {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = T;
+
+        constexpr iterator() noexcept : ptr_(nullptr) { }
+        constexpr explicit iterator(const std::int64_t *ptr) noexcept
+            : ptr_(ptr) { }
+
+        constexpr T operator*() const noexcept { return scale_obs<T>(*ptr_); }
+        constexpr T operator[](difference_type n) const noexcept
+        {
+            return scale_obs<T>(ptr_[n]);
+        }
+        constexpr iterator &operator++() noexcept { ++ptr_; return *this; }
+        constexpr iterator operator++(int) noexcept { return iterator(ptr_++); }
+        constexpr iterator &operator--() noexcept { --ptr_; return *this; }
+        constexpr iterator operator--(int) noexcept { return iterator(ptr_--); }
+        constexpr iterator &operator+=(difference_type n) noexcept
+        {
+            ptr_ += n;
+            return *this;
+        }
+        constexpr iterator &operator-=(difference_type n) noexcept
+        {
+            ptr_ -= n;
+            return *this;
+        }
+        constexpr iterator operator+(difference_type n) const noexcept
+        {
+            return iterator(ptr_ + n);
+        }
+        constexpr iterator operator-(difference_type n) const noexcept
+        {
+            return iterator(ptr_ - n);
+        }
+        constexpr difference_type operator-(iterator other) const noexcept
+        {
+            return ptr_ - other.ptr_;
+        }
+        constexpr bool operator==(iterator other) const noexcept
+        {
+            return ptr_ == other.ptr_;
+        }
+        constexpr bool operator!=(iterator other) const noexcept
+        {
+            return ptr_ != other.ptr_;
+        }
+        constexpr bool operator<(iterator other) const noexcept
+        {
+            return ptr_ < other.ptr_;
+        }
+
+    private:
+        const std::int64_t *ptr_;
+    };
+
+    constexpr column_view() noexcept { }
+    constexpr explicit column_view(span<const std::int64_t> raw) noexcept
+        : raw_(raw) { }
+
+    constexpr std::size_t size() const noexcept { return raw_.size(); }
+    constexpr bool empty() const noexcept { return raw_.empty(); }
+    constexpr T operator[](std::size_t idx) const noexcept
+    {
+        return scale_obs<T>(raw_[idx]);
+    }
+    constexpr iterator begin() const noexcept { return iterator(raw_.begin()); }
+    constexpr iterator end() const noexcept { return iterator(raw_.end()); }
+
+    /** Returns the stored values. */
+    constexpr span<const std::int64_t> raw() const noexcept { return raw_; }
+
+private:
+    span<const std::int64_t> raw_;
+};
+
+/** column holds one decoded signal: the observation values and their
+ * loss-of-lock and signal strength indicators.
+ *
+ * A column may be passed to reader::read() repeatedly; its arrays are
+ * reused when they are large enough.
+ */
+class column
+{
+public:
+    /** Returns the number of observations. */
+    std::size_t size() const noexcept { return n_values_; }
+
+    /** Returns the stored values (RINEX values times 1000). */
+    span<const std::int64_t> values() const noexcept
+    {
+        return span<const std::int64_t>(obs_.get(), n_values_);
+    }
+
+    /** Returns the values converted to \a T; see scale_obs(). */
+    template <typename T>
+    column_view<T> as() const noexcept
+    {
+        return column_view<T>(values());
+    }
+
+    /** Returns the loss-of-lock indicators, as ASCII characters. */
+    span<const char> lli() const noexcept
+    {
+        return span<const char>(lli_.get(), n_values_);
+    }
+
+    /** Returns the signal strength indicators, as ASCII characters. */
+    span<const char> ssi() const noexcept
+    {
+        return span<const char>(ssi_.get(), n_values_);
+    }
+
+private:
+    friend class reader;
+
+    buffer<std::int64_t> obs_;
+    buffer<char> lli_;
+    buffer<char> ssi_;
+    std::size_t n_values_ = 0;
+};
+
+/** Makes a satellite name from text such as "G01". */
+inline srnx_satellite_name satellite(std::string_view text) noexcept
+{
+    srnx_satellite_name name = {};
+    for (std::size_t ii = 0; ii < 3 && ii < text.size(); ++ii)
+    {
+        name.name[ii] = text[ii];
+    }
+    return name;
+}
+
+/** Makes an observation code from text such as "C1C". */
+inline srnx_obs_code obs_code(std::string_view text) noexcept
+{
+    srnx_obs_code code = {};
+    for (std::size_t ii = 0; ii < 3 && ii < text.size(); ++ii)
+    {
+        code.name[ii] = text[ii];
+    }
+    return code;
+}
+
+/** obs_reader streams the values of one signal. */
+class obs_reader
+{
+public:
+    /** Input iterator over the remaining values, as \a T. */
+    template <typename T>
+    class iterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T *;
+        using reference = const T &;
+
+        iterator() noexcept : rdr_(nullptr), value_() { }
+        explicit iterator(srnx_obs_reader *rdr) : rdr_(rdr), value_()
+        {
+            next();
+        }
+
+        const T &operator*() const noexcept { return value_; }
+        iterator &operator++() { next(); return *this; }
+        bool operator==(const iterator &other) const noexcept
+        {
+            return rdr_ == other.rdr_;
+        }
+        bool operator!=(const iterator &other) const noexcept
+        {
+            return rdr_ != other.rdr_;
+        }
+
+    private:
+        void next()
+        {
+            std::int64_t raw;
+            int res = srnx_read_obs_value(rdr_, &raw);
+            if (res == SRNX_END_OF_DATA)
+            {
+                rdr_ = nullptr;
+                return;
+            }
+            if (res)
+            {
+                throw error(res);
+            }
+            value_ = scale_obs<T>(raw);
+        }
+
+        srnx_obs_reader *rdr_;
+        T value_;
+    };
+
+    /** Range adapter returned by values(). */
+    template <typename T>
+    struct range
+    {
+        srnx_obs_reader *rdr;
+        iterator<T> begin() const { return iterator<T>(rdr); }
+        iterator<T> end() const noexcept { return iterator<T>(); }
+    };
+
+    obs_reader() noexcept : rdr_(nullptr) { }
+    explicit obs_reader(srnx_obs_reader *rdr) noexcept : rdr_(rdr) { }
+    obs_reader(obs_reader &&other) noexcept : rdr_(other.rdr_)
+    {
+        other.rdr_ = nullptr;
+    }
+    obs_reader(const obs_reader &) = delete;
+    ~obs_reader() { srnx_free_obs_reader(rdr_); }
+
+    obs_reader &operator=(obs_reader &&other) noexcept
+    {
+        std::swap(rdr_, other.rdr_);
+        return *this;
+    }
+    obs_reader &operator=(const obs_reader &) = delete;
+
+    /** Returns the C reader. */
+    srnx_obs_reader *get() const noexcept { return rdr_; }
+
+    /** Returns a single-pass range over the remaining values. */
+    template <typename T = std::int64_t>
+    range<T> values() const noexcept
+    {
+        return range<T>{rdr_};
+    }
+
+private:
+    srnx_obs_reader *rdr_;
+};
+
+/** epoch_index holds a file's epoch times; see srnx_get_epoch_index().
+ *
+ * It is a random-access range of epoch times in nanoseconds.
+ */
+class epoch_index
+{
+public:
+    /** Iterator over epoch times.  Stepping within a span is O(1). */
+    class iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::int64_t;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const std::int64_t *;
+        using reference = std::int64_t;
+
+        iterator() noexcept
+            : span_(nullptr), last_(nullptr), left_(0), time_(0), idx_(0)
+        {
+        }
+        iterator(span<const srnx_epoch_span> spans, std::uint64_t idx) noexcept
+            : span_(spans.begin()), last_(spans.end()), left_(0), time_(0),
+            idx_(idx)
+        {
+            if (span_ != last_)
+            {
+                left_ = span_->count;
+                time_ = span_->start_ns;
+            }
+        }
+
+        std::int64_t operator*() const noexcept { return time_; }
+        iterator &operator++() noexcept
+        {
+            ++idx_;
+            if (--left_ > 0)
+            {
+                time_ += span_->step_ns;
+            }
+            else if (++span_ != last_)
+            {
+                left_ = span_->count;
+                time_ = span_->start_ns;
+            }
+            return *this;
+        }
+        iterator operator++(int) noexcept
+        {
+            iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        /** Returns the index of the current epoch. */
+        std::uint64_t index() const noexcept { return idx_; }
+
+        bool operator==(const iterator &other) const noexcept
+        {
+            return idx_ == other.idx_;
+        }
+        bool operator!=(const iterator &other) const noexcept
+        {
+            return idx_ != other.idx_;
+        }
+
+    private:
+        const srnx_epoch_span *span_;
+        const srnx_epoch_span *last_;
+        std::uint64_t left_;
+        std::int64_t time_;
+        std::uint64_t idx_;
+    };
+
+    epoch_index() noexcept : idx_(nullptr) { }
+    epoch_index(epoch_index &&other) noexcept : idx_(other.idx_)
+    {
+        other.idx_ = nullptr;
+    }
+    epoch_index(const epoch_index &) = delete;
+    ~epoch_index() { srnx_free_epoch_index(idx_); }
+
+    epoch_index &operator=(epoch_index &&other) noexcept
+    {
+        std::swap(idx_, other.idx_);
+        return *this;
+    }
+    epoch_index &operator=(const epoch_index &) = delete;
+
+    /** Returns the C index. */
+    const srnx_epoch_index *get() const noexcept { return idx_; }
+
+    /** Returns the number of epochs. */
+    std::uint64_t size() const noexcept
+    {
+        return idx_ ? srnx_epoch_index_count(idx_) : 0;
+    }
+
+    /** Returns the time of epoch \a epoch; throws if it is out of range. */
+    std::int64_t operator[](std::uint64_t epoch) const
+    {
+        std::int64_t t = idx_ ? srnx_epoch_index_time(idx_, epoch) : INT64_MIN;
+        if (t == INT64_MIN)
+        {
+            throw error(SRNX_END_OF_DATA);
+        }
+        return t;
+    }
+
+    /** Returns the first epoch at or after \a time_ns. */
+    std::uint64_t find(std::int64_t time_ns) const noexcept
+    {
+        return idx_ ? srnx_epoch_index_find(idx_, time_ns) : 0;
+    }
+
+    /** Returns the spans of the index. */
+    span<const srnx_epoch_span> spans() const noexcept
+    {
+        std::size_t len = 0;
+        const srnx_epoch_span *ptr = idx_
+            ? srnx_epoch_index_spans(idx_, &len) : nullptr;
+        return span<const srnx_epoch_span>(ptr, len);
+    }
+
+    /** Writes the times of epochs [\a first, \a first + out.size()). */
+    void times(std::uint64_t first, span<std::int64_t> out) const
+    {
+        int res = srnx_epoch_index_times(idx_, first, out.size(), out.data());
+        if (res)
+        {
+            throw error(res);
+        }
+    }
+
+    iterator begin() const noexcept
+    {
+        return iterator(spans(), 0);
+    }
+    iterator end() const noexcept
+    {
+        return iterator(span<const srnx_epoch_span>(), size());
+    }
+
+private:
+    friend class reader;
+
+    srnx_epoch_index *idx_;
+};
+
+/** reader owns an open SRNX file. */
+class reader
+{
+public:
+    /** Selects how the file is read; see srnx_open_pread(). */
+    enum class backend { mmap, pread };
+
+    reader() noexcept : srnx_(nullptr) { }
+
+    /** Takes ownership of \a srnx, which may be null. */
+    explicit reader(srnx_reader *srnx) noexcept : srnx_(srnx) { }
+
+    /** Opens \a filename; throws on failure. */
+    explicit reader(const char *filename, backend how = backend::mmap)
+        : srnx_(nullptr)
+    {
+        open(filename, how);
+    }
+    explicit reader(const std::string &filename, backend how = backend::mmap)
+        : reader(filename.c_str(), how)
+    {
+    }
+
+    reader(reader &&other) noexcept : srnx_(other.srnx_)
+    {
+        other.srnx_ = nullptr;
+    }
+    reader(const reader &) = delete;
+    ~reader() { srnx_close(srnx_); }
+
+    reader &operator=(reader &&other) noexcept
+    {
+        std::swap(srnx_, other.srnx_);
+        return *this;
+    }
+    reader &operator=(const reader &) = delete;
+
+    /** Opens \a filename, closing any file already open. */
+    void open(const char *filename, backend how = backend::mmap)
+    {
+        check(how == backend::pread
+            ? srnx_open_pread(&srnx_, filename)
+            : srnx_open(&srnx_, filename));
+    }
+
+    /** Returns the C reader. */
+    srnx_reader *get() const noexcept { return srnx_; }
+
+    /** Returns the RINEX header text. */
+    std::string_view header()
+    {
+        const char *rhdr = nullptr;
+        std::size_t len = 0;
+        check(srnx_get_header(srnx_, &rhdr, &len));
+        return std::string_view(rhdr, len);
+    }
+
+    /** Loads the epochs into \a out, reusing its array. */
+    span<const rinex_epoch> epochs(buffer<rinex_epoch> &out)
+    {
+        std::size_t len = 0;
+        check(srnx_get_epochs(srnx_, out.out(), &len));
+        return span<const rinex_epoch>(out.get(), len);
+    }
+
+    /** Loads the epoch index into \a out, reusing its storage. */
+    void index(epoch_index &out)
+    {
+        check(try_index(out));
+    }
+
+    /** Like index(), but returns an SRNX error number instead of
+     * throwing.
+     */
+    int try_index(epoch_index &out) noexcept
+    {
+        return srnx_get_epoch_index(srnx_, &out.idx_);
+    }
+
+    /** Returns the file's epoch index. */
+    epoch_index index()
+    {
+        epoch_index out;
+        index(out);
+        return out;
+    }
+
+    /** Loads the satellite names into \a out, reusing its array. */
+    span<const srnx_satellite_name> satellites(buffer<srnx_satellite_name> &out)
+    {
+        std::uint64_t len = 0;
+        check(srnx_get_satellites(srnx_, out.out(), &len));
+        return span<const srnx_satellite_name>(out.get(), len);
+    }
+
+    /** Returns the observation codes for satellite system \a system. */
+    span<const srnx_obs_code> codes(char system)
+    {
+        const srnx_obs_code *code = nullptr;
+        int len = 0;
+        check(srnx_get_obs_codes(srnx_, system, &code, &len));
+        return span<const srnx_obs_code>(code, len);
+    }
+
+    /** Decodes observation code \a idx of satellite \a sat into \a out. */
+    void read(srnx_satellite_name sat, int idx, column &out)
+    {
+        check(try_read(sat, idx, out));
+    }
+
+    /** Like read(), but returns an SRNX error number instead of
+     * throwing.
+     */
+    int try_read(srnx_satellite_name sat, int idx, column &out) noexcept
+    {
+        int n_values = 0, res;
+        char **p_lli = out.lli_.out();
+        char **p_ssi = out.ssi_.out();
+
+        res = srnx_get_obs_by_index(srnx_, sat, 1, &idx, &n_values,
+            out.obs_.out(), p_lli, p_ssi);
+        out.n_values_ = res ? 0 : n_values;
+        return res;
+    }
+
+    /** Decodes and returns observation code \a idx of satellite \a sat. */
+    column read(srnx_satellite_name sat, int idx)
+    {
+        column out;
+        read(sat, idx, out);
+        return out;
+    }
+
+    /** Opens a streaming reader for code \a idx of satellite \a sat. */
+    obs_reader open(srnx_satellite_name sat, int idx)
+    {
+        srnx_obs_reader *rdr = nullptr;
+        check(srnx_open_obs_by_index(srnx_, sat, idx, &rdr));
+        return obs_reader(rdr);
+    }
+
+    /** Throws srnx::error if \a res is non-zero. */
+    void check(int res) const
+    {
+        if (res)
+        {
+            throw error(res, srnx_ ? srnx_error_line(srnx_) : 0);
+        }
+    }
+
+private:
+    srnx_reader *srnx_;
+};
+
+} /* namespace srnx */
+
+#endif /* !defined(SRNX_HPP_7d3e91c2_4f08_4a6b_9e15_c0a8b2d64f73) */
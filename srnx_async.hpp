@@ -0,0 +1,721 @@
+/** srnx_async.hpp - C++20 coroutine interface to the SRNX reader.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(SRNX_ASYNC_HPP_1b6f0e83_c25a_4d97_b4e0_8a3d71f5c926)
+#define SRNX_ASYNC_HPP_1b6f0e83_c25a_4d97_b4e0_8a3d71f5c926
+
+#include <atomic>
+#include <cerrno>
+#include <coroutine>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <optional>
+#include <string>
+#include <system_error>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "srnx.hpp"
+
+/* This layers coroutines over the C library so that one thread can
+ * drive many files at once.  An io_ring owns an io_uring instance and
+ * a queue of coroutines that are ready to run; io_ring::run() resumes
+ * them until every spawned task has finished.  SRNX readers opened with
+ * open_async() use srnx_open_async(), so whenever the library needs
+ * file data, the calling coroutine submits a read to the ring and is
+ * resumed when it completes.  Opening a file, fstat() and decoding
+ * still run on the calling thread.
+ *
+ * If the kernel does not support io_uring (or it is disabled), reads
+ * are done with pread() when they are submitted.  Everything still
+ * works, but I/O blocks the thread.
+ */
+
+namespace srnx
+{
+
+template <typename T = void>
+class task;
+
+/** io_op is one read submitted to an io_ring.  It must stay at the same
+ * address until #done is set.
+ */
+struct io_op
+{
+    /** Number of bytes read, or a negated errno value. */
+    std::int32_t result = 0;
+
+    /** Set when the read has completed. */
+    bool done = false;
+
+    /** Coroutine to resume when the read completes, if any. */
+    std::coroutine_handle<> waiter;
+};
+
+namespace detail
+{
+
+/** Fields and behavior shared by every task's promise. */
+struct promise_base
+{
+    /** Coroutine that is awaiting this task. */
+    std::coroutine_handle<> continuation;
+
+    /** Exception that escaped the task, if any. */
+    std::exception_ptr error;
+
+    /** Transfers control to the awaiting coroutine at the end. */
+    struct final_awaiter
+    {
+        bool await_ready() const noexcept { return false; }
+
+        template <typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+        {
+            std::coroutine_handle<> next = h.promise().continuation;
+            return next ? next : std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept { }
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    final_awaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() noexcept { error = std::current_exception(); }
+};
+
+/** Promise for task<T> with a non-void \a T. */
+template <typename T>
+struct promise : promise_base
+{
+    std::optional<T> value;
+
+    task<T> get_return_object() noexcept;
+
+    template <typename U>
+    void return_value(U &&v) { value.emplace(std::forward<U>(v)); }
+
+    T result()
+    {
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+        return std::move(*value);
+    }
+};
+
+/** Promise for task<void>. */
+template <>
+struct promise<void> : promise_base
+{
+    task<void> get_return_object() noexcept;
+
+    void return_void() const noexcept { }
+
+    void result()
+    {
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+};
+
+} /* namespace detail */
+
+/** task is a lazily started coroutine that produces a \a T.
+ *
+ * A task starts when it is awaited, and resumes its awaiter when it
+ * finishes.  To start a task that nothing awaits, use io_ring::spawn().
+ */
+template <typename T>
+class task
+{
+public:
+    using promise_type = detail::promise<T>;
+
+    task() noexcept { }
+    explicit task(std::coroutine_handle<promise_type> h) noexcept : h_(h) { }
+    task(task &&other) noexcept : h_(std::exchange(other.h_, nullptr)) { }
+    task(const task &) = delete;
+    ~task()
+    {
+        if (h_)
+        {
+            h_.destroy();
+        }
+    }
+
+    task &operator=(task &&other) noexcept
+    {
+        std::swap(h_, other.h_);
+        return *this;
+    }
+    task &operator=(const task &) = delete;
+
+    /** Awaiter that starts the task and later yields its result. */
+    struct awaiter
+    {
+        std::coroutine_handle<promise_type> h;
+
+        bool await_ready() const noexcept { return !h || h.done(); }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+        {
+            h.promise().continuation = caller;
+            return h;
+        }
+
+        T await_resume() { return h.promise().result(); }
+    };
+
+    awaiter operator co_await() && noexcept { return awaiter{h_}; }
+    awaiter operator co_await() & noexcept { return awaiter{h_}; }
+
+private:
+    std::coroutine_handle<promise_type> h_;
+};
+
+namespace detail
+{
+
+template <typename T>
+task<T> promise<T>::get_return_object() noexcept
+{
+    return task<T>(std::coroutine_handle<promise<T>>::from_promise(*this));
+}
+
+inline task<void> promise<void>::get_return_object() noexcept
+{
+    return task<void>(std::coroutine_handle<promise<void>>::from_promise(*this));
+}
+
+} /* namespace detail */
+
+/** io_ring submits reads to an io_uring and resumes the coroutines
+ * that wait for them.  It is used by one thread at a time; use one
+ * ring per thread to spread work over a few threads.
+ */
+class io_ring
+{
+public:
+    /** Creates a ring with room for \a entries reads in flight. */
+    explicit io_ring(unsigned entries = 256)
+    {
+        io_uring_params params;
+        std::size_t sq_size, cq_size;
+        char *sq, *cq;
+
+        std::memset(&params, 0, sizeof params);
+        fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd_ < 0)
+        {
+            return;
+        }
+
+        sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+        {
+            sq_size = cq_size = (sq_size > cq_size) ? sq_size : cq_size;
+        }
+        sq = static_cast<char *>(mmap(nullptr, sq_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING));
+        cq = sq;
+        if (sq != MAP_FAILED && !(params.features & IORING_FEAT_SINGLE_MMAP))
+        {
+            cq = static_cast<char *>(mmap(nullptr, cq_size,
+                PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                IORING_OFF_CQ_RING));
+        }
+        sqes_ = static_cast<io_uring_sqe *>(mmap(nullptr,
+            params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES));
+        if (sq == MAP_FAILED || cq == MAP_FAILED || sqes_ == MAP_FAILED)
+        {
+            if (sq != MAP_FAILED)
+            {
+                munmap(sq, sq_size);
+            }
+            if (cq != MAP_FAILED && cq != sq)
+            {
+                munmap(cq, cq_size);
+            }
+            if (sqes_ != MAP_FAILED)
+            {
+                munmap(sqes_, params.sq_entries * sizeof(io_uring_sqe));
+            }
+            sqes_ = nullptr;
+            close(fd_);
+            fd_ = -1;
+            return;
+        }
+
+        sq_ptr_ = sq;
+        sq_size_ = sq_size;
+        cq_ptr_ = cq;
+        cq_size_ = cq_size;
+        sq_entries_ = params.sq_entries;
+        sq_head_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    }
+
+    io_ring(const io_ring &) = delete;
+    io_ring &operator=(const io_ring &) = delete;
+
+    ~io_ring()
+    {
+        if (fd_ < 0)
+        {
+            return;
+        }
+        while (in_flight_ > 0)
+        {
+            enter(0, 1);
+        }
+        munmap(sqes_, sq_entries_ * sizeof(io_uring_sqe));
+        if (cq_ptr_ != sq_ptr_)
+        {
+            munmap(cq_ptr_, cq_size_);
+        }
+        munmap(sq_ptr_, sq_size_);
+        close(fd_);
+    }
+
+    /** Returns true if reads go through io_uring, false if they are
+     * done with pread() as they are submitted.
+     */
+    bool uses_io_uring() const noexcept { return fd_ >= 0; }
+
+    /** Starts reading \a len bytes at \a offset of \a fd into \a buf.
+     *
+     * When the read completes, \a op is updated and its waiter (if
+     * any) is queued to run.  Without io_uring, the read is done before
+     * this returns.
+     */
+    void start_read(io_op &op, int fd, void *buf, std::size_t len,
+        std::uint64_t offset)
+    {
+        op.done = false;
+        op.result = 0;
+        if (len > (1u << 30))
+        {
+            len = 1u << 30;
+        }
+
+        if (fd_ < 0)
+        {
+            ssize_t res;
+            do
+            {
+                res = pread(fd, buf, len, offset);
+            } while (res < 0 && errno == EINTR);
+            complete(op, res < 0 ? -errno : static_cast<std::int32_t>(res));
+            return;
+        }
+
+        /* Keep completions from overflowing the completion queue. */
+        while (in_flight_ + to_submit_ >= sq_entries_)
+        {
+            enter(to_submit_, 1);
+        }
+
+        unsigned tail = *sq_tail_;
+        unsigned idx = tail & sq_mask_;
+        io_uring_sqe *sqe = &sqes_[idx];
+        std::memset(sqe, 0, sizeof *sqe);
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = fd;
+        sqe->off = offset;
+        sqe->addr = reinterpret_cast<std::uintptr_t>(buf);
+        sqe->len = static_cast<std::uint32_t>(len);
+        sqe->user_data = reinterpret_cast<std::uintptr_t>(&op);
+        sq_array_[idx] = idx;
+        std::atomic_ref<unsigned>(*sq_tail_).store(tail + 1,
+            std::memory_order_release);
+        ++to_submit_;
+    }
+
+    /** Blocks until \a op completes.  Other reads that complete
+     * meanwhile have their waiters queued as usual.
+     */
+    void wait(io_op &op)
+    {
+        while (!op.done)
+        {
+            enter(to_submit_, 1);
+        }
+    }
+
+    /** Awaiter for one read; see read(). */
+    struct read_awaiter
+    {
+        io_ring &ring;
+        int fd;
+        void *buf;
+        std::size_t len;
+        std::uint64_t offset;
+        io_op op;
+
+        bool await_ready()
+        {
+            ring.start_read(op, fd, buf, len, offset);
+            return op.done;
+        }
+
+        void await_suspend(std::coroutine_handle<> h) noexcept { op.waiter = h; }
+
+        std::int32_t await_resume() const noexcept { return op.result; }
+    };
+
+    /** Reads from \a fd, suspending the caller until the read completes.
+     *
+     * \returns The number of bytes read, or a negated errno value.
+     */
+    read_awaiter read(int fd, void *buf, std::size_t len, std::uint64_t offset)
+    {
+        return read_awaiter{*this, fd, buf, len, offset, io_op()};
+    }
+
+    /** Awaiter that resumes its caller when an io_op completes. */
+    struct op_awaiter
+    {
+        io_op &op;
+
+        bool await_ready() const noexcept { return op.done; }
+        void await_suspend(std::coroutine_handle<> h) noexcept { op.waiter = h; }
+        std::int32_t await_resume() const noexcept
+        {
+            op.waiter = nullptr;
+            return op.result;
+        }
+    };
+
+    /** Suspends the caller until \a op, started by start_read(),
+     * completes.
+     */
+    op_awaiter wait_async(io_op &op) noexcept { return op_awaiter{op}; }
+
+    /** Starts \a t, which runs until it first waits for a read. */
+    void spawn(task<void> t)
+    {
+        ++live_;
+        detach(this, std::move(t));
+    }
+
+    /** Runs queued coroutines until every spawned task has finished.
+     *
+     * \throws The first exception that escaped a spawned task.
+     */
+    void run()
+    {
+        for (;;)
+        {
+            while (!ready_.empty())
+            {
+                std::coroutine_handle<> h = ready_.front();
+                ready_.pop_front();
+                h.resume();
+            }
+            if (live_ == 0 || (in_flight_ == 0 && to_submit_ == 0))
+            {
+                break;
+            }
+            enter(to_submit_, 1);
+        }
+
+        if (error_)
+        {
+            std::rethrow_exception(std::exchange(error_, nullptr));
+        }
+    }
+
+private:
+    /** Coroutine type that runs a spawned task and then frees itself. */
+    struct detached
+    {
+        struct promise_type
+        {
+            detached get_return_object() const noexcept { return {}; }
+            std::suspend_never initial_suspend() const noexcept { return {}; }
+            std::suspend_never final_suspend() const noexcept { return {}; }
+            void return_void() const noexcept { }
+            void unhandled_exception() const noexcept { std::terminate(); }
+        };
+    };
+
+    static detached detach(io_ring *ring, task<void> t)
+    {
+        try
+        {
+            co_await std::move(t);
+        }
+        catch (...)
+        {
+            if (!ring->error_)
+            {
+                ring->error_ = std::current_exception();
+            }
+        }
+        --ring->live_;
+    }
+
+    /** Records the result of \a op and queues its waiter. */
+    void complete(io_op &op, std::int32_t result)
+    {
+        op.result = result;
+        op.done = true;
+        if (op.waiter)
+        {
+            ready_.push_back(op.waiter);
+        }
+    }
+
+    /** Submits \a to_submit reads, waits for \a min_complete completions
+     * and then processes every available completion.
+     */
+    void enter(unsigned to_submit, unsigned min_complete)
+    {
+        long res;
+
+        for (;;)
+        {
+            res = syscall(__NR_io_uring_enter, fd_, to_submit, min_complete,
+                min_complete ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0);
+            if (res >= 0)
+            {
+                in_flight_ += res;
+                to_submit_ -= res;
+                break;
+            }
+            if (errno == EBUSY && reap())
+            {
+                continue;
+            }
+            if (errno != EINTR)
+            {
+                throw std::system_error(errno, std::generic_category(),
+                    "io_uring_enter");
+            }
+        }
+
+        reap();
+    }
+
+    /** Processes available completions; returns how many there were. */
+    unsigned reap()
+    {
+        unsigned head = *cq_head_, count = 0;
+        unsigned tail = std::atomic_ref<unsigned>(*cq_tail_).load(
+            std::memory_order_acquire);
+
+        for (; head != tail; ++head, ++count)
+        {
+            const io_uring_cqe *cqe = &cqes_[head & cq_mask_];
+            --in_flight_;
+            complete(*reinterpret_cast<io_op *>(cqe->user_data), cqe->res);
+        }
+        std::atomic_ref<unsigned>(*cq_head_).store(head,
+            std::memory_order_release);
+
+        return count;
+    }
+
+    int fd_ = -1;
+    void *sq_ptr_ = nullptr;
+    std::size_t sq_size_ = 0;
+    void *cq_ptr_ = nullptr;
+    std::size_t cq_size_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned *sq_head_ = nullptr;
+    unsigned *sq_tail_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned *sq_array_ = nullptr;
+    io_uring_sqe *sqes_ = nullptr;
+    unsigned *cq_head_ = nullptr;
+    unsigned *cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe *cqes_ = nullptr;
+    unsigned in_flight_ = 0;
+    unsigned to_submit_ = 0;
+    std::size_t live_ = 0;
+    std::deque<std::coroutine_handle<>> ready_;
+    std::exception_ptr error_;
+};
+
+/** Awaiter that calls \a Fn until it no longer fails with
+ * \a SRNX_WOULD_BLOCK, reading the data a reader asks for through an
+ * io_ring in between.  The first call is made without suspending, so
+ * calls that need no I/O cost no more than calling the C function.
+ */
+template <typename Fn>
+class retry_awaiter
+{
+public:
+    /** Creates an awaiter for \a call on \a srnx.  If \a throws, a
+     * non-zero result is thrown as srnx::error.
+     */
+    retry_awaiter(io_ring &ring, srnx_reader *srnx, Fn call, bool throws)
+        : ring_(ring), srnx_(srnx), call_(std::move(call)), throws_(throws)
+    {
+    }
+
+    bool await_ready()
+    {
+        res_ = call_();
+        return res_ != SRNX_WOULD_BLOCK;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> h)
+    {
+        slow_ = finish(ring_, srnx_, call_);
+        waiter_ = slow_.operator co_await();
+        return waiter_.await_suspend(h);
+    }
+
+    int await_resume()
+    {
+        int res = (res_ == SRNX_WOULD_BLOCK) ? waiter_.await_resume() : res_;
+
+        if (res && throws_)
+        {
+            throw error(res, srnx_error_line(srnx_));
+        }
+        return res;
+    }
+
+private:
+    /** Does the pending read, then retries \a call, until \a call
+     * stops failing with \a SRNX_WOULD_BLOCK.
+     */
+    static task<int> finish(io_ring &ring, srnx_reader *srnx, Fn &call)
+    {
+        int fd, res;
+        void *buf;
+        std::uint64_t offset;
+        std::size_t len;
+        std::int32_t nbr;
+
+        do
+        {
+            res = srnx_pending_read(srnx, &fd, &buf, &offset, &len);
+            if (res)
+            {
+                co_return res;
+            }
+            nbr = co_await ring.read(fd, buf, len, offset);
+            if (nbr <= 0)
+            {
+                errno = nbr ? -nbr : EIO;
+                co_return SRNX_IO_ERROR;
+            }
+            res = srnx_complete_read(srnx, offset, nbr);
+            if (res)
+            {
+                co_return res;
+            }
+            res = call();
+        } while (res == SRNX_WOULD_BLOCK);
+
+        co_return res;
+    }
+
+    io_ring &ring_;
+    srnx_reader *srnx_;
+    Fn call_;
+    bool throws_;
+    int res_ = 0;
+    task<int> slow_;
+    typename task<int>::awaiter waiter_{};
+};
+
+/** Calls \a call, which wraps a C function on \a srnx, reading data
+ * through \a ring whenever the function needs it.
+ *
+ * \returns An awaiter that yields the function's last result.
+ */
+template <typename Fn>
+retry_awaiter<Fn> complete(io_ring &ring, srnx_reader *srnx, Fn call)
+{
+    return retry_awaiter<Fn>(ring, srnx, std::move(call), false);
+}
+
+/** Opens \a filename for reading through \a ring.
+ *
+ * \throws srnx::error If the file cannot be opened.
+ */
+inline task<reader> open_async(io_ring &ring, std::string filename)
+{
+    srnx_reader *srnx = nullptr;
+    int res = srnx_open_async(&srnx, filename.c_str());
+    reader out(srnx);
+
+    if (res == SRNX_WOULD_BLOCK)
+    {
+        res = co_await complete(ring, srnx,
+            [srnx] { return srnx_continue_open(srnx); });
+    }
+    out.check(res);
+    co_return out;
+}
+
+/** Decodes observation code \a idx of satellite \a sat into \a out,
+ * reading through \a ring.  \a rdr should come from open_async().
+ *
+ * \returns An awaiter that throws srnx::error if the signal cannot be
+ *   read.
+ */
+inline auto read_column(io_ring &ring, reader &rdr, srnx_satellite_name sat,
+    int idx, column &out)
+{
+    auto call = [&rdr, sat, idx, &out] { return rdr.try_read(sat, idx, out); };
+    return retry_awaiter<decltype(call)>(ring, rdr.get(), call, true);
+}
+
+/** Loads the epoch index of \a rdr into \a out, reading through
+ * \a ring.
+ *
+ * \returns An awaiter that throws srnx::error if the epochs cannot be
+ *   read.
+ */
+inline auto read_index(io_ring &ring, reader &rdr, epoch_index &out)
+{
+    auto call = [&rdr, &out] { return rdr.try_index(out); };
+    return retry_awaiter<decltype(call)>(ring, rdr.get(), call, true);
+}
+
+} /* namespace srnx */
+
+#endif /* !defined(SRNX_ASYNC_HPP_1b6f0e83_c25a_4d97_b4e0_8a3d71f5c926) */
@@ -0,0 +1,528 @@
+/** srnx_cache.c - Process-wide cache of decoded Succinct RINEX signals.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "srnx_p.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The cache is a hash table split into independently locked stripes,
+ * so concurrent readers of different signals rarely contend.  Entries
+ * are evicted using the GreedyDual-Size policy: each entry's priority
+ * is the cache's "clock" when it was last used plus the time it took
+ * to decode per KiB of memory it holds.  Eviction removes the entry
+ * with the lowest priority in the whole cache and advances the clock to
+ * that priority, so entries that are both old and cheap to rebuild go
+ * first.  Each stripe keeps its entries in a binary min-heap by
+ * priority and publishes the heap's minimum, so finding the victim
+ * takes one look at each stripe and one heap removal.
+ */
+
+/** Number of independently locked parts of the cache. */
+#define CACHE_STRIPES 16
+
+/** srnx_cache_entry holds one decoded signal. */
+struct srnx_cache_entry
+{
+    /** Next entry in the same hash bucket. */
+    struct srnx_cache_entry *next;
+
+    /** Identifies the signal. */
+    struct srnx_cache_key key;
+
+    /** Hash of #key. */
+    uint64_t hash;
+
+    /** Eviction priority; see the comment at the top of the file. */
+    uint64_t priority;
+
+    /** Position of this entry in its stripe's #srnx_cache_stripe::heap. */
+    size_t heap_idx;
+
+    /** Decode time per KiB of #bytes. */
+    uint64_t value;
+
+    /** Memory charged to this entry. */
+    size_t bytes;
+
+    /** Number of observations. */
+    int n_values;
+
+    /** Observation values, followed by #n_values LLIs and then
+     * #n_values SSIs.
+     */
+    int64_t obs[];
+};
+
+/** srnx_cache_stripe is one independently locked part of the cache. */
+struct srnx_cache_stripe
+{
+    /** Protects the rest of the structure. */
+    pthread_mutex_t lock;
+
+    /** Hash buckets, each a linked list of entries. */
+    struct srnx_cache_entry **bucket;
+
+    /** Number of elements in #bucket; zero or a power of two. */
+    size_t n_buckets;
+
+    /** Number of entries in this stripe. */
+    size_t n_entries;
+
+    /** Entries in this stripe, as a binary min-heap by priority. */
+    struct srnx_cache_entry **heap;
+
+    /** Number of elements allocated for #heap. */
+    size_t heap_cap;
+
+    /** Priority of #heap[0], or UINT64_MAX if the stripe is empty.
+     * This is written under #lock but may be read without it.
+     */
+    atomic_uint_fast64_t min_priority;
+};
+
+static struct srnx_cache_stripe cache_stripe[CACHE_STRIPES] = {
+#define S PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, NULL, 0, UINT64_MAX
+    { S }, { S }, { S }, { S }, { S }, { S }, { S }, { S },
+    { S }, { S }, { S }, { S }, { S }, { S }, { S }, { S }
+#undef S
+};
+
+static atomic_size_t cache_budget;
+static atomic_size_t cache_bytes;
+static atomic_uint_fast64_t cache_clock;
+static atomic_uint_fast64_t cache_hits;
+static atomic_uint_fast64_t cache_misses;
+static atomic_uint_fast64_t cache_insertions;
+static atomic_uint_fast64_t cache_evictions;
+
+/** Computes the FNV-1a hash of \a key. */
+static uint64_t cache_hash(const struct srnx_cache_key *key)
+{
+    const unsigned char *ptr = (const unsigned char *)key;
+    uint64_t hash = 14695981039346656037u;
+    size_t ii;
+
+    for (ii = 0; ii < sizeof *key; ++ii)
+    {
+        hash = (hash ^ ptr[ii]) * 1099511628211u;
+    }
+
+    return hash;
+}
+
+/** Returns the bucket in \a stripe for hash value \a hash. */
+static struct srnx_cache_entry **cache_bucket(
+    struct srnx_cache_stripe *stripe,
+    uint64_t hash
+)
+{
+    return stripe->bucket + ((hash / CACHE_STRIPES) & (stripe->n_buckets - 1));
+}
+
+/** Doubles the number of buckets in \a stripe, if possible.
+ * The caller must hold \a stripe->lock.
+ */
+static void cache_grow(struct srnx_cache_stripe *stripe)
+{
+    struct srnx_cache_entry **old, **bucket, *entry;
+    size_t n_old, ii;
+
+    old = stripe->bucket;
+    n_old = stripe->n_buckets;
+    stripe->n_buckets = n_old ? 2 * n_old : 16;
+    stripe->bucket = calloc(stripe->n_buckets, sizeof(*stripe->bucket));
+    if (!stripe->bucket)
+    {
+        /* Keep using the old table; chains just get longer. */
+        stripe->bucket = old;
+        stripe->n_buckets = n_old;
+        return;
+    }
+
+    for (ii = 0; ii < n_old; ++ii)
+    {
+        while ((entry = old[ii]) != NULL)
+        {
+            old[ii] = entry->next;
+            bucket = cache_bucket(stripe, entry->hash);
+            entry->next = *bucket;
+            *bucket = entry;
+        }
+    }
+    free(old);
+}
+
+/** Stores \a entry at position \a idx of \a stripe's heap. */
+static void cache_heap_set(
+    struct srnx_cache_stripe *stripe,
+    size_t idx,
+    struct srnx_cache_entry *entry
+)
+{
+    stripe->heap[idx] = entry;
+    entry->heap_idx = idx;
+}
+
+/** Restores the heap order of \a stripe after the priority of the
+ * entry at \a idx changed, and republishes the stripe's minimum.
+ * The caller must hold \a stripe->lock.
+ */
+static void cache_heap_fix(struct srnx_cache_stripe *stripe, size_t idx)
+{
+    struct srnx_cache_entry *entry;
+    size_t parent, child;
+
+    entry = stripe->heap[idx];
+    while (idx > 0)
+    {
+        parent = (idx - 1) / 2;
+        if (stripe->heap[parent]->priority <= entry->priority)
+        {
+            break;
+        }
+        cache_heap_set(stripe, idx, stripe->heap[parent]);
+        idx = parent;
+    }
+    while ((child = 2 * idx + 1) < stripe->n_entries)
+    {
+        if (child + 1 < stripe->n_entries
+            && stripe->heap[child + 1]->priority < stripe->heap[child]->priority)
+        {
+            ++child;
+        }
+        if (entry->priority <= stripe->heap[child]->priority)
+        {
+            break;
+        }
+        cache_heap_set(stripe, idx, stripe->heap[child]);
+        idx = child;
+    }
+    cache_heap_set(stripe, idx, entry);
+
+    atomic_store(&stripe->min_priority, stripe->heap[0]->priority);
+}
+
+/** Doubles the size of the heap in \a stripe, if possible.
+ * The caller must hold \a stripe->lock.
+ */
+static void cache_grow_heap(struct srnx_cache_stripe *stripe)
+{
+    struct srnx_cache_entry **heap;
+    size_t cap;
+
+    cap = stripe->heap_cap ? 2 * stripe->heap_cap : 16;
+    heap = realloc(stripe->heap, cap * sizeof(*heap));
+    if (heap)
+    {
+        stripe->heap = heap;
+        stripe->heap_cap = cap;
+    }
+}
+
+/** Evicts the lowest-priority entry from one stripe.
+ *
+ * \returns Non-zero if an entry was evicted, zero if the stripe was
+ *   empty.
+ */
+static int cache_evict_one(struct srnx_cache_stripe *stripe)
+{
+    struct srnx_cache_entry **pp, *entry;
+    uint_fast64_t clock;
+
+    pthread_mutex_lock(&stripe->lock);
+    if (!stripe->n_entries)
+    {
+        pthread_mutex_unlock(&stripe->lock);
+        return 0;
+    }
+
+    /* Unlink the heap's root from its hash chain and from the heap. */
+    entry = stripe->heap[0];
+    for (pp = cache_bucket(stripe, entry->hash); *pp != entry; pp = &(*pp)->next)
+    {
+    }
+    *pp = entry->next;
+    if (--stripe->n_entries)
+    {
+        cache_heap_set(stripe, 0, stripe->heap[stripe->n_entries]);
+        cache_heap_fix(stripe, 0);
+    }
+    else
+    {
+        atomic_store(&stripe->min_priority, UINT64_MAX);
+    }
+    pthread_mutex_unlock(&stripe->lock);
+
+    /* Advance the clock to the victim's priority. */
+    clock = atomic_load(&cache_clock);
+    while (clock < entry->priority
+        && !atomic_compare_exchange_weak(&cache_clock, &clock, entry->priority))
+    {
+    }
+
+    atomic_fetch_sub(&cache_bytes, entry->bytes);
+    atomic_fetch_add(&cache_evictions, 1);
+    free(entry);
+    return 1;
+}
+
+/** Evicts entries until the cache fits within its budget. */
+static void cache_shrink(void)
+{
+    uint_fast64_t priority, best;
+    int ii, victim;
+
+    while (atomic_load(&cache_bytes) > atomic_load(&cache_budget))
+    {
+        /* Find the stripe holding the lowest priority.  Another thread
+         * may change it before we lock it; that only makes this
+         * eviction slightly less exact.
+         */
+        best = UINT64_MAX;
+        victim = -1;
+        for (ii = 0; ii < CACHE_STRIPES; ++ii)
+        {
+            priority = atomic_load(&cache_stripe[ii].min_priority);
+            if (priority < best)
+            {
+                best = priority;
+                victim = ii;
+            }
+        }
+        if (victim < 0)
+        {
+            break;
+        }
+        (void)cache_evict_one(cache_stripe + victim);
+    }
+}
+
+/* Doc comment in srnx_p.h. */
+int srnx_cache_enabled(void)
+{
+    return atomic_load_explicit(&cache_budget, memory_order_relaxed) != 0;
+}
+
+/* Doc comment in srnx_p.h. */
+int srnx_cache_get(
+    const struct srnx_cache_key *key,
+    int *p_n_values,
+    int64_t **p_obs,
+    char **p_lli,
+    char **p_ssi
+)
+{
+    struct srnx_cache_stripe *stripe;
+    struct srnx_cache_entry *entry;
+    const char *inds;
+    uint64_t hash;
+    void *ptr;
+    size_t n;
+
+    hash = cache_hash(key);
+    stripe = cache_stripe + hash % CACHE_STRIPES;
+
+    pthread_mutex_lock(&stripe->lock);
+    entry = stripe->n_buckets ? *cache_bucket(stripe, hash) : NULL;
+    for (; entry; entry = entry->next)
+    {
+        if (entry->hash == hash && !memcmp(&entry->key, key, sizeof *key))
+        {
+            break;
+        }
+    }
+    if (!entry)
+    {
+        pthread_mutex_unlock(&stripe->lock);
+        atomic_fetch_add(&cache_misses, 1);
+        return 0;
+    }
+
+    /* Copy the data out while the entry cannot be evicted. */
+    n = entry->n_values;
+    inds = (const char *)(entry->obs + n);
+    if (!(ptr = srnx_reserve(*p_obs, n * sizeof(int64_t))))
+    {
+        goto fail;
+    }
+    *p_obs = ptr;
+    memcpy(*p_obs, entry->obs, n * sizeof(int64_t));
+    if (p_lli)
+    {
+        if (!(ptr = srnx_reserve(*p_lli, n)))
+        {
+            goto fail;
+        }
+        *p_lli = ptr;
+        memcpy(*p_lli, inds, n);
+    }
+    if (p_ssi)
+    {
+        if (!(ptr = srnx_reserve(*p_ssi, n)))
+        {
+            goto fail;
+        }
+        *p_ssi = ptr;
+        memcpy(*p_ssi, inds + n, n);
+    }
+    *p_n_values = n;
+    entry->priority = atomic_load(&cache_clock) + entry->value;
+    cache_heap_fix(stripe, entry->heap_idx);
+    pthread_mutex_unlock(&stripe->lock);
+
+    atomic_fetch_add(&cache_hits, 1);
+    return 1;
+
+fail:
+    /* Let the caller try to decode the signal, which reports ENOMEM
+     * if memory is still short.
+     */
+    pthread_mutex_unlock(&stripe->lock);
+    atomic_fetch_add(&cache_misses, 1);
+    return 0;
+}
+
+/* Doc comment in srnx_p.h. */
+void srnx_cache_put(
+    const struct srnx_cache_key *key,
+    int n_values,
+    const int64_t obs[],
+    const char lli[],
+    const char ssi[],
+    uint64_t decode_ns
+)
+{
+    struct srnx_cache_stripe *stripe;
+    struct srnx_cache_entry *entry, **bucket, *old;
+    char *inds;
+    size_t n, bytes;
+
+    n = n_values;
+    bytes = sizeof(*entry) + n * (sizeof(int64_t) + 2);
+    if (bytes > atomic_load(&cache_budget))
+    {
+        return;
+    }
+
+    entry = malloc(bytes);
+    if (!entry)
+    {
+        return;
+    }
+    entry->key = *key;
+    entry->hash = cache_hash(key);
+    entry->bytes = bytes;
+    entry->value = decode_ns * 1024 / bytes;
+    entry->n_values = n_values;
+    inds = (char *)(entry->obs + n);
+    memcpy(entry->obs, obs, n * sizeof(int64_t));
+    memcpy(inds, lli, n);
+    memcpy(inds + n, ssi, n);
+    entry->priority = atomic_load(&cache_clock) + entry->value;
+
+    stripe = cache_stripe + entry->hash % CACHE_STRIPES;
+    pthread_mutex_lock(&stripe->lock);
+    if (stripe->n_entries >= stripe->n_buckets)
+    {
+        cache_grow(stripe);
+    }
+    if (stripe->n_entries >= stripe->heap_cap)
+    {
+        cache_grow_heap(stripe);
+    }
+    if (!stripe->n_buckets || stripe->n_entries >= stripe->heap_cap)
+    {
+        pthread_mutex_unlock(&stripe->lock);
+        free(entry);
+        return;
+    }
+
+    /* Another thread may have decoded the same signal. */
+    bucket = cache_bucket(stripe, entry->hash);
+    for (old = *bucket; old; old = old->next)
+    {
+        if (old->hash == entry->hash
+            && !memcmp(&old->key, key, sizeof *key))
+        {
+            pthread_mutex_unlock(&stripe->lock);
+            free(entry);
+            return;
+        }
+    }
+    entry->next = *bucket;
+    *bucket = entry;
+    cache_heap_set(stripe, stripe->n_entries++, entry);
+    cache_heap_fix(stripe, entry->heap_idx);
+    pthread_mutex_unlock(&stripe->lock);
+
+    atomic_fetch_add(&cache_bytes, bytes);
+    atomic_fetch_add(&cache_insertions, 1);
+    cache_shrink();
+}
+
+/* Doc comment in srnx.h. */
+void srnx_cache_set_budget(size_t bytes)
+{
+    atomic_store(&cache_budget, bytes);
+    cache_shrink();
+}
+
+/* Doc comment in srnx.h. */
+void srnx_cache_clear(void)
+{
+    int ii;
+
+    for (ii = 0; ii < CACHE_STRIPES; ++ii)
+    {
+        while (cache_evict_one(cache_stripe + ii))
+        {
+        }
+    }
+}
+
+/* Doc comment in srnx.h. */
+void srnx_cache_get_stats(struct srnx_cache_stats *stats)
+{
+    size_t n_entries;
+    int ii;
+
+    n_entries = 0;
+    for (ii = 0; ii < CACHE_STRIPES; ++ii)
+    {
+        pthread_mutex_lock(&cache_stripe[ii].lock);
+        n_entries += cache_stripe[ii].n_entries;
+        pthread_mutex_unlock(&cache_stripe[ii].lock);
+    }
+
+    stats->hits = atomic_load(&cache_hits);
+    stats->misses = atomic_load(&cache_misses);
+    stats->insertions = atomic_load(&cache_insertions);
+    stats->evictions = atomic_load(&cache_evictions);
+    stats->n_entries = n_entries;
+    stats->bytes_used = atomic_load(&cache_bytes);
+    stats->budget = atomic_load(&cache_budget);
+}
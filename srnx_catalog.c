@@ -0,0 +1,943 @@
+/** srnx_catalog.c - Index of metadata for many Succinct RINEX files.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "srnx_catalog.h"
+#include "srnx_numa.h"
+#include "srnx_p.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#if !defined(O_CLOEXEC)
+# define O_CLOEXEC 0
+#endif
+
+/** Identifies a catalog file (and its byte order). */
+static const char catalog_magic[8] = "SRNXCAT";
+
+/** Current catalog file layout version. */
+#define CATALOG_VERSION 2
+
+/** srnx_catalog_header is the start of a catalog file. */
+struct srnx_catalog_header
+{
+    /** Holds #catalog_magic. */
+    char magic[8];
+
+    /** Holds #CATALOG_VERSION. */
+    uint32_t version;
+
+    /** Size of each struct srnx_catalog_entry in the file. */
+    uint32_t entry_size;
+
+    /** Number of entries. */
+    uint64_t n_entries;
+
+    /** File offset of the entry array. */
+    uint64_t entries_offset;
+
+    /** Number of signals. */
+    uint64_t n_signals;
+
+    /** File offset of the signal array. */
+    uint64_t signals_offset;
+
+    /** File offset of the string table. */
+    uint64_t strings_offset;
+
+    /** Size of the string table. */
+    uint64_t strings_size;
+};
+
+/* Doc comment in srnx_catalog.h. */
+struct srnx_catalog
+{
+    /** Memory-mapped catalog file. */
+    const char *data;
+
+    /** Length of #data. */
+    size_t data_size;
+
+    /** Header at the start of #data. */
+    const struct srnx_catalog_header *header;
+
+    /** Entry array within #data. */
+    const struct srnx_catalog_entry *entry;
+
+    /** Signal array within #data. */
+    const struct srnx_catalog_signal *signal;
+
+    /** String table within #data. */
+    const char *strings;
+};
+
+/** catalog_item is an entry under construction. */
+struct catalog_item
+{
+    /** Entry metadata; path_offset and signals_idx are filled in when
+     * writing the catalog.
+     */
+    struct srnx_catalog_entry entry;
+
+    /** File name. */
+    const char *path;
+
+    /** Signals for the entry. */
+    struct srnx_catalog_signal *signal;
+
+    /** Zero if the file was read successfully, else an error number. */
+    int err;
+};
+
+/** catalog_work is shared between threads scanning files. */
+struct catalog_work
+{
+    /** Items to fill in. */
+    struct catalog_item *item;
+
+    /** Number of items at #item. */
+    int n_items;
+
+    /** Hands out items to scan, nearest first. */
+    struct srnx_numa_queue *queue;
+
+    /** Number of threads started so far, for srnx_numa_bind_worker(). */
+    int n_workers;
+};
+
+/** Compares two epochs given as (date, minute of day, seconds). */
+static int compare_time(
+    int32_t a_date, int32_t a_hh_mm, int32_t a_sec_e7,
+    int32_t b_date, int32_t b_hh_mm, int32_t b_sec_e7
+)
+{
+    if (a_date != b_date)
+        return (a_date < b_date) ? -1 : 1;
+    if (a_hh_mm != b_hh_mm)
+        return (a_hh_mm < b_hh_mm) ? -1 : 1;
+    if (a_sec_e7 != b_sec_e7)
+        return (a_sec_e7 < b_sec_e7) ? -1 : 1;
+    return 0;
+}
+
+/** Returns the time of day of \a epoch, in seconds times 1e7. */
+static int64_t time_of_day_e7(const struct rinex_epoch *epoch)
+{
+    return ((epoch->hh_mm / 100) * 60 + epoch->hh_mm % 100) * 600000000LL
+        + epoch->sec_e7;
+}
+
+/** Copies the MARKER NAME from RINEX header text into \a marker.
+ *
+ * \param[out] marker Receives the marker name, '\0'-padded.
+ * \param[in] rhdr RINEX header text.
+ * \param[in] rhdr_len Length of \a rhdr.
+ */
+static void find_marker_name(
+    char marker[64],
+    const char *rhdr,
+    size_t rhdr_len
+)
+{
+    const char *line, *eol, *end;
+    int len;
+
+    memset(marker, 0, 64);
+    end = rhdr + rhdr_len;
+    for (line = rhdr; line < end; line = eol + 1)
+    {
+        eol = memchr(line, '\n', end - line);
+        if (!eol)
+        {
+            eol = end;
+        }
+        if (eol - line < 71 || memcmp(line + 60, "MARKER NAME", 11))
+        {
+            continue;
+        }
+
+        for (len = 60; len > 0 && line[len - 1] == ' '; --len) {}
+        memcpy(marker, line, len);
+        return;
+    }
+}
+
+/** Reads the catalog metadata for \a p_item->path.
+ *
+ * \param[in,out] p_item Item to fill in.
+ * \param[in,out] p_srnx SRNX reader object to (re-)use.
+ * \returns Zero on success, non-zero SRNX error number on error.
+ */
+static int scan_file(
+    struct catalog_item *p_item,
+    struct srnx_reader **p_srnx
+)
+{
+    struct srnx_catalog_entry *entry = &p_item->entry;
+    struct srnx_satellite_name *name = NULL;
+    struct rinex_epoch *epoch = NULL;
+    struct srnx_catalog_signal *signal;
+    const struct srnx_obs_code *code;
+    const char *rhdr;
+    uint64_t n_names, n_values, socd_offset, ii;
+    size_t rhdr_len, n_epochs, signals_alloc;
+    int res, jj, codes_len, n_sigs;
+
+    res = srnx_open(p_srnx, p_item->path);
+    if (res)
+    {
+        return res;
+    }
+
+    res = srnx_get_header(*p_srnx, &rhdr, &rhdr_len);
+    if (res)
+    {
+        return res;
+    }
+    find_marker_name(entry->marker, rhdr, rhdr_len);
+
+    /* Record the time span. */
+    n_epochs = 0;
+    res = srnx_get_epochs(*p_srnx, &epoch, &n_epochs);
+    if (res && res != SRNX_NO_CHUNK)
+    {
+        goto out;
+    }
+    if (n_epochs > 0)
+    {
+        entry->n_epochs = n_epochs;
+        entry->first_yyyy_mm_dd = epoch[0].yyyy_mm_dd;
+        entry->first_hh_mm = epoch[0].hh_mm;
+        entry->first_sec_e7 = epoch[0].sec_e7;
+        entry->last_yyyy_mm_dd = epoch[n_epochs - 1].yyyy_mm_dd;
+        entry->last_hh_mm = epoch[n_epochs - 1].hh_mm;
+        entry->last_sec_e7 = epoch[n_epochs - 1].sec_e7;
+        if (n_epochs > 1 && epoch[0].yyyy_mm_dd == epoch[1].yyyy_mm_dd)
+        {
+            entry->interval_e7 = time_of_day_e7(epoch + 1)
+                - time_of_day_e7(epoch);
+        }
+    }
+
+    /* Record each satellite's signals. */
+    n_names = 0;
+    res = srnx_get_satellites(*p_srnx, &name, &n_names);
+    if (res)
+    {
+        goto out;
+    }
+
+    signals_alloc = 0;
+    for (ii = 0; ii < n_names; ++ii)
+    {
+        if (srnx_get_obs_codes(*p_srnx, name[ii].name[0], &code, &codes_len))
+        {
+            continue;
+        }
+
+        for (jj = n_sigs = 0; jj < codes_len; ++jj)
+        {
+            n_values = socd_offset = 0;
+            res = srnx_get_obs_info(*p_srnx, name[ii], jj, &n_values, &socd_offset);
+            if (res == SRNX_UNKNOWN_CODE)
+            {
+                continue;
+            }
+            if (res)
+            {
+                goto out;
+            }
+
+            if (entry->n_signals >= signals_alloc)
+            {
+                signals_alloc = signals_alloc ? 2 * signals_alloc : 64;
+                signal = realloc(p_item->signal, signals_alloc * sizeof(*signal));
+                if (!signal)
+                {
+                    res = ENOMEM;
+                    goto out;
+                }
+                p_item->signal = signal;
+            }
+
+            signal = p_item->signal + entry->n_signals++;
+            signal->sat = name[ii];
+            signal->code = code[jj];
+            signal->n_values = n_values;
+            signal->socd_offset = socd_offset;
+            ++n_sigs;
+        }
+
+        if (n_sigs > 0)
+        {
+            ++entry->n_satellites;
+        }
+    }
+    res = 0;
+
+out:
+    srnx_free(epoch);
+    srnx_free(name);
+    return res;
+}
+
+/** Scans files from \a arg (a struct catalog_work) until none are left. */
+static void *scan_thread(void *arg)
+{
+    struct catalog_work *work = arg;
+    struct srnx_reader *srnx = NULL;
+    int idx, node;
+
+    node = srnx_numa_current_node();
+    while ((idx = srnx_numa_queue_next(work->queue, node)) >= 0)
+    {
+        work->item[idx].err = scan_file(work->item + idx, &srnx);
+    }
+
+    srnx_close(srnx);
+    return NULL;
+}
+
+/** Places a thread that we started for scanning, then scans files. */
+static void *scan_worker(void *arg)
+{
+    struct catalog_work *work = arg;
+
+    srnx_numa_bind_worker(__atomic_fetch_add(&work->n_workers, 1,
+        __ATOMIC_RELAXED));
+    return scan_thread(arg);
+}
+
+/** Orders catalog items by file name. */
+static int compare_item_path(const void *a, const void *b)
+{
+    const struct catalog_item *ia = a, *ib = b;
+
+    return strcmp(ia->path, ib->path);
+}
+
+/** Orders catalog items by marker name, then first epoch. */
+static int compare_item_key(const void *a, const void *b)
+{
+    const struct srnx_catalog_entry *ea = &((const struct catalog_item *)a)->entry;
+    const struct srnx_catalog_entry *eb = &((const struct catalog_item *)b)->entry;
+    int res;
+
+    res = strncmp(ea->marker, eb->marker, sizeof ea->marker);
+    if (res)
+    {
+        return res;
+    }
+
+    res = compare_time(ea->first_yyyy_mm_dd, ea->first_hh_mm, ea->first_sec_e7,
+        eb->first_yyyy_mm_dd, eb->first_hh_mm, eb->first_sec_e7);
+    if (res)
+    {
+        return res;
+    }
+
+    return strcmp(((const struct catalog_item *)a)->path,
+        ((const struct catalog_item *)b)->path);
+}
+
+/** Writes \a n_items catalog items (those without errors) to \a fout.
+ *
+ * \returns Zero on success, else an errno value.
+ */
+static int write_catalog(
+    FILE *fout,
+    struct catalog_item *item,
+    int n_items
+)
+{
+    struct srnx_catalog_header header;
+    struct srnx_catalog_entry entry, *prev;
+    uint64_t signals_idx, path_offset;
+    int ii, n_good;
+
+    memset(&header, 0, sizeof header);
+    memcpy(header.magic, catalog_magic, sizeof header.magic);
+    header.version = CATALOG_VERSION;
+    header.entry_size = sizeof(struct srnx_catalog_entry);
+
+    for (ii = n_good = 0; ii < n_items; ++ii)
+    {
+        if (item[ii].err)
+        {
+            continue;
+        }
+        ++n_good;
+        header.n_signals += item[ii].entry.n_signals;
+        header.strings_size += strlen(item[ii].path) + 1;
+    }
+    header.n_entries = n_good;
+    header.entries_offset = sizeof header;
+    header.signals_offset = header.entries_offset
+        + header.n_entries * sizeof(struct srnx_catalog_entry);
+    header.strings_offset = header.signals_offset
+        + header.n_signals * sizeof(struct srnx_catalog_signal);
+
+    if (fwrite(&header, sizeof header, 1, fout) != 1)
+    {
+        return errno;
+    }
+
+    for (ii = 0, signals_idx = path_offset = 0, prev = NULL; ii < n_items; ++ii)
+    {
+        if (item[ii].err)
+        {
+            continue;
+        }
+        memcpy(&entry, &item[ii].entry, sizeof entry);
+        entry.signals_idx = signals_idx;
+        entry.path_offset = path_offset;
+        entry.reserved = 0;
+
+        /* Carry the latest last epoch forward within each marker. */
+        entry.max_last_yyyy_mm_dd = entry.last_yyyy_mm_dd;
+        entry.max_last_hh_mm = entry.last_hh_mm;
+        entry.max_last_sec_e7 = entry.last_sec_e7;
+        if (prev && !strncmp(prev->marker, entry.marker, sizeof entry.marker)
+            && compare_time(prev->max_last_yyyy_mm_dd, prev->max_last_hh_mm,
+                prev->max_last_sec_e7, entry.last_yyyy_mm_dd,
+                entry.last_hh_mm, entry.last_sec_e7) > 0)
+        {
+            entry.max_last_yyyy_mm_dd = prev->max_last_yyyy_mm_dd;
+            entry.max_last_hh_mm = prev->max_last_hh_mm;
+            entry.max_last_sec_e7 = prev->max_last_sec_e7;
+        }
+        item[ii].entry.max_last_yyyy_mm_dd = entry.max_last_yyyy_mm_dd;
+        item[ii].entry.max_last_hh_mm = entry.max_last_hh_mm;
+        item[ii].entry.max_last_sec_e7 = entry.max_last_sec_e7;
+        prev = &item[ii].entry;
+
+        signals_idx += entry.n_signals;
+        path_offset += strlen(item[ii].path) + 1;
+        if (fwrite(&entry, sizeof entry, 1, fout) != 1)
+        {
+            return errno;
+        }
+    }
+
+    for (ii = 0; ii < n_items; ++ii)
+    {
+        if (!item[ii].err && item[ii].entry.n_signals > 0
+            && fwrite(item[ii].signal, sizeof(item[ii].signal[0]),
+                item[ii].entry.n_signals, fout) != item[ii].entry.n_signals)
+        {
+            return errno;
+        }
+    }
+
+    for (ii = 0; ii < n_items; ++ii)
+    {
+        if (!item[ii].err
+            && fwrite(item[ii].path, strlen(item[ii].path) + 1, 1, fout) != 1)
+        {
+            return errno;
+        }
+    }
+
+    return 0;
+}
+
+/* Doc comment in srnx_catalog.h. */
+int srnx_catalog_build(
+    const char out_filename[],
+    const char old_filename[],
+    int n_files,
+    const char *const filename[],
+    int n_threads,
+    int *p_n_failed
+)
+{
+    struct srnx_catalog *old = NULL;
+    struct catalog_item *item, key, *found;
+    struct catalog_work work;
+    const struct srnx_catalog_entry *old_entry;
+    const struct srnx_catalog_signal *old_signal;
+    pthread_t *thread;
+    struct stat sbuf;
+    char *tmp_name;
+    FILE *fout;
+    size_t n_old, ii;
+    int *node;
+    int res, jj, n_items, n_scan, n_failed, n_missing;
+
+    /* Load the old catalog, if there is one. */
+    n_old = 0;
+    if (old_filename)
+    {
+        res = srnx_catalog_open(&old, old_filename);
+        if (res == 0)
+        {
+            n_old = srnx_catalog_size(old);
+        }
+        else if (res != ENOENT)
+        {
+            return res;
+        }
+    }
+
+    item = calloc(n_old + n_files, sizeof(*item));
+    tmp_name = malloc(strlen(out_filename) + 5);
+    if (!item || !tmp_name)
+    {
+        res = ENOMEM;
+        goto out;
+    }
+
+    /* Old entries come first, sorted by path so they can be searched. */
+    for (ii = 0; ii < n_old; ++ii)
+    {
+        old_entry = srnx_catalog_entry(old, ii);
+        item[ii].entry = *old_entry;
+        item[ii].path = srnx_catalog_path(old, old_entry);
+    }
+    qsort(item, n_old, sizeof(*item), compare_item_path);
+
+    /* Add or refresh each listed file.  Entries that are still current
+     * keep their old metadata; others are scanned below.
+     */
+    n_items = n_old;
+    n_missing = 0;
+    for (jj = 0; jj < n_files; ++jj)
+    {
+        key.path = filename[jj];
+        found = bsearch(&key, item, n_old, sizeof(*item), compare_item_path);
+        if (stat(filename[jj], &sbuf) < 0)
+        {
+            if (found)
+            {
+                found->err = errno;
+            }
+            else
+            {
+                ++n_missing;
+            }
+            continue;
+        }
+
+        if (found && found->entry.file_size == (uint64_t)sbuf.st_size
+            && found->entry.file_mtime == (int64_t)sbuf.st_mtime)
+        {
+            continue;
+        }
+        if (found)
+        {
+            found->err = EEXIST; /* superseded by a new item */
+        }
+
+        memset(item + n_items, 0, sizeof(*item));
+        item[n_items].path = filename[jj];
+        item[n_items].entry.file_size = sbuf.st_size;
+        item[n_items].entry.file_mtime = sbuf.st_mtime;
+        ++n_items;
+    }
+
+    /* Copy signals for the old entries that we are keeping. */
+    for (ii = 0; ii < n_old; ++ii)
+    {
+        if (item[ii].err || !item[ii].entry.n_signals)
+        {
+            continue;
+        }
+        item[ii].signal = malloc(item[ii].entry.n_signals * sizeof(*item[ii].signal));
+        if (!item[ii].signal)
+        {
+            res = ENOMEM;
+            goto out;
+        }
+        old_signal = srnx_catalog_signals(old, &item[ii].entry);
+        memcpy(item[ii].signal, old_signal,
+            item[ii].entry.n_signals * sizeof(*item[ii].signal));
+    }
+
+    /* Scan the new and changed files in parallel. */
+    n_scan = n_items - n_old;
+    if (n_threads < 1)
+    {
+        n_threads = 1;
+    }
+    if (n_threads > n_scan)
+    {
+        n_threads = n_scan;
+    }
+    work.item = item + n_old;
+    work.n_items = n_scan;
+    work.n_workers = 0;
+    node = NULL;
+    if (n_threads > 1 && srnx_numa_node_count() > 1)
+    {
+        /* Scan files on the nodes that already cache them. */
+        node = malloc(n_scan * sizeof(*node));
+        for (jj = 0; node && jj < n_scan; ++jj)
+        {
+            node[jj] = srnx_numa_file_node(work.item[jj].path);
+        }
+    }
+    res = srnx_numa_queue_create(&work.queue, n_scan, node);
+    free(node);
+    if (res)
+    {
+        goto out;
+    }
+    if (n_threads > 1)
+    {
+        thread = calloc(n_threads, sizeof(*thread));
+        if (!thread)
+        {
+            srnx_numa_queue_free(work.queue);
+            res = ENOMEM;
+            goto out;
+        }
+        for (jj = 0; jj < n_threads; ++jj)
+        {
+            if (pthread_create(thread + jj, NULL, scan_worker, &work))
+            {
+                break;
+            }
+        }
+        scan_thread(&work);
+        while (jj-- > 0)
+        {
+            pthread_join(thread[jj], NULL);
+        }
+        free(thread);
+    }
+    else
+    {
+        scan_thread(&work);
+    }
+    srnx_numa_queue_free(work.queue);
+
+    /* Count failures, ignoring superseded entries. */
+    for (jj = 0, n_failed = n_missing; jj < n_items; ++jj)
+    {
+        if (item[jj].err && item[jj].err != EEXIST)
+        {
+            ++n_failed;
+        }
+    }
+    if (p_n_failed)
+    {
+        *p_n_failed = n_failed;
+    }
+
+    /* Sort by key and write the new catalog. */
+    qsort(item, n_items, sizeof(*item), compare_item_key);
+    sprintf(tmp_name, "%s.tmp", out_filename);
+    fout = fopen(tmp_name, "wb");
+    if (!fout)
+    {
+        res = errno;
+        goto out;
+    }
+    res = write_catalog(fout, item, n_items);
+    if (fclose(fout) && !res)
+    {
+        res = errno;
+    }
+    if (!res && rename(tmp_name, out_filename) < 0)
+    {
+        res = errno;
+    }
+    if (res)
+    {
+        unlink(tmp_name);
+    }
+
+out:
+    if (item)
+    {
+        for (jj = 0; jj < (int)n_old + n_files; ++jj)
+        {
+            free(item[jj].signal);
+        }
+    }
+    free(item);
+    free(tmp_name);
+    srnx_catalog_close(old);
+    return res;
+}
+
+/* Doc comment in srnx_catalog.h. */
+int srnx_catalog_open(
+    struct srnx_catalog **p_cat,
+    const char filename[]
+)
+{
+    const struct srnx_catalog_header *header;
+    struct srnx_catalog *cat;
+    struct stat sbuf;
+    void *addr;
+    int fd, res;
+
+    fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return errno;
+    }
+    if (fstat(fd, &sbuf) < 0)
+    {
+        res = errno;
+        close(fd);
+        return res;
+    }
+    if ((size_t)sbuf.st_size < sizeof *header)
+    {
+        close(fd);
+        return SRNX_CORRUPT;
+    }
+
+    addr = mmap(NULL, sbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    res = errno;
+    close(fd);
+    if (addr == MAP_FAILED)
+    {
+        return res;
+    }
+
+    /* Validate the header and that each section fits in the file. */
+    header = addr;
+    if (memcmp(header->magic, catalog_magic, sizeof header->magic)
+        || header->version != CATALOG_VERSION
+        || header->entry_size != sizeof(struct srnx_catalog_entry)
+        || header->entries_offset + header->n_entries
+            * sizeof(struct srnx_catalog_entry) > header->signals_offset
+        || header->signals_offset + header->n_signals
+            * sizeof(struct srnx_catalog_signal) > header->strings_offset
+        || header->strings_offset + header->strings_size
+            > (uint64_t)sbuf.st_size)
+    {
+        munmap(addr, sbuf.st_size);
+        return SRNX_CORRUPT;
+    }
+
+    cat = calloc(1, sizeof *cat);
+    if (!cat)
+    {
+        munmap(addr, sbuf.st_size);
+        return ENOMEM;
+    }
+    cat->data = addr;
+    cat->data_size = sbuf.st_size;
+    cat->header = header;
+    cat->entry = (const void *)(cat->data + header->entries_offset);
+    cat->signal = (const void *)(cat->data + header->signals_offset);
+    cat->strings = cat->data + header->strings_offset;
+
+    srnx_catalog_close(*p_cat);
+    *p_cat = cat;
+    return 0;
+}
+
+/* Doc comment in srnx_catalog.h. */
+void srnx_catalog_close(
+    struct srnx_catalog *cat
+)
+{
+    if (!cat)
+    {
+        return;
+    }
+
+    munmap((void *)cat->data, cat->data_size);
+    free(cat);
+}
+
+/* Doc comment in srnx_catalog.h. */
+size_t srnx_catalog_size(
+    const struct srnx_catalog *cat
+)
+{
+    return cat->header->n_entries;
+}
+
+/* Doc comment in srnx_catalog.h. */
+const struct srnx_catalog_entry *srnx_catalog_entry(
+    const struct srnx_catalog *cat,
+    size_t idx
+)
+{
+    return cat->entry + idx;
+}
+
+/* Doc comment in srnx_catalog.h. */
+const char *srnx_catalog_path(
+    const struct srnx_catalog *cat,
+    const struct srnx_catalog_entry *entry
+)
+{
+    return cat->strings + entry->path_offset;
+}
+
+/* Doc comment in srnx_catalog.h. */
+const struct srnx_catalog_signal *srnx_catalog_signals(
+    const struct srnx_catalog *cat,
+    const struct srnx_catalog_entry *entry
+)
+{
+    return cat->signal + entry->signals_idx;
+}
+
+/** Returns the first index in [\a lo, \a hi) of \a cat whose marker
+ * is not less than \a marker and (if \a epoch is not NULL) whose
+ * first epoch is after (if \a after) or not before \a epoch.
+ */
+static size_t lower_bound(
+    const struct srnx_catalog *cat,
+    size_t lo,
+    size_t hi,
+    const char marker[64],
+    const struct rinex_epoch *epoch,
+    int after
+)
+{
+    const struct srnx_catalog_entry *entry;
+    size_t mid;
+    int cmp;
+
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        entry = cat->entry + mid;
+        cmp = strncmp(entry->marker, marker, sizeof entry->marker);
+        if (cmp == 0 && epoch)
+        {
+            cmp = compare_time(entry->first_yyyy_mm_dd, entry->first_hh_mm,
+                entry->first_sec_e7, epoch->yyyy_mm_dd, epoch->hh_mm,
+                epoch->sec_e7);
+            if (cmp == 0)
+            {
+                cmp = after ? -1 : 1;
+            }
+        }
+        else if (cmp == 0)
+        {
+            cmp = after ? -1 : 1;
+        }
+
+        if (cmp < 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+/** Returns non-zero if the epoch given as (date, minute of day,
+ * seconds) is before \a epoch.
+ */
+static int before_epoch(
+    int32_t date,
+    int32_t hh_mm,
+    int32_t sec_e7,
+    const struct rinex_epoch *epoch
+)
+{
+    return compare_time(date, hh_mm, sec_e7, epoch->yyyy_mm_dd,
+        epoch->hh_mm, epoch->sec_e7) < 0;
+}
+
+/* Doc comment in srnx_catalog.h. */
+int srnx_catalog_find(
+    const struct srnx_catalog *cat,
+    const char marker[],
+    const struct rinex_epoch *start,
+    const struct rinex_epoch *end,
+    size_t **p_idx,
+    size_t *p_count
+)
+{
+    const struct srnx_catalog_entry *entry;
+    size_t *idx;
+    char key[64];
+    size_t n, first, last, lo, back, count, ii;
+
+    memset(key, 0, sizeof key);
+    strncpy(key, marker, sizeof key - 1);
+
+    /* Find the station's entries. */
+    n = cat->header->n_entries;
+    lo = lower_bound(cat, 0, n, key, NULL, 0);
+    n = lower_bound(cat, lo, n, key, NULL, 1);
+
+    /* Entries that start after \a end cannot overlap, and all entries
+     * that start at or after \a start (but not after \a end) do.
+     */
+    last = end ? lower_bound(cat, lo, n, key, end, 1) : n;
+    first = start ? lower_bound(cat, lo, last, key, start, 0) : lo;
+
+    /* Earlier entries overlap if they end at or after \a start.  No
+     * entry before one whose running maximum of last epochs is before
+     * \a start can, so stop there.
+     */
+    for (back = first; start && back > lo; --back)
+    {
+        entry = cat->entry + back - 1;
+        if (before_epoch(entry->max_last_yyyy_mm_dd, entry->max_last_hh_mm,
+            entry->max_last_sec_e7, start))
+        {
+            break;
+        }
+    }
+
+    idx = srnx_reserve(*p_idx, (last - back + 1) * sizeof(*idx));
+    if (!idx)
+    {
+        return ENOMEM;
+    }
+    *p_idx = idx;
+
+    for (ii = back, count = 0; ii < first; ++ii)
+    {
+        entry = cat->entry + ii;
+        if (!before_epoch(entry->last_yyyy_mm_dd, entry->last_hh_mm,
+            entry->last_sec_e7, start))
+        {
+            idx[count++] = ii;
+        }
+    }
+    for (; ii < last; ++ii)
+    {
+        idx[count++] = ii;
+    }
+
+    *p_count = count;
+    return 0;
+}
@@ -0,0 +1,243 @@
+/** srnx_catalog.h - Index of metadata for many Succinct RINEX files.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(SRNX_CATALOG_H_5c1e0f7a_93d2_4b8e_a6f4_2d7b90c3e815)
+#define SRNX_CATALOG_H_5c1e0f7a_93d2_4b8e_a6f4_2d7b90c3e815
+
+#include "srnx.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/* A catalog file is a fixed header, an array of entries sorted by
+ * marker name and then first epoch, an array of signals (grouped by
+ * entry), and a table of NUL-terminated file names.  Integers are in
+ * host byte order, so a catalog is only portable between hosts with
+ * the same endianness.  Readers use the file through mmap() without
+ * copying or parsing it.
+ */
+
+/** srnx_catalog represents an open catalog file. */
+struct srnx_catalog;
+
+/** Describes one SRNX file in a catalog. */
+struct srnx_catalog_entry
+{
+    /** MARKER NAME from the RINEX header, without trailing spaces and
+     * padded with '\0'.
+     */
+    char marker[64];
+
+    /** Date of the first epoch, as in rinex_epoch::yyyy_mm_dd. */
+    int32_t first_yyyy_mm_dd;
+
+    /** Minute of day of the first epoch, as in rinex_epoch::hh_mm. */
+    int32_t first_hh_mm;
+
+    /** Seconds of minute of the first epoch, times 1e7. */
+    int32_t first_sec_e7;
+
+    /** Date of the last epoch. */
+    int32_t last_yyyy_mm_dd;
+
+    /** Minute of day of the last epoch. */
+    int32_t last_hh_mm;
+
+    /** Seconds of minute of the last epoch, times 1e7. */
+    int32_t last_sec_e7;
+
+    /** Date of the latest last epoch among this entry and the entries
+     * before it for the same marker.
+     */
+    int32_t max_last_yyyy_mm_dd;
+
+    /** Minute of day of that latest last epoch. */
+    int32_t max_last_hh_mm;
+
+    /** Seconds of minute of that latest last epoch, times 1e7. */
+    int32_t max_last_sec_e7;
+
+    /** Reserved; zero. */
+    int32_t reserved;
+
+    /** Interval between the first two epochs, in seconds times 1e7;
+     * zero if unknown.
+     */
+    int64_t interval_e7;
+
+    /** Number of epochs in the file. */
+    uint64_t n_epochs;
+
+    /** Size of the file when it was cataloged. */
+    uint64_t file_size;
+
+    /** Modification time (seconds since the Unix epoch) of the file
+     * when it was cataloged.
+     */
+    int64_t file_mtime;
+
+    /** Offset of the file name in the catalog's string table. */
+    uint64_t path_offset;
+
+    /** Index of this file's first signal in the catalog. */
+    uint64_t signals_idx;
+
+    /** Number of signals for this file. */
+    uint32_t n_signals;
+
+    /** Number of distinct satellites among this file's signals. */
+    uint32_t n_satellites;
+};
+
+/** Describes one (satellite, observation code) pair in a catalog. */
+struct srnx_catalog_signal
+{
+    /** Satellite name. */
+    struct srnx_satellite_name sat;
+
+    /** Observation code. */
+    struct srnx_obs_code code;
+
+    /** Number of observation values. */
+    uint64_t n_values;
+
+    /** File offset of the signal's SOCD chunk. */
+    uint64_t socd_offset;
+};
+
+/** Builds a catalog file from a list of SRNX files.
+ *
+ * If \a old_filename names an existing catalog, its entries are carried
+ * over, and files in \a filename whose size and modification time
+ * match their old entry are not reopened.  \a old_filename may be the
+ * same as \a out_filename; the new catalog is written to a temporary
+ * file and renamed into place.
+ *
+ * \param[in] out_filename Name of the catalog file to write.
+ * \param[in] old_filename Name of an existing catalog, or NULL.
+ * \param[in] n_files Number of SRNX files in \a filename.
+ * \param[in] filename Names of SRNX files to add or refresh.
+ * \param[in] n_threads Number of threads to scan files with; values
+ *   less than one mean one.  The threads are placed as described in
+ *   srnx_numa.h.
+ * \param[out] p_n_failed If not NULL, receives the number of files that
+ *   could not be read (and were left out of the catalog).
+ * \returns Zero on success, non-zero SRNX error number on error.
+ */
+int srnx_catalog_build(
+    const char out_filename[],
+    const char old_filename[],
+    int n_files,
+    const char *const filename[],
+    int n_threads,
+    int *p_n_failed
+);
+
+/** Opens a catalog file.
+ *
+ * \param[out] p_cat Receives a pointer to the catalog object.
+ * \param[in] filename Name of the catalog file.
+ * \returns Zero on success, non-zero SRNX error number on error.
+ */
+int srnx_catalog_open(
+    struct srnx_catalog **p_cat,
+    const char filename[]
+);
+
+/** Closes a catalog file and releases its resources.
+ *
+ * \param[in] cat Catalog object to close; may be NULL.
+ */
+void srnx_catalog_close(
+    struct srnx_catalog *cat
+);
+
+/** Returns the number of entries in \a cat. */
+size_t srnx_catalog_size(
+    const struct srnx_catalog *cat
+);
+
+/** Returns a pointer to the \a idx'th entry in \a cat.
+ *
+ * \param[in] cat Catalog object.
+ * \param[in] idx Index of the entry; must be less than
+ *   srnx_catalog_size(\a cat).
+ * \returns A pointer into the catalog, valid until it is closed.
+ */
+const struct srnx_catalog_entry *srnx_catalog_entry(
+    const struct srnx_catalog *cat,
+    size_t idx
+);
+
+/** Returns the file name for an entry in \a cat. */
+const char *srnx_catalog_path(
+    const struct srnx_catalog *cat,
+    const struct srnx_catalog_entry *entry
+);
+
+/** Returns the signals for an entry in \a cat; there are
+ * \a entry->n_signals of them.
+ */
+const struct srnx_catalog_signal *srnx_catalog_signals(
+    const struct srnx_catalog *cat,
+    const struct srnx_catalog_entry *entry
+);
+
+/** Finds the entries for a station that overlap a time span.
+ *
+ * An entry overlaps the span if its first epoch is not after \a end
+ * and its last epoch is not before \a start.  Because one file can
+ * cover another that starts later and ends sooner, the matching
+ * entries need not be consecutive in the catalog.
+ *
+ * This takes O(log n) time for n entries, plus the number of entries
+ * for the station that start before \a start but do not end before
+ * it (or that lie between such entries), plus the number of matches.
+ *
+ * \param[in] cat Catalog object.
+ * \param[in] marker Marker name to search for.
+ * \param[in] start Start of the time span, or NULL for no lower bound.
+ * \param[in] end End of the time span, or NULL for no upper bound.
+ * \param[in,out] p_idx Receives a pointer to the indices of the
+ *   matching entries, in increasing order.  The array should be freed
+ *   with srnx_free().
+ * \param[out] p_count Receives the number of matching entries.
+ * \returns Zero on success (even if no entries match), non-zero SRNX
+ *   error number on error.
+ */
+int srnx_catalog_find(
+    const struct srnx_catalog *cat,
+    const char marker[],
+    const struct rinex_epoch *start,
+    const struct rinex_epoch *end,
+    size_t **p_idx,
+    size_t *p_count
+);
+
+#if defined(__cplusplus)
+}
+#endif /* defined(__cplusplus) */
+
+#endif /* !defined(SRNX_CATALOG_H_5c1e0f7a_93d2_4b8e_a6f4_2d7b90c3e815) */
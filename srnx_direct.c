@@ -0,0 +1,57 @@
+/** srnx_direct.c - Direct I/O control for the SRNX pread backend.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* glibc only names O_DIRECT under _GNU_SOURCE, which the rest of the
+ * library does not define, so the fcntl() calls live in this file.
+ */
+#define _GNU_SOURCE
+
+#include "srnx_p.h"
+
+#include <errno.h>
+#include <fcntl.h>
+
+/* Doc comment in srnx_p.h. */
+int srnx_set_direct_io(int fd, int enable)
+{
+#if defined(O_DIRECT)
+    int flags;
+
+    flags = fcntl(fd, F_GETFL);
+    if (flags < 0)
+    {
+        return errno;
+    }
+    flags = enable ? (flags | O_DIRECT) : (flags & ~O_DIRECT);
+    if (fcntl(fd, F_SETFL, flags) < 0)
+    {
+        return errno;
+    }
+
+    return 0;
+#else
+    (void)fd;
+    return enable ? ENOTSUP : 0;
+#endif
+}
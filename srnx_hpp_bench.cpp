@@ -0,0 +1,245 @@
+/** srnx_hpp_bench.cpp - Compares the C++ wrappers against the C API.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Each benchmark runs a C API loop and the equivalent C++ loop the
+ * same number of times and prints nanoseconds per iteration for both,
+ * in the style of Google Benchmark's console output.  Usage:
+ *   srnx_hpp_bench [file.srnx [file.rnx]]
+ * Without arguments, only the in-memory benchmarks run.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "rinex.hpp"
+#include "srnx.hpp"
+
+namespace
+{
+
+/** Keeps the compiler from discarding a benchmark's result. */
+volatile double sink;
+
+/** Runs \a fn \a n_iter times and reports the time per iteration. */
+template <typename Fn>
+void run(const char *name, int n_iter, Fn fn)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int ii = 0; ii < n_iter; ++ii)
+    {
+        sink = fn();
+    }
+    auto stop = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+    std::printf("%-32s %12.0f ns %10d\n", name, ns / n_iter, n_iter);
+}
+
+void bench_columns()
+{
+    const std::size_t n = 1 << 16;
+    std::vector<std::int64_t> raw(n), work(n);
+    const int n_iter = 2000;
+
+    for (std::size_t ii = 0; ii < n; ++ii)
+    {
+        raw[ii] = 20000000000LL + (std::int64_t)(ii * 7919 % 100003);
+    }
+
+    run("BM_C_ConvertSum", n_iter, [&] {
+        std::memcpy(work.data(), raw.data(), n * sizeof raw[0]);
+        srnx_convert_s64_to_double(work.data(), n, 1);
+        const double *d = reinterpret_cast<const double *>(work.data());
+        double sum = 0.0;
+        for (std::size_t ii = 0; ii < n; ++ii)
+        {
+            sum += d[ii];
+        }
+        return sum;
+    });
+
+    run("BM_C_ScaleSum", n_iter, [&] {
+        const std::int64_t *p = raw.data();
+        double sum = 0.0;
+        for (std::size_t ii = 0; ii < n; ++ii)
+        {
+            sum += (double)p[ii] * 0.001;
+        }
+        return sum;
+    });
+
+    run("BM_Cxx_ColumnViewSum<double>", n_iter, [&] {
+        srnx::column_view<double> view(
+            srnx::span<const std::int64_t>(raw.data(), n));
+        double sum = 0.0;
+        for (double v : view)
+        {
+            sum += v;
+        }
+        return sum;
+    });
+
+    run("BM_C_Sum<int64_t>", n_iter, [&] {
+        const std::int64_t *p = raw.data();
+        std::int64_t sum = 0;
+        for (std::size_t ii = 0; ii < n; ++ii)
+        {
+            sum += p[ii];
+        }
+        return (double)sum;
+    });
+
+    run("BM_Cxx_ColumnViewSum<int64_t>", n_iter, [&] {
+        srnx::column_view<std::int64_t> view(
+            srnx::span<const std::int64_t>(raw.data(), n));
+        std::int64_t sum = 0;
+        for (std::int64_t v : view)
+        {
+            sum += v;
+        }
+        return (double)sum;
+    });
+}
+
+void bench_srnx(const char *filename)
+{
+    struct srnx_reader *c_srnx = nullptr;
+    struct srnx_satellite_name *names = nullptr;
+    std::int64_t *obs = nullptr;
+    char *lli = nullptr, *ssi = nullptr;
+    std::uint64_t n_names = 0;
+    int res, idx = 0, n_values;
+    const int n_iter = 1000;
+
+    res = srnx_open(&c_srnx, filename);
+    if (!res)
+    {
+        res = srnx_get_satellites(c_srnx, &names, &n_names);
+    }
+    if (res || n_names == 0)
+    {
+        std::fprintf(stderr, "Unable to read %s: %s\n", filename,
+            srnx_strerror(res));
+        srnx_free(names);
+        srnx_close(c_srnx);
+        return;
+    }
+
+    run("BM_C_GetObsByIndex", n_iter, [&] {
+        double sum = 0.0;
+        if (srnx_get_obs_by_index(c_srnx, names[0], 1, &idx, &n_values,
+            &obs, &lli, &ssi))
+        {
+            return sum;
+        }
+        for (int ii = 0; ii < n_values; ++ii)
+        {
+            sum += obs[ii] * 0.001;
+        }
+        return sum;
+    });
+
+    srnx::reader rdr(filename);
+    srnx::column col;
+    run("BM_Cxx_ReaderRead", n_iter, [&] {
+        double sum = 0.0;
+        rdr.read(names[0], idx, col);
+        for (double v : col.as<double>())
+        {
+            sum += v;
+        }
+        return sum;
+    });
+
+    srnx_free(obs);
+    srnx_free(lli);
+    srnx_free(ssi);
+    srnx_free(names);
+    srnx_close(c_srnx);
+}
+
+void bench_rinex(const char *filename)
+{
+    const int n_iter = 10;
+
+    run("BM_C_ParseRecords", n_iter, [&] {
+        struct rinex_parser *p = nullptr;
+        struct rinex_stream *s = rinex_mmap_stream(filename);
+        double count = 0;
+        if (s && !rinex_open(&p, s))
+        {
+            while (p->read(p) == RINEX_SUCCESS)
+            {
+                count += p->epoch.n_sats;
+            }
+        }
+        if (p)
+        {
+            p->destroy(p);
+        }
+        if (s)
+        {
+            s->destroy(s);
+        }
+        return count;
+    });
+
+    run("BM_Cxx_ParseRecords", n_iter, [&] {
+        rinex::parser p(filename);
+        double count = 0;
+        for (const rinex_parser &rec : p.records())
+        {
+            count += rec.epoch.n_sats;
+        }
+        return count;
+    });
+}
+
+} /* namespace */
+
+int main(int argc, char *argv[])
+{
+    std::printf("%-32s %15s %10s\n", "Benchmark", "Time", "Iterations");
+    bench_columns();
+    try
+    {
+        if (argc > 1)
+        {
+            bench_srnx(argv[1]);
+        }
+        if (argc > 2)
+        {
+            bench_rinex(argv[2]);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::fprintf(stderr, "Benchmark failed: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
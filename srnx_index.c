@@ -0,0 +1,142 @@
+/** srnx_index.c - Builds and queries catalogs of Succinct RINEX files.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "srnx_catalog.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "Usage:\n"
+        " %s [-j threads] catalog file.srnx...\n"
+        "    Adds or refreshes files in catalog.\n"
+        " %s -q catalog marker [yyyymmdd [yyyymmdd]]\n"
+        "    Lists files for marker, optionally within a date range.\n",
+        argv0, argv0);
+}
+
+static void print_entry(
+    const struct srnx_catalog *cat,
+    const struct srnx_catalog_entry *entry
+)
+{
+    printf("%s %08d %04d %9d %08d %04d %9d %llu epochs %u sats %u signals\n",
+        srnx_catalog_path(cat, entry),
+        entry->first_yyyy_mm_dd, entry->first_hh_mm, entry->first_sec_e7,
+        entry->last_yyyy_mm_dd, entry->last_hh_mm, entry->last_sec_e7,
+        (unsigned long long)entry->n_epochs, entry->n_satellites,
+        entry->n_signals);
+}
+
+static int query(int argc, char *argv[])
+{
+    struct srnx_catalog *cat = NULL;
+    struct rinex_epoch start, end;
+    size_t *idx = NULL;
+    size_t count, ii;
+    int res;
+
+    res = srnx_catalog_open(&cat, argv[0]);
+    if (res)
+    {
+        fprintf(stderr, "Unable to open %s: %s\n", argv[0], srnx_strerror(res));
+        return EXIT_FAILURE;
+    }
+
+    memset(&start, 0, sizeof start);
+    memset(&end, 0, sizeof end);
+    if (argc > 2)
+    {
+        start.yyyy_mm_dd = strtol(argv[2], NULL, 10);
+    }
+    if (argc > 3)
+    {
+        end.yyyy_mm_dd = strtol(argv[3], NULL, 10);
+        end.hh_mm = 2359;
+        end.sec_e7 = 609999999;
+    }
+
+    res = srnx_catalog_find(cat, argv[1], (argc > 2) ? &start : NULL,
+        (argc > 3) ? &end : NULL, &idx, &count);
+    if (res)
+    {
+        fprintf(stderr, "Unable to search %s: %s\n", argv[0], srnx_strerror(res));
+        srnx_catalog_close(cat);
+        return EXIT_FAILURE;
+    }
+
+    for (ii = 0; ii < count; ++ii)
+    {
+        print_entry(cat, srnx_catalog_entry(cat, idx[ii]));
+    }
+
+    srnx_free(idx);
+    srnx_catalog_close(cat);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    int res, n_threads, n_failed, ii;
+
+    n_threads = 1;
+    for (ii = 1; ii < argc && argv[ii][0] == '-'; ++ii)
+    {
+        if (!strcmp(argv[ii], "-q") && argc - ii >= 3 && argc - ii <= 5)
+        {
+            return query(argc - ii - 1, argv + ii + 1);
+        }
+        else if (!strcmp(argv[ii], "-j") && ii + 1 < argc)
+        {
+            n_threads = strtol(argv[++ii], NULL, 10);
+        }
+        else
+        {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (argc - ii < 2)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    res = srnx_catalog_build(argv[ii], argv[ii], argc - ii - 1,
+        (const char *const *)argv + ii + 1, n_threads, &n_failed);
+    if (res)
+    {
+        fprintf(stderr, "Unable to build %s: %s\n", argv[ii], srnx_strerror(res));
+        return EXIT_FAILURE;
+    }
+    if (n_failed)
+    {
+        fprintf(stderr, "%d files could not be read\n", n_failed);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,668 @@
+/** srnx_numa.c - NUMA placement for Succinct RINEX worker threads.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "srnx_numa.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+# include <linux/mempolicy.h>
+# include <sys/syscall.h>
+#endif
+
+#if !defined(O_CLOEXEC)
+# define O_CLOEXEC 0
+#endif
+
+/** Number of pages that srnx_numa_addr_node() and srnx_numa_file_node()
+ * look at.
+ */
+#define NUMA_SAMPLE_PAGES 16
+
+/** numa_topology describes NUMA nodes and their CPUs. */
+struct numa_topology
+{
+    /** Number of nodes; zero if NUMA placement is disabled. */
+    int n_nodes;
+
+    /** Non-zero if the topology came from a CPU list rather than the
+     * kernel, so #node_id means nothing to the kernel.
+     */
+    int from_list;
+
+    /** Kernel node number of each node. */
+    int node_id[SRNX_NUMA_MAX_NODES];
+
+    /** Index in #cpu of each node's first CPU, and then the number of
+     * CPUs in #cpu.
+     */
+    int first_cpu[SRNX_NUMA_MAX_NODES + 1];
+
+    /** CPU numbers, grouped by node. */
+    short cpu[SRNX_NUMA_MAX_CPUS];
+};
+
+/* Doc comment in srnx_numa.h. */
+struct srnx_numa_queue
+{
+    /** Number of buckets: one per node, then one for unknown nodes. */
+    int n_buckets;
+
+    /** Start of each bucket in #item, and then the number of items. */
+    int *start;
+
+    /** Number of items taken from each bucket; this may pass the
+     * bucket's size.
+     */
+    int *taken;
+
+    /** Item numbers, grouped by bucket. */
+    int *item;
+};
+
+/** The topology in use. */
+static struct numa_topology numa_topology;
+
+/** Makes sure numa_init() runs once. */
+static pthread_once_t numa_once = PTHREAD_ONCE_INIT;
+
+/** Parses a comma-separated list of CPUs and CPU ranges.
+ *
+ * \param[in,out] p_str Start of the list; receives the first character
+ *   after it (a ';', newline or '\0').
+ * \param[in,out] topo Topology to append CPUs to.
+ * \param[in,out] p_n_cpus Number of CPUs in \a topo->cpu.
+ * \returns Zero on success, else EINVAL.
+ */
+static int numa_parse_cpus(
+    const char **p_str,
+    struct numa_topology *topo,
+    int *p_n_cpus
+)
+{
+    const char *str;
+    char *end;
+    long lo, hi;
+
+    str = *p_str;
+    while (*str != '\0' && *str != ';' && *str != '\n')
+    {
+        lo = strtol(str, &end, 10);
+        if (end == str || lo < 0)
+        {
+            return EINVAL;
+        }
+        hi = lo;
+        if (*end == '-')
+        {
+            str = end + 1;
+            hi = strtol(str, &end, 10);
+            if (end == str || hi < lo)
+            {
+                return EINVAL;
+            }
+        }
+        if (hi >= SRNX_NUMA_MAX_CPUS
+            || *p_n_cpus + (hi - lo) >= SRNX_NUMA_MAX_CPUS)
+        {
+            return EINVAL;
+        }
+        while (lo <= hi)
+        {
+            topo->cpu[(*p_n_cpus)++] = lo++;
+        }
+
+        str = end;
+        if (*str == ',')
+        {
+            ++str;
+        }
+    }
+
+    *p_str = str;
+    return 0;
+}
+
+/** Reads the topology from /sys/devices/system/node.
+ *
+ * Nodes without CPUs, and nodes past #SRNX_NUMA_MAX_NODES, are left
+ * out.  If there is no such directory, the topology is left disabled.
+ *
+ * \param[out] topo Receives the topology.
+ */
+static void numa_read_kernel(struct numa_topology *topo)
+{
+    char path[64], line[4096];
+    const char *str;
+    FILE *fin;
+    int id, n_cpus, res;
+
+    memset(topo, 0, sizeof *topo);
+    for (id = n_cpus = 0; id < SRNX_NUMA_MAX_NODES; ++id)
+    {
+        snprintf(path, sizeof path, "/sys/devices/system/node/node%d/cpulist",
+            id);
+        fin = fopen(path, "r");
+        if (!fin)
+        {
+            continue;
+        }
+        str = fgets(line, sizeof line, fin);
+        fclose(fin);
+
+        topo->first_cpu[topo->n_nodes] = n_cpus;
+        res = str ? numa_parse_cpus(&str, topo, &n_cpus) : EINVAL;
+        if (res)
+        {
+            n_cpus = topo->first_cpu[topo->n_nodes];
+            continue;
+        }
+        if (n_cpus > topo->first_cpu[topo->n_nodes])
+        {
+            topo->node_id[topo->n_nodes++] = id;
+        }
+    }
+    topo->first_cpu[topo->n_nodes] = n_cpus;
+}
+
+/** Parses a topology specification, as for srnx_numa_select().
+ *
+ * \param[in] spec Topology specification.
+ * \param[out] topo Receives the topology.
+ * \returns Zero on success, else EINVAL.
+ */
+static int numa_parse(const char *spec, struct numa_topology *topo)
+{
+    int n_cpus, res;
+
+    if (!spec || !strcmp(spec, "auto"))
+    {
+        numa_read_kernel(topo);
+        return 0;
+    }
+
+    memset(topo, 0, sizeof *topo);
+    if (!strcmp(spec, "off"))
+    {
+        return 0;
+    }
+
+    topo->from_list = 1;
+    for (n_cpus = 0; ; ++spec)
+    {
+        if (topo->n_nodes == SRNX_NUMA_MAX_NODES)
+        {
+            return EINVAL;
+        }
+        topo->node_id[topo->n_nodes] = topo->n_nodes;
+        topo->first_cpu[topo->n_nodes] = n_cpus;
+        res = numa_parse_cpus(&spec, topo, &n_cpus);
+        if (res || n_cpus == topo->first_cpu[topo->n_nodes])
+        {
+            return EINVAL;
+        }
+        ++topo->n_nodes;
+        if (*spec != ';')
+        {
+            break;
+        }
+    }
+    topo->first_cpu[topo->n_nodes] = n_cpus;
+
+    return *spec ? EINVAL : 0;
+}
+
+/** Sets the default topology, from $SRNX_NUMA or the kernel. */
+static void numa_init(void)
+{
+    if (numa_parse(getenv("SRNX_NUMA"), &numa_topology))
+    {
+        numa_parse(NULL, &numa_topology);
+    }
+}
+
+/** Returns the topology in use. */
+static const struct numa_topology *numa_get(void)
+{
+    pthread_once(&numa_once, numa_init);
+    return &numa_topology;
+}
+
+/** Picks the node that holds the most pages.
+ *
+ * \param[in] topo Topology in use.
+ * \param[in] status Kernel node numbers, or negative error numbers, as
+ *   from move_pages().
+ * \param[in] count Number of entries in \a status.
+ * \returns The most common node, or -1 if no page is on a known node.
+ */
+static int numa_vote(
+    const struct numa_topology *topo,
+    const int status[],
+    int count
+)
+{
+    int votes[SRNX_NUMA_MAX_NODES];
+    int ii, jj, best;
+
+    memset(votes, 0, sizeof votes);
+    for (ii = 0; ii < count; ++ii)
+    {
+        for (jj = 0; status[ii] >= 0 && jj < topo->n_nodes; ++jj)
+        {
+            if (topo->node_id[jj] == status[ii])
+            {
+                ++votes[jj];
+                break;
+            }
+        }
+    }
+
+    for (ii = 1, best = 0; ii < topo->n_nodes; ++ii)
+    {
+        if (votes[ii] > votes[best])
+        {
+            best = ii;
+        }
+    }
+
+    return votes[best] ? best : -1;
+}
+
+/** Finds the nodes of pages in our address space.
+ *
+ * \param[in] topo Topology in use.
+ * \param[in] pages Addresses of the pages.
+ * \param[in] count Number of entries in \a pages.
+ * \returns The most common node, or -1 if none is known.
+ */
+static int numa_pages_node(
+    const struct numa_topology *topo,
+    void *pages[],
+    int count
+)
+{
+#if defined(__linux__) && defined(SYS_move_pages)
+    int status[NUMA_SAMPLE_PAGES];
+
+    if (count > 0
+        && syscall(SYS_move_pages, 0, (unsigned long)count, pages, NULL,
+            status, 0) >= 0)
+    {
+        return numa_vote(topo, status, count);
+    }
+#else
+    (void)topo;
+    (void)pages;
+    (void)count;
+#endif
+
+    return -1;
+}
+
+/* Doc comment in srnx_numa.h. */
+int srnx_numa_select(const char *spec)
+{
+    struct numa_topology topo;
+
+    pthread_once(&numa_once, numa_init);
+    if (numa_parse(spec, &topo))
+    {
+        return EINVAL;
+    }
+    numa_topology = topo;
+
+    return 0;
+}
+
+/* Doc comment in srnx_numa.h. */
+int srnx_numa_node_count(void)
+{
+    const struct numa_topology *topo = numa_get();
+
+    return (topo->n_nodes > 0) ? topo->n_nodes : 1;
+}
+
+/* Doc comment in srnx_numa.h. */
+int srnx_numa_current_node(void)
+{
+#if defined(__linux__) && defined(SYS_getcpu)
+    const struct numa_topology *topo = numa_get();
+    unsigned int cpu;
+    int ii, jj;
+
+    if (topo->n_nodes < 2 || syscall(SYS_getcpu, &cpu, NULL, NULL) < 0)
+    {
+        return 0;
+    }
+    for (ii = 0; ii < topo->n_nodes; ++ii)
+    {
+        for (jj = topo->first_cpu[ii]; jj < topo->first_cpu[ii + 1]; ++jj)
+        {
+            if ((unsigned int)topo->cpu[jj] == cpu)
+            {
+                return ii;
+            }
+        }
+    }
+#endif
+
+    return 0;
+}
+
+#if defined(__linux__)
+/** Number of bits in each word of a CPU mask. */
+#define NUMA_MASK_BITS (8 * (int)sizeof(unsigned long))
+
+/** Number of words in a CPU mask. */
+#define NUMA_MASK_WORDS (SRNX_NUMA_MAX_CPUS / NUMA_MASK_BITS)
+
+/** Builds the mask of a node's CPUs that the thread may run on.
+ *
+ * \param[in] topo Topology in use.
+ * \param[in] node Index of the node in \a topo.
+ * \param[in] allowed CPUs that the thread may run on.
+ * \param[out] mask Receives the node's CPUs that are in \a allowed.
+ * \returns The number of CPUs in \a mask.
+ */
+static int numa_node_mask(
+    const struct numa_topology *topo,
+    int node,
+    const unsigned long allowed[NUMA_MASK_WORDS],
+    unsigned long mask[NUMA_MASK_WORDS]
+)
+{
+    unsigned long bit;
+    int ii, word, count;
+
+    memset(mask, 0, NUMA_MASK_WORDS * sizeof mask[0]);
+    for (ii = topo->first_cpu[node], count = 0;
+        ii < topo->first_cpu[node + 1]; ++ii)
+    {
+        word = topo->cpu[ii] / NUMA_MASK_BITS;
+        bit = 1ul << (topo->cpu[ii] % NUMA_MASK_BITS);
+        if ((allowed[word] & bit) && !(mask[word] & bit))
+        {
+            mask[word] |= bit;
+            ++count;
+        }
+    }
+
+    return count;
+}
+#endif
+
+/* Doc comment in srnx_numa.h. */
+int srnx_numa_bind_worker(int worker)
+{
+    const struct numa_topology *topo = numa_get();
+    int node;
+
+    if (topo->n_nodes < 2 || worker < 0)
+    {
+        return 0;
+    }
+    node = worker % topo->n_nodes;
+
+#if defined(__linux__)
+    {
+        unsigned long allowed[NUMA_MASK_WORDS], mask[NUMA_MASK_WORDS];
+        unsigned long nodes;
+        int usable[SRNX_NUMA_MAX_NODES];
+        int n_usable, ii;
+
+        /* Only consider nodes with CPUs that we may run on, so that a
+         * worker started under taskset or a cpuset still gets a node
+         * and a mask that the kernel accepts.
+         */
+        memset(allowed, 0, sizeof allowed);
+        if (syscall(SYS_sched_getaffinity, 0, sizeof allowed, allowed) < 0)
+        {
+            return node;
+        }
+        for (ii = n_usable = 0; ii < topo->n_nodes; ++ii)
+        {
+            if (numa_node_mask(topo, ii, allowed, mask) > 0)
+            {
+                usable[n_usable++] = ii;
+            }
+        }
+        if (!n_usable)
+        {
+            return node;
+        }
+
+        /* Pin to all of the node's allowed CPUs rather than one of
+         * them, so that workers from different processes do not pile
+         * onto the same CPU.  Only ask for local memory if the thread
+         * really runs on the node.
+         */
+        node = usable[worker % n_usable];
+        numa_node_mask(topo, node, allowed, mask);
+        if (syscall(SYS_sched_setaffinity, 0, sizeof mask, mask) < 0)
+        {
+            return node;
+        }
+
+        /* set_mempolicy() counts one more node than the mask holds. */
+        if (!topo->from_list && topo->node_id[node] < NUMA_MASK_BITS)
+        {
+            nodes = 1ul << topo->node_id[node];
+            (void)syscall(SYS_set_mempolicy, MPOL_PREFERRED, &nodes,
+                NUMA_MASK_BITS + 1);
+        }
+    }
+#endif
+
+    return node;
+}
+
+/* Doc comment in srnx_numa.h. */
+int srnx_numa_addr_node(const void *addr, size_t len)
+{
+    const struct numa_topology *topo = numa_get();
+    void *pages[NUMA_SAMPLE_PAGES];
+    uintptr_t start;
+    size_t n_pages, n_sample, ii;
+    long page;
+
+    page = sysconf(_SC_PAGESIZE);
+    if (topo->n_nodes < 2 || !len || page <= 0)
+    {
+        return -1;
+    }
+
+    start = (uintptr_t)addr & -(uintptr_t)page;
+    n_pages = ((uintptr_t)addr + len - start + page - 1) / page;
+    n_sample = (n_pages < NUMA_SAMPLE_PAGES) ? n_pages : NUMA_SAMPLE_PAGES;
+    for (ii = 0; ii < n_sample; ++ii)
+    {
+        pages[ii] = (void *)(start + (n_pages * ii / n_sample) * page);
+    }
+
+    return numa_pages_node(topo, pages, n_sample);
+}
+
+/* Doc comment in srnx_numa.h. */
+int srnx_numa_file_node(const char filename[])
+{
+    const struct numa_topology *topo = numa_get();
+    void *pages[NUMA_SAMPLE_PAGES];
+    struct stat sbuf;
+    char *map, *pg;
+    size_t n_pages, n_sample, ii;
+    unsigned char resident;
+    long page;
+    int fd, n_resident, node;
+
+    page = sysconf(_SC_PAGESIZE);
+    if (topo->n_nodes < 2 || page <= 0)
+    {
+        return -1;
+    }
+
+    fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    if (fstat(fd, &sbuf) < 0 || sbuf.st_size <= 0)
+    {
+        close(fd);
+        return -1;
+    }
+    map = mmap(NULL, sbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return -1;
+    }
+
+    /* Fault in (without reading) the sampled pages that are cached, so
+     * move_pages() can tell where they are.
+     */
+    n_pages = (sbuf.st_size + page - 1) / page;
+    n_sample = (n_pages < NUMA_SAMPLE_PAGES) ? n_pages : NUMA_SAMPLE_PAGES;
+    for (ii = 0, n_resident = 0; ii < n_sample; ++ii)
+    {
+        pg = map + (n_pages * ii / n_sample) * page;
+        if (!mincore(pg, page, &resident) && (resident & 1))
+        {
+            (void)*(volatile const char *)pg;
+            pages[n_resident++] = pg;
+        }
+    }
+    node = numa_pages_node(topo, pages, n_resident);
+
+    munmap(map, sbuf.st_size);
+    return node;
+}
+
+/* Doc comment in srnx_numa.h. */
+int srnx_numa_queue_create(
+    struct srnx_numa_queue **p_queue,
+    int n_items,
+    const int node[]
+)
+{
+    struct srnx_numa_queue *queue;
+    int n_nodes, ii, bucket;
+
+    n_nodes = srnx_numa_node_count();
+    queue = malloc(sizeof *queue
+        + (2 * (n_nodes + 1) + 1 + n_items) * sizeof(int));
+    if (!queue)
+    {
+        return ENOMEM;
+    }
+    queue->n_buckets = n_nodes + 1;
+    queue->start = (int *)(queue + 1);
+    queue->taken = queue->start + queue->n_buckets + 1;
+    queue->item = queue->taken + queue->n_buckets;
+
+    /* Count the items in each bucket, then place them.  #taken serves
+     * as the fill cursor for each bucket.
+     */
+    memset(queue->start, 0, (2 * queue->n_buckets + 1) * sizeof(int));
+    for (ii = 0; ii < n_items; ++ii)
+    {
+        bucket = (node && node[ii] >= 0 && node[ii] < n_nodes)
+            ? node[ii] : n_nodes;
+        ++queue->start[bucket + 1];
+    }
+    for (ii = 0; ii < queue->n_buckets; ++ii)
+    {
+        queue->start[ii + 1] += queue->start[ii];
+    }
+    for (ii = 0; ii < n_items; ++ii)
+    {
+        bucket = (node && node[ii] >= 0 && node[ii] < n_nodes)
+            ? node[ii] : n_nodes;
+        queue->item[queue->start[bucket] + queue->taken[bucket]++] = ii;
+    }
+    memset(queue->taken, 0, queue->n_buckets * sizeof(int));
+
+    *p_queue = queue;
+    return 0;
+}
+
+/** Takes the next item from one bucket of \a queue.
+ *
+ * \param[in] queue Work queue.
+ * \param[in] bucket Bucket to take from.
+ * \returns The item number, or -1 if the bucket is empty.
+ */
+static int numa_queue_take(struct srnx_numa_queue *queue, int bucket)
+{
+    int size, idx;
+
+    size = queue->start[bucket + 1] - queue->start[bucket];
+    if (__atomic_load_n(queue->taken + bucket, __ATOMIC_RELAXED) >= size)
+    {
+        return -1;
+    }
+    idx = __atomic_fetch_add(queue->taken + bucket, 1, __ATOMIC_RELAXED);
+
+    return (idx < size) ? queue->item[queue->start[bucket] + idx] : -1;
+}
+
+/* Doc comment in srnx_numa.h. */
+int srnx_numa_queue_next(struct srnx_numa_queue *queue, int node)
+{
+    int n_nodes, idx, ii;
+
+    n_nodes = queue->n_buckets - 1;
+    if (node < 0 || node >= n_nodes)
+    {
+        node = 0;
+    }
+
+    idx = numa_queue_take(queue, node);
+    if (idx < 0)
+    {
+        idx = numa_queue_take(queue, n_nodes);
+    }
+    for (ii = 1; idx < 0 && ii < n_nodes; ++ii)
+    {
+        idx = numa_queue_take(queue, (node + ii) % n_nodes);
+    }
+
+    return idx;
+}
+
+/* Doc comment in srnx_numa.h. */
+void srnx_numa_queue_free(struct srnx_numa_queue *queue)
+{
+    free(queue);
+}
@@ -0,0 +1,159 @@
+/** srnx_numa.h - NUMA placement for Succinct RINEX worker threads.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(SRNX_NUMA_H_91b4b36d_9fec_411a_89c8_c7309b1b1f44)
+#define SRNX_NUMA_H_91b4b36d_9fec_411a_89c8_c7309b1b1f44
+
+#include <stddef.h>
+
+/* On machines with more than one NUMA node, threads that the library
+ * and its tools start to scan or decode files (srnx_catalog_update(),
+ * srnx_verify and the Python module's read_files()) call
+ * srnx_numa_bind_worker().  That pins each worker to the CPUs of one
+ * node, spreads the workers round-robin over the nodes that the process
+ * may run on, and makes the kernel prefer the worker's node for its
+ * memory, so that parser buffers, decoded columns and the per-thread
+ * srnx_obs_reader pool are allocated locally on first touch.  Files are then handed out by a
+ * srnx_numa_queue, which gives each worker the files whose cached
+ * pages are already on its node before any others.
+ *
+ * The topology normally comes from /sys/devices/system/node.  The
+ * SRNX_NUMA environment variable, or srnx_numa_select(), overrides it:
+ * "off" disables all of this, and a list such as "0-3,8-11;4-7,12-15"
+ * gives the CPUs of each node, with nodes separated by semicolons.
+ * A list need not match the hardware, so a single-node machine can
+ * exercise the multi-node paths; memory policies are only set for
+ * topologies read from the kernel.
+ */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/** Maximum number of NUMA nodes that srnx_numa functions handle. */
+#define SRNX_NUMA_MAX_NODES 64
+
+/** Maximum number of CPUs that srnx_numa functions handle. */
+#define SRNX_NUMA_MAX_CPUS 1024
+
+/** srnx_numa_queue hands out work items, preferring items whose data
+ * is on the caller's node.
+ */
+struct srnx_numa_queue;
+
+/** Sets the NUMA topology used by the other srnx_numa functions.
+ *
+ * This is not thread-safe: call it before starting work that uses
+ * the topology.  Without a call, the first use of the topology
+ * behaves as if this were called with getenv("SRNX_NUMA").
+ *
+ * \param[in] spec "off", a list of CPU lists as described above, or
+ *   NULL or "auto" to read the topology from the kernel.
+ * \returns Zero on success, or EINVAL (leaving the topology
+ *   unchanged) if \a spec cannot be parsed.
+ */
+int srnx_numa_select(const char *spec);
+
+/** Returns the number of NUMA nodes in the topology, at least one. */
+int srnx_numa_node_count(void);
+
+/** Returns the node of the CPU that the calling thread is running on,
+ * or zero if that is not known.
+ */
+int srnx_numa_current_node(void);
+
+/** Places the calling thread as worker number \a worker.
+ *
+ * If the topology has more than one node, this pins the thread to the
+ * CPUs of one node that are also in its current affinity mask; workers
+ * take turns over the nodes that have such CPUs.  Unless the topology
+ * came from a list, it then asks the kernel to allocate the thread's
+ * memory from that node when it can.  If the thread cannot be pinned,
+ * its placement and memory policy are left alone.  Only call this from
+ * threads that the caller started for the purpose, not from a thread
+ * that also does other work.
+ *
+ * \param[in] worker Non-negative worker number.
+ * \returns The node that the worker belongs to.
+ */
+int srnx_numa_bind_worker(int worker);
+
+/** Finds the node that holds most of the resident pages in a range.
+ *
+ * \param[in] addr Start of the range, which must be mapped.
+ * \param[in] len Length of the range.
+ * \returns The node holding most of the sampled pages, or -1 if none
+ *   of them are resident or the topology has only one node.
+ */
+int srnx_numa_addr_node(const void *addr, size_t len);
+
+/** Finds the node that holds most of a file's cached pages.
+ *
+ * This samples the file through a temporary mapping, using only pages
+ * that are already in the page cache, so it does not read the file.
+ *
+ * \param[in] filename Name of the file.
+ * \returns The node holding most of the sampled pages, or -1 if none
+ *   are cached, the file cannot be opened, or the topology has only
+ *   one node.
+ */
+int srnx_numa_file_node(const char filename[]);
+
+/** Creates a work queue for \a n_items items.
+ *
+ * \param[out] p_queue Receives the new queue.
+ * \param[in] n_items Number of work items, numbered from zero.
+ * \param[in] node Node of each item's data, or -1 if not known.  May
+ *   be NULL if no node is known.
+ * \returns Zero on success, else ENOMEM.
+ */
+int srnx_numa_queue_create(
+    struct srnx_numa_queue **p_queue,
+    int n_items,
+    const int node[]
+);
+
+/** Takes the next item from \a queue.
+ *
+ * Items on \a node come first, then items with no known node, then
+ * items on other nodes.  Any number of threads may call this at once.
+ *
+ * \param[in] queue Work queue.
+ * \param[in] node Caller's node, as from srnx_numa_bind_worker() or
+ *   srnx_numa_current_node().
+ * \returns The index of the item, or -1 once every item was taken.
+ */
+int srnx_numa_queue_next(struct srnx_numa_queue *queue, int node);
+
+/** Frees \a queue.
+ *
+ * \param[in] queue Work queue to free; may be NULL.
+ */
+void srnx_numa_queue_free(struct srnx_numa_queue *queue);
+
+#if defined(__cplusplus)
+}
+#endif /* defined(__cplusplus) */
+
+#endif /* !defined(SRNX_NUMA_H_91b4b36d_9fec_411a_89c8_c7309b1b1f44) */
@@ -0,0 +1,247 @@
+/** srnx_p.h - Private definitions for Succinct RINEX readers.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(SRNX_P_H_e3a1c9d4_6b0f_4f27_8d5e_71c2a4b8f093)
+#define SRNX_P_H_e3a1c9d4_6b0f_4f27_8d5e_71c2a4b8f093
+
+#include "srnx.h"
+
+/** Alignment of output buffers and observation readers allocated by
+ * the library; a typical cache line size.
+ */
+#define SRNX_ALIGN 64
+
+/** Makes sure a library-allocated buffer can hold \a size bytes.
+ *
+ * Every output array that the library returns is allocated by this
+ * function, which records its allocated length separately from the
+ * length the caller uses, so a buffer is only reallocated when it
+ * grows.  Buffers are aligned to #SRNX_ALIGN and must be released
+ * with srnx_free().
+ *
+ * \param[in] ptr Existing buffer, or NULL.
+ * \param[in] size Number of bytes needed.
+ * \returns The (possibly moved) buffer, with the first
+ *   min(\a size, srnx_reserved(\a ptr)) bytes preserved, or NULL if
+ *   memory could not be allocated (in which case \a ptr is unchanged).
+ */
+void *srnx_reserve(void *ptr, size_t size);
+
+/** Returns the allocated length of a buffer from srnx_reserve(), or
+ * zero if \a ptr is NULL.
+ */
+size_t srnx_reserved(const void *ptr);
+
+/** Identifies a particular version of a file. */
+struct srnx_file_id
+{
+    /** Device number of the file. */
+    uint64_t dev;
+
+    /** Inode number of the file. */
+    uint64_t ino;
+
+    /** Size of the file. */
+    uint64_t size;
+
+    /** Modification time of the file, in nanoseconds since the Unix
+     * epoch.
+     */
+    int64_t mtime_ns;
+};
+
+/** Identifies one decoded signal.  This has no padding, so it can be
+ * hashed and compared as bytes.
+ */
+struct srnx_cache_key
+{
+    /** File that holds the signal. */
+    struct srnx_file_id file;
+
+    /** Satellite name, with unused bytes set to '\0'. */
+    struct srnx_satellite_name name;
+
+    /** Observation code, with unused bytes set to '\0'. */
+    struct srnx_obs_code code;
+};
+
+/** Returns non-zero if the decoded-observation cache is enabled. */
+int srnx_cache_enabled(void);
+
+/** Looks up a signal in the decoded-observation cache.
+ *
+ * On a hit, this (re-)allocates and fills \a *p_obs, and \a *p_lli and
+ * \a *p_ssi if they are not NULL, as srnx_get_obs_by_index() would.
+ *
+ * \param[in] key Signal to look up.
+ * \param[out] p_n_values Receives the number of observations.
+ * \param[in,out] p_obs Observation value buffer.
+ * \param[in,out] p_lli If not NULL, loss-of-lock indicator buffer.
+ * \param[in,out] p_ssi If not NULL, signal strength indicator buffer.
+ * \returns Non-zero on a hit, zero on a miss.
+ */
+int srnx_cache_get(
+    const struct srnx_cache_key *key,
+    int *p_n_values,
+    int64_t **p_obs,
+    char **p_lli,
+    char **p_ssi
+);
+
+/** Adds a decoded signal to the decoded-observation cache.
+ *
+ * The cache copies the data, so the caller keeps ownership of its
+ * buffers.  Failures are silent; the signal simply is not cached.
+ *
+ * \param[in] key Signal that was decoded.
+ * \param[in] n_values Number of observations.
+ * \param[in] obs Observation values.
+ * \param[in] lli Loss-of-lock indicators.
+ * \param[in] ssi Signal strength indicators.
+ * \param[in] decode_ns How long it took to decode the signal, in
+ *   nanoseconds.
+ */
+void srnx_cache_put(
+    const struct srnx_cache_key *key,
+    int n_values,
+    const int64_t obs[],
+    const char lli[],
+    const char ssi[],
+    uint64_t decode_ns
+);
+
+/** Starts a PADD chunk that takes a writer from \a offset to the next
+ * multiple of 2^\a align_log2, for files that align satellite chunk
+ * groups.
+ *
+ * The caller writes the chunk header from \a out, then zeros (or a
+ * hole) for the rest of the payload, then the chunk digest (if any),
+ * for the total length returned.
+ *
+ * \param[out] out Receives the FOURCC and payload length.
+ * \param[in] offset File offset where the chunk would start.
+ * \param[in] align_log2 Log2 of the alignment, from 9 to 30.
+ * \param[in] chunk_digest The file's per-chunk digest identifier.
+ * \param[out] p_head_len Receives the number of bytes written to
+ *   \a out.
+ * \returns The length of the whole chunk, or zero if \a offset is
+ *   already aligned.  If the gap to the next boundary is too small for
+ *   a chunk, this pads to the boundary after that.
+ */
+uint64_t srnx_padding_chunk(
+    char out[16],
+    uint64_t offset,
+    int align_log2,
+    int chunk_digest,
+    int *p_head_len
+);
+
+/** Turns direct I/O (O_DIRECT) on or off for a file descriptor.
+ *
+ * \param[in] fd File descriptor to change.
+ * \param[in] enable Non-zero to turn direct I/O on, zero to turn it off.
+ * \returns Zero on success, else an errno value, such as ENOTSUP if
+ *   the platform has no direct I/O.
+ */
+int srnx_set_direct_io(int fd, int enable);
+
+/** Splits a pread reader's bitmap of loaded blocks into smaller blocks.
+ *
+ * Bit \a n of the result is set if the block of 2^\a new_shift bytes
+ * that starts at file offset \a n * 2^\a new_shift lies in a loaded
+ * block of \a loaded.
+ *
+ * \param[in] loaded Bitmap of loaded blocks of 2^\a old_shift bytes.
+ * \param[in] file_size Size of the file.
+ * \param[in] old_shift Log2 of the block size in \a loaded.
+ * \param[in] new_shift Log2 of the new block size; at most
+ *   \a old_shift.
+ * \returns The new bitmap, to be released with free(), or NULL if
+ *   memory could not be allocated.
+ */
+uint8_t *srnx_split_loaded(
+    const uint8_t *loaded,
+    uint64_t file_size,
+    unsigned int old_shift,
+    unsigned int new_shift
+);
+
+/** Number of bits of precision in rANS symbol frequencies. */
+#define SRNX_RANS_BITS 12
+
+/** Number of interleaved rANS states.  The AVX2 decoder assumes 16. */
+#define SRNX_RANS_LANES 16
+
+/** srnx_rans_encode() does not bother with inputs shorter than this;
+ * building the decoding table would cost more than it saves.
+ */
+#define SRNX_RANS_MIN_LEN 256
+
+/** srnx_rans_encode() only codes inputs that it shrinks by at least
+ * one part in this many.
+ */
+#define SRNX_RANS_MIN_GAIN 8
+
+/** Selects the implementation that srnx_rans_decode() uses.
+ *
+ * \param[in] version "generic" for the scalar decoder, "avx2" for the
+ *   AVX2 decoder, or NULL for the fastest one built.
+ * \returns Zero on success, or -1 if \a version was not built.
+ */
+int srnx_rans_select(const char *version);
+
+/** Decodes an entropy-coded SOCD segment.
+ *
+ * \param[out] out Receives the decoded bytes.
+ * \param[in] out_len Number of bytes to decode.
+ * \param[in] in Coded stream: symbol table, states and words.
+ * \param[in] in_len Length of \a in.
+ * \returns Zero on success, or \a SRNX_CORRUPT if \a in is not
+ *   exactly a valid coding of \a out_len bytes.
+ */
+int srnx_rans_decode(
+    char *out,
+    size_t out_len,
+    const char *in,
+    size_t in_len
+);
+
+/** Entropy-codes \a in, if that pays for itself.
+ *
+ * \param[in,out] p_out Output buffer from srnx_reserve(), or NULL;
+ *   (re-)allocated as needed.
+ * \param[in] in Bytes to code.
+ * \param[in] in_len Length of \a in.
+ * \returns The length of the coded data in \a *p_out, or zero if
+ *   \a in should be stored without entropy coding: it is shorter than
+ *   #SRNX_RANS_MIN_LEN, coding would not save 1/#SRNX_RANS_MIN_GAIN of
+ *   its size, or memory ran out.
+ */
+size_t srnx_rans_encode(
+    char **p_out,
+    const char *in,
+    size_t in_len
+);
+
+#endif /* !defined(SRNX_P_H_e3a1c9d4_6b0f_4f27_8d5e_71c2a4b8f093) */
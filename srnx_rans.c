@@ -0,0 +1,490 @@
+/** srnx_rans.c - Interleaved rANS entropy coder for SRNX payloads.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "srnx_p.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+# include <x86intrin.h>
+#endif
+
+/* This is a byte-oriented rANS coder in the style of Fabian Giesen's
+ * rans_word: each of SRNX_RANS_LANES states is kept in [2^16, 2^32)
+ * and renormalized by whole 16-bit words, so decoding a symbol reads
+ * at most one word.  Symbol ii of the payload belongs to state
+ * (ii % SRNX_RANS_LANES), and after each symbol is decoded, its state
+ * reads the next word if it needs one.  Because the states are
+ * independent, the AVX2 decoder handles a whole group of symbols at a
+ * time: it decodes all sixteen lanes (as two vectors), then hands out
+ * the next words to the lanes that need them, in lane order.
+ *
+ * Encoding runs backwards over the input, so the encoder writes words
+ * from the end of a scratch buffer towards its start.
+ */
+
+/** Lower bound of a normalized rANS state. */
+#define RANS_LOW (1u << 16)
+
+/** Sum of the symbol frequencies. */
+#define RANS_TOTAL (1u << SRNX_RANS_BITS)
+
+/** Bytes of header beyond the frequency table: the states. */
+#define RANS_STATE_BYTES (4 * SRNX_RANS_LANES)
+
+#if defined(__AVX2__)
+/** Non-zero if srnx_rans_decode() uses its AVX2 loop. */
+static int rans_use_avx2 = 1;
+
+/** For each 8-bit mask of lanes that need a word, the index of the
+ * word each lane gets (lanes that need none get an ignored index).
+ */
+static uint8_t rans_word_idx[256][8];
+
+/** Ensures #rans_word_idx is filled in once. */
+static pthread_once_t rans_word_once = PTHREAD_ONCE_INIT;
+
+/** Fills in #rans_word_idx. */
+static void rans_word_init(void)
+{
+    int mask, lane, count;
+
+    for (mask = 0; mask < 256; ++mask)
+    {
+        for (lane = count = 0; lane < 8; ++lane)
+        {
+            rans_word_idx[mask][lane] = count;
+            count += (mask >> lane) & 1;
+        }
+    }
+}
+#endif
+
+/* Doc comment in srnx_p.h. */
+int srnx_rans_select(const char *version)
+{
+#if defined(__AVX2__)
+    if (!version || !strcmp(version, "avx2"))
+    {
+        rans_use_avx2 = 1;
+        return 0;
+    }
+    if (!strcmp(version, "generic"))
+    {
+        rans_use_avx2 = 0;
+        return 0;
+    }
+#else
+    if (!version || !strcmp(version, "generic"))
+    {
+        return 0;
+    }
+#endif
+
+    return -1;
+}
+
+/** Decodes a ULEB128 from \a *d, advancing \a *d, or sets \a *d past
+ * \a end if the value runs off the end.
+ */
+static uint64_t rans_uleb128(const unsigned char **d, const unsigned char *end)
+{
+    uint64_t accum = 0;
+    int shift = 0;
+
+    while (*d < end && shift < 64)
+    {
+        accum |= (uint64_t)(**d & 127) << shift;
+        shift += 7;
+        if (!(*(*d)++ & 128))
+        {
+            return accum;
+        }
+    }
+
+    *d = end + 1;
+    return 0;
+}
+
+/** Appends \a value to \a out as a ULEB128, returning the new end. */
+static unsigned char *rans_put_uleb128(unsigned char *out, uint64_t value)
+{
+    while (value >= 128)
+    {
+        *out++ = (value & 127) | 128;
+        value >>= 7;
+    }
+    *out++ = value;
+    return out;
+}
+
+/** Decodes one symbol from \a *p_x into \a *out and renormalizes the
+ * state from \a *p_in.
+ *
+ * \returns Zero on success, or \a SRNX_CORRUPT if the state needs a
+ *   word past \a end.
+ */
+static inline int rans_decode_one(
+    uint32_t *p_x,
+    unsigned char *out,
+    const uint32_t table[],
+    const unsigned char **p_in,
+    const unsigned char *end
+)
+{
+    uint32_t x = *p_x, e;
+
+    e = table[x & (RANS_TOTAL - 1)];
+    *out = e & 255;
+    x = (((e >> 8) & (RANS_TOTAL - 1)) + 1) * (x >> SRNX_RANS_BITS)
+        + (e >> 20);
+    if (x < RANS_LOW)
+    {
+        if (end - *p_in < 2)
+        {
+            return SRNX_CORRUPT;
+        }
+        x = (x << 16) | (*p_in)[0] | ((uint32_t)(*p_in)[1] << 8);
+        *p_in += 2;
+    }
+    *p_x = x;
+
+    return 0;
+}
+
+/* Doc comment in srnx_p.h. */
+int srnx_rans_decode(
+    char *out,
+    size_t out_len,
+    const char *in,
+    size_t in_len
+)
+{
+    /* Each table entry is the symbol in bits 0-7, its frequency minus
+     * one in bits 8-19, and the slot minus the symbol's cumulative
+     * frequency in bits 20-31.
+     */
+    uint32_t table[RANS_TOTAL], x[SRNX_RANS_LANES];
+    const unsigned char *rptr, *end;
+    uint64_t n_syms, sym, freq, cum, ii, ii_freq;
+    unsigned char *wptr;
+    int lane;
+
+    rptr = (const unsigned char *)in;
+    end = rptr + in_len;
+    wptr = (unsigned char *)out;
+
+    /* Read the frequency table. */
+    n_syms = rans_uleb128(&rptr, end);
+    if (n_syms < 1 || n_syms > 256)
+    {
+        return SRNX_CORRUPT;
+    }
+    for (ii = cum = 0, sym = 0; ii < n_syms; ++ii, ++sym)
+    {
+        sym += rans_uleb128(&rptr, end);
+        freq = rans_uleb128(&rptr, end) + 1;
+        if (rptr > end || sym > 255 || freq > RANS_TOTAL - cum)
+        {
+            return SRNX_CORRUPT;
+        }
+        for (ii_freq = 0; ii_freq < freq; ++ii_freq)
+        {
+            table[cum++] = sym | ((freq - 1) << 8);
+        }
+    }
+    if (cum != RANS_TOTAL)
+    {
+        return SRNX_CORRUPT;
+    }
+
+    /* Convert the table entries' cumulative offsets.  An entry's slot
+     * minus its symbol's start is how many entries back the symbol's
+     * first entry is.
+     */
+    for (ii = 1, cum = 0; ii < RANS_TOTAL; ++ii)
+    {
+        cum = ((table[ii] & 255) == (table[ii - 1] & 255)) ? cum + 1 : 0;
+        table[ii] |= cum << 20;
+    }
+
+    /* Read the initial states. */
+    if (end - rptr < RANS_STATE_BYTES)
+    {
+        return SRNX_CORRUPT;
+    }
+    for (lane = 0; lane < SRNX_RANS_LANES; ++lane, rptr += 4)
+    {
+        x[lane] = rptr[0] | (rptr[1] << 8) | (rptr[2] << 16)
+            | ((uint32_t)rptr[3] << 24);
+        if (x[lane] < RANS_LOW)
+        {
+            return SRNX_CORRUPT;
+        }
+    }
+
+    ii = 0;
+#if defined(__AVX2__)
+    if (rans_use_avx2)
+    {
+        pthread_once(&rans_word_once, rans_word_init);
+        const __m256i v_mask = _mm256_set1_epi32(RANS_TOTAL - 1);
+        const __m256i v_sym = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1,
+            -1, -1, -1, -1, -1, -1, -1, -1, 0, 4, 8, 12, -1, -1, -1, -1,
+            -1, -1, -1, -1, -1, -1, -1, -1);
+        const __m256i v_pack = _mm256_setr_epi32(0, 4, 1, 1, 1, 1, 1, 1);
+        __m256i vx[2];
+        int half;
+
+        vx[0] = _mm256_loadu_si256((const __m256i *)x);
+        vx[1] = _mm256_loadu_si256((const __m256i *)(x + 8));
+
+        /* Each group of sixteen symbols reads at most 32 bytes of words.
+         * The two halves of the group only depend on each other through
+         * the read pointer, so their table lookups and multiplies overlap.
+         */
+        for (; ii + 16 <= out_len && end - rptr >= 32; ii += 16)
+        {
+            __m256i need[2];
+            int mask[2];
+
+            for (half = 0; half < 2; ++half)
+            {
+                __m256i slot = _mm256_and_si256(vx[half], v_mask);
+                __m256i e = _mm256_i32gather_epi32((const int *)table,
+                    slot, 4);
+                __m256i syms = _mm256_permutevar8x32_epi32(
+                    _mm256_shuffle_epi8(e, v_sym), v_pack);
+                _mm_storel_epi64((__m128i *)(wptr + ii + 8 * half),
+                    _mm256_castsi256_si128(syms));
+
+                __m256i freq = _mm256_add_epi32(_mm256_and_si256(
+                    _mm256_srli_epi32(e, 8), v_mask),
+                    _mm256_set1_epi32(1));
+                vx[half] = _mm256_add_epi32(_mm256_mullo_epi32(freq,
+                    _mm256_srli_epi32(vx[half], SRNX_RANS_BITS)),
+                    _mm256_srli_epi32(e, 20));
+                need[half] = _mm256_cmpeq_epi32(
+                    _mm256_srli_epi32(vx[half], 16), _mm256_setzero_si256());
+                mask[half] = _mm256_movemask_ps(
+                    _mm256_castsi256_ps(need[half]));
+            }
+
+            for (half = 0; half < 2; ++half)
+            {
+                __m256i words = _mm256_cvtepu16_epi32(
+                    _mm_loadu_si128((const __m128i *)rptr));
+                __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64(
+                    (const __m128i *)rans_word_idx[mask[half]]));
+                __m256i refill = _mm256_or_si256(
+                    _mm256_slli_epi32(vx[half], 16),
+                    _mm256_permutevar8x32_epi32(words, idx));
+                vx[half] = _mm256_blendv_epi8(vx[half], refill, need[half]);
+                rptr += 2 * __builtin_popcount(mask[half]);
+            }
+        }
+        _mm256_storeu_si256((__m256i *)x, vx[0]);
+        _mm256_storeu_si256((__m256i *)(x + 8), vx[1]);
+    }
+#endif
+
+    /* Decode whatever is left one symbol at a time. */
+    for (lane = 0; ii < out_len; ++ii)
+    {
+        if (rans_decode_one(x + lane, wptr + ii, table, &rptr, end))
+        {
+            return SRNX_CORRUPT;
+        }
+        lane = (lane + 1) & (SRNX_RANS_LANES - 1);
+    }
+
+    /* The encoder started every state at RANS_LOW, and it should have
+     * used all of the input.
+     */
+    for (lane = 0; lane < SRNX_RANS_LANES; ++lane)
+    {
+        if (x[lane] != RANS_LOW)
+        {
+            return SRNX_CORRUPT;
+        }
+    }
+
+    return (rptr == end) ? 0 : SRNX_CORRUPT;
+}
+
+/** Scales \a count[] to frequencies that sum to #RANS_TOTAL, keeping
+ * every symbol that occurs at a frequency of at least one.
+ */
+static void rans_normalize(
+    uint32_t freq[256],
+    const uint64_t count[256],
+    uint64_t total
+)
+{
+    uint32_t sum;
+    int ii, biggest;
+
+    for (ii = 0, sum = 0, biggest = 0; ii < 256; ++ii)
+    {
+        freq[ii] = (count[ii] * RANS_TOTAL) / total;
+        if (count[ii] && !freq[ii])
+        {
+            freq[ii] = 1;
+        }
+        sum += freq[ii];
+        if (count[ii] > count[biggest])
+        {
+            biggest = ii;
+        }
+    }
+
+    /* Rounding down usually leaves a shortfall, which goes to the most
+     * common symbol.  Rounding rare symbols up to one can leave an
+     * excess instead, which comes from the biggest frequencies.
+     */
+    if (sum <= RANS_TOTAL)
+    {
+        freq[biggest] += RANS_TOTAL - sum;
+        return;
+    }
+    for (; sum > RANS_TOTAL; --sum)
+    {
+        for (ii = 0, biggest = 0; ii < 256; ++ii)
+        {
+            if (freq[ii] > freq[biggest])
+            {
+                biggest = ii;
+            }
+        }
+        freq[biggest]--;
+    }
+}
+
+/* Doc comment in srnx_p.h. */
+size_t srnx_rans_encode(
+    char **p_out,
+    const char *in,
+    size_t in_len
+)
+{
+    uint64_t count[256];
+    uint32_t freq[256], cum[256], x[SRNX_RANS_LANES];
+    const unsigned char *src = (const unsigned char *)in;
+    unsigned char *out, *words, *wptr, *hdr;
+    size_t ii, n_words, out_len;
+    uint64_t x_max;
+    uint32_t s_freq;
+    int lane, prev, sym, n_syms;
+
+    if (in_len < SRNX_RANS_MIN_LEN)
+    {
+        return 0;
+    }
+
+    /* Count the symbols and build the frequency table. */
+    memset(count, 0, sizeof count);
+    for (ii = 0; ii < in_len; ++ii)
+    {
+        count[src[ii]]++;
+    }
+    rans_normalize(freq, count, in_len);
+    for (sym = 0, n_syms = 0; sym < 256; ++sym)
+    {
+        cum[sym] = sym ? cum[sym - 1] + freq[sym - 1] : 0;
+        n_syms += freq[sym] > 0;
+    }
+
+    /* Each symbol emits at most one word. */
+    words = malloc(2 * in_len + 2);
+    if (!words)
+    {
+        return 0;
+    }
+    wptr = words + 2 * in_len + 2;
+
+    /* Encode backwards: the decoder renormalizes a state right after
+     * decoding its symbol, so the encoder does so right before.
+     */
+    for (lane = 0; lane < SRNX_RANS_LANES; ++lane)
+    {
+        x[lane] = RANS_LOW;
+    }
+    for (ii = in_len; ii-- > 0; )
+    {
+        lane = ii & (SRNX_RANS_LANES - 1);
+        sym = src[ii];
+        s_freq = freq[sym];
+        x_max = (uint64_t)((RANS_LOW >> SRNX_RANS_BITS) << 16) * s_freq;
+        if (x[lane] >= x_max)
+        {
+            *--wptr = x[lane] >> 8;
+            *--wptr = x[lane];
+            x[lane] >>= 16;
+        }
+        x[lane] = ((x[lane] / s_freq) << SRNX_RANS_BITS)
+            + (x[lane] % s_freq) + cum[sym];
+    }
+    n_words = words + 2 * in_len + 2 - wptr;
+
+    /* The frequency table takes at most four bytes per symbol. */
+    out_len = 2 + 4 * n_syms + RANS_STATE_BYTES + n_words;
+    out = srnx_reserve(*p_out, out_len);
+    if (!out)
+    {
+        free(words);
+        return 0;
+    }
+    *p_out = (char *)out;
+
+    /* Write the frequency table, states and words. */
+    hdr = rans_put_uleb128(out, n_syms);
+    for (sym = 0, prev = -1; sym < 256; ++sym)
+    {
+        if (freq[sym])
+        {
+            hdr = rans_put_uleb128(hdr, sym - prev - 1);
+            hdr = rans_put_uleb128(hdr, freq[sym] - 1);
+            prev = sym;
+        }
+    }
+    for (lane = 0; lane < SRNX_RANS_LANES; ++lane)
+    {
+        *hdr++ = x[lane];
+        *hdr++ = x[lane] >> 8;
+        *hdr++ = x[lane] >> 16;
+        *hdr++ = x[lane] >> 24;
+    }
+    memcpy(hdr, wptr, n_words);
+    out_len = hdr + n_words - out;
+    free(words);
+
+    /* Is it worth the time to decode? */
+    if (out_len > in_len - in_len / SRNX_RANS_MIN_GAIN)
+    {
+        return 0;
+    }
+    return out_len;
+}
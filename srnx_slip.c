@@ -0,0 +1,385 @@
+/** srnx_slip.c - Cycle-slip detection over decoded SRNX columns.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "srnx_slip.h"
+#include "rinex_p.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+# include <immintrin.h>
+#endif
+
+/** Speed of light, in meters per second. */
+#define SLIP_C_LIGHT 299792458.0
+
+/** Number of samples whose jump tests srnx_slip_detect() batches. */
+#define SLIP_CHUNK 256
+
+/* Doc comment in srnx_slip.h. */
+int srnx_slip_params_init(
+    struct srnx_slip_params *params,
+    char system
+)
+{
+    const struct rnx_freq *freq;
+
+    if (system == ' ')
+    {
+        system = 'G';
+    }
+    freq = rnx_find_freq(system);
+    if (!freq)
+    {
+        return SRNX_UNKNOWN_SYSTEM;
+    }
+
+    params->band1 = freq->band1;
+    params->band2 = freq->band2;
+    params->lambda1 = SLIP_C_LIGHT / freq->f1;
+    params->lambda2 = SLIP_C_LIGHT / freq->f2;
+    params->gf_max = 0.05;
+    params->pc_max = 10.0;
+    params->mw_sigmas = 4.0;
+    params->mw_min = 1.0;
+    params->mw_window = 30;
+    params->max_gap = 2;
+    return 0;
+}
+
+/** slip_coeffs holds the per-unit weights of the combinations, with
+ * the factor of 1000 in observation values folded in.
+ */
+struct slip_coeffs
+{
+    /** GF = #g1 * L1 - #g2 * L2; PC = #g1 * L1 - #p * P1. */
+    double g1, g2, p;
+
+    /** MW = #p * (L1 - L2) - #a1 * P1 - #a2 * P2. */
+    double a1, a2;
+};
+
+/** Computes the combination weights for \a params. */
+static void slip_coeffs_init(
+    struct slip_coeffs *k,
+    const struct srnx_slip_params *params
+)
+{
+    double f1, f2;
+
+    f1 = SLIP_C_LIGHT / params->lambda1;
+    f2 = SLIP_C_LIGHT / params->lambda2;
+    k->g1 = params->lambda1 * 0.001;
+    k->g2 = params->lambda2 * 0.001;
+    k->p = 0.001;
+
+    /* Narrow-lane code, divided by the wide-lane wavelength. */
+    k->a1 = 0.001 * f1 * (f1 - f2) / ((f1 + f2) * SLIP_C_LIGHT);
+    k->a2 = 0.001 * f2 * (f1 - f2) / ((f1 + f2) * SLIP_C_LIGHT);
+}
+
+#if defined(__AVX2__)
+/** Lane selectors for _mm256_permutevar8x32_ps() that move the
+ * doubles named by a four-bit mask to the front of a vector.
+ */
+static const int32_t slip_pack[16][8] __attribute__((aligned(32))) = {
+    { 0, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 1, 0, 0, 0, 0, 0, 0 },
+    { 2, 3, 0, 0, 0, 0, 0, 0 },
+    { 0, 1, 2, 3, 0, 0, 0, 0 },
+    { 4, 5, 0, 0, 0, 0, 0, 0 },
+    { 0, 1, 4, 5, 0, 0, 0, 0 },
+    { 2, 3, 4, 5, 0, 0, 0, 0 },
+    { 0, 1, 2, 3, 4, 5, 0, 0 },
+    { 6, 7, 0, 0, 0, 0, 0, 0 },
+    { 0, 1, 6, 7, 0, 0, 0, 0 },
+    { 2, 3, 6, 7, 0, 0, 0, 0 },
+    { 0, 1, 2, 3, 6, 7, 0, 0 },
+    { 4, 5, 6, 7, 0, 0, 0, 0 },
+    { 0, 1, 4, 5, 6, 7, 0, 0 },
+    { 2, 3, 4, 5, 6, 7, 0, 0 },
+    { 0, 1, 2, 3, 4, 5, 6, 7 },
+};
+
+/** Converts four int64_t values (of magnitude below 2**51) to double,
+ * as in srnx_convert_s64_to_double().
+ */
+static inline __m256d slip_cvt(const int64_t *in)
+{
+    const __m256d hh = _mm256_set1_pd(0x0018000000000000);
+    __m256i xx = _mm256_loadu_si256((const __m256i *)in);
+
+    xx = _mm256_add_epi64(xx, _mm256_castpd_si256(hh));
+    return _mm256_sub_pd(_mm256_castsi256_pd(xx), hh);
+}
+
+/** Stores the lanes of \a v selected by \a perm at \a out. */
+static inline void slip_store_packed(double *out, __m256d v, __m256i perm)
+{
+    _mm256_storeu_pd(out, _mm256_castps_pd(
+        _mm256_permutevar8x32_ps(_mm256_castpd_ps(v), perm)));
+}
+#endif
+
+/* Doc comment in srnx_slip.h. */
+size_t srnx_slip_combine(
+    const struct srnx_slip_params *params,
+    size_t n,
+    const int64_t *const obs[4],
+    uint32_t idx[],
+    double gf[],
+    double mw[],
+    double pc[]
+)
+{
+    struct slip_coeffs k;
+    size_t ii, n_out;
+    double l1, l2, p1, p2;
+
+    slip_coeffs_init(&k, params);
+    ii = n_out = 0;
+
+#if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256d g1 = _mm256_set1_pd(k.g1), g2 = _mm256_set1_pd(k.g2);
+    const __m256d pp = _mm256_set1_pd(k.p);
+    const __m256d a1 = _mm256_set1_pd(k.a1), a2 = _mm256_set1_pd(k.a2);
+
+    /* Each store writes four lanes at or before the input position, so
+     * the packed outputs never overrun \a n elements.
+     */
+    for (; ii + 4 <= n; ii += 4)
+    {
+        __m256i missing;
+        __m256d vl1, vl2, vp1, vp2, l1m, out_gf, out_mw, out_pc;
+        __m256i perm;
+        unsigned int valid, bits;
+
+        missing = _mm256_or_si256(
+            _mm256_or_si256(
+                _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *)(obs[0] + ii)), zero),
+                _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *)(obs[1] + ii)), zero)),
+            _mm256_or_si256(
+                _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *)(obs[2] + ii)), zero),
+                _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *)(obs[3] + ii)), zero)));
+        valid = ~_mm256_movemask_pd(_mm256_castsi256_pd(missing)) & 15;
+        if (!valid)
+        {
+            continue;
+        }
+
+        vl1 = slip_cvt(obs[0] + ii);
+        vl2 = slip_cvt(obs[1] + ii);
+        vp1 = slip_cvt(obs[2] + ii);
+        vp2 = slip_cvt(obs[3] + ii);
+        l1m = _mm256_mul_pd(vl1, g1);
+        out_gf = _mm256_sub_pd(l1m, _mm256_mul_pd(vl2, g2));
+        out_pc = _mm256_sub_pd(l1m, _mm256_mul_pd(vp1, pp));
+        out_mw = _mm256_sub_pd(
+            _mm256_mul_pd(_mm256_sub_pd(vl1, vl2), pp),
+            _mm256_add_pd(_mm256_mul_pd(vp1, a1), _mm256_mul_pd(vp2, a2)));
+
+        perm = _mm256_load_si256((const __m256i *)slip_pack[valid]);
+        slip_store_packed(gf + n_out, out_gf, perm);
+        slip_store_packed(mw + n_out, out_mw, perm);
+        slip_store_packed(pc + n_out, out_pc, perm);
+        for (bits = valid; bits; bits &= bits - 1)
+        {
+            idx[n_out++] = ii + __builtin_ctz(bits);
+        }
+    }
+#endif
+
+    for (; ii < n; ++ii)
+    {
+        if (!obs[0][ii] || !obs[1][ii] || !obs[2][ii] || !obs[3][ii])
+        {
+            continue;
+        }
+        l1 = obs[0][ii];
+        l2 = obs[1][ii];
+        p1 = obs[2][ii];
+        p2 = obs[3][ii];
+        idx[n_out] = ii;
+        gf[n_out] = l1 * k.g1 - l2 * k.g2;
+        mw[n_out] = (l1 - l2) * k.p - (p1 * k.a1 + p2 * k.a2);
+        pc[n_out] = l1 * k.g1 - p1 * k.p;
+        ++n_out;
+    }
+
+    return n_out;
+}
+
+/** Sets \a jump[ii - base] to the GF and PC reasons for sample \a ii,
+ * for \a base <= ii < \a end.  \a base must be positive.
+ */
+static void slip_jumps(
+    const struct srnx_slip_params *params,
+    size_t base,
+    size_t end,
+    const double gf[],
+    const double pc[],
+    uint8_t jump[]
+)
+{
+    double pc_max;
+    size_t ii;
+
+    /* A zero threshold disables the PC test. */
+    pc_max = (params->pc_max > 0.0) ? params->pc_max : INFINITY;
+    ii = base;
+
+#if defined(__AVX2__)
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    const __m256d v_gf_max = _mm256_set1_pd(params->gf_max);
+    const __m256d v_pc_max = _mm256_set1_pd(pc_max);
+
+    for (; ii + 4 <= end; ii += 4)
+    {
+        __m256d d_gf, d_pc;
+        unsigned int m_gf, m_pc, jj;
+
+        d_gf = _mm256_sub_pd(_mm256_loadu_pd(gf + ii), _mm256_loadu_pd(gf + ii - 1));
+        d_pc = _mm256_sub_pd(_mm256_loadu_pd(pc + ii), _mm256_loadu_pd(pc + ii - 1));
+        m_gf = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_andnot_pd(sign, d_gf),
+            v_gf_max, _CMP_GT_OQ));
+        m_pc = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_andnot_pd(sign, d_pc),
+            v_pc_max, _CMP_GT_OQ));
+        for (jj = 0; jj < 4; ++jj)
+        {
+            jump[ii - base + jj] = ((m_gf >> jj & 1) ? SRNX_SLIP_GF : 0)
+                | ((m_pc >> jj & 1) ? SRNX_SLIP_PC : 0);
+        }
+    }
+#endif
+
+    for (; ii < end; ++ii)
+    {
+        jump[ii - base] = ((fabs(gf[ii] - gf[ii - 1]) > params->gf_max)
+                ? SRNX_SLIP_GF : 0)
+            | ((fabs(pc[ii] - pc[ii - 1]) > pc_max) ? SRNX_SLIP_PC : 0);
+    }
+}
+
+/* Doc comment in srnx_slip.h. */
+size_t srnx_slip_detect(
+    const struct srnx_slip_params *params,
+    size_t n,
+    const uint32_t idx[],
+    const uint64_t epoch[],
+    const double gf[],
+    const double mw[],
+    const double pc[],
+    const char lli1[],
+    const char lli2[],
+    struct srnx_slip slip[]
+)
+{
+    uint8_t jump[SLIP_CHUNK];
+    double ref, sum, sumsq, dd, mean, var, sigma, limit;
+    size_t ii, base, end, arc, n_win, n_slips;
+    uint32_t reasons;
+
+    /* The MW window holds samples since the start of the arc, relative
+     * to the arc's first value so the sums keep their precision.
+     */
+    n_slips = 0;
+    arc = 0;
+    ref = n ? mw[0] : 0.0;
+    sum = sumsq = 0.0;
+    for (base = 1; base < n; base = end)
+    {
+        end = (n - base > SLIP_CHUNK) ? base + SLIP_CHUNK : n;
+        slip_jumps(params, base, end, gf, pc, jump);
+
+        for (ii = base; ii < end; ++ii)
+        {
+            reasons = jump[ii - base];
+            if (epoch[idx[ii]] - epoch[idx[ii - 1]] > params->max_gap + (uint64_t)1)
+            {
+                reasons |= SRNX_SLIP_GAP;
+            }
+            if ((lli1 && (lli1[idx[ii]] & 1)) || (lli2 && (lli2[idx[ii]] & 1)))
+            {
+                reasons |= SRNX_SLIP_LLI;
+            }
+
+            /* Compare MW against the window, which holds the samples
+             * from max(arc, ii - mw_window) to ii - 1.
+             */
+            n_win = ii - arc;
+            if (n_win > params->mw_window)
+            {
+                n_win = params->mw_window;
+            }
+            dd = mw[ii] - ref;
+            if (n_win > 0)
+            {
+                mean = sum / n_win;
+                limit = params->mw_min;
+                if (n_win > 1)
+                {
+                    var = (sumsq - sum * mean) / (n_win - 1);
+                    sigma = (var > 0.0) ? sqrt(var) : 0.0;
+                    if (params->mw_sigmas * sigma > limit)
+                    {
+                        limit = params->mw_sigmas * sigma;
+                    }
+                }
+                if (fabs(dd - mean) > limit)
+                {
+                    reasons |= SRNX_SLIP_MW;
+                }
+            }
+
+            if (reasons)
+            {
+                /* Start a new arc; its first sample is the reference,
+                 * so the window's sums start at zero.
+                 */
+                slip[n_slips].idx = idx[ii];
+                slip[n_slips].reasons = reasons;
+                ++n_slips;
+                arc = ii;
+                ref = mw[ii];
+                sum = sumsq = 0.0;
+                continue;
+            }
+
+            /* Slide the window forward over this sample. */
+            sum += dd;
+            sumsq += dd * dd;
+            if (ii - arc >= params->mw_window)
+            {
+                dd = mw[ii - params->mw_window] - ref;
+                sum -= dd;
+                sumsq -= dd * dd;
+            }
+        }
+    }
+
+    return n_slips;
+}
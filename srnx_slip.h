@@ -0,0 +1,193 @@
+/** srnx_slip.h - Cycle-slip detection over decoded SRNX columns.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(SRNX_SLIP_H_0b5bdfeb_0f14_4f77_bfd0_9f81a5d29348)
+#define SRNX_SLIP_H_0b5bdfeb_0f14_4f77_bfd0_9f81a5d29348
+
+#include "srnx.h"
+
+/* Cycle-slip screening works on one satellite at a time, using whole
+ * decoded columns: phase and code on two carrier frequencies (L1, L2,
+ * P1 and P2 below, whatever the bands are called for the system).
+ * srnx_slip_combine() forms the geometry-free (GF), Melbourne-Wübbena
+ * (MW) and phase-minus-code (PC) combinations for the epochs where all
+ * four observations are present, and srnx_slip_detect() walks those
+ * samples and reports where a new phase arc starts:
+ *
+ * - after more than srnx_slip_params::max_gap missing epochs,
+ * - where either phase has LLI bit 0 (loss of lock) set,
+ * - where GF or the time difference of PC jumps by more than its
+ *   threshold between consecutive samples, or
+ * - where MW departs from its mean over the previous samples in the
+ *   arc by more than srnx_slip_params::mw_sigmas standard deviations
+ *   (and at least srnx_slip_params::mw_min wide-lane cycles).
+ *
+ * The columns must be aligned, with element ii of each one for the
+ * satellite's ii'th epoch.  Observation values are as SRNX readers
+ * return them (times 1000), and zero marks a missing observation.
+ */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/** Reasons that srnx_slip_detect() starts a new arc. */
+enum srnx_slip_reason
+{
+    /** More than srnx_slip_params::max_gap epochs were missing. */
+    SRNX_SLIP_GAP = 1,
+
+    /** Either phase observation had LLI bit 0 set. */
+    SRNX_SLIP_LLI = 2,
+
+    /** The geometry-free combination jumped. */
+    SRNX_SLIP_GF = 4,
+
+    /** The Melbourne-Wübbena combination left its window. */
+    SRNX_SLIP_MW = 8,
+
+    /** The time-differenced phase-minus-code combination jumped. */
+    SRNX_SLIP_PC = 16
+};
+
+/** Carrier frequencies and thresholds for cycle-slip detection. */
+struct srnx_slip_params
+{
+    /** Band digit of the first frequency, such as '1'. */
+    char band1;
+
+    /** Band digit of the second frequency, such as '2'. */
+    char band2;
+
+    /** Wavelength of the first frequency, in meters. */
+    double lambda1;
+
+    /** Wavelength of the second frequency, in meters. */
+    double lambda2;
+
+    /** Largest change in GF between samples, in meters. */
+    double gf_max;
+
+    /** Largest change in PC between samples, in meters; zero disables
+     * the test.
+     */
+    double pc_max;
+
+    /** Number of standard deviations for the MW test. */
+    double mw_sigmas;
+
+    /** Smallest MW departure that is a slip, in wide-lane cycles. */
+    double mw_min;
+
+    /** Number of previous samples in the MW window. */
+    unsigned int mw_window;
+
+    /** Most epochs that may be missing within an arc. */
+    unsigned int max_gap;
+};
+
+/** Describes the start of a new arc. */
+struct srnx_slip
+{
+    /** Index of the observation in the input columns. */
+    uint32_t idx;
+
+    /** Bitwise OR of srnx_slip_reason values. */
+    uint32_t reasons;
+};
+
+/** Initializes \a params with the frequencies for a satellite system
+ * and default thresholds for 30-second data.
+ *
+ * \param[out] params Receives the parameters.
+ * \param[in] system Satellite system letter, such as 'G'.  A blank is
+ *   treated as 'G'.
+ * \returns Zero on success, or \a SRNX_UNKNOWN_SYSTEM if the system
+ *   does not have two fixed carrier frequencies (such as GLONASS).
+ */
+int srnx_slip_params_init(
+    struct srnx_slip_params *params,
+    char system
+);
+
+/** Forms the GF, MW and PC combinations.
+ *
+ * Only epochs where all four observations are non-zero produce a
+ * sample; \a idx receives each sample's index in the input columns.
+ * Each output array must have room for \a n elements.
+ *
+ * \param[in] params Carrier frequencies to use.
+ * \param[in] n Number of elements in each input column.
+ * \param[in] obs Phase and code columns, in the order L1, L2, P1, P2.
+ * \param[out] idx Receives the input index of each sample.
+ * \param[out] gf Receives GF for each sample, in meters.
+ * \param[out] mw Receives MW for each sample, in wide-lane cycles.
+ * \param[out] pc Receives PC on the first frequency, in meters.
+ * \returns Number of samples written.
+ */
+size_t srnx_slip_combine(
+    const struct srnx_slip_params *params,
+    size_t n,
+    const int64_t *const obs[4],
+    uint32_t idx[],
+    double gf[],
+    double mw[],
+    double pc[]
+);
+
+/** Finds the starts of phase arcs in combinations from
+ * srnx_slip_combine().  The first sample is not reported.
+ *
+ * \param[in] params Thresholds to use.
+ * \param[in] n Number of samples.
+ * \param[in] idx Input index of each sample.
+ * \param[in] epoch Epoch number for each input index, such as from
+ *   the satellite's presence bitmap.
+ * \param[in] gf GF for each sample.
+ * \param[in] mw MW for each sample.
+ * \param[in] pc PC for each sample.
+ * \param[in] lli1 LLIs for the first phase, by input index, or NULL.
+ * \param[in] lli2 LLIs for the second phase, by input index, or NULL.
+ * \param[out] slip Receives the arc starts, in order; must have room
+ *   for \a n elements.
+ * \returns Number of elements written to \a slip.
+ */
+size_t srnx_slip_detect(
+    const struct srnx_slip_params *params,
+    size_t n,
+    const uint32_t idx[],
+    const uint64_t epoch[],
+    const double gf[],
+    const double mw[],
+    const double pc[],
+    const char lli1[],
+    const char lli2[],
+    struct srnx_slip slip[]
+);
+
+#if defined(__cplusplus)
+}
+#endif /* defined(__cplusplus) */
+
+#endif /* !defined(SRNX_SLIP_H_0b5bdfeb_0f14_4f77_bfd0_9f81a5d29348) */
@@ -0,0 +1,455 @@
+/** srnx_slips.c - Lists cycle slips in SRNX files.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* For each satellite with two known carrier frequencies, this decodes
+ * only the two phase and two code columns it needs, rather than the
+ * whole file, and prints one line per detected arc start:
+ *   satellite yyyymmdd hhmm sec_e7 reasons
+ * where reasons is a comma-separated list of gap, lli, gf, mw and pc.
+ * With -t, it also reports how long decoding and the kernels took.
+ */
+
+#include "srnx_slip.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** Command-line overrides for srnx_slip_params; NAN or negative values
+ * keep the defaults.
+ */
+static double opt_gf_max = NAN;
+static double opt_pc_max = NAN;
+static double opt_mw_sigmas = NAN;
+static long opt_mw_window = -1;
+static long opt_max_gap = -1;
+
+/** Non-zero to report time spent decoding and in the kernels. */
+static int opt_timing;
+
+/** slip_work holds buffers that are reused from one satellite to the
+ * next.
+ */
+struct slip_work
+{
+    int64_t *obs[4];
+    char *lli[4];
+    uint64_t *presence;
+    uint64_t *epoch;
+    uint32_t *idx;
+    double *gf;
+    double *mw;
+    double *pc;
+    struct srnx_slip *slip;
+    size_t alloc;
+
+    /** Seconds spent decoding columns, for -t. */
+    double decode_time;
+
+    /** Seconds spent in srnx_slip_combine() and srnx_slip_detect(). */
+    double kernel_time;
+
+    /** Number of samples given to srnx_slip_detect(). */
+    uint64_t n_samples;
+};
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "Usage: %s [-t] [-g gf_max] [-p pc_max] [-s mw_sigmas]"
+        " [-w mw_window] [-n max_gap] file.srnx...\n", argv0);
+}
+
+/** Finds an observation code by type, band and attribute.
+ * \returns The code's index, or -1 if it is not present.
+ */
+static int find_code(
+    const struct srnx_obs_code code[],
+    int n_codes,
+    char type,
+    char band,
+    char attr
+)
+{
+    int ii;
+
+    for (ii = 0; ii < n_codes; ++ii)
+    {
+        if (code[ii].name[0] == type && code[ii].name[1] == band
+            && (!attr || code[ii].name[2] == attr))
+        {
+            return ii;
+        }
+    }
+
+    return -1;
+}
+
+/** Chooses the phase and code columns for a satellite system, in the
+ * order srnx_slip_combine() takes them.  Code with the same tracking
+ * mode as the phase is preferred, then P code (in RINEX 2), then C/A.
+ * \returns Zero on success, non-zero if a column is missing.
+ */
+static int pick_codes(
+    const struct srnx_obs_code code[],
+    int n_codes,
+    const struct srnx_slip_params *params,
+    int idx[4]
+)
+{
+    char band[2] = { params->band1, params->band2 };
+    int ii;
+
+    for (ii = 0; ii < 2; ++ii)
+    {
+        idx[ii] = find_code(code, n_codes, 'L', band[ii], 0);
+        if (idx[ii] < 0)
+        {
+            return -1;
+        }
+        idx[ii + 2] = -1;
+        if (code[idx[ii]].name[2])
+        {
+            idx[ii + 2] = find_code(code, n_codes, 'C', band[ii],
+                code[idx[ii]].name[2]);
+        }
+        if (idx[ii + 2] < 0)
+        {
+            idx[ii + 2] = find_code(code, n_codes, 'P', band[ii], 0);
+        }
+        if (idx[ii + 2] < 0)
+        {
+            idx[ii + 2] = find_code(code, n_codes, 'C', band[ii], 0);
+        }
+        if (idx[ii + 2] < 0)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/** Resizes the array at \a *p_ptr to \a size bytes.
+ * \returns Zero on success, non-zero on allocation failure.
+ */
+static int resize(void *p_ptr, size_t size)
+{
+    void *ptr;
+
+    ptr = realloc(*(void **)p_ptr, size);
+    if (!ptr)
+    {
+        return 1;
+    }
+    *(void **)p_ptr = ptr;
+    return 0;
+}
+
+/** Makes sure \a work has room for \a n samples.
+ * \returns Zero on success, non-zero on allocation failure.
+ */
+static int grow(struct slip_work *work, size_t n)
+{
+    if (n <= work->alloc)
+    {
+        return 0;
+    }
+    if (resize(&work->epoch, n * sizeof work->epoch[0])
+        || resize(&work->idx, n * sizeof work->idx[0])
+        || resize(&work->gf, n * sizeof work->gf[0])
+        || resize(&work->mw, n * sizeof work->mw[0])
+        || resize(&work->pc, n * sizeof work->pc[0])
+        || resize(&work->slip, n * sizeof work->slip[0]))
+    {
+        return 1;
+    }
+
+    work->alloc = n;
+    return 0;
+}
+
+/** Returns the monotonic clock, in seconds. */
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/** Prints the reasons for one slip. */
+static void print_reasons(uint32_t reasons)
+{
+    static const char *const name[] = { "gap", "lli", "gf", "mw", "pc" };
+    const char *sep = "";
+    int ii;
+
+    for (ii = 0; ii < (int)(sizeof name / sizeof name[0]); ++ii)
+    {
+        if (reasons >> ii & 1)
+        {
+            printf("%s%s", sep, name[ii]);
+            sep = ",";
+        }
+    }
+    putchar('\n');
+}
+
+/** Finds and prints the slips for one satellite.
+ * \returns Zero on success, non-zero SRNX error number on error.
+ */
+static int process_sat(
+    struct srnx_reader *srnx,
+    struct srnx_satellite_name sat,
+    const struct rinex_epoch epoch[],
+    size_t n_epochs,
+    struct slip_work *work
+)
+{
+    struct srnx_slip_params params;
+    const struct srnx_obs_code *code;
+    uint64_t n_present, word, ii;
+    size_t n_samples, n_slips, jj;
+    double t0, t1;
+    int idx[4], n_values[4], n_codes, res;
+
+    /* Systems without two fixed frequencies are skipped. */
+    if (srnx_slip_params_init(&params, sat.name[0]))
+    {
+        return 0;
+    }
+    if (!isnan(opt_gf_max))
+    {
+        params.gf_max = opt_gf_max;
+    }
+    if (!isnan(opt_pc_max))
+    {
+        params.pc_max = opt_pc_max;
+    }
+    if (!isnan(opt_mw_sigmas))
+    {
+        params.mw_sigmas = opt_mw_sigmas;
+    }
+    if (opt_mw_window >= 0)
+    {
+        params.mw_window = opt_mw_window;
+    }
+    if (opt_max_gap >= 0)
+    {
+        params.max_gap = opt_max_gap;
+    }
+
+    res = srnx_get_obs_codes(srnx, sat.name[0], &code, &n_codes);
+    if (res)
+    {
+        return res;
+    }
+    if (pick_codes(code, n_codes, &params, idx))
+    {
+        return 0;
+    }
+
+    /* Find the epochs the satellite was observed at. */
+    n_present = 0;
+    res = srnx_get_sat_presence(srnx, sat, n_epochs, &work->presence,
+        &n_present);
+    if (res)
+    {
+        return res;
+    }
+    if (grow(work, n_present))
+    {
+        return ENOMEM;
+    }
+    for (ii = jj = 0; ii < (n_epochs + 63) / 64; ++ii)
+    {
+        for (word = work->presence[ii]; word; word &= word - 1)
+        {
+            work->epoch[jj++] = ii * 64 + __builtin_ctzll(word);
+        }
+    }
+
+    t0 = now();
+    res = srnx_get_obs_by_index(srnx, sat, 4, idx, n_values, work->obs,
+        work->lli, NULL);
+    t1 = now();
+    work->decode_time += t1 - t0;
+    if (res == SRNX_UNKNOWN_CODE)
+    {
+        return 0;
+    }
+    if (res)
+    {
+        return res;
+    }
+
+    /* Each column must have one value per epoch of the satellite, as
+     * for srnx_get_combination().
+     */
+    for (jj = 0; jj < 4; ++jj)
+    {
+        if ((uint64_t)n_values[jj] != n_present)
+        {
+            fprintf(stderr, "%.3s: %.4s has %d values for %llu epochs\n",
+                sat.name, code[idx[jj]].name, n_values[jj],
+                (unsigned long long)n_present);
+            return SRNX_CORRUPT;
+        }
+    }
+
+    n_samples = srnx_slip_combine(&params, n_present,
+        (const int64_t *const *)work->obs, work->idx, work->gf, work->mw,
+        work->pc);
+    n_slips = srnx_slip_detect(&params, n_samples, work->idx, work->epoch,
+        work->gf, work->mw, work->pc, work->lli[0], work->lli[1], work->slip);
+    work->kernel_time += now() - t1;
+    work->n_samples += n_samples;
+
+    for (jj = 0; jj < n_slips; ++jj)
+    {
+        const struct rinex_epoch *ep = &epoch[work->epoch[work->slip[jj].idx]];
+
+        printf("%.3s %08d %04d %9d ", sat.name, ep->yyyy_mm_dd, ep->hh_mm,
+            ep->sec_e7);
+        print_reasons(work->slip[jj].reasons);
+    }
+
+    return 0;
+}
+
+static void process_file(const char filename[], struct slip_work *work)
+{
+    struct srnx_reader *srnx;
+    struct srnx_satellite_name *names;
+    struct rinex_epoch *epoch;
+    uint64_t n_names, ii;
+    size_t n_epochs;
+    int res;
+
+    srnx = NULL;
+    names = NULL;
+    epoch = NULL;
+    res = srnx_open(&srnx, filename);
+    if (!res)
+    {
+        res = srnx_get_epochs(srnx, &epoch, &n_epochs);
+    }
+    if (!res)
+    {
+        res = srnx_get_satellites(srnx, &names, &n_names);
+    }
+    for (ii = 0; !res && ii < n_names; ++ii)
+    {
+        res = process_sat(srnx, names[ii], epoch, n_epochs, work);
+    }
+    if (res)
+    {
+        fprintf(stderr, "Unable to read %s: %s (line %d)\n", filename,
+            srnx_strerror(res), srnx ? srnx_error_line(srnx) : 0);
+    }
+
+    srnx_free(epoch);
+    srnx_free(names);
+    srnx_close(srnx);
+}
+
+int main(int argc, char *argv[])
+{
+    struct slip_work work;
+    int ii;
+
+    for (ii = 1; ii < argc && argv[ii][0] == '-'; ++ii)
+    {
+        if (!strcmp(argv[ii], "-t"))
+        {
+            opt_timing = 1;
+        }
+        else if (ii + 1 >= argc)
+        {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        else if (!strcmp(argv[ii], "-g"))
+        {
+            opt_gf_max = strtod(argv[++ii], NULL);
+        }
+        else if (!strcmp(argv[ii], "-p"))
+        {
+            opt_pc_max = strtod(argv[++ii], NULL);
+        }
+        else if (!strcmp(argv[ii], "-s"))
+        {
+            opt_mw_sigmas = strtod(argv[++ii], NULL);
+        }
+        else if (!strcmp(argv[ii], "-w"))
+        {
+            opt_mw_window = strtol(argv[++ii], NULL, 10);
+        }
+        else if (!strcmp(argv[ii], "-n"))
+        {
+            opt_max_gap = strtol(argv[++ii], NULL, 10);
+        }
+        else
+        {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (ii >= argc)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    memset(&work, 0, sizeof work);
+    for (; ii < argc; ++ii)
+    {
+        process_file(argv[ii], &work);
+    }
+    if (opt_timing)
+    {
+        fprintf(stderr, "decode %.3f s, kernels %.3f s for %llu samples"
+            " (%.1f ns per sample)\n", work.decode_time, work.kernel_time,
+            (unsigned long long)work.n_samples,
+            work.n_samples ? work.kernel_time * 1e9 / work.n_samples : 0.0);
+    }
+
+    for (ii = 0; ii < 4; ++ii)
+    {
+        srnx_free(work.obs[ii]);
+        srnx_free(work.lli[ii]);
+    }
+    srnx_free(work.presence);
+    free(work.epoch);
+    free(work.idx);
+    free(work.gf);
+    free(work.mw);
+    free(work.pc);
+    free(work.slip);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,3166 @@
+/** srnx_test.c - Tests SRNX decoding against hand-built files.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Usage: srnx_test [test ...]
+ *
+ * Each test builds a small SRNX file byte by byte, as the format
+ * specification describes it, and checks what the reader decodes from
+ * it.  With no arguments, every test runs.  Failed checks are printed
+ * with a leading '!', and the exit status is non-zero if any failed.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include "rinex_arrow.h"
+#include "rinex_crx.h"
+#include "rinex_p.h"
+#include "rinex_qc.h"
+#include "srnx_catalog.h"
+#include "srnx_numa.h"
+#include "srnx_p.h"
+#include "srnx_slip.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+# include <sys/syscall.h>
+#endif
+
+/** tbuf is a growable byte buffer for building test files. */
+struct tbuf
+{
+    /** Buffer contents. */
+    char *data;
+
+    /** Number of bytes used in #data. */
+    size_t len;
+
+    /** Number of bytes allocated for #data. */
+    size_t cap;
+};
+
+/** Number of failed checks so far. */
+static int n_failed;
+
+/** Counts and reports a failed check if \a cond is false.
+ *
+ * \param[in] cond Condition that should be true.
+ * \param[in] fmt printf-style description of the check.
+ * \returns \a cond.
+ */
+static int check(int cond, const char *fmt, ...)
+{
+    va_list args;
+
+    if (!cond)
+    {
+        va_start(args, fmt);
+        printf(" ! ");
+        vprintf(fmt, args);
+        printf("\n");
+        va_end(args);
+        ++n_failed;
+    }
+
+    return cond;
+}
+
+/** Appends \a len bytes from \a data to \a tb. */
+static void tb_bytes(struct tbuf *tb, const void *data, size_t len)
+{
+    if (tb->len + len > tb->cap)
+    {
+        tb->cap = (tb->len + len) * 2 + 64;
+        tb->data = realloc(tb->data, tb->cap);
+        if (!tb->data)
+        {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+    }
+    memcpy(tb->data + tb->len, data, len);
+    tb->len += len;
+}
+
+/** Appends a single byte to \a tb. */
+static void tb_byte(struct tbuf *tb, int byte)
+{
+    char ch = byte;
+
+    tb_bytes(tb, &ch, 1);
+}
+
+/** Appends \a value to \a tb as a ULEB128. */
+static void tb_uleb(struct tbuf *tb, uint64_t value)
+{
+    while (value >= 128)
+    {
+        tb_byte(tb, (value & 127) | 128);
+        value >>= 7;
+    }
+    tb_byte(tb, value);
+}
+
+/** Appends \a value to \a tb as a SLEB128. */
+static void tb_sleb(struct tbuf *tb, int64_t value)
+{
+    tb_uleb(tb, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+/** Writes \a value as a five-byte SLEB128 at offset \a pos of \a tb,
+ * appending it if \a pos is the end of \a tb.  The fixed width lets
+ * file offsets be filled in after the chunks they point to.
+ */
+static void tb_sleb_at(struct tbuf *tb, size_t pos, int64_t value)
+{
+    uint64_t u64 = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+    char bytes[5];
+    int ii;
+
+    for (ii = 0; ii < 5; ++ii)
+    {
+        bytes[ii] = (u64 & 127) | (ii < 4 ? 128 : 0);
+        u64 >>= 7;
+    }
+    if (pos < tb->len)
+    {
+        memcpy(tb->data + pos, bytes, 5);
+    }
+    else
+    {
+        tb_bytes(tb, bytes, 5);
+    }
+}
+
+/** Appends a chunk with FOURCC \a fourcc and payload \a payload to
+ * \a tb, with no per-chunk digest.
+ */
+static void tb_chunk(struct tbuf *tb, const char *fourcc,
+    const struct tbuf *payload)
+{
+    tb_bytes(tb, fourcc, 4);
+    tb_uleb(tb, payload->len);
+    tb_bytes(tb, payload->data, payload->len);
+}
+
+/** Releases the memory held by \a tb. */
+static void tb_free(struct tbuf *tb)
+{
+    free(tb->data);
+    tb->data = NULL;
+    tb->len = tb->cap = 0;
+}
+
+/** test_signal describes one SOCD chunk of a test file. */
+struct test_signal
+{
+    /** Observation code, such as "L1". */
+    const char *code;
+
+    /** Number of observations. */
+    uint64_t n_values;
+
+    /** Run-length encoded LLIs, or empty for none. */
+    struct tbuf lli;
+
+    /** Run-length encoded SSIs, or empty for none. */
+    struct tbuf ssi;
+
+    /** Packed observation data, starting with the schema. */
+    struct tbuf packed;
+
+    /** Zone map, or empty for none. */
+    struct tbuf zones;
+};
+
+/** RINEX 2.11 header for a GPS-only file with L1 and L2. */
+static const char test_rhdr[] =
+    "     2.11           OBSERVATION DATA    G (GPS)             RINEX VERSION / TYPE\n"
+    "     2    L1    L2                                          # / TYPES OF OBSERV\n"
+    "                                                            END OF HEADER\n";
+
+/** Builds an SRNX file with one satellite, G01.
+ *
+ * \param[out] file Receives the file contents.
+ * \param[in] rhdr RINEX header text, or NULL for #test_rhdr.
+ * \param[in] minor SRNX minor version.
+ * \param[in] epoc If not NULL, payload of an EPOC chunk to write
+ *   after the RHDR chunk.
+ * \param[in] sigs Signals to write, in RHDR order.
+ * \param[in] n_sigs Number of signals in \a sigs.
+ */
+static void build_test_file(
+    struct tbuf *file,
+    const char *rhdr,
+    int minor,
+    const struct tbuf *epoc,
+    const struct test_signal *sigs,
+    int n_sigs
+)
+{
+    struct tbuf payload = { NULL, 0, 0 };
+    size_t sate_start, offsets;
+    int ii;
+
+    /* SRNX and RHDR chunks. */
+    tb_uleb(&payload, 1);
+    tb_uleb(&payload, minor);
+    tb_uleb(&payload, 0);
+    tb_uleb(&payload, 0);
+    tb_uleb(&payload, 0);
+    if (minor >= 4)
+    {
+        tb_uleb(&payload, 0);
+    }
+    tb_chunk(file, "SRNX", &payload);
+    payload.len = 0;
+    if (!rhdr)
+    {
+        rhdr = test_rhdr;
+    }
+    tb_bytes(&payload, rhdr, strlen(rhdr));
+    tb_chunk(file, "RHDR", &payload);
+    if (epoc)
+    {
+        tb_chunk(file, "EPOC", epoc);
+    }
+
+    /* SATE chunk: the SOCD offsets are filled in below. */
+    sate_start = file->len;
+    payload.len = 0;
+    tb_bytes(&payload, "G01", 4);
+    offsets = payload.len;
+    for (ii = 0; ii < 2; ++ii)
+    {
+        tb_sleb_at(&payload, payload.len, 0);
+    }
+    tb_uleb(&payload, 0);
+    tb_uleb(&payload, 0);
+    tb_uleb(&payload, sigs[0].n_values - 1);
+    tb_chunk(file, "SATE", &payload);
+    offsets += file->len - payload.len;
+
+    /* SOCD chunks. */
+    for (ii = 0; ii < n_sigs; ++ii)
+    {
+        char name[8] = "G01";
+
+        tb_sleb_at(file, offsets + 5 * ii, file->len - sate_start);
+        strncpy(name + 4, sigs[ii].code, 3);
+        payload.len = 0;
+        tb_bytes(&payload, name, 8);
+        tb_uleb(&payload, sigs[ii].n_values - 1);
+        tb_uleb(&payload, sigs[ii].lli.len);
+        tb_bytes(&payload, sigs[ii].lli.data, sigs[ii].lli.len);
+        tb_uleb(&payload, sigs[ii].ssi.len);
+        tb_bytes(&payload, sigs[ii].ssi.data, sigs[ii].ssi.len);
+        tb_uleb(&payload, sigs[ii].packed.len);
+        tb_bytes(&payload, sigs[ii].packed.data, sigs[ii].packed.len);
+        tb_bytes(&payload, sigs[ii].zones.data, sigs[ii].zones.len);
+        tb_chunk(file, "SOCD", &payload);
+    }
+
+    tb_free(&payload);
+}
+
+/** Writes \a len bytes of \a file to \a path, or to a new temporary
+ * file if \a path is empty.
+ *
+ * \param[in] file File contents to write.
+ * \param[in] len Number of bytes to write.
+ * \param[in,out] path Name of the file to write.
+ * \returns Zero on success, else -1.
+ */
+static int write_file(const struct tbuf *file, size_t len, char path[32])
+{
+    int fd, res;
+
+    if (*path)
+    {
+        fd = open(path, O_WRONLY | O_TRUNC);
+    }
+    else
+    {
+        strcpy(path, "/tmp/srnx_test.XXXXXX");
+        fd = mkstemp(path);
+    }
+    if (fd < 0)
+    {
+        perror(path);
+        return -1;
+    }
+    res = write(fd, file->data, len) == (ssize_t)len ? 0 : -1;
+    close(fd);
+    return res;
+}
+
+/** Writes an SRNX file with one satellite, G01, to a temporary file.
+ *
+ * \param[in] minor SRNX minor version.
+ * \param[in] epoc If not NULL, payload of an EPOC chunk.
+ * \param[in] sigs Signals to write, in RHDR order.
+ * \param[in] n_sigs Number of signals in \a sigs.
+ * \param[out] path Receives the temporary file's name.
+ * \returns Zero on success, else -1.
+ */
+static int write_test_file(
+    int minor,
+    const struct tbuf *epoc,
+    const struct test_signal *sigs,
+    int n_sigs,
+    char path[32]
+)
+{
+    struct tbuf file = { NULL, 0, 0 };
+    int res;
+
+    build_test_file(&file, NULL, minor, epoc, sigs, n_sigs);
+    *path = '\0';
+    res = write_file(&file, file.len, path);
+    tb_free(&file);
+    return res;
+}
+
+/** Appends a zone-map summary entry to \a tb. */
+static void tb_summary(
+    struct tbuf *tb,
+    int64_t min_value,
+    int64_t max_value,
+    uint64_t n_lli,
+    uint64_t first_epoch,
+    uint64_t last_epoch
+)
+{
+    tb_sleb(tb, min_value);
+    tb_uleb(tb, max_value - min_value);
+    tb_uleb(tb, n_lli);
+    tb_uleb(tb, first_epoch);
+    tb_uleb(tb, last_epoch - first_epoch);
+}
+
+/** Number of zones in zone_value(). */
+#define ZONE_COUNT 10
+
+/** Number of observations per zone in zone_value(). */
+#define ZONE_SIZE 10
+
+/** Returns observation \a idx of the zone-map test signal: zone \a k
+ * holds the values 1000*k through 1000*k + 9.
+ */
+static int64_t zone_value(int idx)
+{
+    return 1000 * (idx / ZONE_SIZE) + idx % ZONE_SIZE;
+}
+
+/** Builds a first-order signal with a zone map over zone_value(). */
+static void build_zone_signal(struct test_signal *sig)
+{
+    uint64_t blocks[ZONE_COUNT];
+    size_t first_block;
+    int ii, jj;
+
+    memset(sig, 0, sizeof *sig);
+    sig->code = "L1";
+    sig->n_values = ZONE_COUNT * ZONE_SIZE;
+
+    /* Each zone is one run of SLEB128 deltas. */
+    tb_uleb(&sig->packed, 1);
+    tb_sleb(&sig->packed, 0);
+    first_block = sig->packed.len;
+    for (ii = 0; ii < ZONE_COUNT; ++ii)
+    {
+        blocks[ii] = sig->packed.len - first_block;
+        tb_byte(&sig->packed, 0xFF);
+        tb_uleb(&sig->packed, ZONE_SIZE - 1);
+        for (jj = ii * ZONE_SIZE; jj < (ii + 1) * ZONE_SIZE; ++jj)
+        {
+            tb_sleb(&sig->packed, zone_value(jj)
+                - (jj ? zone_value(jj - 1) : 0));
+        }
+    }
+
+    tb_uleb(&sig->zones, ZONE_SIZE - 1);
+    tb_summary(&sig->zones, 0, zone_value(sig->n_values - 1), 0, 0,
+        sig->n_values - 1);
+    for (ii = 0; ii < ZONE_COUNT; ++ii)
+    {
+        jj = ii * ZONE_SIZE;
+        tb_summary(&sig->zones, zone_value(jj),
+            zone_value(jj + ZONE_SIZE - 1), 0, jj, jj + ZONE_SIZE - 1);
+        tb_uleb(&sig->zones, blocks[ii]);
+        tb_sleb(&sig->zones, jj ? zone_value(jj - 1) : 0);
+    }
+}
+
+/** Reads the next \a count observations from \a p_socd and checks that
+ * they are zone_value(first) onwards.
+ */
+static void check_zone_values(
+    struct srnx_obs_reader *p_socd,
+    int first,
+    int count,
+    const char *what
+)
+{
+    int64_t value;
+    int ii, res;
+
+    for (ii = first; ii < first + count; ++ii)
+    {
+        value = -1;
+        res = srnx_read_obs_value(p_socd, &value);
+        if (!check(!res && value == zone_value(ii),
+            "%s: obs %d: %s, %lld", what, ii, srnx_strerror(res),
+            (long long)value))
+        {
+            break;
+        }
+    }
+}
+
+/** Tests srnx_seek_obs_zone() and srnx_next_matching_zone(). */
+static void test_zones(void)
+{
+    static const int seeks[] = { 0, 3, 4, 9, 2, 2, 7 };
+    struct srnx_satellite_name g01 = { "G01" };
+    struct srnx_obs_predicate pred;
+    struct srnx_reader *srnx = NULL;
+    struct srnx_obs_reader *p_socd = NULL;
+    struct srnx_obs_zone zone;
+    struct test_signal sig;
+    uint64_t zone_idx;
+    char path[32];
+    int ii, res;
+
+    build_zone_signal(&sig);
+    if (!check(!write_test_file(1, NULL, &sig, 1, path), "zones: write"))
+    {
+        return;
+    }
+    res = srnx_open(&srnx, path);
+    if (check(!res, "zones: open: %s", srnx_strerror(res)))
+    {
+        res = srnx_open_obs_by_index(srnx, g01, 0, &p_socd);
+        check(!res, "zones: open_obs: %s", srnx_strerror(res));
+    }
+    unlink(path);
+    if (res)
+    {
+        goto out;
+    }
+
+    /* Forward, repeated and backward seeks. */
+    check_zone_values(p_socd, 0, ZONE_SIZE + 3, "zones: start");
+    for (ii = 0; ii < (int)(sizeof seeks / sizeof seeks[0]); ++ii)
+    {
+        res = srnx_seek_obs_zone(p_socd, seeks[ii]);
+        if (check(!res, "zones: seek %d: %s", seeks[ii],
+            srnx_strerror(res)))
+        {
+            check_zone_values(p_socd, seeks[ii] * ZONE_SIZE, ZONE_SIZE,
+                "zones: seek");
+        }
+    }
+    res = srnx_seek_obs_zone(p_socd, ZONE_COUNT);
+    check(res == SRNX_END_OF_DATA, "zones: seek past end: %s",
+        srnx_strerror(res));
+
+    /* Values 3005 through 5002 lie in zones 3, 4 and 5. */
+    pred.min_value = 3005;
+    pred.max_value = 5002;
+    pred.need_lli = 0;
+    for (ii = 3, zone_idx = 0; ii < 6; ++ii, ++zone_idx)
+    {
+        res = srnx_next_matching_zone(p_socd, &pred, &zone_idx, &zone);
+        if (check(!res && zone_idx == (uint64_t)ii,
+            "zones: next match %d: %s, %llu", ii, srnx_strerror(res),
+            (unsigned long long)zone_idx))
+        {
+            check(zone.first_obs == (uint64_t)ii * ZONE_SIZE
+                && zone.n_obs == ZONE_SIZE
+                && zone.min_value == 1000 * ii
+                && zone.max_value == 1000 * ii + 9,
+                "zones: zone %d statistics", ii);
+            check_zone_values(p_socd, ii * ZONE_SIZE, ZONE_SIZE,
+                "zones: next match");
+        }
+    }
+    res = srnx_next_matching_zone(p_socd, &pred, &zone_idx, &zone);
+    check(res == SRNX_END_OF_DATA, "zones: after last match: %s",
+        srnx_strerror(res));
+
+    /* A predicate outside the summary skips the whole signal, and the
+     * search can restart from an earlier zone.
+     */
+    pred.need_lli = 1;
+    zone_idx = 0;
+    res = srnx_next_matching_zone(p_socd, &pred, &zone_idx, &zone);
+    check(res == SRNX_END_OF_DATA, "zones: LLI predicate: %s",
+        srnx_strerror(res));
+    pred.need_lli = 0;
+    pred.min_value = pred.max_value = 1004;
+    zone_idx = 0;
+    res = srnx_next_matching_zone(p_socd, &pred, &zone_idx, &zone);
+    check(!res && zone_idx == 1, "zones: restart: %s, %llu",
+        srnx_strerror(res), (unsigned long long)zone_idx);
+    check_zone_values(p_socd, ZONE_SIZE, ZONE_SIZE, "zones: restart");
+
+out:
+    srnx_free_obs_reader(p_socd);
+    srnx_close(srnx);
+    tb_free(&sig.packed);
+    tb_free(&sig.zones);
+}
+
+/** Appends a block of \a count SLEB128 values to \a tb. */
+static void tb_sleb_block(struct tbuf *tb, const int64_t values[], int count)
+{
+    int ii;
+
+    tb_byte(tb, 0xFF);
+    tb_uleb(tb, count - 1);
+    for (ii = 0; ii < count; ++ii)
+    {
+        tb_sleb(tb, values[ii]);
+    }
+}
+
+/** Appends a bit-matrix block to \a tb: \a count values (8, 16 or 32),
+ * each \a bits bits wide, as transposed big-endian bit planes.
+ */
+static void tb_bit_matrix(
+    struct tbuf *tb,
+    const int64_t values[],
+    int count,
+    int bits
+)
+{
+    int plane, ii, jj, byte;
+
+    tb_byte(tb, ((count >> 4) << 5) | (bits - 1));
+    for (plane = bits; plane-- > 0; )
+    {
+        for (ii = 0; ii < count; ii += 8)
+        {
+            for (jj = byte = 0; jj < 8; ++jj)
+            {
+                byte = (byte << 1) | ((values[ii + jj] >> plane) & 1);
+            }
+            tb_byte(tb, byte);
+        }
+    }
+}
+
+/** Opens signal \a obs_idx of G01 and checks that it holds exactly the
+ * \a count values in \a expect.
+ */
+static void check_signal(
+    struct srnx_reader *srnx,
+    int obs_idx,
+    const int64_t expect[],
+    int count,
+    const char *what
+)
+{
+    struct srnx_satellite_name g01 = { "G01" };
+    struct srnx_obs_reader *p_socd = NULL;
+    int64_t value;
+    int ii, res;
+
+    res = srnx_open_obs_by_index(srnx, g01, obs_idx, &p_socd);
+    if (!check(!res, "%s: open_obs: %s", what, srnx_strerror(res)))
+    {
+        return;
+    }
+    for (ii = 0; ii < count; ++ii)
+    {
+        value = 0;
+        res = srnx_read_obs_value(p_socd, &value);
+        if (!check(!res && value == expect[ii], "%s: obs %d: %s, %lld"
+            " instead of %lld", what, ii, srnx_strerror(res),
+            (long long)value, (long long)expect[ii]))
+        {
+            break;
+        }
+    }
+    if (ii == count)
+    {
+        res = srnx_read_obs_value(p_socd, &value);
+        check(res == SRNX_END_OF_DATA, "%s: after last obs: %s", what,
+            srnx_strerror(res));
+    }
+    srnx_free_obs_reader(p_socd);
+}
+
+/** Number of values in each long block of test_blocks(); more than an
+ * observation reader decodes at once.
+ */
+#define LONG_BLOCK 300
+
+/** Number of values in test_blocks(). */
+#define BLOCKS_COUNT (6 + LONG_BLOCK + 8 + 16 + 32 + LONG_BLOCK)
+
+/** Tests each block encoding, with values and counts that need
+ * multi-byte LEB128s, blocks longer than the decode buffer, and bit
+ * matrices with several bit planes.  L1 stores the values directly
+ * and L2 stores them as second-order deltas.
+ */
+static void test_blocks(void)
+{
+    static const int64_t sleb_values[] = {
+        -1, 1, -64, 64, -8193, INT64_C(1234567890123)
+    };
+    static const int64_t m8[] = { -16, 15, 0, -1, 7, -8, 3, -3 };
+    struct test_signal sigs[2];
+    struct srnx_reader *srnx = NULL;
+    struct tbuf blocks = { NULL, 0, 0 };
+    int64_t *values, *expect, m16[16], m32[32], y0, y1;
+    char path[32];
+    int ii, nn, res;
+
+    /* Build the blocks and the values they hold. */
+    values = calloc(2 * BLOCKS_COUNT, sizeof *values);
+    if (!values)
+    {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    expect = values + BLOCKS_COUNT;
+    tb_sleb_block(&blocks, sleb_values, 6);
+    memcpy(values, sleb_values, sizeof sleb_values);
+    nn = 6;
+    tb_byte(&blocks, 0xFE);
+    tb_uleb(&blocks, LONG_BLOCK - 1);
+    nn += LONG_BLOCK;
+    tb_bit_matrix(&blocks, m8, 8, 5);
+    memcpy(values + nn, m8, sizeof m8);
+    nn += 8;
+    for (ii = 0; ii < 16; ++ii)
+    {
+        m16[ii] = values[nn++] = ii % 8 - 4;
+    }
+    tb_bit_matrix(&blocks, m16, 16, 3);
+    for (ii = 0; ii < 32; ++ii)
+    {
+        m32[ii] = values[nn++] = ii * 97 % 4096 - 2048;
+    }
+    tb_bit_matrix(&blocks, m32, 32, 12);
+    for (ii = 0; ii < LONG_BLOCK; ++ii)
+    {
+        values[nn + ii] = ii * 1000 - 150000;
+    }
+    tb_sleb_block(&blocks, values + nn, LONG_BLOCK);
+
+    /* L1 is zeroth order; L2 is second order, starting from 5 and -3. */
+    memset(sigs, 0, sizeof sigs);
+    sigs[0].code = "L1";
+    sigs[0].n_values = BLOCKS_COUNT;
+    tb_uleb(&sigs[0].packed, 0);
+    tb_bytes(&sigs[0].packed, blocks.data, blocks.len);
+    sigs[1].code = "L2";
+    sigs[1].n_values = BLOCKS_COUNT;
+    tb_uleb(&sigs[1].packed, 2);
+    tb_sleb(&sigs[1].packed, 5);
+    tb_sleb(&sigs[1].packed, -3);
+    tb_bytes(&sigs[1].packed, blocks.data, blocks.len);
+    for (ii = 0, y0 = 5, y1 = -3; ii < BLOCKS_COUNT; ++ii)
+    {
+        y1 += values[ii];
+        y0 += y1;
+        expect[ii] = y0;
+    }
+
+    if (check(!write_test_file(2, NULL, sigs, 2, path), "blocks: write"))
+    {
+        res = srnx_open(&srnx, path);
+        unlink(path);
+        if (check(!res, "blocks: open: %s", srnx_strerror(res)))
+        {
+            check_signal(srnx, 0, values, BLOCKS_COUNT, "blocks: L1");
+            check_signal(srnx, 1, expect, BLOCKS_COUNT, "blocks: L2");
+        }
+    }
+
+    srnx_close(srnx);
+    for (ii = 0; ii < 2; ++ii)
+    {
+        tb_free(&sigs[ii].packed);
+    }
+    tb_free(&blocks);
+    free(values);
+}
+
+/** Returns the cross-signal prediction for reference value \a ref,
+ * computed as the format specification gives it.
+ */
+static int64_t predict(int64_t num, int64_t den, int64_t ref)
+{
+    __int128 n = (__int128)2 * num * ref + den, q;
+
+    q = n / (2 * den);
+    if (n % (2 * den) < 0)
+    {
+        --q;
+    }
+    return q;
+}
+
+/** Tests cross-signal prediction, including blanks on either side and
+ * the largest allowed denominator.
+ */
+static void test_predict(void)
+{
+    /* Observation 2 has a blank reference and observation 3 is a blank
+     * predicted value.
+     */
+    static const int64_t ref[] = {
+        20000000, -20000001, 0, 123456789, 987654321, 77, -77, 1
+    };
+    static const int64_t obs[] = {
+        15584000, -15584002, 5000, 0, 769600000, 60, -60, 1
+    };
+    static const struct
+    {
+        int64_t num;
+        uint64_t den_m1;
+        int valid;
+    } params[] = {
+        { 60, 76, 1 },
+        { -3, 0, 1 },
+        { 1000000000, 1000000000, 1 },
+        { -1000000000, 999999999, 1 },
+        { 1, 1000000001, 0 },
+        { 1000000001, 0, 0 },
+    };
+    const int n_obs = sizeof obs / sizeof obs[0];
+    struct srnx_satellite_name g01 = { "G01" };
+    struct srnx_obs_reader *p_socd = NULL;
+    struct test_signal sigs[2];
+    struct srnx_reader *srnx;
+    int64_t prev, residual;
+    char path[32], what[32];
+    int ii, jj, res;
+
+    memset(sigs, 0, sizeof sigs);
+    sigs[0].code = "L1";
+    sigs[0].n_values = n_obs;
+    tb_uleb(&sigs[0].packed, 0);
+    tb_sleb_block(&sigs[0].packed, ref, n_obs);
+    sigs[1].code = "L2";
+    sigs[1].n_values = n_obs;
+
+    for (ii = 0; ii < (int)(sizeof params / sizeof params[0]); ++ii)
+    {
+        /* L2 is predicted from L1 and first-order delta coded. */
+        sigs[1].packed.len = 0;
+        tb_uleb(&sigs[1].packed, 16 | 1);
+        tb_uleb(&sigs[1].packed, 0);
+        tb_sleb(&sigs[1].packed, params[ii].num);
+        tb_uleb(&sigs[1].packed, params[ii].den_m1);
+        tb_sleb(&sigs[1].packed, 0);
+        tb_byte(&sigs[1].packed, 0xFF);
+        tb_uleb(&sigs[1].packed, n_obs - 1);
+        for (jj = 0, prev = 0; jj < n_obs; ++jj)
+        {
+            residual = obs[jj] - predict(params[ii].num,
+                params[ii].den_m1 + 1, ref[jj]);
+            tb_sleb(&sigs[1].packed, residual - prev);
+            prev = residual;
+        }
+
+        snprintf(what, sizeof what, "predict %lld/%llu",
+            (long long)params[ii].num,
+            (unsigned long long)params[ii].den_m1 + 1);
+        if (!check(!write_test_file(2, NULL, sigs, 2, path),
+            "%s: write", what))
+        {
+            continue;
+        }
+        srnx = NULL;
+        res = srnx_open(&srnx, path);
+        unlink(path);
+        if (!check(!res, "%s: open: %s", what, srnx_strerror(res)))
+        {
+            continue;
+        }
+        if (params[ii].valid)
+        {
+            check_signal(srnx, 0, ref, n_obs, what);
+            check_signal(srnx, 1, obs, n_obs, what);
+        }
+        else
+        {
+            res = srnx_open_obs_by_index(srnx, g01, 1, &p_socd);
+            check(res == SRNX_CORRUPT, "%s: open_obs: %s", what,
+                srnx_strerror(res));
+            srnx_free_obs_reader(p_socd);
+            p_socd = NULL;
+        }
+        srnx_close(srnx);
+    }
+
+    for (ii = 0; ii < 2; ++ii)
+    {
+        tb_free(&sigs[ii].packed);
+    }
+}
+
+/** Length of the rANS test input. */
+#define RANS_LEN 10007
+
+/** Tests that each rANS decoder inverts srnx_rans_encode(), and that
+ * they reject truncated or mislabelled streams.
+ */
+static void test_rans(void)
+{
+    static const char *const versions[] = { "generic", "avx2" };
+    char *in, *out, *coded = NULL;
+    size_t coded_len;
+    uint32_t seed = 1;
+    int ii, res;
+
+    /* Mostly 0 and 1, with 255 and a spread of rarer bytes, so that the
+     * symbol table has first, adjacent and distant byte values.
+     */
+    in = malloc(RANS_LEN);
+    out = malloc(RANS_LEN + 1);
+    if (!in || !out)
+    {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for (ii = 0; ii < RANS_LEN; ++ii)
+    {
+        seed = seed * 1103515245 + 12345;
+        res = (seed >> 16) & 63;
+        in[ii] = res < 40 ? 0 : res < 56 ? 1 : res < 60 ? -1 : res * 3;
+    }
+    check(srnx_rans_encode(&coded, in, SRNX_RANS_MIN_LEN - 1) == 0,
+        "rans: encoded a short input");
+    coded_len = srnx_rans_encode(&coded, in, RANS_LEN);
+    if (!check(coded_len > 0 && coded_len < RANS_LEN, "rans: coded length"
+        " %zu", coded_len))
+    {
+        goto out;
+    }
+
+    for (ii = 0; ii < 2; ++ii)
+    {
+        if (srnx_rans_select(versions[ii]))
+        {
+            printf("rans: %s decoder not built\n", versions[ii]);
+            continue;
+        }
+        memset(out, 0, RANS_LEN);
+        res = srnx_rans_decode(out, RANS_LEN, coded, coded_len);
+        check(!res && !memcmp(in, out, RANS_LEN), "rans %s: round trip:"
+            " %s", versions[ii], srnx_strerror(res));
+
+        /* Streams that end early, or that hold more or fewer bytes
+         * than claimed, are corrupt.
+         */
+        res = srnx_rans_decode(out, RANS_LEN, coded, coded_len - 1);
+        check(res == SRNX_CORRUPT, "rans %s: missing byte: %s",
+            versions[ii], srnx_strerror(res));
+        res = srnx_rans_decode(out, RANS_LEN, coded, coded_len / 2);
+        check(res == SRNX_CORRUPT, "rans %s: missing half: %s",
+            versions[ii], srnx_strerror(res));
+        res = srnx_rans_decode(out, RANS_LEN, coded, 40);
+        check(res == SRNX_CORRUPT, "rans %s: missing states: %s",
+            versions[ii], srnx_strerror(res));
+        res = srnx_rans_decode(out, RANS_LEN + 1, coded, coded_len);
+        check(res == SRNX_CORRUPT, "rans %s: long output: %s",
+            versions[ii], srnx_strerror(res));
+        res = srnx_rans_decode(out, RANS_LEN - 1, coded, coded_len);
+        check(res == SRNX_CORRUPT, "rans %s: short output: %s",
+            versions[ii], srnx_strerror(res));
+    }
+    srnx_rans_select(NULL);
+
+out:
+    srnx_free(coded);
+    free(out);
+    free(in);
+}
+
+/** Number of zones in coded_value(). */
+#define CODED_ZONES 4
+
+/** Number of observations per zone in coded_value(); enough for each
+ * zone's blocks to be worth entropy coding.
+ */
+#define CODED_ZONE_SIZE 400
+
+/** Returns observation \a idx of the entropy-coding test signal. */
+static int64_t coded_value(int idx)
+{
+    return 1000 * (idx / CODED_ZONE_SIZE) + idx % 3;
+}
+
+/** Tests a first-order signal whose blocks are entropy coded, with
+ * one segment per zone.
+ */
+static void test_coded(void)
+{
+    static const int seeks[] = { 2, 0, 3, 1 };
+    struct srnx_satellite_name g01 = { "G01" };
+    struct srnx_obs_reader *p_socd = NULL;
+    struct srnx_reader *srnx = NULL;
+    struct test_signal sig;
+    struct tbuf blocks = { NULL, 0, 0 }, segments = { NULL, 0, 0 };
+    uint64_t offsets[CODED_ZONES];
+    int64_t *obs = NULL, expect[CODED_ZONES * CODED_ZONE_SIZE], value;
+    char *coded = NULL, path[32];
+    size_t coded_len;
+    int idx[1] = { 0 }, n_values, ii, jj, res;
+
+    /* Code each zone's SLEB128 run as its own segment. */
+    memset(&sig, 0, sizeof sig);
+    for (ii = 0; ii < CODED_ZONES * CODED_ZONE_SIZE; ++ii)
+    {
+        expect[ii] = coded_value(ii);
+    }
+    for (ii = 0; ii < CODED_ZONES; ++ii)
+    {
+        jj = ii * CODED_ZONE_SIZE;
+        blocks.len = 0;
+        tb_byte(&blocks, 0xFF);
+        tb_uleb(&blocks, CODED_ZONE_SIZE - 1);
+        for (; jj < (ii + 1) * CODED_ZONE_SIZE; ++jj)
+        {
+            tb_sleb(&blocks, expect[jj] - (jj ? expect[jj - 1] : 0));
+        }
+        coded_len = srnx_rans_encode(&coded, blocks.data, blocks.len);
+        if (!check(coded_len > 0, "coded: zone %d not coded", ii))
+        {
+            goto out;
+        }
+        offsets[ii] = segments.len;
+        tb_uleb(&segments, blocks.len);
+        tb_uleb(&segments, coded_len);
+        tb_bytes(&segments, coded, coded_len);
+    }
+
+    sig.code = "L1";
+    sig.n_values = CODED_ZONES * CODED_ZONE_SIZE;
+    tb_uleb(&sig.packed, 32 | 1);
+    tb_sleb(&sig.packed, 0);
+    tb_bytes(&sig.packed, segments.data, segments.len);
+    tb_uleb(&sig.zones, CODED_ZONE_SIZE - 1);
+    tb_summary(&sig.zones, 0, expect[sig.n_values - 1], 0, 0,
+        sig.n_values - 1);
+    for (ii = 0; ii < CODED_ZONES; ++ii)
+    {
+        jj = ii * CODED_ZONE_SIZE;
+        tb_summary(&sig.zones, 1000 * ii, 1000 * ii + 2, 0, jj,
+            jj + CODED_ZONE_SIZE - 1);
+        tb_uleb(&sig.zones, offsets[ii]);
+        tb_sleb(&sig.zones, jj ? expect[jj - 1] : 0);
+    }
+
+    if (!check(!write_test_file(3, NULL, &sig, 1, path), "coded: write"))
+    {
+        goto out;
+    }
+    res = srnx_open(&srnx, path);
+    unlink(path);
+    if (!check(!res, "coded: open: %s", srnx_strerror(res)))
+    {
+        goto out;
+    }
+
+    /* Read the whole signal, then seek around its zones. */
+    check_signal(srnx, 0, expect, sig.n_values, "coded");
+    res = srnx_open_obs_by_index(srnx, g01, 0, &p_socd);
+    if (!check(!res, "coded: open_obs: %s", srnx_strerror(res)))
+    {
+        goto out;
+    }
+    for (ii = 0; ii < (int)(sizeof seeks / sizeof seeks[0]); ++ii)
+    {
+        res = srnx_seek_obs_zone(p_socd, seeks[ii]);
+        if (!check(!res, "coded: seek %d: %s", seeks[ii],
+            srnx_strerror(res)))
+        {
+            continue;
+        }
+        jj = seeks[ii] * CODED_ZONE_SIZE;
+        for (; jj < (seeks[ii] + 1) * CODED_ZONE_SIZE; ++jj)
+        {
+            value = -1;
+            res = srnx_read_obs_value(p_socd, &value);
+            if (!check(!res && value == expect[jj], "coded: seek %d: obs"
+                " %d: %s, %lld", seeks[ii], jj, srnx_strerror(res),
+                (long long)value))
+            {
+                break;
+            }
+        }
+    }
+
+    /* The column reader decodes every segment too. */
+    res = srnx_get_obs_by_index(srnx, g01, 1, idx, &n_values, &obs,
+        NULL, NULL);
+    check(!res && n_values == (int)sig.n_values
+        && !memcmp(obs, expect, sizeof expect), "coded: column: %s",
+        srnx_strerror(res));
+
+out:
+    srnx_free(obs);
+    srnx_free_obs_reader(p_socd);
+    srnx_close(srnx);
+    srnx_free(coded);
+    tb_free(&blocks);
+    tb_free(&segments);
+    tb_free(&sig.packed);
+    tb_free(&sig.zones);
+}
+
+/** Number of observations in the pread test signal; enough that its
+ * SOCD chunk spans several of the pread backend's blocks.
+ */
+#define PREAD_COUNT 200000
+
+/** Builds a zeroth-order signal of \a n_values observations, stored
+ * as one SLEB128 run, with observation \a ii equal to \a ii modulo
+ * \a modulus.
+ */
+static void build_run_signal(
+    struct test_signal *sig,
+    const char *code,
+    int n_values,
+    int modulus
+)
+{
+    int ii;
+
+    memset(sig, 0, sizeof *sig);
+    sig->code = code;
+    sig->n_values = n_values;
+    tb_uleb(&sig->packed, 0);
+    tb_byte(&sig->packed, 0xFF);
+    tb_uleb(&sig->packed, n_values - 1);
+    for (ii = 0; ii < n_values; ++ii)
+    {
+        tb_sleb(&sig->packed, ii % modulus);
+    }
+}
+
+/** Number of observations in test_indicators()' signals. */
+#define INDICATOR_COUNT 200
+
+/** Appends one run of \a count indicators \a ind to \a tb. */
+static void tb_indicator_run(struct tbuf *tb, char ind, uint64_t count)
+{
+    tb_byte(tb, ind);
+    tb_uleb(tb, count - 1);
+}
+
+/** Checks that \a runs (\a n_runs of them) match \a expect, a string
+ * of indicator characters, and that their counts match \a counts and
+ * add up to INDICATOR_COUNT.
+ */
+static void check_indicator_runs(
+    const struct srnx_indicator_run *runs,
+    size_t n_runs,
+    const char *expect,
+    const uint64_t counts[],
+    const char *what
+)
+{
+    uint64_t total;
+    size_t ii;
+
+    if (!check(n_runs == strlen(expect), "%s: %zu runs", what, n_runs))
+    {
+        return;
+    }
+    for (ii = 0, total = 0; ii < n_runs; ++ii)
+    {
+        check(runs[ii].value == expect[ii] && runs[ii].count == counts[ii],
+            "%s: run %zu is %llu of '%c'", what, ii,
+            (unsigned long long)runs[ii].count, runs[ii].value);
+        total += runs[ii].count;
+    }
+    check(total == INDICATOR_COUNT, "%s: %llu values", what,
+        (unsigned long long)total);
+}
+
+/** Checks \a bitmap against the expanded indicators \a inds: each bit
+ * must be set exactly when \a want(\a inds[ii], \a arg) is true.
+ */
+static void check_flag_bitmap(
+    const uint64_t *bitmap,
+    const char *inds,
+    int (*want)(char ind, int arg),
+    int arg,
+    const char *what
+)
+{
+    int ii, bit;
+
+    for (ii = 0; ii < INDICATOR_COUNT; ++ii)
+    {
+        bit = (bitmap[ii / 64] >> (ii % 64)) & 1;
+        if (!check(bit == !!want(inds[ii], arg), "%s: bit %d", what, ii))
+        {
+            break;
+        }
+    }
+    for (ii = INDICATOR_COUNT; ii % 64; ++ii)
+    {
+        check(!((bitmap[ii / 64] >> (ii % 64)) & 1), "%s: pad bit %d",
+            what, ii);
+    }
+}
+
+/** Returns whether LLI \a ind has bit \a mask set. */
+static int lli_has(char ind, int mask)
+{
+    return ind >= '0' && ind <= '7' && ((ind - '0') & mask);
+}
+
+/** Returns whether SSI \a ind is at least \a ssi_min. */
+static int ssi_at_least(char ind, int ssi_min)
+{
+    return ind >= '0' + ssi_min && ind <= '9';
+}
+
+/** Tests the indicator-run and packed flag APIs.  L1's runs cross
+ * 64-bit word boundaries and leave a final run of epochs unencoded;
+ * L2's SSI runs cover every epoch, but its LLI runs overrun the count.
+ */
+static void test_indicators(void)
+{
+    static const char l1_lli[] = "1 32 ";
+    static const uint64_t l1_lli_count[] = { 3, 60, 70, 5, 62 };
+    static const char l1_ssi[] = "5739 ";
+    static const uint64_t l1_ssi_count[] = { 64, 65, 10, 1, 60 };
+    static const char l2_ssi[] = "81";
+    static const uint64_t l2_ssi_count[] = { 128, 72 };
+    struct srnx_satellite_name g01 = { "G01" };
+    struct srnx_reader *srnx = NULL;
+    struct srnx_obs_reader *p_socd = NULL;
+    struct srnx_indicator_run *runs = NULL;
+    struct test_signal sigs[2];
+    uint64_t *slip = NULL, *half = NULL, *strong = NULL;
+    char *lli = NULL, *ssi = NULL, path[32];
+    size_t n_runs;
+    int ii, n_values, res;
+
+    /* The last run of L1's LLIs and SSIs is left implicit. */
+    build_run_signal(sigs + 0, "L1", INDICATOR_COUNT, 7);
+    build_run_signal(sigs + 1, "L2", INDICATOR_COUNT, 9);
+    for (ii = 0; ii < 4; ++ii)
+    {
+        tb_indicator_run(&sigs[0].lli, l1_lli[ii], l1_lli_count[ii]);
+        tb_indicator_run(&sigs[0].ssi, l1_ssi[ii], l1_ssi_count[ii]);
+    }
+    tb_indicator_run(&sigs[1].lli, '1', 150);
+    tb_indicator_run(&sigs[1].lli, '2', 51);
+    tb_indicator_run(&sigs[1].ssi, l2_ssi[0], l2_ssi_count[0]);
+    tb_indicator_run(&sigs[1].ssi, l2_ssi[1], l2_ssi_count[1]);
+
+    if (!check(!write_test_file(1, NULL, sigs, 2, path),
+        "indicators: write"))
+    {
+        goto out;
+    }
+    res = srnx_open(&srnx, path);
+    unlink(path);
+    if (!check(!res, "indicators: open: %s", srnx_strerror(res)))
+    {
+        goto out;
+    }
+
+    /* L1: the runs, then the bitmaps against the expanded indicators. */
+    res = srnx_open_obs_by_index(srnx, g01, 0, &p_socd);
+    if (!check(!res, "indicators: open L1: %s", srnx_strerror(res)))
+    {
+        goto out;
+    }
+    res = srnx_read_obs_lli_runs(p_socd, &runs, &n_runs);
+    if (check(!res, "indicators: L1 LLI runs: %s", srnx_strerror(res)))
+    {
+        check_indicator_runs(runs, n_runs, l1_lli, l1_lli_count,
+            "indicators: L1 LLI runs");
+    }
+    res = srnx_read_obs_ssi_runs(p_socd, &runs, &n_runs);
+    if (check(!res, "indicators: L1 SSI runs: %s", srnx_strerror(res)))
+    {
+        check_indicator_runs(runs, n_runs, l1_ssi, l1_ssi_count,
+            "indicators: L1 SSI runs");
+    }
+
+    res = srnx_read_obs_ssi_lli(p_socd, &n_values, &lli, &ssi);
+    if (!check(!res && n_values == INDICATOR_COUNT,
+        "indicators: L1 expand: %s", srnx_strerror(res)))
+    {
+        goto out;
+    }
+    for (ii = 1; ii <= 9; ii += 4)
+    {
+        res = srnx_read_obs_flags(p_socd, ii, &slip, &half, &strong);
+        if (check(!res, "indicators: L1 flags: %s", srnx_strerror(res)))
+        {
+            check_flag_bitmap(slip, lli, lli_has, 1, "indicators: slip");
+            check_flag_bitmap(half, lli, lli_has, 2, "indicators: half");
+            check_flag_bitmap(strong, ssi, ssi_at_least, ii,
+                "indicators: strong");
+        }
+    }
+
+    /* NULL outputs are skipped, and the others still filled. */
+    memset(half, 0xff, sizeof(*half));
+    res = srnx_read_obs_flags(p_socd, 5, NULL, &half, NULL);
+    if (check(!res, "indicators: half only: %s", srnx_strerror(res)))
+    {
+        check_flag_bitmap(half, lli, lli_has, 2, "indicators: half only");
+    }
+    memset(ssi, 0, INDICATOR_COUNT);
+    res = srnx_read_obs_ssi_lli(p_socd, &n_values, NULL, &ssi);
+    check(!res && ssi[0] == '5' && ssi[INDICATOR_COUNT - 1] == ' ',
+        "indicators: SSI only: %s", srnx_strerror(res));
+
+    /* L2: SSI runs that cover every epoch need no blank run, but LLI
+     * runs that cover too many are corrupt.
+     */
+    res = srnx_open_obs_by_index(srnx, g01, 1, &p_socd);
+    if (!check(!res, "indicators: open L2: %s", srnx_strerror(res)))
+    {
+        goto out;
+    }
+    res = srnx_read_obs_ssi_runs(p_socd, &runs, &n_runs);
+    if (check(!res, "indicators: L2 SSI runs: %s", srnx_strerror(res)))
+    {
+        check_indicator_runs(runs, n_runs, l2_ssi, l2_ssi_count,
+            "indicators: L2 SSI runs");
+    }
+    res = srnx_read_obs_lli_runs(p_socd, &runs, &n_runs);
+    check(res == SRNX_CORRUPT, "indicators: L2 LLI runs: %s",
+        srnx_strerror(res));
+    res = srnx_read_obs_flags(p_socd, 5, &slip, NULL, NULL);
+    check(res == SRNX_CORRUPT, "indicators: L2 slip: %s",
+        srnx_strerror(res));
+    res = srnx_read_obs_flags(p_socd, 5, NULL, NULL, &strong);
+    check(!res && strong[0] == ~0ULL && strong[1] == ~0ULL && !strong[2],
+        "indicators: L2 strong: %s", srnx_strerror(res));
+    res = srnx_read_obs_ssi_lli(p_socd, &n_values, &lli, NULL);
+    check(res == SRNX_CORRUPT, "indicators: L2 expand: %s",
+        srnx_strerror(res));
+
+out:
+    srnx_free(lli);
+    srnx_free(ssi);
+    srnx_free(slip);
+    srnx_free(half);
+    srnx_free(strong);
+    srnx_free(runs);
+    srnx_free_obs_reader(p_socd);
+    srnx_close(srnx);
+    for (ii = 0; ii < 2; ++ii)
+    {
+        tb_free(&sigs[ii].packed);
+        tb_free(&sigs[ii].lli);
+        tb_free(&sigs[ii].ssi);
+    }
+}
+
+/** GPS time of 2021-01-02 00:00:00, in nanoseconds. */
+#define EPOCH_20210102 INT64_C(1293580800000000000)
+
+/** Tests the epoch index against a hand-built EPOC chunk.  The second
+ * lookup finds the chunk from its remembered offset rather than by
+ * scanning, which once misread the chunk's length.
+ */
+static void test_epochs(void)
+{
+    static const int64_t expect[] = {
+        EPOCH_20210102,
+        EPOCH_20210102 + INT64_C(30000000000),
+        EPOCH_20210102 + INT64_C(270000000000),
+        EPOCH_20210102 + INT64_C(3600000000000),
+        EPOCH_20210102 + INT64_C(3604000000000)
+    };
+    static const uint64_t expect_idx[] = { 0, 1, 9, 10, 14 };
+    struct srnx_epoch_index *index = NULL;
+    struct srnx_reader *srnx = NULL;
+    struct rinex_epoch *epochs = NULL;
+    struct test_signal sig;
+    struct tbuf epoc = { NULL, 0, 0 };
+    size_t n_epochs = 0;
+    char path[32];
+    int ii, pass, res;
+
+    /* Ten epochs every 30 seconds from midnight, then five epochs
+     * every second from 01:00:00.  Like the reader, this stores each
+     * span's epoch count itself, and it omits the clock offsets.
+     */
+    tb_uleb(&epoc, 15);
+    tb_sleb(&epoc, -30);
+    tb_uleb(&epoc, 10);
+    tb_uleb(&epoc, 20210102);
+    tb_uleb(&epoc, 0);
+    tb_sleb(&epoc, 10000000);
+    tb_uleb(&epoc, 5);
+    tb_uleb(&epoc, 20210102);
+    tb_uleb(&epoc, INT64_C(100000000000));
+
+    build_run_signal(&sig, "L1", 15, 7);
+    if (!check(!write_test_file(1, &epoc, &sig, 1, path), "epochs: write"))
+    {
+        goto out;
+    }
+    res = srnx_open(&srnx, path);
+    unlink(path);
+    if (!check(!res, "epochs: open: %s", srnx_strerror(res)))
+    {
+        goto out;
+    }
+
+    for (pass = 0; pass < 2; ++pass)
+    {
+        res = srnx_get_epoch_index(srnx, &index);
+        if (!check(!res, "epochs: pass %d: %s", pass, srnx_strerror(res)))
+        {
+            continue;
+        }
+        check(srnx_epoch_index_count(index) == 15, "epochs: count %llu",
+            (unsigned long long)srnx_epoch_index_count(index));
+        for (ii = 0; ii < 5; ++ii)
+        {
+            check(srnx_epoch_index_time(index, expect_idx[ii]) == expect[ii],
+                "epochs: time of epoch %llu",
+                (unsigned long long)expect_idx[ii]);
+            check(srnx_epoch_index_find(index, expect[ii] - 1)
+                == expect_idx[ii], "epochs: find %d", ii);
+        }
+    }
+
+    res = srnx_get_epochs(srnx, &epochs, &n_epochs);
+    if (check(!res && n_epochs == 15, "epochs: get_epochs: %s",
+        srnx_strerror(res)))
+    {
+        for (ii = 0; ii < 5; ++ii)
+        {
+            check(srnx_epoch_to_gps_ns(epochs + expect_idx[ii])
+                == expect[ii], "epochs: epoch %llu",
+                (unsigned long long)expect_idx[ii]);
+        }
+    }
+
+out:
+    srnx_free(epochs);
+    srnx_free_epoch_index(index);
+    srnx_close(srnx);
+    tb_free(&sig.packed);
+    tb_free(&epoc);
+}
+
+/** Number of SRNX files in test_catalog(). */
+#define CATALOG_FILES 5
+
+/** Writes an SRNX file for test_catalog() whose epochs are each minute
+ * of 2021-01-02 from \a first_min to \a last_min.
+ *
+ * \param[in] marker MARKER NAME for the file.
+ * \param[in] first_min Minute of the first epoch; less than 60.
+ * \param[in] last_min Minute of the last epoch; less than 60.
+ * \param[in] sig Signal to write.
+ * \param[in,out] path Name of the file to write, or empty for a new
+ *   temporary file.
+ * \returns Zero on success, else -1.
+ */
+static int write_catalog_file(
+    const char *marker,
+    int first_min,
+    int last_min,
+    const struct test_signal *sig,
+    char path[32]
+)
+{
+    struct tbuf file = { NULL, 0, 0 }, epoc = { NULL, 0, 0 };
+    char rhdr[4 * 81 + 1];
+    int res;
+
+    snprintf(rhdr, sizeof rhdr, "%s%-60.60sMARKER NAME         \n%s",
+        "     2.11           OBSERVATION DATA    G (GPS)             RINEX VERSION / TYPE\n",
+        marker,
+        "     2    L1    L2                                          # / TYPES OF OBSERV\n"
+        "                                                            END OF HEADER\n");
+    tb_uleb(&epoc, last_min - first_min + 1);
+    tb_sleb(&epoc, -60);
+    tb_uleb(&epoc, last_min - first_min + 1);
+    tb_uleb(&epoc, 20210102);
+    tb_uleb(&epoc, first_min * INT64_C(1000000000));
+    build_test_file(&file, rhdr, 1, &epoc, sig, 1);
+    res = write_file(&file, file.len, path);
+    tb_free(&file);
+    tb_free(&epoc);
+    return res;
+}
+
+/** Returns a bit mask of which of \a path the entries that
+ * srnx_catalog_find() returns for ALPHA between minutes \a start_min
+ * and \a end_min (either negative for no bound) belong to, or -1 if
+ * the search fails or returns entries out of order.
+ */
+static int catalog_matches(
+    const struct srnx_catalog *cat,
+    int start_min,
+    int end_min,
+    char path[CATALOG_FILES][32]
+)
+{
+    struct rinex_epoch start, end;
+    size_t *idx = NULL;
+    size_t count = 0, ii;
+    const char *name;
+    int res, mask, jj;
+
+    memset(&start, 0, sizeof start);
+    memset(&end, 0, sizeof end);
+    start.yyyy_mm_dd = end.yyyy_mm_dd = 20210102;
+    start.hh_mm = start_min;
+    end.hh_mm = end_min;
+
+    res = srnx_catalog_find(cat, "ALPHA", (start_min < 0) ? NULL : &start,
+        (end_min < 0) ? NULL : &end, &idx, &count);
+    if (!check(!res, "catalog: find: %s", srnx_strerror(res)))
+    {
+        return -1;
+    }
+
+    for (ii = 0, mask = 0; ii < count; ++ii)
+    {
+        if (ii > 0 && idx[ii] <= idx[ii - 1])
+        {
+            mask = -1;
+            break;
+        }
+        name = srnx_catalog_path(cat, srnx_catalog_entry(cat, idx[ii]));
+        for (jj = 0; jj < CATALOG_FILES; ++jj)
+        {
+            if (!strcmp(name, path[jj]))
+            {
+                mask |= 1 << jj;
+            }
+        }
+    }
+
+    srnx_free(idx);
+    return mask;
+}
+
+/** Tests building, rebuilding and searching a catalog.  File A covers
+ * minutes 0-50 of a day, B 10-20 and C 30-40, so A overlaps spans
+ * that lie between B and C although B does not.  D (30-45 after it
+ * is rewritten) touches C, and E is another station.
+ */
+static void test_catalog(void)
+{
+    static const struct
+    {
+        const char *marker;
+        int first_min, last_min;
+    } spec[CATALOG_FILES] = {
+        { "ALPHA", 0, 50 },
+        { "ALPHA", 10, 20 },
+        { "ALPHA", 30, 40 },
+        { "ALPHA", 40, 45 },
+        { "BRAVO", 0, 59 }
+    };
+    static const struct
+    {
+        int start_min, end_min, mask;
+    } query[] = {
+        { 25, -1, 0x0D },       /* A (nested B ends first), C, D */
+        { 25, 28, 0x01 },       /* A only: B and C are disjoint */
+        { 20, 20, 0x03 },       /* touches B's end */
+        { 30, 30, 0x05 },       /* touches C's start */
+        { 45, -1, 0x09 },       /* touches D's end */
+        { 51, -1, 0x00 },       /* after every file */
+        { -1, 5, 0x01 },        /* before all but A */
+        { -1, -1, 0x0F }        /* every ALPHA file */
+    };
+    const char *names[CATALOG_FILES];
+    struct srnx_catalog *cat = NULL;
+    const struct srnx_catalog_entry *entry;
+    struct timespec times[2];
+    struct test_signal sig;
+    char path[CATALOG_FILES][32], cat_path[32];
+    int ii, res, n_failed_files, mask;
+
+    build_run_signal(&sig, "L1", 60, 7);
+    memset(path, 0, sizeof path);
+    strcpy(cat_path, "/tmp/srnx_test.XXXXXX");
+    res = mkstemp(cat_path);
+    if (!check(res >= 0, "catalog: mkstemp: %s", strerror(errno)))
+    {
+        *cat_path = '\0';
+        goto out;
+    }
+    close(res);
+
+    /* First build: A, B, and C with a span that is rewritten below. */
+    for (ii = 0; ii < CATALOG_FILES; ++ii)
+    {
+        if (!check(!write_catalog_file(spec[ii].marker, spec[ii].first_min,
+            (ii == 2) ? 35 : spec[ii].last_min, &sig, path[ii]),
+            "catalog: write file %d", ii))
+        {
+            goto out;
+        }
+        names[ii] = path[ii];
+    }
+    res = srnx_catalog_build(cat_path, NULL, 3, names, 1, &n_failed_files);
+    if (!check(!res && !n_failed_files, "catalog: build: %s, %d failed",
+        srnx_strerror(res), n_failed_files))
+    {
+        goto out;
+    }
+
+    /* Rewrite C with a different modification time, then rebuild from
+     * the old catalog with C, D, E and a missing file.
+     */
+    times[0].tv_sec = times[1].tv_sec = 1000000000;
+    times[0].tv_nsec = times[1].tv_nsec = 0;
+    if (!check(!write_catalog_file(spec[2].marker, spec[2].first_min,
+            spec[2].last_min, &sig, path[2])
+        && !utimensat(AT_FDCWD, path[2], times, 0), "catalog: rewrite C"))
+    {
+        goto out;
+    }
+    names[1] = "/nonexistent/srnx_test.srnx";
+    res = srnx_catalog_build(cat_path, cat_path, 4, names + 1, 2,
+        &n_failed_files);
+    names[1] = path[1];
+    if (!check(!res && n_failed_files == 1, "catalog: rebuild: %s, %d failed",
+        srnx_strerror(res), n_failed_files))
+    {
+        goto out;
+    }
+
+    res = srnx_catalog_open(&cat, cat_path);
+    if (!check(!res, "catalog: open: %s", srnx_strerror(res)))
+    {
+        goto out;
+    }
+    if (!check(srnx_catalog_size(cat) == CATALOG_FILES, "catalog: size %zu",
+        srnx_catalog_size(cat)))
+    {
+        goto out;
+    }
+
+    /* Entries are sorted by marker, then first epoch. */
+    for (ii = 0; ii < CATALOG_FILES; ++ii)
+    {
+        entry = srnx_catalog_entry(cat, ii);
+        check(!strcmp(srnx_catalog_path(cat, entry), path[ii])
+            && !strcmp(entry->marker, spec[ii].marker)
+            && entry->first_hh_mm == spec[ii].first_min
+            && entry->last_hh_mm == spec[ii].last_min
+            && entry->n_epochs == (uint64_t)(spec[ii].last_min
+                - spec[ii].first_min + 1)
+            && entry->interval_e7 == 600000000 && entry->n_signals == 1
+            && entry->n_satellites == 1, "catalog: entry %d", ii);
+    }
+
+    for (ii = 0; ii < (int)(sizeof query / sizeof query[0]); ++ii)
+    {
+        mask = catalog_matches(cat, query[ii].start_min, query[ii].end_min,
+            path);
+        check(mask == query[ii].mask, "catalog: query %d: %#x, not %#x",
+            ii, mask, query[ii].mask);
+    }
+
+out:
+    srnx_catalog_close(cat);
+    for (ii = 0; ii < CATALOG_FILES; ++ii)
+    {
+        if (*path[ii])
+        {
+            unlink(path[ii]);
+        }
+    }
+    if (*cat_path)
+    {
+        unlink(cat_path);
+    }
+    tb_free(&sig.packed);
+}
+
+/** Checks the time column of an exported Arrow batch.
+ *
+ * \param[in] schema Batch schema.
+ * \param[in] array Batch.
+ * \param[in] row Row to check.
+ * \param[in] expect Expected time of \a row.
+ * \param[in] what Name of the batch's source.
+ */
+static void check_arrow_time(
+    const struct ArrowSchema *schema,
+    const struct ArrowArray *array,
+    int64_t row,
+    int64_t expect,
+    const char *what
+)
+{
+    static const char *const kv[] = {
+        "epoch", "1980-01-06T00:00:00",
+        "unit", "ns",
+        "time_system", "GPS"
+    };
+    const struct ArrowSchema *field = schema->children[0];
+    const int64_t *times;
+    const char *rptr;
+    int32_t i32;
+    int ii;
+
+    check(!strcmp(field->format, "l") && !strcmp(field->name, "time"),
+        "%s: time column is \"%s\" of format \"%s\"", what, field->name,
+        field->format);
+    check(array->children[0]->length > row, "%s: %lld rows", what,
+        (long long)array->children[0]->length);
+    if (array->children[0]->length > row)
+    {
+        times = array->children[0]->buffers[1];
+        check(times[row] == expect, "%s: row %lld time %lld", what,
+            (long long)row, (long long)times[row]);
+    }
+
+    if (!check(field->metadata != NULL, "%s: no time metadata", what))
+    {
+        return;
+    }
+    rptr = field->metadata;
+    memcpy(&i32, rptr, sizeof i32);
+    rptr += sizeof i32;
+    check(i32 == 3, "%s: %d metadata pairs", what, i32);
+    for (ii = 0; ii < 6 && ii < 2 * i32; ++ii)
+    {
+        memcpy(&i32, rptr, sizeof i32);
+        check(i32 == (int32_t)strlen(kv[ii])
+            && !memcmp(rptr + sizeof i32, kv[ii], i32),
+            "%s: metadata item %d is \"%.*s\"", what, ii, i32,
+            rptr + sizeof i32);
+        rptr += sizeof i32 + i32;
+    }
+}
+
+/** A RINEX 2.11 observation file with two epochs. */
+static const char test_rinex[] =
+    "     2.11           OBSERVATION DATA    G (GPS)             RINEX VERSION / TYPE\n"
+    "     2    L1    L2                                          # / TYPES OF OBSERV\n"
+    "  2021     1     2     0     0    0.0000000     GPS         TIME OF FIRST OBS\n"
+    "                                                            END OF HEADER\n"
+    " 21  1  2  0  0  0.0000000  0  1G01\n"
+    "  12345678.123 1  23456789.456 2\n"
+    " 21  1  2  1  0  4.0000000  0  1G01\n"
+    "  12345679.123 1  23456790.456 2\n";
+
+/** Tests that Arrow exports label their epoch times correctly. */
+static void test_arrow(void)
+{
+    struct srnx_satellite_name g01 = { "G01" };
+    struct rinex_arrow_builder *builder = NULL;
+    struct rinex_parser *p = NULL;
+    struct rinex_stream *stream;
+    struct srnx_reader *srnx = NULL;
+    struct ArrowSchema schema;
+    struct ArrowArray array;
+    struct test_signal sig;
+    struct tbuf epoc = { NULL, 0, 0 }, text = { NULL, 0, 0 };
+    const char *err;
+    char path[32];
+    int idx = 0, res;
+
+    /* Export 2021-01-02 00:00:00 and 00:00:30 from an SRNX file. */
+    tb_uleb(&epoc, 2);
+    tb_sleb(&epoc, -30);
+    tb_uleb(&epoc, 2);
+    tb_uleb(&epoc, 20210102);
+    tb_uleb(&epoc, 0);
+    build_run_signal(&sig, "L1", 2, 7);
+    if (check(!write_test_file(1, &epoc, &sig, 1, path), "arrow: write"))
+    {
+        res = srnx_open(&srnx, path);
+        unlink(path);
+        if (!res)
+        {
+            res = srnx_export_arrow(srnx, g01, 1, &idx, 0, &schema, &array);
+        }
+        if (check(!res, "arrow: SRNX export: %s", srnx_strerror(res)))
+        {
+            check_arrow_time(&schema, &array, 1,
+                EPOCH_20210102 + INT64_C(30000000000), "arrow: SRNX");
+            schema.release(&schema);
+            array.release(&array);
+        }
+    }
+
+    /* Export 2021-01-02 01:00:04 from a parsed RINEX file. */
+    *path = '\0';
+    tb_bytes(&text, test_rinex, sizeof test_rinex - 1);
+    if (!check(!write_file(&text, text.len, path), "arrow: write RINEX"))
+    {
+        goto out;
+    }
+    stream = rinex_mmap_stream(path);
+    err = stream ? rinex_open(&p, stream) : "cannot map file";
+    if (!check(!err, "arrow: rinex_open: %s", err)
+        || !check(!rinex_arrow_builder_create(&builder, p, 0),
+            "arrow: builder"))
+    {
+        goto out;
+    }
+    while ((res = p->read(p)) > 0)
+    {
+        check(!rinex_arrow_builder_append(builder, p), "arrow: append");
+    }
+    check(res == 0, "arrow: RINEX read: %d", res);
+    res = rinex_arrow_builder_finish(builder, &schema, &array);
+    if (check(!res, "arrow: builder export: %d", res))
+    {
+        check_arrow_time(&schema, &array, 1,
+            EPOCH_20210102 + INT64_C(3604000000000), "arrow: RINEX");
+        schema.release(&schema);
+        array.release(&array);
+    }
+
+out:
+    if (*path)
+    {
+        unlink(path);
+    }
+    rinex_arrow_builder_destroy(builder);
+    if (p)
+    {
+        p->destroy(p);
+    }
+    srnx_close(srnx);
+    tb_free(&sig.packed);
+    tb_free(&epoc);
+    tb_free(&text);
+}
+
+/** Tests that rnx_index_header() trims blank lines only back to their
+ * own start, and still indexes the labels around them.
+ */
+static void test_header_index(void)
+{
+    static const char text[] =
+        "                                                                      \n"
+        "    30.000                                                  INTERVAL            \r\n"
+        "                                                             \r\n"
+        "                                                            END OF HEADER\n";
+    static const char expect[] =
+        "\n"
+        "    30.000                                                  INTERVAL\n"
+        "\n"
+        "                                                            END OF HEADER\n";
+    struct rnx_header_index index;
+    char in[sizeof text + 32], buf[sizeof text + 1], *out = buf + 1;
+    int len, ofs;
+
+    /* A space before the output would let an unbounded trim continue
+     * past the start of the first line.
+     */
+    memset(&index, 0, sizeof index);
+    memset(in, 0, sizeof in);
+    memcpy(in, text, sizeof text - 1);
+    buf[0] = ' ';
+    len = rnx_index_header(&index, out, in, sizeof text - 1);
+    if (!check(len == sizeof expect - 1, "header_index: length %d", len))
+    {
+        free(index.line_ofs);
+        return;
+    }
+    check(!memcmp(out, expect, len), "header_index: wrong text");
+    check(index.n_lines == 4, "header_index: %d lines", index.n_lines);
+
+    ofs = rnx_lookup_header(&index, out, "INTERVAL", sizeof "INTERVAL");
+    check(ofs == 1, "header_index: INTERVAL at %d", ofs);
+    ofs = rnx_lookup_header(&index, out, "END OF HEADER",
+        sizeof "END OF HEADER");
+    check(ofs == 71, "header_index: END OF HEADER at %d", ofs);
+    free(index.line_ofs);
+}
+
+/** Tests that rinex_find_sat() treats a blank RINEX 2 system as GPS. */
+static void test_find_sat(void)
+{
+    static const char text[] =
+        "     2.11           OBSERVATION DATA    G (GPS)             RINEX VERSION / TYPE\n"
+        "     2    L1    L2                                          # / TYPES OF OBSERV\n"
+        "                                                            END OF HEADER\n"
+        " 21  1  2  0  0  0.0000000  0  2 01G02\n"
+        "  12345678.123 1  23456789.456 2\n"
+        "  22345678.123 1  33456789.456 2\n";
+    struct rinex_parser *p = NULL;
+    struct rinex_stream *stream;
+    const struct rinex_sat_entry *sat;
+    struct tbuf tb = { NULL, 0, 0 };
+    const char *err;
+    char path[32];
+    int pass;
+
+    *path = '\0';
+    tb_bytes(&tb, text, sizeof text - 1);
+    if (!check(!write_file(&tb, tb.len, path), "find_sat: write"))
+    {
+        goto out;
+    }
+    stream = rinex_mmap_stream(path);
+    err = stream ? rinex_open(&p, stream) : "cannot map file";
+    if (!check(!err, "find_sat: rinex_open: %s", err)
+        || !check(p->read(p) > 0, "find_sat: read failed"))
+    {
+        goto out;
+    }
+
+    /* Check both the directory scan and the slot table. */
+    for (pass = 0; pass < 2; ++pass)
+    {
+        if (pass)
+        {
+            check(!rinex_enable_sat_lookup(p), "find_sat: enable lookup");
+        }
+        sat = rinex_find_sat(p, 'G', 1);
+        check(sat == p->sats, "find_sat %d: G01 is %p", pass, (void *)sat);
+        sat = rinex_find_sat(p, ' ', 1);
+        check(sat == p->sats, "find_sat %d: \" 01\" is %p", pass,
+            (void *)sat);
+        sat = rinex_find_sat(p, ' ', 2);
+        check(sat == p->sats + 1, "find_sat %d: \" 02\" is %p", pass,
+            (void *)sat);
+        sat = rinex_find_sat(p, 'R', 1);
+        check(sat == NULL, "find_sat %d: R01 is %p", pass, (void *)sat);
+    }
+
+out:
+    if (*path)
+    {
+        unlink(path);
+    }
+    if (p)
+    {
+        p->destroy(p);
+    }
+    tb_free(&tb);
+}
+
+/** Tests srnx_padding_chunk() against the PADD chunk layout. */
+static void test_padding(void)
+{
+    static const struct
+    {
+        uint64_t offset;
+        int align_log2;
+        int chunk_digest;
+        uint64_t expect;
+    } cases[] = {
+        { 4096, 12, 0, 0 },
+        { 4000, 12, 0, 96 },
+        { 4093, 12, 0, 4099 },
+        { 8192 - 133, 13, 0, 133 },
+        { 1000, 10, 2, 24 },
+        { 1016, 10, 2, 8 + 1024 },
+        { 1000, 10, 6, 24 + 1024 },
+        { ((uint64_t)3 << 30) + 1, 30, 0, ((uint64_t)1 << 30) - 1 },
+    };
+    char out[16];
+    uint64_t len, payload_len;
+    int ii, jj, head_len, digest_len;
+
+    for (ii = 0; ii < (int)(sizeof cases / sizeof cases[0]); ++ii)
+    {
+        head_len = -1;
+        len = srnx_padding_chunk(out, cases[ii].offset, cases[ii].align_log2,
+            cases[ii].chunk_digest, &head_len);
+        if (!check(len == cases[ii].expect, "padding %d: length %llu",
+            ii, (unsigned long long)len) || !len)
+        {
+            check(head_len == 0, "padding %d: header length %d", ii,
+                head_len);
+            continue;
+        }
+
+        /* The header and payload length must describe the whole gap. */
+        digest_len = cases[ii].chunk_digest
+            ? 1 << (cases[ii].chunk_digest & 7) : 0;
+        for (jj = 4, payload_len = 0; jj < head_len; ++jj)
+        {
+            payload_len |= (uint64_t)(out[jj] & 127) << (7 * (jj - 4));
+            if (!(out[jj] & 128) != (jj + 1 == head_len))
+            {
+                break;
+            }
+        }
+        check(!memcmp(out, "PADD", 4) && jj == head_len
+            && head_len + payload_len + digest_len == len,
+            "padding %d: header length %d, payload %llu", ii, head_len,
+            (unsigned long long)payload_len);
+    }
+}
+
+/** Tests splitting the pread backend's loaded-block bitmap for direct
+ * I/O.
+ */
+static void test_split_loaded(void)
+{
+    const uint64_t file_size = 5 * 65536 + 100;
+    const uint8_t loaded[1] = { 1 | 4 | 32 };
+    uint8_t *split;
+    int blk, set;
+
+    split = srnx_split_loaded(loaded, file_size, 16, 12);
+    if (!check(split != NULL, "split: no bitmap"))
+    {
+        return;
+    }
+
+    /* Old blocks 0, 2 and 5 are loaded; block 5 is the file's short
+     * last block, which splits into one 4 KiB block.
+     */
+    for (blk = 0; blk <= (int)(file_size >> 12); ++blk)
+    {
+        set = (split[blk >> 3] >> (blk & 7)) & 1;
+        check(set == ((blk >> 4) == 0 || (blk >> 4) == 2
+            || (blk >> 4) == 5), "split: block %d is %d", blk, set);
+    }
+    free(split);
+}
+
+/** Number of threads that test_pread() reads with at once. */
+#define PREAD_THREADS 4
+
+/** pread_ctx is one thread's share of test_pread(). */
+struct pread_ctx
+{
+    /** Reader shared by all the threads. */
+    struct srnx_reader *srnx;
+
+    /** Index of the first bad observation, or -1 if all were good. */
+    int failed;
+};
+
+/** Reads every G01 observation from \a arg's reader and checks it. */
+static void *pread_thread(void *arg)
+{
+    struct srnx_satellite_name g01 = { "G01" };
+    struct pread_ctx *ctx = arg;
+    struct srnx_obs_reader *p_socd = NULL;
+    int64_t value;
+    int ii, res;
+
+    res = srnx_open_obs_by_index(ctx->srnx, g01, 0, &p_socd);
+    for (ii = 0; ii < PREAD_COUNT; ++ii)
+    {
+        value = -1;
+        res = res ? res : srnx_read_obs_value(p_socd, &value);
+        if (res || value != ii % 50)
+        {
+            ctx->failed = ii;
+            break;
+        }
+    }
+    srnx_free_obs_reader(p_socd);
+    return NULL;
+}
+
+/** Tests that the pread backend retries blocks that failed to load. */
+static void test_pread(void)
+{
+    struct srnx_satellite_name g01 = { "G01" };
+    struct srnx_reader *srnx = NULL;
+    struct srnx_obs_reader *p_socd = NULL;
+    struct test_signal sig;
+    struct tbuf file = { NULL, 0, 0 };
+    struct pread_ctx ctx[PREAD_THREADS];
+    pthread_t thread[PREAD_THREADS];
+    int started[PREAD_THREADS];
+    int64_t value;
+    char path[32];
+    int ii, res;
+
+    build_run_signal(&sig, "L1", PREAD_COUNT, 50);
+    build_test_file(&file, NULL, 1, NULL, &sig, 1);
+
+    /* Open the file, then cut it short so reading the signal fails. */
+    *path = '\0';
+    if (!check(!write_file(&file, file.len, path), "pread: write"))
+    {
+        goto out;
+    }
+    res = srnx_open_pread(&srnx, path);
+    if (!check(!res, "pread: open: %s", srnx_strerror(res))
+        || !check(!write_file(&file, file.len / 2, path), "pread: cut"))
+    {
+        goto out;
+    }
+    res = srnx_open_obs_by_index(srnx, g01, 0, &p_socd);
+    for (ii = 0; !res && ii < PREAD_COUNT; ++ii)
+    {
+        res = srnx_read_obs_value(p_socd, &value);
+    }
+    check(res == SRNX_IO_ERROR, "pread: short file: %s",
+        srnx_strerror(res));
+
+    /* Once the file is whole again, the same reads must succeed. */
+    if (!check(!write_file(&file, file.len, path), "pread: restore"))
+    {
+        goto out;
+    }
+    res = srnx_open_obs_by_index(srnx, g01, 0, &p_socd);
+    check(!res, "pread: reopen obs: %s", srnx_strerror(res));
+    for (ii = 0; !res && ii < PREAD_COUNT; ++ii)
+    {
+        value = -1;
+        res = srnx_read_obs_value(p_socd, &value);
+        if (!check(!res && value == ii % 50, "pread: obs %d: %s, %lld",
+            ii, srnx_strerror(res), (long long)value))
+        {
+            break;
+        }
+    }
+
+    /* Threads sharing a fresh reader must each see every value, even
+     * though they race to read the same blocks.
+     */
+    srnx_close(srnx);
+    srnx = NULL;
+    res = srnx_open_pread(&srnx, path);
+    if (!check(!res, "pread: open again: %s", srnx_strerror(res)))
+    {
+        goto out;
+    }
+    for (ii = 0; ii < PREAD_THREADS; ++ii)
+    {
+        ctx[ii].srnx = srnx;
+        ctx[ii].failed = -1;
+        started[ii] = !pthread_create(&thread[ii], NULL, pread_thread,
+            &ctx[ii]);
+        check(started[ii], "pread: start thread %d", ii);
+    }
+    for (ii = 0; ii < PREAD_THREADS; ++ii)
+    {
+        if (started[ii])
+        {
+            pthread_join(thread[ii], NULL);
+            check(ctx[ii].failed < 0, "pread: thread %d failed at obs %d",
+                ii, ctx[ii].failed);
+        }
+    }
+
+out:
+    if (*path)
+    {
+        unlink(path);
+    }
+    srnx_free_obs_reader(p_socd);
+    srnx_close(srnx);
+    tb_free(&sig.packed);
+    tb_free(&file);
+}
+
+/** Makes a distinct cache key for test entry \a ii. */
+static void cache_test_key(struct srnx_cache_key *key, int ii)
+{
+    memset(key, 0, sizeof *key);
+    key->file.ino = 1000 + ii;
+    memcpy(key->name.name, "G01", 3);
+    memcpy(key->code.name, "L1", 2);
+}
+
+/** Tests that the decoded-observation cache evicts the entry with the
+ * lowest priority in the whole cache, and that a hit refreshes it.
+ */
+static void test_cache(void)
+{
+    struct srnx_cache_key key;
+    struct srnx_cache_stats stats;
+    int64_t obs[100], *out = NULL;
+    char inds[100];
+    size_t bytes;
+    int rank[18], ii, n;
+
+    memset(obs, 0, sizeof obs);
+    memset(inds, ' ', sizeof inds);
+
+    /* How much does one entry cost? */
+    srnx_cache_set_budget(1 << 30);
+    srnx_cache_clear();
+    cache_test_key(&key, 99);
+    srnx_cache_put(&key, 100, obs, inds, inds, 1000);
+    srnx_cache_get_stats(&stats);
+    bytes = stats.bytes_used;
+    srnx_cache_clear();
+
+    /* Fill the cache with sixteen entries of scrambled decode costs,
+     * so the cheapest ones land in different stripes.
+     */
+    srnx_cache_set_budget(16 * bytes);
+    for (ii = 0; ii < 16; ++ii)
+    {
+        rank[ii] = ii * 7 % 16;
+        cache_test_key(&key, ii);
+        srnx_cache_put(&key, 100, obs, inds, inds,
+            1000000 + 100000 * rank[ii]);
+    }
+    rank[16] = rank[17] = 100;
+    srnx_cache_get_stats(&stats);
+    check(stats.n_entries == 16, "cache: %zu entries after filling",
+        stats.n_entries);
+
+    /* An expensive entry evicts the cheapest one and advances the
+     * cache's clock.  Touching the second cheapest then lifts it above
+     * the rest, so the next expensive entry evicts the third cheapest.
+     */
+    cache_test_key(&key, 16);
+    srnx_cache_put(&key, 100, obs, inds, inds, 100000000);
+    for (ii = 0; rank[ii] != 1; ++ii)
+    {
+    }
+    cache_test_key(&key, ii);
+    check(srnx_cache_get(&key, &n, &out, NULL, NULL) && n == 100,
+        "cache: refresh");
+    cache_test_key(&key, 17);
+    srnx_cache_put(&key, 100, obs, inds, inds, 100000000);
+    for (ii = 0; ii < 18; ++ii)
+    {
+        cache_test_key(&key, ii);
+        n = srnx_cache_get(&key, &n, &out, NULL, NULL);
+        check(n == (rank[ii] != 0 && rank[ii] != 2),
+            "cache: entry with rank %d %s", rank[ii],
+            n ? "kept" : "evicted");
+    }
+
+    srnx_free(out);
+    srnx_cache_set_budget(0);
+}
+
+/** Tests that srnx_get_obs_by_index() serves cached signals without
+ * touching the file, even when it would prefetch several signals.
+ */
+static void test_cache_prefetch(void)
+{
+    struct srnx_satellite_name g01 = { "G01" };
+    struct srnx_reader *srnx = NULL, *srnx2 = NULL;
+    struct srnx_cache_stats stats;
+    struct test_signal sigs[2];
+    struct tbuf file = { NULL, 0, 0 };
+    int64_t *obs[2] = { NULL, NULL };
+    uint64_t hits;
+    char path[32];
+    int idx[2] = { 0, 1 }, n_values[2], ii, jj, res;
+
+    build_run_signal(sigs + 0, "L1", PREAD_COUNT, 50);
+    build_run_signal(sigs + 1, "L2", PREAD_COUNT, 60);
+    build_test_file(&file, NULL, 1, NULL, sigs, 2);
+    *path = '\0';
+    srnx_cache_set_budget(1 << 26);
+    if (!check(!write_file(&file, file.len, path), "prefetch: write"))
+    {
+        goto out;
+    }
+
+    /* Fill the cache from one reader, then open another reader and
+     * cut the file short, so any read from the file fails.
+     */
+    res = srnx_open(&srnx, path);
+    if (!res)
+    {
+        res = srnx_get_obs_by_index(srnx, g01, 2, idx, n_values, obs,
+            NULL, NULL);
+    }
+    if (!check(!res, "prefetch: first read: %s", srnx_strerror(res)))
+    {
+        goto out;
+    }
+    res = srnx_open_pread(&srnx2, path);
+    if (!check(!res, "prefetch: open: %s", srnx_strerror(res))
+        || !check(!write_file(&file, file.len / 8, path), "prefetch: cut"))
+    {
+        goto out;
+    }
+
+    srnx_cache_get_stats(&stats);
+    hits = stats.hits;
+    memset(n_values, 0, sizeof n_values);
+    res = srnx_get_obs_by_index(srnx2, g01, 2, idx, n_values, obs,
+        NULL, NULL);
+    srnx_cache_get_stats(&stats);
+    if (check(!res && stats.hits == hits + 2, "prefetch: cached read: %s,"
+        " %llu hits", srnx_strerror(res),
+        (unsigned long long)(stats.hits - hits)))
+    {
+        for (ii = 0; ii < 2; ++ii)
+        {
+            for (jj = 0; jj < PREAD_COUNT; ++jj)
+            {
+                if (!check(n_values[ii] == PREAD_COUNT
+                    && obs[ii][jj] == jj % (50 + 10 * ii),
+                    "prefetch: signal %d obs %d", ii, jj))
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+out:
+    if (*path)
+    {
+        unlink(path);
+    }
+    srnx_cache_set_budget(0);
+    srnx_free(obs[0]);
+    srnx_free(obs[1]);
+    srnx_close(srnx2);
+    srnx_close(srnx);
+    for (ii = 0; ii < 2; ++ii)
+    {
+        tb_free(&sigs[ii].packed);
+    }
+    tb_free(&file);
+}
+
+/** Restores the NUMA topology that the environment asks for. */
+static void numa_restore(void)
+{
+    if (srnx_numa_select(getenv("SRNX_NUMA")))
+    {
+        srnx_numa_select(NULL);
+    }
+}
+
+/** Tests parsing of NUMA topology lists. */
+static void test_numa_select(void)
+{
+    static const char *const bad[] = {
+        "", ";", "0;", ";0", "0-", "-1", "3-1", "0x", "0,,1", "1024",
+        "0-1023,0", "auto;0"
+    };
+    char many[4 * (SRNX_NUMA_MAX_NODES + 1)];
+    int ii, len;
+
+    check(!srnx_numa_select("0-1;4,6-7"), "numa: list rejected");
+    check(srnx_numa_node_count() == 2, "numa: %d nodes in list",
+        srnx_numa_node_count());
+    for (ii = 0; ii < (int)(sizeof bad / sizeof bad[0]); ++ii)
+    {
+        check(srnx_numa_select(bad[ii]) == EINVAL, "numa: accepted '%s'",
+            bad[ii]);
+    }
+    check(srnx_numa_node_count() == 2, "numa: %d nodes after bad lists",
+        srnx_numa_node_count());
+
+    /* One node per CPU, up to and then past the node limit. */
+    for (ii = len = 0; ii < SRNX_NUMA_MAX_NODES; ++ii)
+    {
+        len += sprintf(many + len, "%s%d", ii ? ";" : "", ii);
+    }
+    check(!srnx_numa_select(many), "numa: %d nodes rejected",
+        SRNX_NUMA_MAX_NODES);
+    check(srnx_numa_node_count() == SRNX_NUMA_MAX_NODES,
+        "numa: %d nodes in full list", srnx_numa_node_count());
+    sprintf(many + len, ";%d", ii);
+    check(srnx_numa_select(many) == EINVAL, "numa: %d nodes accepted",
+        SRNX_NUMA_MAX_NODES + 1);
+
+    check(!srnx_numa_select("off") && srnx_numa_node_count() == 1,
+        "numa: off has %d nodes", srnx_numa_node_count());
+    numa_restore();
+}
+
+/** Tests the order in which a NUMA work queue hands out items. */
+static void test_numa_queue(void)
+{
+    static const int node[] = { 1, 0, -1, 1, 0, 7 };
+    static const struct
+    {
+        const char *what;
+        int node[8];
+        int expect[8];
+    } orders[] = {
+        /* A worker takes its own node's items, then unknown ones
+         * (including those on nodes past the topology), then others.
+         */
+        { "node 0", { 0, 0, 0, 0, 0, 0, 0 }, { 1, 4, 2, 5, 0, 3, -1 } },
+        { "node 1", { 1, 1, 1, 1, 1, 1, 1 }, { 0, 3, 2, 5, 1, 4, -1 } },
+        { "bad node", { -1, 9, -1, 9, -1, 9, -1 }, { 1, 4, 2, 5, 0, 3, -1 } },
+        { "both", { 0, 1, 0, 1, 0, 1, 0 }, { 1, 0, 4, 3, 2, 5, -1 } },
+    };
+    struct srnx_numa_queue *queue = NULL;
+    int ii, jj, idx;
+
+    if (!check(!srnx_numa_select("0;1"), "queue: list rejected"))
+    {
+        return;
+    }
+    for (ii = 0; ii < (int)(sizeof orders / sizeof orders[0]); ++ii)
+    {
+        if (!check(!srnx_numa_queue_create(&queue, 6, node),
+            "queue: cannot create"))
+        {
+            break;
+        }
+        for (jj = 0; jj < 7; ++jj)
+        {
+            idx = srnx_numa_queue_next(queue, orders[ii].node[jj]);
+            check(idx == orders[ii].expect[jj], "queue %s: item %d is %d",
+                orders[ii].what, jj, idx);
+        }
+        srnx_numa_queue_free(queue);
+    }
+
+    /* Without node information, items come out in order. */
+    if (check(!srnx_numa_queue_create(&queue, 3, NULL),
+        "queue: cannot create"))
+    {
+        for (jj = 0; jj < 4; ++jj)
+        {
+            idx = srnx_numa_queue_next(queue, 1);
+            check(idx == (jj < 3 ? jj : -1), "queue: item %d is %d", jj,
+                idx);
+        }
+        srnx_numa_queue_free(queue);
+    }
+    numa_restore();
+}
+
+#if defined(__linux__)
+/** Number of words in the CPU masks of test_numa_bind(). */
+#define TEST_MASK_WORDS (SRNX_NUMA_MAX_CPUS / (8 * sizeof(unsigned long)))
+
+/** Binds a worker, as for test_numa_bind(), in a thread of its own. */
+static void *numa_bind_thread(void *arg)
+{
+    unsigned long before[TEST_MASK_WORDS], after[TEST_MASK_WORDS];
+    const int bits = 8 * sizeof(unsigned long);
+    char spec[32];
+    int ii, allowed, other;
+
+    /* Use a topology whose second node has no CPU that we may use. */
+    memset(before, 0, sizeof before);
+    if (syscall(SYS_sched_getaffinity, 0, sizeof before, before) < 0)
+    {
+        return NULL;
+    }
+    for (ii = 0, allowed = other = -1; ii < SRNX_NUMA_MAX_CPUS; ++ii)
+    {
+        if ((before[ii / bits] >> (ii % bits)) & 1)
+        {
+            allowed = (allowed < 0) ? ii : allowed;
+        }
+        else if (other < 0)
+        {
+            other = ii;
+        }
+    }
+    if (allowed < 0 || other < 0)
+    {
+        return NULL;
+    }
+    snprintf(spec, sizeof spec, "%d;%d", other, allowed);
+    if (!check(!srnx_numa_select(spec), "bind: '%s' rejected", spec))
+    {
+        return NULL;
+    }
+
+    /* Every worker belongs on node 1, and is pinned to the CPU there. */
+    for (ii = 0; ii < 3; ++ii)
+    {
+        check(srnx_numa_bind_worker(ii) == 1, "bind: worker %d on node %d",
+            ii, srnx_numa_bind_worker(ii));
+    }
+    memset(after, 0, sizeof after);
+    memset(before, 0, sizeof before);
+    before[allowed / bits] = 1ul << (allowed % bits);
+    check(syscall(SYS_sched_getaffinity, 0, sizeof after, after) >= 0
+        && !memcmp(before, after, sizeof after), "bind: not pinned to %d",
+        allowed);
+
+    *(int *)arg = 1;
+    return NULL;
+}
+#endif
+
+/** Tests that workers are only bound to CPUs they may run on. */
+static void test_numa_bind(void)
+{
+#if defined(__linux__)
+    pthread_t thread;
+    int ran = 0;
+
+    if (check(!pthread_create(&thread, NULL, numa_bind_thread, &ran),
+        "bind: cannot start thread"))
+    {
+        pthread_join(thread, NULL);
+        check(ran, "bind: no usable CPU mask");
+    }
+#endif
+
+    /* One node means no placement at all. */
+    srnx_numa_select("off");
+    check(srnx_numa_bind_worker(3) == 0, "bind: off gives a node");
+    numa_restore();
+}
+
+/** Number of epochs in the slip tests' synthetic pass. */
+#define SLIP_EPOCHS 103
+
+/** Fills the columns for the slip tests: a satellite receding at a
+ * steady rate, with no ionosphere, seen at epochs \a epoch.  L1 gains
+ * \a slip_cycles from input index \a slip_idx onwards.
+ */
+static void slip_columns(
+    const struct srnx_slip_params *params,
+    const uint64_t epoch[],
+    int slip_idx,
+    int slip_cycles,
+    int64_t obs[4][SLIP_EPOCHS]
+)
+{
+    double rho;
+    int ii;
+
+    for (ii = 0; ii < SLIP_EPOCHS; ++ii)
+    {
+        rho = 2.2e7 + 531.25 * epoch[ii];
+        obs[0][ii] = llround(rho / params->lambda1 * 1000.0)
+            + ((ii >= slip_idx) ? slip_cycles * 1000 : 0);
+        obs[1][ii] = llround(rho / params->lambda2 * 1000.0);
+        obs[2][ii] = llround(rho * 1000.0);
+        obs[3][ii] = llround(rho * 1000.0);
+    }
+}
+
+/** Tests srnx_slip_combine() against the combinations' definitions. */
+static void test_slip_combine(void)
+{
+    struct srnx_slip_params params;
+    int64_t obs[4][SLIP_EPOCHS];
+    const int64_t *cols[4] = { obs[0], obs[1], obs[2], obs[3] };
+    uint64_t epoch[SLIP_EPOCHS];
+    uint32_t idx[SLIP_EPOCHS];
+    double gf[SLIP_EPOCHS], mw[SLIP_EPOCHS], pc[SLIP_EPOCHS];
+    double f1, f2, l1, l2, p1, p2, expect;
+    size_t n_out, jj;
+    int ii;
+
+    if (!check(!srnx_slip_params_init(&params, ' '), "combine: no GPS"))
+    {
+        return;
+    }
+    for (ii = 0; ii < SLIP_EPOCHS; ++ii)
+    {
+        epoch[ii] = ii;
+    }
+    slip_columns(&params, epoch, SLIP_EPOCHS, 0, obs);
+
+    /* Blank one column at some epochs, so that the samples in each
+     * group of four epochs take every pattern in turn, and then at
+     * scattered epochs.
+     */
+    for (ii = 0; ii < SLIP_EPOCHS; ++ii)
+    {
+        if ((ii < 64) ? !((ii / 4) >> (ii % 4) & 1) : (ii % 7 == 3))
+        {
+            obs[ii % 4][ii] = 0;
+        }
+    }
+
+    n_out = srnx_slip_combine(&params, SLIP_EPOCHS, cols, idx, gf, mw, pc);
+    f1 = 299792458.0 / params.lambda1;
+    f2 = 299792458.0 / params.lambda2;
+    for (ii = jj = 0; ii < SLIP_EPOCHS; ++ii)
+    {
+        if (!obs[0][ii] || !obs[1][ii] || !obs[2][ii] || !obs[3][ii])
+        {
+            continue;
+        }
+        if (!check(jj < n_out && idx[jj] == (uint32_t)ii,
+            "combine: sample %d is not epoch %d", (int)jj, ii))
+        {
+            return;
+        }
+        l1 = obs[0][ii] * 0.001;
+        l2 = obs[1][ii] * 0.001;
+        p1 = obs[2][ii] * 0.001;
+        p2 = obs[3][ii] * 0.001;
+        expect = l1 * params.lambda1 - l2 * params.lambda2;
+        check(fabs(gf[jj] - expect) < 1e-6, "combine: GF %d is %f, not %f",
+            ii, gf[jj], expect);
+        expect = (l1 - l2) - (f1 * p1 + f2 * p2) / (f1 + f2)
+            * (f1 - f2) / 299792458.0;
+        check(fabs(mw[jj] - expect) < 1e-6, "combine: MW %d is %f, not %f",
+            ii, mw[jj], expect);
+        expect = l1 * params.lambda1 - p1;
+        check(fabs(pc[jj] - expect) < 1e-6, "combine: PC %d is %f, not %f",
+            ii, pc[jj], expect);
+        ++jj;
+    }
+    check(jj == n_out, "combine: %d samples, expected %d", (int)n_out,
+        (int)jj);
+}
+
+/** Tests that srnx_slip_detect() finds a slip, a gap and a loss of
+ * lock, and nothing else.
+ */
+static void test_slip_detect(void)
+{
+    static const struct srnx_slip expect[] = {
+        { 20, SRNX_SLIP_GF | SRNX_SLIP_MW },
+        { 40, SRNX_SLIP_GAP },
+        { 60, SRNX_SLIP_LLI },
+    };
+    struct srnx_slip_params params;
+    struct srnx_slip slip[SLIP_EPOCHS];
+    int64_t obs[4][SLIP_EPOCHS];
+    const int64_t *cols[4] = { obs[0], obs[1], obs[2], obs[3] };
+    uint64_t epoch[SLIP_EPOCHS];
+    uint32_t idx[SLIP_EPOCHS];
+    double gf[SLIP_EPOCHS], mw[SLIP_EPOCHS], pc[SLIP_EPOCHS];
+    char lli1[SLIP_EPOCHS], lli2[SLIP_EPOCHS];
+    size_t n_samples, n_slips, ii;
+
+    if (!check(!srnx_slip_params_init(&params, 'G'), "detect: no GPS"))
+    {
+        return;
+    }
+
+    /* Five cycles on L1 from index 20, four missing epochs before
+     * index 40, and loss of lock on L1 at index 60.  Only LLI bit 0
+     * counts, so the L2 indicator at index 70 does not.
+     */
+    for (ii = 0; ii < SLIP_EPOCHS; ++ii)
+    {
+        epoch[ii] = (ii < 40) ? ii : ii + 4;
+    }
+    slip_columns(&params, epoch, 20, 5, obs);
+    memset(lli1, ' ', sizeof lli1);
+    memset(lli2, ' ', sizeof lli2);
+    lli1[60] = '1';
+    lli2[70] = '2';
+
+    n_samples = srnx_slip_combine(&params, SLIP_EPOCHS, cols, idx, gf, mw,
+        pc);
+    check(n_samples == SLIP_EPOCHS, "detect: %d samples", (int)n_samples);
+    n_slips = srnx_slip_detect(&params, n_samples, idx, epoch, gf, mw, pc,
+        lli1, lli2, slip);
+    for (ii = 0; ii < n_slips || ii < sizeof expect / sizeof expect[0];
+        ++ii)
+    {
+        if (ii >= n_slips || ii >= sizeof expect / sizeof expect[0])
+        {
+            check(0, "detect: %d slips, expected %d", (int)n_slips,
+                (int)(sizeof expect / sizeof expect[0]));
+            break;
+        }
+        check(slip[ii].idx == expect[ii].idx
+            && slip[ii].reasons == expect[ii].reasons,
+            "detect: slip %d at %u for %#x", (int)ii, slip[ii].idx,
+            slip[ii].reasons);
+    }
+
+    /* Without the LLIs, only the slip and the gap remain. */
+    n_slips = srnx_slip_detect(&params, n_samples, idx, epoch, gf, mw, pc,
+        NULL, NULL, slip);
+    check(n_slips == 2, "detect: %d slips without LLIs", (int)n_slips);
+}
+
+/** A RINEX 2.11 file for the QC statistics.  The 00:01:30 epoch is
+ * missing, G01 loses lock on L1 at 00:01:00 and jumps 1000 cycles at
+ * 00:02:30, and G02 skips 00:01:00, has P2 rising 1 m per epoch, and
+ * has no S2 at 00:02:30.
+ */
+static const char test_qc_rinex[] =
+    "     2.11           OBSERVATION DATA    G (GPS)             RINEX VERSION / TYPE\n"
+    "     6    C1    P2    L1    L2    S1    S2                  # / TYPES OF OBSERV \n"
+    "    30.000                                                  INTERVAL            \n"
+    "                                                            END OF HEADER       \n"
+    " 21  1  2  0  0  0.0000000  0  2G01G02\n"
+    "  20000000.000    20000001.000   105100000.000    81900000.000          45.000\n"
+    "        38.000\n"
+    "  21000000.000    21000001.000   110000000.000    86000000.000          12.300\n"
+    "        70.000\n"
+    " 21  1  2  0  0 30.0000000  0  2G01G02\n"
+    "  20000000.000    20000001.000   105100000.000    81900000.000          45.000\n"
+    "        38.000\n"
+    "  21000000.000    21000002.000   110000000.000    86000000.000          12.300\n"
+    "        70.000\n"
+    " 21  1  2  0  1  0.0000000  0  1G01\n"
+    "  20000000.000    20000001.000   105100000.0001   81900000.000          45.000\n"
+    "        38.000\n"
+    " 21  1  2  0  2  0.0000000  0  2G01G02\n"
+    "  20000000.000    20000001.000   105100000.000    81900000.000          45.000\n"
+    "        38.000\n"
+    "  21000000.000    21000005.000   110000000.000    86000000.000          12.300\n"
+    "        70.000\n"
+    " 21  1  2  0  2 30.0000000  0  2G01G02\n"
+    "  20000000.000    20000001.000   105101000.000    81900000.000          45.000\n"
+    "        38.000\n"
+    "  21000000.000    21000006.000   110000000.000    86000000.000          12.300\n"
+    "\n";
+
+/** Tests the statistics that rinex_qc reports, including epochs that
+ * reuse the previous epoch's satellite layout.
+ */
+static void test_qc(void)
+{
+    static const char *const expect[] = {
+        "\"epochs\":5,",
+        "\"expected\":6,\"gaps\":1,",
+        "{\"sv\":\"G01\",\"epochs\":5,\"gaps\":1,\"mp1\":0.0000,"
+            "\"mp2\":0.0000,\"iod\":0.000,\"iod_slips\":1,"
+            "\"obs\":[5,5,5,5,5,5],\"lli\":[0,0,1,0,0,0],"
+            "\"snr\":{\"S1\":[0,0,0,0,0,0,0,0,0,5,0,0,0],"
+            "\"S2\":[0,0,0,0,0,0,0,5,0,0,0,0,0]}}",
+        "{\"sv\":\"G02\",\"epochs\":4,\"gaps\":1,\"mp1\":0.0000,"
+            "\"mp2\":0.7071,\"iod\":0.000,\"iod_slips\":0,"
+            "\"obs\":[4,4,4,4,4,3],\"lli\":[0,0,0,0,0,0],"
+            "\"snr\":{\"S1\":[0,0,4,0,0,0,0,0,0,0,0,0,0],"
+            "\"S2\":[0,0,0,0,0,0,0,0,0,0,0,0,3]}}",
+    };
+    struct rinex_parser *p = NULL;
+    struct rinex_stream *stream;
+    struct rinex_qc *qc = NULL;
+    struct tbuf text = { NULL, 0, 0 };
+    const char *err;
+    char path[32], *json = NULL;
+    size_t json_len, ii;
+    FILE *out;
+    int res;
+
+    *path = '\0';
+    tb_bytes(&text, test_qc_rinex, sizeof test_qc_rinex - 1);
+    if (!check(!write_file(&text, text.len, path), "qc: write RINEX"))
+    {
+        goto out;
+    }
+    stream = rinex_mmap_stream(path);
+    err = stream ? rinex_open(&p, stream) : "cannot map file";
+    if (!check(!err, "qc: rinex_open: %s", err)
+        || !check(!rinex_qc_create(&qc, p), "qc: create"))
+    {
+        goto out;
+    }
+    while ((res = p->read(p)) > 0)
+    {
+        check(!rinex_qc_add(qc, p), "qc: add");
+    }
+    check(res == 0, "qc: RINEX read: %d", res);
+
+    out = open_memstream(&json, &json_len);
+    if (!check(out != NULL, "qc: open_memstream"))
+    {
+        goto out;
+    }
+    res = rinex_qc_write_json(qc, NULL, out);
+    fclose(out);
+    check(!res, "qc: write JSON: %d", res);
+    for (ii = 0; ii < sizeof expect / sizeof expect[0]; ++ii)
+    {
+        check(strstr(json, expect[ii]) != NULL, "qc: missing %s in %s",
+            expect[ii], json);
+    }
+
+out:
+    if (*path)
+    {
+        unlink(path);
+    }
+    rinex_qc_destroy(qc);
+    if (p)
+    {
+        p->destroy(p);
+    }
+    free(json);
+    tb_free(&text);
+}
+
+/** Appends formatted text to \a tb. */
+static void tb_printf(struct tbuf *tb, const char *fmt, ...)
+{
+    char text[256];
+    va_list args;
+    int len;
+
+    va_start(args, fmt);
+    len = vsnprintf(text, sizeof text, fmt, args);
+    va_end(args);
+    tb_bytes(tb, text, len);
+}
+
+/** Appends \a value, in units of 10**-\a frac, as a fixed-point field. */
+static void tb_fixed(struct tbuf *tb, int64_t value, int width, int frac)
+{
+    char text[32];
+    int64_t scale;
+    int ii;
+
+    for (ii = 0, scale = 1; ii < frac; ++ii)
+    {
+        scale *= 10;
+    }
+    snprintf(text, sizeof text, "%s%lld.%0*lld", (value < 0) ? "-" : "",
+        (long long)(llabs(value) / scale), frac,
+        (long long)(llabs(value) % scale));
+    tb_printf(tb, "%*s", width, text);
+}
+
+/** Removes trailing spaces from \a tb and ends the line. */
+static void tb_end_line(struct tbuf *tb)
+{
+    while (tb->len > 0 && tb->data[tb->len - 1] == ' ')
+    {
+        --tb->len;
+    }
+    tb_byte(tb, '\n');
+}
+
+/** Satellites used by test_crx(); records pick them by bitmask. */
+static const char *const crx_sats[] = {
+    "G01", "G02", "R05", "E11", "G03", "G04", "G05", "G06",
+    "G07", "G08", "G09", "G10", "G12", "R07"
+};
+
+/** Records written by test_crx().  Flags 2-5 are special events with
+ * \a n comment lines; for others, \a n is a bitmask of crx_sats.
+ */
+static const struct
+{
+    int sec;
+    char flag;
+    int n;
+    int64_t clock;
+} crx_records[] = {
+    { 0, '0', 0x7, 123456789 },
+    { 30, '0', 0xf, 123456999 },
+    { 60, '0', 0xd, -2468 },
+    { 60, '4', 2, 0 },
+    { 75, '5', 0, 0 },
+    { 90, '0', 0xf, 0 },
+    { 90, '6', 0x1, 0 },
+    { 120, '0', 0xf, 555 },
+    { 150, '0', 0x3fff, 556 },
+    { 180, '1', 0x3fff, 560 },
+    { 210, '0', 0x3ffe, 570 }
+};
+
+/** Appends a RINEX 2.11 or 3.04 observation file built from
+ * crx_records to \a tb.  Observations have blank fields, missing LLI
+ * or SSI, and values that need every order of differencing.
+ */
+static void build_crx_rinex(struct tbuf *tb, int version)
+{
+    int ii, jj, nn, n_obs, n_sats, sec, line_start;
+    char svs[3 * 14];
+    int64_t value;
+    const char *sv;
+
+    if (version == 2)
+    {
+        tb_printf(tb, "%-60s%s\n", "     2.11           OBSERVATION DATA    "
+            "M (MIXED)", "RINEX VERSION / TYPE");
+        tb_printf(tb, "%-60s%s\n", "     6    C1    L1    L2    P2    S1    S2",
+            "# / TYPES OF OBSERV");
+    }
+    else
+    {
+        tb_printf(tb, "%-60s%s\n", "     3.04           OBSERVATION DATA    "
+            "M (MIXED)", "RINEX VERSION / TYPE");
+        tb_printf(tb, "%-60s%s\n", "G    6 C1C L1C L2W C2W S1C S2W",
+            "SYS / # / OBS TYPES");
+        tb_printf(tb, "%-60s%s\n", "R    4 C1C L1C C2P L2P",
+            "SYS / # / OBS TYPES");
+        tb_printf(tb, "%-60s%s\n", "E    3 C1X L1X S1X",
+            "SYS / # / OBS TYPES");
+    }
+    tb_printf(tb, "%-60s%s\n", "", "END OF HEADER");
+
+    for (ii = 0; ii < (int)(sizeof crx_records / sizeof crx_records[0]);
+        ++ii)
+    {
+        /* Write the epoch line(s). */
+        sec = crx_records[ii].sec;
+        n_sats = crx_records[ii].n;
+        if (crx_records[ii].flag < '2' || crx_records[ii].flag > '5')
+        {
+            n_sats = __builtin_popcount(n_sats);
+        }
+        line_start = tb->len;
+        if (version == 2)
+        {
+            tb_printf(tb, " 21  1  2  0 %2d%3d.0000000  %c%3d", sec / 60,
+                sec % 60, crx_records[ii].flag, n_sats);
+        }
+        else
+        {
+            tb_printf(tb, "> 2021 01 02 00 %02d%3d.0000000  %c%3d", sec / 60,
+                sec % 60, crx_records[ii].flag, n_sats);
+        }
+        if (crx_records[ii].flag >= '2' && crx_records[ii].flag <= '5')
+        {
+            tb_byte(tb, '\n');
+            for (jj = 0; jj < n_sats; ++jj)
+            {
+                tb_printf(tb, "%-60s%s\n", "EVENT COMMENT", "COMMENT");
+            }
+            continue;
+        }
+        /* RINEX 2 lists twelve satellites per line, and puts any clock
+         * offset at the end of the first line.
+         */
+        for (jj = nn = 0; version == 2 && jj < 14; ++jj)
+        {
+            if (crx_records[ii].n & (1 << jj))
+            {
+                memcpy(svs + 3 * nn++, crx_sats[jj], 3);
+            }
+        }
+        tb_bytes(tb, svs, 3 * ((nn < 12) ? nn : 12));
+        if (crx_records[ii].clock)
+        {
+            tb_printf(tb, "%*s", (version == 2 ? 68 : 41)
+                - (tb->len - line_start), "");
+            tb_fixed(tb, crx_records[ii].clock, (version == 2) ? 12 : 15,
+                (version == 2) ? 9 : 12);
+        }
+        tb_byte(tb, '\n');
+        if (nn > 12)
+        {
+            tb_printf(tb, "%32s%.*s\n", "", 3 * (nn - 12), svs + 36);
+        }
+
+        /* Write each satellite's observations. */
+        for (jj = 0; jj < 14; ++jj)
+        {
+            if (!(crx_records[ii].n & (1 << jj)))
+            {
+                continue;
+            }
+            sv = crx_sats[jj];
+            n_obs = (version == 2 || sv[0] == 'G') ? 6
+                : (sv[0] == 'R') ? 4 : 3;
+            if (version == 3)
+            {
+                tb_printf(tb, "%s", sv);
+            }
+            for (nn = 0; nn < n_obs; ++nn)
+            {
+                value = INT64_C(20000000000) + INT64_C(100000000) * jj
+                    + INT64_C(5000000000) * nn + sec * (1234567 + sec
+                    * (3456 + sec * 78));
+                if (nn == 4)
+                {
+                    value = -value / 1000;
+                }
+                if ((sec / 30 + jj + nn) % 7 == 3)
+                {
+                    tb_printf(tb, "%16s", "");
+                }
+                else
+                {
+                    tb_fixed(tb, value, 14, 3);
+                    tb_printf(tb, "%c%c", (sec + nn) % 4 ? ' ' : '1',
+                        (jj + nn) % 3 ? '0' + (jj + nn + sec / 30) % 10
+                        : ' ');
+                }
+
+                /* Leave trailing blanks on the second record. */
+                if (version == 2 && nn % 5 == 4 && nn + 1 < n_obs)
+                {
+                    if (ii == 1)
+                    {
+                        tb_byte(tb, '\n');
+                    }
+                    else
+                    {
+                        tb_end_line(tb);
+                    }
+                }
+            }
+            if (ii == 1)
+            {
+                tb_byte(tb, '\n');
+            }
+            else
+            {
+                tb_end_line(tb);
+            }
+        }
+    }
+}
+
+/** Checks that \a crx read the same record as \a rnx. */
+static void check_crx_record(
+    const struct rinex_parser *rnx,
+    const struct rinex_parser *crx,
+    const char *what,
+    int idx
+)
+{
+    const struct rinex_sat_entry *last;
+    int ii, n_obs;
+
+    check(crx->epoch.yyyy_mm_dd == rnx->epoch.yyyy_mm_dd
+        && crx->epoch.hh_mm == rnx->epoch.hh_mm
+        && crx->epoch.sec_e7 == rnx->epoch.sec_e7
+        && crx->epoch.flag == rnx->epoch.flag
+        && crx->epoch.n_sats == rnx->epoch.n_sats,
+        "%s record %d: epoch %d %d %d %c %d", what, idx,
+        crx->epoch.yyyy_mm_dd, crx->epoch.hh_mm, crx->epoch.sec_e7,
+        crx->epoch.flag, crx->epoch.n_sats);
+    check(crx->epoch.clock_offset == rnx->epoch.clock_offset,
+        "%s record %d: clock offset %lld, not %lld", what, idx,
+        (long long)crx->epoch.clock_offset,
+        (long long)rnx->epoch.clock_offset);
+    if (!check(crx->buffer_len == rnx->buffer_len
+            && !memcmp(crx->buffer, rnx->buffer, rnx->buffer_len),
+            "%s record %d: buffer differs", what, idx))
+    {
+        return;
+    }
+    if (rnx->epoch.flag >= '2' && rnx->epoch.flag <= '5')
+    {
+        return;
+    }
+
+    /* Compare the satellites and observations. */
+    for (ii = 0; ii < rnx->epoch.n_sats; ++ii)
+    {
+        check(crx->sats[ii].system == rnx->sats[ii].system
+            && crx->sats[ii].svn == rnx->sats[ii].svn
+            && crx->sats[ii].n_obs == rnx->sats[ii].n_obs
+            && crx->sats[ii].obs_ofs == rnx->sats[ii].obs_ofs,
+            "%s record %d: satellite %d is %c%02d", what, idx, ii,
+            crx->sats[ii].system, crx->sats[ii].svn);
+    }
+    last = rnx->sats + rnx->epoch.n_sats - 1;
+    n_obs = rnx->epoch.n_sats ? last->obs_ofs + last->n_obs : 0;
+    for (ii = 0; ii < n_obs; ++ii)
+    {
+        check(crx->obs[ii] == rnx->obs[ii] && crx->lli[ii] == rnx->lli[ii]
+            && crx->ssi[ii] == rnx->ssi[ii],
+            "%s record %d: observation %d is %lld %c%c, not %lld %c%c",
+            what, idx, ii, (long long)crx->obs[ii], crx->lli[ii],
+            crx->ssi[ii], (long long)rnx->obs[ii], rnx->lli[ii],
+            rnx->ssi[ii]);
+    }
+
+    /* The test writes cycle slip records as the decoder rebuilds them. */
+    if (rnx->epoch.flag == '6')
+    {
+        check(crx->slip_text_len == rnx->slip_text_len
+            && !memcmp(crx->slip_text, rnx->slip_text, rnx->slip_text_len),
+            "%s record %d: slip text \"%.*s\"", what, idx,
+            crx->slip_text_len, crx->slip_text);
+    }
+}
+
+/** Tests that RINEX 2 and 3 files read the same after a round trip
+ * through the Compact RINEX encoder and crx_open_v23().
+ */
+static void test_crx(void)
+{
+    struct rinex_stream *rnx_stream = NULL, *crx_stream = NULL;
+    struct rinex_parser *rnx = NULL, *crx = NULL;
+    struct rinex_crx *enc = NULL;
+    struct tbuf text;
+    const char *err, *what;
+    char rnx_path[32], crx_path[32];
+    FILE *out;
+    int version, res, crx_res, idx;
+
+    memset(&text, 0, sizeof text);
+    *rnx_path = *crx_path = '\0';
+    for (version = 2; version <= 3; ++version)
+    {
+        what = (version == 2) ? "crx v2" : "crx v3";
+
+        /* Encode the RINEX file. */
+        text.len = 0;
+        build_crx_rinex(&text, version);
+        if (!check(!write_file(&text, text.len, rnx_path)
+                && !write_file(&text, 0, crx_path), "%s: write", what))
+        {
+            break;
+        }
+        rnx_stream = rinex_mmap_stream(rnx_path);
+        err = rnx_stream ? rinex_open(&rnx, rnx_stream) : "cannot map file";
+        if (!check(!err, "%s: rinex_open: %s", what, err))
+        {
+            break;
+        }
+        out = fopen(crx_path, "w");
+        res = out ? rinex_crx_create(&enc, rnx, out) : errno;
+        check(!res, "%s: rinex_crx_create: %d", what, res);
+        while (!res && (res = rnx->read(rnx)) > 0)
+        {
+            res = rinex_crx_write(enc, rnx);
+            check(!res, "%s: rinex_crx_write: %d", what, res);
+        }
+        check(res == 0, "%s: RINEX read: %d", what, res);
+        rinex_crx_destroy(enc);
+        enc = NULL;
+        if (out)
+        {
+            fclose(out);
+        }
+        rnx->destroy(rnx);
+        rnx = NULL;
+        rnx_stream->destroy(rnx_stream);
+
+        /* Read both files in step. */
+        rnx_stream = rinex_mmap_stream(rnx_path);
+        crx_stream = rinex_mmap_stream(crx_path);
+        err = rnx_stream ? rinex_open(&rnx, rnx_stream) : "cannot map file";
+        if (!err)
+        {
+            err = crx_stream ? rinex_open(&crx, crx_stream)
+                : "cannot map file";
+        }
+        if (!check(!err, "%s: reopen: %s", what, err))
+        {
+            break;
+        }
+        for (idx = 0; ; ++idx)
+        {
+            res = rnx->read(rnx);
+            crx_res = crx->read(crx);
+            if (!check(crx_res == res, "%s record %d: read %d, not %d (line %d)",
+                    what, idx, crx_res, res, crx->error_line) || res <= 0)
+            {
+                break;
+            }
+            check_crx_record(rnx, crx, what, idx);
+        }
+        check(idx == (int)(sizeof crx_records / sizeof crx_records[0]),
+            "%s: read %d records", what, idx);
+
+        rnx->destroy(rnx);
+        crx->destroy(crx);
+        rnx = crx = NULL;
+        rnx_stream->destroy(rnx_stream);
+        crx_stream->destroy(crx_stream);
+        rnx_stream = crx_stream = NULL;
+    }
+
+    if (rnx)
+    {
+        rnx->destroy(rnx);
+    }
+    if (crx)
+    {
+        crx->destroy(crx);
+    }
+    if (rnx_stream)
+    {
+        rnx_stream->destroy(rnx_stream);
+    }
+    if (crx_stream)
+    {
+        crx_stream->destroy(crx_stream);
+    }
+    if (*rnx_path)
+    {
+        unlink(rnx_path);
+    }
+    if (*crx_path)
+    {
+        unlink(crx_path);
+    }
+    tb_free(&text);
+}
+
+/** Table of tests, by name. */
+static const struct
+{
+    const char *name;
+    void (*func)(void);
+} tests[] = {
+    { "zones", test_zones },
+    { "blocks", test_blocks },
+    { "predict", test_predict },
+    { "rans", test_rans },
+    { "coded", test_coded },
+    { "indicators", test_indicators },
+    { "padding", test_padding },
+    { "split", test_split_loaded },
+    { "pread", test_pread },
+    { "epochs", test_epochs },
+    { "catalog", test_catalog },
+    { "arrow", test_arrow },
+    { "header_index", test_header_index },
+    { "find_sat", test_find_sat },
+    { "cache", test_cache },
+    { "prefetch", test_cache_prefetch },
+    { "numa", test_numa_select },
+    { "queue", test_numa_queue },
+    { "bind", test_numa_bind },
+    { "combine", test_slip_combine },
+    { "detect", test_slip_detect },
+    { "qc", test_qc },
+    { "crx", test_crx },
+    { NULL, NULL }
+};
+
+int main(int argc, char *argv[])
+{
+    int ii, jj, before;
+
+    for (ii = 0; tests[ii].name; ++ii)
+    {
+        for (jj = 1; jj < argc; ++jj)
+        {
+            if (!strcmp(argv[jj], tests[ii].name))
+            {
+                break;
+            }
+        }
+        if (argc > 1 && jj == argc)
+        {
+            continue;
+        }
+
+        before = n_failed;
+        tests[ii].func();
+        printf("%s: %d failures\n", tests[ii].name, n_failed - before);
+    }
+
+    return n_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
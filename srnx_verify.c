@@ -0,0 +1,719 @@
+/** srnx_verify.c - Checks that SRNX files match their RINEX sources.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Usage: srnx_verify [-j threads] [--numa spec] file.rnx file.srnx [...]
+ *
+ * Each pair of files is checked by streaming the RINEX file through
+ * rinex_parser while one srnx_obs_reader per signal advances in step
+ * with it, so no column is decoded ahead of time and the first
+ * difference stops the check for that pair.  This compares the header,
+ * epoch times and clock offsets, satellite presence, observation
+ * values, LLIs, SSIs and special event records.  Pairs are spread over
+ * the worker threads, which are placed as described in srnx_numa.h;
+ * --numa overrides the topology, like $SRNX_NUMA.
+ *
+ * When a signal has one value for each epoch that its satellite is
+ * present, blank RINEX fields must be zero in the SRNX file; otherwise,
+ * the signal must have exactly one value for each non-blank field.
+ */
+
+#include "rinex.h"
+#include "srnx.h"
+#include "srnx_numa.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** verify_signal tracks one signal of one satellite. */
+struct verify_signal
+{
+    /** rdr is NULL if the SRNX file does not have this signal. */
+    struct srnx_obs_reader *rdr;
+    char *lli;
+    char *ssi;
+    int n_values;
+    int n_read;
+};
+
+/** verify_sat tracks one satellite. */
+struct verify_sat
+{
+    struct srnx_satellite_name name;
+    struct verify_signal *signal;
+    uint64_t *presence;
+    uint64_t n_present;
+    uint64_t n_seen;
+    int n_codes;
+
+    /** state is 0 before the satellite is first seen, 1 after its
+     * readers are opened, or -1 if it is not in the SRNX file.
+     */
+    int state;
+};
+
+/** verify_pair holds the inputs and result for one pair of files. */
+struct verify_pair
+{
+    const char *rinex_name;
+    const char *srnx_name;
+    uint64_t n_epochs;
+    uint64_t n_values;
+    int failed;
+    char message[256];
+};
+
+/** verify_state holds what verify_files() needs while it runs. */
+struct verify_state
+{
+    struct verify_pair *pair;
+    struct rinex_parser *p;
+    struct srnx_reader *srnx;
+    struct rinex_epoch *epoch;
+    struct verify_sat *sat;
+    size_t n_epochs;
+};
+
+/** verify_work is shared by the worker threads. */
+struct verify_work
+{
+    struct verify_pair *pair;
+    int n_pairs;
+    struct srnx_numa_queue *queue;
+    int n_workers;
+};
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "Usage: %s [-j threads] [--numa spec] file.rnx"
+        " file.srnx [file.rnx file.srnx...]\n", argv0);
+}
+
+/** Records why \a pair failed.
+ * \returns -1, so callers can return the result.
+ */
+static int fail(struct verify_pair *pair, const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    vsnprintf(pair->message, sizeof pair->message, fmt, args);
+    va_end(args);
+    pair->failed = 1;
+    return -1;
+}
+
+/** Maps LLI and SSI characters to a canonical form, so that a missing
+ * indicator compares equal to a blank one.
+ */
+static char indicator(char c)
+{
+    return (c >= '0' && c <= '9') ? c : ' ';
+}
+
+/** Compares two texts, ignoring carriage returns.
+ * \returns Zero if they match, else non-zero.
+ */
+static int text_differs(const char *a, size_t a_len, const char *b, size_t b_len)
+{
+    size_t ii, jj;
+
+    for (ii = jj = 0; ; ++ii, ++jj)
+    {
+        while (ii < a_len && a[ii] == '\r')
+        {
+            ++ii;
+        }
+        while (jj < b_len && b[jj] == '\r')
+        {
+            ++jj;
+        }
+        if (ii == a_len || jj == b_len)
+        {
+            return (ii != a_len) || (jj != b_len);
+        }
+        if (a[ii] != b[jj])
+        {
+            return 1;
+        }
+    }
+}
+
+/** Opens presence data and signal readers for \a sat.
+ * \returns Zero on success, else -1 after calling fail().
+ */
+static int open_sat(
+    struct verify_state *vs,
+    struct verify_sat *sat,
+    int n_obs
+)
+{
+    const struct srnx_obs_code *code;
+    struct verify_signal *sig;
+    uint64_t n_values, socd_offset;
+    int res, n_codes, ii;
+
+    res = srnx_get_sat_presence(vs->srnx, sat->name, vs->n_epochs,
+        &sat->presence, &sat->n_present);
+    if (res == SRNX_UNKNOWN_SATELLITE)
+    {
+        sat->state = -1;
+        return 0;
+    }
+    if (!res)
+    {
+        res = srnx_get_obs_codes(vs->srnx, sat->name.name[0], &code, &n_codes);
+    }
+    if (res)
+    {
+        return fail(vs->pair, "%s: %s (line %d)", sat->name.name,
+            srnx_strerror(res), srnx_error_line(vs->srnx));
+    }
+    if (n_codes != n_obs)
+    {
+        return fail(vs->pair, "%s: %d observation codes in RINEX, %d in SRNX",
+            sat->name.name, n_obs, n_codes);
+    }
+
+    sat->signal = calloc(n_codes, sizeof(*sat->signal));
+    if (!sat->signal)
+    {
+        return fail(vs->pair, "%s", strerror(ENOMEM));
+    }
+    sat->n_codes = n_codes;
+    sat->state = 1;
+
+    for (ii = 0; ii < n_codes; ++ii)
+    {
+        sig = sat->signal + ii;
+        res = srnx_get_obs_info(vs->srnx, sat->name, ii, &n_values,
+            &socd_offset);
+        if (res == SRNX_UNKNOWN_CODE)
+        {
+            continue;
+        }
+        if (!res)
+        {
+            res = srnx_open_obs_by_index(vs->srnx, sat->name, ii, &sig->rdr);
+        }
+        if (!res)
+        {
+            res = srnx_read_obs_ssi_lli(sig->rdr, &sig->n_values, &sig->lli,
+                &sig->ssi);
+        }
+        if (res)
+        {
+            return fail(vs->pair, "%s %.3s: %s (line %d)", sat->name.name,
+                code[ii].name, srnx_strerror(res), srnx_error_line(vs->srnx));
+        }
+        if ((uint64_t)sig->n_values != sat->n_present)
+        {
+            return fail(vs->pair, "%s %.3s: %d values for %llu epochs",
+                sat->name.name, code[ii].name, sig->n_values,
+                (unsigned long long)sat->n_present);
+        }
+    }
+
+    return 0;
+}
+
+/** Compares one satellite's observations in the current record.
+ * \returns Zero on success, else -1 after calling fail().
+ */
+static int verify_sat_obs(
+    struct verify_state *vs,
+    const struct rinex_sat_entry *entry,
+    uint64_t epoch_idx
+)
+{
+    struct rinex_parser *p = vs->p;
+    struct verify_sat *sat;
+    struct verify_signal *sig;
+    const unsigned char *present;
+    int64_t value, expect;
+    char system, lli, ssi;
+    int res, n_obs, ii, kk, has;
+
+    system = (entry->system == ' ') ? 'G' : entry->system;
+    if (entry->svn >= RINEX_MAX_SVN)
+    {
+        return fail(vs->pair, "epoch %llu: bad satellite number %d",
+            (unsigned long long)epoch_idx, entry->svn);
+    }
+    sat = vs->sat + (system & 31) * RINEX_MAX_SVN + entry->svn;
+    n_obs = p->n_obs[entry->system & 31];
+    if (!sat->state)
+    {
+        sat->name.name[0] = system;
+        sat->name.name[1] = '0' + entry->svn / 10;
+        sat->name.name[2] = '0' + entry->svn % 10;
+        if (open_sat(vs, sat, n_obs))
+        {
+            return -1;
+        }
+    }
+    if (sat->state < 0)
+    {
+        return fail(vs->pair, "epoch %llu: %s is missing from SRNX",
+            (unsigned long long)epoch_idx, sat->name.name);
+    }
+    if (!(sat->presence[epoch_idx / 64] & (1ull << (epoch_idx % 64))))
+    {
+        return fail(vs->pair, "epoch %llu: %s is not present in SRNX",
+            (unsigned long long)epoch_idx, sat->name.name);
+    }
+    ++sat->n_seen;
+
+    present = (const unsigned char *)p->buffer + entry->buffer_ofs + 2;
+    for (ii = 0, kk = entry->obs_ofs; ii < n_obs; ++ii)
+    {
+        sig = sat->signal + ii;
+        has = (present[ii >> 3] >> (ii & 7)) & 1;
+        if (has)
+        {
+            expect = p->obs[kk];
+            lli = indicator(p->lli[kk]);
+            ssi = indicator(p->ssi[kk]);
+            ++kk;
+        }
+        else if (!sig->rdr)
+        {
+            /* The signal was never observed. */
+            continue;
+        }
+        else
+        {
+            expect = 0;
+            lli = ssi = ' ';
+        }
+
+        if (!sig->rdr)
+        {
+            return fail(vs->pair, "epoch %llu: %s obs %d is missing from SRNX",
+                (unsigned long long)epoch_idx, sat->name.name, ii);
+        }
+        res = srnx_read_obs_value(sig->rdr, &value);
+        if (res)
+        {
+            return fail(vs->pair, "epoch %llu: %s obs %d: %s",
+                (unsigned long long)epoch_idx, sat->name.name, ii,
+                srnx_strerror(res));
+        }
+        if (value != expect || indicator(sig->lli[sig->n_read]) != lli
+            || indicator(sig->ssi[sig->n_read]) != ssi)
+        {
+            return fail(vs->pair, "epoch %llu: %s obs %d: RINEX %lld%c%c,"
+                " SRNX %lld%c%c", (unsigned long long)epoch_idx,
+                sat->name.name, ii, (long long)expect, lli, ssi,
+                (long long)value, indicator(sig->lli[sig->n_read]),
+                indicator(sig->ssi[sig->n_read]));
+        }
+        ++sig->n_read;
+        ++vs->pair->n_values;
+    }
+
+    return 0;
+}
+
+/** Checks that every satellite and signal in the SRNX file was fully
+ * matched by the RINEX file.
+ * \returns Zero on success, else -1 after calling fail().
+ */
+static int verify_leftovers(struct verify_state *vs)
+{
+    struct srnx_satellite_name *names = NULL;
+    struct verify_sat *sat;
+    uint64_t n_names, ii;
+    int res, svn, jj;
+
+    res = srnx_get_satellites(vs->srnx, &names, &n_names);
+    if (res)
+    {
+        return fail(vs->pair, "%s (line %d)", srnx_strerror(res),
+            srnx_error_line(vs->srnx));
+    }
+
+    for (ii = 0; ii < n_names && !res; ++ii)
+    {
+        svn = (names[ii].name[1] - '0') * 10 + (names[ii].name[2] - '0');
+        if (svn < 0 || svn >= RINEX_MAX_SVN)
+        {
+            res = fail(vs->pair, "%.3s is not a valid name", names[ii].name);
+            break;
+        }
+        sat = vs->sat + (names[ii].name[0] & 31) * RINEX_MAX_SVN + svn;
+        if (sat->state <= 0)
+        {
+            res = fail(vs->pair, "%.3s is only in SRNX", names[ii].name);
+            break;
+        }
+        if (sat->n_seen != sat->n_present)
+        {
+            res = fail(vs->pair, "%s: present at %llu epochs in RINEX,"
+                " %llu in SRNX", sat->name.name,
+                (unsigned long long)sat->n_seen,
+                (unsigned long long)sat->n_present);
+            break;
+        }
+        for (jj = 0; jj < sat->n_codes; ++jj)
+        {
+            if (sat->signal[jj].n_read != sat->signal[jj].n_values)
+            {
+                res = fail(vs->pair, "%s obs %d: %d values in RINEX,"
+                    " %d in SRNX", sat->name.name, jj,
+                    sat->signal[jj].n_read, sat->signal[jj].n_values);
+                break;
+            }
+        }
+    }
+
+    srnx_free(names);
+    return res;
+}
+
+/** Walks through the records of the RINEX file.
+ * \returns Zero on success, else -1 after calling fail().
+ */
+static int verify_records(struct verify_state *vs)
+{
+    struct rinex_parser *p = vs->p;
+    const struct rinex_epoch *ep;
+    const char *event = NULL, *text;
+    size_t event_len = 0, text_len;
+    uint64_t epoch_idx, event_idx = 0;
+    int res, ev_res, ii;
+
+    /* Fetch the first special event, if any. */
+    ev_res = srnx_next_special_event(vs->srnx, &event, &event_len, &event_idx);
+
+    for (epoch_idx = 0; (res = p->read(p)) == RINEX_SUCCESS; )
+    {
+        if (p->epoch.flag == '0' || p->epoch.flag == '1')
+        {
+            if (epoch_idx >= vs->n_epochs)
+            {
+                return fail(vs->pair, "RINEX has more than %llu epochs",
+                    (unsigned long long)vs->n_epochs);
+            }
+            ep = vs->epoch + epoch_idx;
+            if (ep->yyyy_mm_dd != p->epoch.yyyy_mm_dd
+                || ep->hh_mm != p->epoch.hh_mm
+                || ep->sec_e7 != p->epoch.sec_e7
+                || ep->clock_offset != p->epoch.clock_offset)
+            {
+                return fail(vs->pair, "epoch %llu: RINEX %08d %04d %d,"
+                    " SRNX %08d %04d %d", (unsigned long long)epoch_idx,
+                    p->epoch.yyyy_mm_dd, p->epoch.hh_mm, p->epoch.sec_e7,
+                    ep->yyyy_mm_dd, ep->hh_mm, ep->sec_e7);
+            }
+
+            if (!p->sats && p->epoch.n_sats > 0)
+            {
+                return fail(vs->pair, "epoch %llu: RINEX parser does not"
+                    " list satellites", (unsigned long long)epoch_idx);
+            }
+            for (ii = 0; ii < p->epoch.n_sats; ++ii)
+            {
+                if (verify_sat_obs(vs, p->sats + ii, epoch_idx))
+                {
+                    return -1;
+                }
+            }
+            ++epoch_idx;
+            continue;
+        }
+
+        /* Anything else is stored as a special event.  The parser
+         * keeps the text of cycle slip records (flag 6) separately,
+         * since it parses their observations into #buffer.
+         */
+        if (ev_res)
+        {
+            return fail(vs->pair, "epoch %llu: event flag %c is missing"
+                " from SRNX", (unsigned long long)epoch_idx, p->epoch.flag);
+        }
+        if (p->epoch.flag == '6')
+        {
+            text = p->slip_text;
+            text_len = p->slip_text_len;
+            if (!text)
+            {
+                return fail(vs->pair, "epoch %llu: RINEX parser does not"
+                    " keep cycle slip text", (unsigned long long)epoch_idx);
+            }
+        }
+        else
+        {
+            text = p->buffer;
+            text_len = p->buffer_len;
+        }
+        if (event_idx != epoch_idx
+            || text_differs(text, text_len, event, event_len))
+        {
+            return fail(vs->pair, "epoch %llu: event flag %c differs"
+                " from SRNX", (unsigned long long)epoch_idx, p->epoch.flag);
+        }
+        ev_res = srnx_next_special_event(vs->srnx, &event, &event_len,
+            &event_idx);
+    }
+
+    if (res < 0)
+    {
+        return fail(vs->pair, "RINEX parse error %d (line %d)", res,
+            p->error_line);
+    }
+    if (epoch_idx != vs->n_epochs)
+    {
+        return fail(vs->pair, "RINEX has %llu epochs, SRNX has %llu",
+            (unsigned long long)epoch_idx, (unsigned long long)vs->n_epochs);
+    }
+    if (!ev_res)
+    {
+        return fail(vs->pair, "SRNX has an extra event before epoch %llu",
+            (unsigned long long)event_idx);
+    }
+    if (ev_res != SRNX_NO_CHUNK)
+    {
+        return fail(vs->pair, "%s (line %d)", srnx_strerror(ev_res),
+            srnx_error_line(vs->srnx));
+    }
+    vs->pair->n_epochs = epoch_idx;
+
+    return verify_leftovers(vs);
+}
+
+/** Checks one pair of files, recording the result in \a pair. */
+static void verify_files(struct verify_pair *pair)
+{
+    struct verify_state vs;
+    struct rinex_stream *stream;
+    const char *rhdr, *err;
+    size_t rhdr_len, ii;
+    int res, jj;
+
+    memset(&vs, 0, sizeof vs);
+    vs.pair = pair;
+
+    /* Open both files and compare their headers. */
+    stream = rinex_mmap_stream(pair->rinex_name);
+    if (!stream)
+    {
+        fail(pair, "%s: %s", pair->rinex_name, strerror(errno));
+        return;
+    }
+    err = rinex_open(&vs.p, stream);
+    if (err)
+    {
+        fail(pair, "%s: %s", pair->rinex_name, err);
+        goto out;
+    }
+    res = srnx_open(&vs.srnx, pair->srnx_name);
+    if (!res)
+    {
+        res = srnx_get_header(vs.srnx, &rhdr, &rhdr_len);
+    }
+    if (!res)
+    {
+        res = srnx_get_epochs(vs.srnx, &vs.epoch, &vs.n_epochs);
+    }
+    if (res)
+    {
+        fail(pair, "%s: %s", pair->srnx_name, srnx_strerror(res));
+        goto out;
+    }
+    if (text_differs(vs.p->buffer, vs.p->buffer_len, rhdr, rhdr_len))
+    {
+        fail(pair, "headers differ");
+        goto out;
+    }
+
+    vs.sat = calloc(32 * RINEX_MAX_SVN, sizeof(*vs.sat));
+    if (!vs.sat)
+    {
+        fail(pair, "%s", strerror(ENOMEM));
+        goto out;
+    }
+
+    verify_records(&vs);
+
+out:
+    if (vs.sat)
+    {
+        for (ii = 0; ii < 32 * RINEX_MAX_SVN; ++ii)
+        {
+            for (jj = 0; jj < vs.sat[ii].n_codes; ++jj)
+            {
+                srnx_free_obs_reader(vs.sat[ii].signal[jj].rdr);
+                srnx_free(vs.sat[ii].signal[jj].lli);
+                srnx_free(vs.sat[ii].signal[jj].ssi);
+            }
+            free(vs.sat[ii].signal);
+            srnx_free(vs.sat[ii].presence);
+        }
+        free(vs.sat);
+    }
+    srnx_free(vs.epoch);
+    srnx_close(vs.srnx);
+    if (vs.p)
+    {
+        vs.p->destroy(vs.p);
+    }
+    stream->destroy(stream);
+}
+
+/** Checks pairs from \a work until none are left.
+ *
+ * \param[in,out] work Work queue and file pairs.
+ * \param[in] node NUMA node that the calling thread runs on.
+ */
+static void verify_pairs(struct verify_work *work, int node)
+{
+    int idx;
+
+    while ((idx = srnx_numa_queue_next(work->queue, node)) >= 0)
+    {
+        verify_files(work->pair + idx);
+    }
+}
+
+/** Places a thread that main() started, then checks pairs. */
+static void *verify_thread(void *arg)
+{
+    struct verify_work *work = arg;
+
+    verify_pairs(work, srnx_numa_bind_worker(__atomic_fetch_add(
+        &work->n_workers, 1, __ATOMIC_RELAXED)));
+
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    struct verify_work work;
+    pthread_t *thread;
+    int *node;
+    int n_threads, n_failed, ii, jj;
+
+    n_threads = 1;
+    for (ii = 1; ii < argc && argv[ii][0] == '-'; ++ii)
+    {
+        if (!strcmp(argv[ii], "-j") && ii + 1 < argc)
+        {
+            n_threads = strtol(argv[++ii], NULL, 10);
+        }
+        else if (!strcmp(argv[ii], "--numa") && ii + 1 < argc)
+        {
+            if (srnx_numa_select(argv[++ii]))
+            {
+                fprintf(stderr, "Bad NUMA topology '%s'\n", argv[ii]);
+                return EXIT_FAILURE;
+            }
+        }
+        else
+        {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (argc - ii < 2 || (argc - ii) % 2)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    work.n_pairs = (argc - ii) / 2;
+    work.n_workers = 0;
+    work.pair = calloc(work.n_pairs, sizeof(*work.pair));
+    if (!work.pair)
+    {
+        fprintf(stderr, "%s\n", strerror(ENOMEM));
+        return EXIT_FAILURE;
+    }
+    for (jj = 0; jj < work.n_pairs; ++jj)
+    {
+        work.pair[jj].rinex_name = argv[ii + 2 * jj];
+        work.pair[jj].srnx_name = argv[ii + 2 * jj + 1];
+    }
+
+    /* Check the pairs, then report in command-line order.  Each pair
+     * goes to the node that caches its RINEX file, if any.
+     */
+    if (n_threads > work.n_pairs)
+    {
+        n_threads = work.n_pairs;
+    }
+    node = NULL;
+    if (n_threads > 1 && srnx_numa_node_count() > 1)
+    {
+        node = malloc(work.n_pairs * sizeof(*node));
+        for (jj = 0; node && jj < work.n_pairs; ++jj)
+        {
+            node[jj] = srnx_numa_file_node(work.pair[jj].rinex_name);
+        }
+    }
+    if (srnx_numa_queue_create(&work.queue, work.n_pairs, node))
+    {
+        fprintf(stderr, "%s\n", strerror(ENOMEM));
+        return EXIT_FAILURE;
+    }
+    free(node);
+    thread = (n_threads > 1) ? calloc(n_threads - 1, sizeof(*thread)) : NULL;
+    for (jj = 0; thread && jj < n_threads - 1; ++jj)
+    {
+        if (pthread_create(thread + jj, NULL, verify_thread, &work))
+        {
+            break;
+        }
+    }
+    verify_pairs(&work, srnx_numa_current_node());
+    while (thread && jj-- > 0)
+    {
+        pthread_join(thread[jj], NULL);
+    }
+    free(thread);
+    srnx_numa_queue_free(work.queue);
+
+    for (jj = n_failed = 0; jj < work.n_pairs; ++jj)
+    {
+        if (work.pair[jj].failed)
+        {
+            printf("%s %s: FAIL: %s\n", work.pair[jj].rinex_name,
+                work.pair[jj].srnx_name, work.pair[jj].message);
+            ++n_failed;
+        }
+        else
+        {
+            printf("%s %s: OK, %llu epochs, %llu values\n",
+                work.pair[jj].rinex_name, work.pair[jj].srnx_name,
+                (unsigned long long)work.pair[jj].n_epochs,
+                (unsigned long long)work.pair[jj].n_values);
+        }
+    }
+    free(work.pair);
+
+    return n_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,1264 @@
+/** srnxmodule.c - CPython bindings for the SRNX reader and RINEX parser.
+ * Copyright 2021 Michael Poole.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* This builds the "srnx" Python module; see "make pysrnx".  It needs
+ * Python 3.10 or later, and pysrnx_test.py is its smoke test.
+ *
+ * Every array this module returns is an srnx.Array, which owns the
+ * memory that the C library decoded into and exports it through the
+ * buffer protocol, so numpy.asarray() (or memoryview()) wraps it
+ * without a copy.  The GIL is released while files are opened, parsed
+ * or decoded.  A Reader or RinexParser serializes its own calls with a
+ * lock, so several Python threads can each work on their own files in
+ * parallel; srnx.read_files() does the same with C threads.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#if PY_VERSION_HEX < 0x030A0000
+# error "The srnx module needs Python 3.10 or later (for Py_NewRef)."
+#endif
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rinex.h"
+#include "srnx.h"
+#include "srnx_numa.h"
+
+/** Buffer format for struct rinex_epoch. */
+#define EPOCH_FORMAT "T{i:yyyy_mm_dd:h:hh_mm:c:flag:xi:sec_e7:i:n_sats:q:clock_offset:}"
+
+static PyObject *srnx_py_error;
+
+/* Arrays */
+
+/** Array exports one contiguous, one-dimensional C array. */
+typedef struct
+{
+    PyObject_HEAD
+
+    /** Elements of the array; owned by this object. */
+    void *data;
+
+    /** Number of elements at #data. */
+    Py_ssize_t len;
+
+    /** Size of each element, in bytes. */
+    Py_ssize_t itemsize;
+
+    /** struct-module format of each element. */
+    const char *format;
+
+    /** Releases #data. */
+    void (*release)(void *);
+} ArrayObject;
+
+static PyTypeObject Array_Type;
+
+/** Wraps \a data, taking ownership of it even on failure. */
+static PyObject *array_wrap(void *data, Py_ssize_t len, Py_ssize_t itemsize,
+    const char *format, void (*release)(void *))
+{
+    ArrayObject *arr;
+
+    arr = PyObject_New(ArrayObject, &Array_Type);
+    if (!arr)
+    {
+        release(data);
+        return NULL;
+    }
+    arr->data = data;
+    arr->len = len;
+    arr->itemsize = itemsize;
+    arr->format = format;
+    arr->release = release;
+
+    return (PyObject *)arr;
+}
+
+static void Array_dealloc(ArrayObject *self)
+{
+    self->release(self->data);
+    PyObject_Free(self);
+}
+
+static int Array_getbuffer(ArrayObject *self, Py_buffer *view, int flags)
+{
+    static char empty[8];
+
+    view->obj = Py_NewRef(self);
+    view->buf = self->data ? self->data : empty;
+    view->len = self->len * self->itemsize;
+    view->itemsize = self->itemsize;
+    view->readonly = 0;
+    view->ndim = 1;
+    view->format = (flags & PyBUF_FORMAT) ? (char *)self->format : NULL;
+    view->shape = (flags & PyBUF_ND) ? &self->len : NULL;
+    view->strides = ((flags & PyBUF_STRIDES) == PyBUF_STRIDES)
+        ? &self->itemsize : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+
+    return 0;
+}
+
+static Py_ssize_t Array_length(ArrayObject *self)
+{
+    return self->len;
+}
+
+static PyObject *Array_get_format(ArrayObject *self, void *closure)
+{
+    (void)closure;
+    return PyUnicode_FromString(self->format);
+}
+
+static PyObject *Array_repr(ArrayObject *self)
+{
+    return PyUnicode_FromFormat("<srnx.Array format=%s len=%zd>",
+        self->format, self->len);
+}
+
+static PyBufferProcs Array_as_buffer = {
+    .bf_getbuffer = (getbufferproc)Array_getbuffer,
+};
+
+static PySequenceMethods Array_as_sequence = {
+    .sq_length = (lenfunc)Array_length,
+};
+
+static PyGetSetDef Array_getset[] = {
+    { "format", (getter)Array_get_format, NULL,
+      "struct-module format of each element.", NULL },
+    { NULL, NULL, NULL, NULL, NULL }
+};
+
+static PyTypeObject Array_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "srnx.Array",
+    .tp_basicsize = sizeof(ArrayObject),
+    .tp_dealloc = (destructor)Array_dealloc,
+    .tp_repr = (reprfunc)Array_repr,
+    .tp_as_sequence = &Array_as_sequence,
+    .tp_as_buffer = &Array_as_buffer,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Array decoded by the srnx module.\n\n"
+        "It supports the buffer protocol; use numpy.asarray() or\n"
+        "memoryview() to read it without copying.",
+    .tp_getset = Array_getset,
+};
+
+/* Errors */
+
+/** Raises the exception for SRNX status \a res, and returns NULL. */
+static PyObject *srnx_py_raise(int res, int line, const char *filename)
+{
+    if (res > 0)
+    {
+        errno = res;
+        return filename
+            ? PyErr_SetFromErrnoWithFilename(PyExc_OSError, filename)
+            : PyErr_SetFromErrno(PyExc_OSError);
+    }
+
+    if (filename)
+    {
+        PyErr_Format(srnx_py_error, "%s: %s (line %d)", filename,
+            srnx_strerror(res), line);
+    }
+    else
+    {
+        PyErr_Format(srnx_py_error, "%s (line %d)", srnx_strerror(res), line);
+    }
+    return NULL;
+}
+
+/** Converts \a obj to a satellite name such as "G01". */
+static int sat_name_converter(PyObject *obj, void *ptr)
+{
+    struct srnx_satellite_name *name = ptr;
+    const char *str;
+    Py_ssize_t len;
+
+    str = PyUnicode_AsUTF8AndSize(obj, &len);
+    if (!str)
+    {
+        return 0;
+    }
+    if (len != 3)
+    {
+        PyErr_Format(PyExc_ValueError, "invalid satellite name %R", obj);
+        return 0;
+    }
+    memcpy(name->name, str, 3);
+    name->name[3] = '\0';
+
+    return 1;
+}
+
+/* SRNX reader */
+
+/** Reader wraps an srnx_reader. */
+typedef struct
+{
+    PyObject_HEAD
+
+    /** SRNX reader, or NULL before __init__ succeeds. */
+    struct srnx_reader *srnx;
+
+    /** Serializes calls into #srnx. */
+    PyThread_type_lock lock;
+} ReaderObject;
+
+/** Locks \a self without holding the GIL. */
+static void reader_lock(ReaderObject *self)
+{
+    if (!PyThread_acquire_lock(self->lock, NOWAIT_LOCK))
+    {
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(self->lock, WAIT_LOCK);
+        Py_END_ALLOW_THREADS
+    }
+}
+
+/** Locks \a self and checks that it is open.
+ *
+ * \returns Zero with the lock held, or non-zero with ValueError set.
+ */
+static int reader_acquire(ReaderObject *self)
+{
+    reader_lock(self);
+    if (!self->srnx)
+    {
+        PyThread_release_lock(self->lock);
+        PyErr_SetString(PyExc_ValueError, "I/O operation on closed file");
+        return 1;
+    }
+    return 0;
+}
+
+/** Unlocks \a self, first raising an exception if \a res is non-zero.
+ *
+ * \returns \a res.
+ */
+static int reader_release(ReaderObject *self, int res)
+{
+    if (res)
+    {
+        srnx_py_raise(res, srnx_error_line(self->srnx), NULL);
+    }
+    PyThread_release_lock(self->lock);
+    return res;
+}
+
+static PyObject *Reader_new(PyTypeObject *type, PyObject *args,
+    PyObject *kwds)
+{
+    ReaderObject *self;
+
+    (void)args;
+    (void)kwds;
+    self = (ReaderObject *)type->tp_alloc(type, 0);
+    if (!self)
+    {
+        return NULL;
+    }
+    self->lock = PyThread_allocate_lock();
+    if (!self->lock)
+    {
+        Py_DECREF(self);
+        return PyErr_NoMemory();
+    }
+
+    return (PyObject *)self;
+}
+
+static int Reader_init(ReaderObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = { "filename", "pread", NULL };
+    struct srnx_reader *srnx = NULL;
+    PyObject *filename;
+    int use_pread = 0, res;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&|p", kwlist,
+        PyUnicode_FSConverter, &filename, &use_pread))
+    {
+        return -1;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    res = use_pread
+        ? srnx_open_pread(&srnx, PyBytes_AS_STRING(filename))
+        : srnx_open(&srnx, PyBytes_AS_STRING(filename));
+    Py_END_ALLOW_THREADS
+    if (res)
+    {
+        srnx_py_raise(res, srnx ? srnx_error_line(srnx) : 0,
+            PyBytes_AS_STRING(filename));
+        srnx_close(srnx);
+        Py_DECREF(filename);
+        return -1;
+    }
+    Py_DECREF(filename);
+
+    reader_lock(self);
+    srnx_close(self->srnx);
+    self->srnx = srnx;
+    PyThread_release_lock(self->lock);
+
+    return 0;
+}
+
+static void Reader_dealloc(ReaderObject *self)
+{
+    srnx_close(self->srnx);
+    if (self->lock)
+    {
+        PyThread_free_lock(self->lock);
+    }
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *Reader_close(ReaderObject *self, PyObject *unused)
+{
+    (void)unused;
+    reader_lock(self);
+    srnx_close(self->srnx);
+    self->srnx = NULL;
+    PyThread_release_lock(self->lock);
+    Py_RETURN_NONE;
+}
+
+static PyObject *Reader_enter(ReaderObject *self, PyObject *unused)
+{
+    (void)unused;
+    return Py_NewRef(self);
+}
+
+static PyObject *Reader_exit(ReaderObject *self, PyObject *args)
+{
+    (void)args;
+    return Reader_close(self, NULL);
+}
+
+static PyObject *Reader_header(ReaderObject *self, PyObject *unused)
+{
+    PyObject *result;
+    const char *rhdr;
+    size_t rhdr_len;
+    int res;
+
+    (void)unused;
+    if (reader_acquire(self))
+    {
+        return NULL;
+    }
+    res = srnx_get_header(self->srnx, &rhdr, &rhdr_len);
+    result = res ? NULL : PyBytes_FromStringAndSize(rhdr, rhdr_len);
+    reader_release(self, res);
+
+    return result;
+}
+
+static PyObject *Reader_epochs(ReaderObject *self, PyObject *unused)
+{
+    struct rinex_epoch *epoch = NULL;
+    size_t n_epochs = 0;
+    int res;
+
+    (void)unused;
+    if (reader_acquire(self))
+    {
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    res = srnx_get_epochs(self->srnx, &epoch, &n_epochs);
+    Py_END_ALLOW_THREADS
+    if (reader_release(self, res))
+    {
+        srnx_free(epoch);
+        return NULL;
+    }
+
+    return array_wrap(epoch, n_epochs, sizeof *epoch, EPOCH_FORMAT,
+        srnx_free);
+}
+
+static PyObject *Reader_epoch_times(ReaderObject *self, PyObject *unused)
+{
+    struct srnx_epoch_index *index = NULL;
+    int64_t *time_ns = NULL;
+    uint64_t count = 0;
+    int res;
+
+    (void)unused;
+    if (reader_acquire(self))
+    {
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    res = srnx_get_epoch_index(self->srnx, &index);
+    if (!res)
+    {
+        count = srnx_epoch_index_count(index);
+        time_ns = malloc(count ? count * sizeof *time_ns : 1);
+        res = time_ns
+            ? srnx_epoch_index_times(index, 0, count, time_ns)
+            : ENOMEM;
+    }
+    srnx_free_epoch_index(index);
+    Py_END_ALLOW_THREADS
+    if (reader_release(self, res))
+    {
+        free(time_ns);
+        return NULL;
+    }
+
+    return array_wrap(time_ns, count, sizeof *time_ns, "q", free);
+}
+
+static PyObject *Reader_satellites(ReaderObject *self, PyObject *unused)
+{
+    struct srnx_satellite_name *names = NULL;
+    uint64_t n_names = 0, ii;
+    PyObject *list;
+    int res;
+
+    (void)unused;
+    if (reader_acquire(self))
+    {
+        return NULL;
+    }
+    res = srnx_get_satellites(self->srnx, &names, &n_names);
+    if (reader_release(self, res))
+    {
+        srnx_free(names);
+        return NULL;
+    }
+
+    list = PyList_New(n_names);
+    for (ii = 0; list && ii < n_names; ++ii)
+    {
+        PyObject *str = PyUnicode_FromStringAndSize(names[ii].name,
+            strnlen(names[ii].name, 3));
+        if (!str)
+        {
+            Py_CLEAR(list);
+            break;
+        }
+        PyList_SET_ITEM(list, ii, str);
+    }
+    srnx_free(names);
+
+    return list;
+}
+
+static PyObject *Reader_codes(ReaderObject *self, PyObject *args)
+{
+    const struct srnx_obs_code *code;
+    PyObject *list;
+    int n_codes, ii, res;
+    char system;
+
+    if (!PyArg_ParseTuple(args, "C", &ii))
+    {
+        return NULL;
+    }
+    system = ii;
+    if (reader_acquire(self))
+    {
+        return NULL;
+    }
+    res = srnx_get_obs_codes(self->srnx, system, &code, &n_codes);
+    list = res ? NULL : PyList_New(n_codes);
+    for (ii = 0; list && ii < n_codes; ++ii)
+    {
+        PyObject *str = PyUnicode_FromStringAndSize(code[ii].name,
+            strnlen(code[ii].name, 3));
+        if (!str)
+        {
+            Py_CLEAR(list);
+            break;
+        }
+        PyList_SET_ITEM(list, ii, str);
+    }
+    reader_release(self, res);
+
+    return list;
+}
+
+/** Wraps one decoded signal as a (values, lli, ssi) tuple. */
+static PyObject *wrap_signal(int n_values, int64_t *obs, char *lli,
+    char *ssi)
+{
+    PyObject *values, *lli_arr, *ssi_arr;
+
+    values = array_wrap(obs, n_values, sizeof *obs, "q", srnx_free);
+    lli_arr = array_wrap(lli, n_values, 1, "c", srnx_free);
+    ssi_arr = array_wrap(ssi, n_values, 1, "c", srnx_free);
+    if (!values || !lli_arr || !ssi_arr)
+    {
+        Py_XDECREF(values);
+        Py_XDECREF(lli_arr);
+        Py_XDECREF(ssi_arr);
+        return NULL;
+    }
+
+    return Py_BuildValue("(NNN)", values, lli_arr, ssi_arr);
+}
+
+static PyObject *Reader_obs(ReaderObject *self, PyObject *args)
+{
+    struct srnx_satellite_name name;
+    int64_t *obs = NULL;
+    char *lli = NULL, *ssi = NULL;
+    int idx, n_values = 0, res;
+
+    if (!PyArg_ParseTuple(args, "O&i", sat_name_converter, &name, &idx))
+    {
+        return NULL;
+    }
+
+    if (reader_acquire(self))
+    {
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    res = srnx_get_obs_by_index(self->srnx, name, 1, &idx, &n_values,
+        &obs, &lli, &ssi);
+    Py_END_ALLOW_THREADS
+    if (reader_release(self, res))
+    {
+        srnx_free(obs);
+        srnx_free(lli);
+        srnx_free(ssi);
+        return NULL;
+    }
+
+    return wrap_signal(n_values, obs, lli, ssi);
+}
+
+static PyMethodDef Reader_methods[] = {
+    { "close", (PyCFunction)Reader_close, METH_NOARGS,
+      "close()\n\nCloses the file." },
+    { "__enter__", (PyCFunction)Reader_enter, METH_NOARGS, NULL },
+    { "__exit__", (PyCFunction)Reader_exit, METH_VARARGS, NULL },
+    { "header", (PyCFunction)Reader_header, METH_NOARGS,
+      "header() -> bytes\n\nReturns the RINEX header." },
+    { "epochs", (PyCFunction)Reader_epochs, METH_NOARGS,
+      "epochs() -> Array\n\n"
+      "Returns every epoch as a struct rinex_epoch record." },
+    { "epoch_times", (PyCFunction)Reader_epoch_times, METH_NOARGS,
+      "epoch_times() -> Array\n\n"
+      "Returns every epoch's time in nanoseconds since the start of\n"
+      "GPS time, as int64." },
+    { "satellites", (PyCFunction)Reader_satellites, METH_NOARGS,
+      "satellites() -> list of str\n\nReturns the satellite names." },
+    { "codes", (PyCFunction)Reader_codes, METH_VARARGS,
+      "codes(system) -> list of str\n\n"
+      "Returns the observation codes for a satellite system, such as 'G'." },
+    { "obs", (PyCFunction)Reader_obs, METH_VARARGS,
+      "obs(satellite, index) -> (values, lli, ssi)\n\n"
+      "Decodes one signal.  values holds int64 observations times 1000;\n"
+      "lli and ssi hold the indicator characters." },
+    { NULL, NULL, 0, NULL }
+};
+
+static PyTypeObject Reader_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "srnx.Reader",
+    .tp_basicsize = sizeof(ReaderObject),
+    .tp_dealloc = (destructor)Reader_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
+    .tp_doc = "Reader(filename, pread=False)\n\n"
+        "Opens an SRNX file, with mmap() or (if pread is true) pread().",
+    .tp_methods = Reader_methods,
+    .tp_init = (initproc)Reader_init,
+    .tp_new = Reader_new,
+};
+
+/* RINEX parser */
+
+/** RinexParser wraps a rinex_parser and its stream. */
+typedef struct
+{
+    PyObject_HEAD
+
+    /** Input stream, or NULL before __init__ succeeds. */
+    struct rinex_stream *stream;
+
+    /** Parser reading #stream. */
+    struct rinex_parser *parser;
+
+    /** Copy of the file header. */
+    PyObject *header;
+
+    /** Serializes calls into #parser. */
+    PyThread_type_lock lock;
+
+    /** Set once the parser reports end of file. */
+    int eof;
+} RinexParserObject;
+
+/** Columns accumulated by RinexParser.read(). */
+struct batch
+{
+    struct rinex_epoch *epoch;
+    int32_t *record;
+    char (*sat)[4];
+    int16_t *code;
+    int64_t *value;
+    char *lli;
+    char *ssi;
+    size_t n_epochs;
+    size_t n_values;
+    size_t values_alloc;
+};
+
+/** Makes room for \a count more values in \a b. */
+static int batch_reserve(struct batch *b, size_t count)
+{
+    size_t n;
+    void *p;
+
+    if (b->n_values + count <= b->values_alloc)
+    {
+        return 0;
+    }
+    n = b->values_alloc ? b->values_alloc : 4096;
+    while (n < b->n_values + count)
+    {
+        n *= 2;
+    }
+
+#define GROW(FIELD) do { \
+        p = realloc(b->FIELD, n * sizeof b->FIELD[0]); \
+        if (!p) return ENOMEM; \
+        b->FIELD = p; \
+    } while (0)
+    GROW(record);
+    GROW(sat);
+    GROW(code);
+    GROW(value);
+    GROW(lli);
+    GROW(ssi);
+#undef GROW
+    b->values_alloc = n;
+
+    return 0;
+}
+
+/** Appends the observations in \a p's current record to \a b. */
+static int batch_add_record(struct batch *b, const struct rinex_parser *p)
+{
+    const unsigned char *buf = (const unsigned char *)p->buffer;
+    size_t n_bytes, obs_idx = 0;
+    int ii, jj, n_obs;
+    char sys;
+
+    b->epoch[b->n_epochs] = p->epoch;
+    if (p->epoch.flag != '0' && p->epoch.flag != '1' && p->epoch.flag != '6')
+    {
+        goto done;
+    }
+
+    for (ii = 0; ii < p->epoch.n_sats; ++ii)
+    {
+        sys = buf[0];
+        n_obs = p->n_obs[sys & 31];
+        n_bytes = (n_obs + 7) / 8;
+        if (batch_reserve(b, n_obs))
+        {
+            return ENOMEM;
+        }
+        for (jj = 0; jj < n_obs; ++jj)
+        {
+            size_t kk;
+
+            if (!(buf[2 + jj / 8] & (1 << (jj % 8))))
+            {
+                continue;
+            }
+            kk = b->n_values++;
+            b->record[kk] = b->n_epochs;
+            b->sat[kk][0] = sys;
+            b->sat[kk][1] = '0' + buf[1] / 10;
+            b->sat[kk][2] = '0' + buf[1] % 10;
+            b->sat[kk][3] = '\0';
+            b->code[kk] = jj;
+            b->value[kk] = p->obs[obs_idx];
+            b->lli[kk] = p->lli[obs_idx];
+            b->ssi[kk] = p->ssi[obs_idx];
+            ++obs_idx;
+        }
+        buf += 2 + n_bytes;
+    }
+
+done:
+    b->n_epochs++;
+    return 0;
+}
+
+static void batch_free(struct batch *b)
+{
+    free(b->epoch);
+    free(b->record);
+    free(b->sat);
+    free(b->code);
+    free(b->value);
+    free(b->lli);
+    free(b->ssi);
+}
+
+/** Locks \a self without holding the GIL. */
+static void parser_lock(RinexParserObject *self)
+{
+    if (!PyThread_acquire_lock(self->lock, NOWAIT_LOCK))
+    {
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(self->lock, WAIT_LOCK);
+        Py_END_ALLOW_THREADS
+    }
+}
+
+/** Releases \a self's parser and stream. */
+static void parser_close(RinexParserObject *self)
+{
+    if (self->parser)
+    {
+        self->parser->destroy(self->parser);
+        self->parser = NULL;
+    }
+    if (self->stream)
+    {
+        self->stream->destroy(self->stream);
+        self->stream = NULL;
+    }
+}
+
+static PyObject *RinexParser_new(PyTypeObject *type, PyObject *args,
+    PyObject *kwds)
+{
+    RinexParserObject *self;
+
+    (void)args;
+    (void)kwds;
+    self = (RinexParserObject *)type->tp_alloc(type, 0);
+    if (!self)
+    {
+        return NULL;
+    }
+    self->lock = PyThread_allocate_lock();
+    if (!self->lock)
+    {
+        Py_DECREF(self);
+        return PyErr_NoMemory();
+    }
+
+    return (PyObject *)self;
+}
+
+static int RinexParser_init(RinexParserObject *self, PyObject *args,
+    PyObject *kwds)
+{
+    static char *kwlist[] = { "filename", NULL };
+    struct rinex_parser *parser = NULL;
+    struct rinex_stream *stream;
+    const char *err = NULL;
+    PyObject *filename, *header;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&", kwlist,
+        PyUnicode_FSConverter, &filename))
+    {
+        return -1;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    stream = rinex_mmap_stream(PyBytes_AS_STRING(filename));
+    if (stream)
+    {
+        err = rinex_open(&parser, stream);
+    }
+    Py_END_ALLOW_THREADS
+    if (!stream)
+    {
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, filename);
+        Py_DECREF(filename);
+        return -1;
+    }
+    if (err)
+    {
+        PyErr_Format(srnx_py_error, "%s: %s", PyBytes_AS_STRING(filename),
+            err);
+        if (parser)
+        {
+            parser->destroy(parser);
+        }
+        stream->destroy(stream);
+        Py_DECREF(filename);
+        return -1;
+    }
+    Py_DECREF(filename);
+
+    header = PyBytes_FromStringAndSize(parser->buffer, parser->buffer_len);
+    if (!header)
+    {
+        parser->destroy(parser);
+        stream->destroy(stream);
+        return -1;
+    }
+
+    parser_lock(self);
+    parser_close(self);
+    self->stream = stream;
+    self->parser = parser;
+    self->eof = 0;
+    Py_XSETREF(self->header, header);
+    PyThread_release_lock(self->lock);
+
+    return 0;
+}
+
+static void RinexParser_dealloc(RinexParserObject *self)
+{
+    parser_close(self);
+    Py_XDECREF(self->header);
+    if (self->lock)
+    {
+        PyThread_free_lock(self->lock);
+    }
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *RinexParser_close(RinexParserObject *self, PyObject *unused)
+{
+    (void)unused;
+    parser_lock(self);
+    parser_close(self);
+    PyThread_release_lock(self->lock);
+    Py_RETURN_NONE;
+}
+
+static PyObject *RinexParser_exit(RinexParserObject *self, PyObject *args)
+{
+    (void)args;
+    return RinexParser_close(self, NULL);
+}
+
+static PyObject *RinexParser_get_header(RinexParserObject *self,
+    void *closure)
+{
+    (void)closure;
+    if (!self->header)
+    {
+        Py_RETURN_NONE;
+    }
+    return Py_NewRef(self->header);
+}
+
+static PyObject *RinexParser_read(RinexParserObject *self, PyObject *args,
+    PyObject *kwds)
+{
+    static char *kwlist[] = { "max_records", NULL };
+    struct batch b;
+    rinex_error_t res = RINEX_SUCCESS;
+    Py_ssize_t max_records = 65536;
+    PyObject *result;
+    int err = 0, error_line = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|n", kwlist, &max_records))
+    {
+        return NULL;
+    }
+    if (max_records < 1 || max_records > INT32_MAX)
+    {
+        PyErr_SetString(PyExc_ValueError, "max_records is out of range");
+        return NULL;
+    }
+
+    memset(&b, 0, sizeof b);
+    parser_lock(self);
+    if (!self->parser)
+    {
+        PyThread_release_lock(self->lock);
+        PyErr_SetString(PyExc_ValueError, "I/O operation on closed file");
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    b.epoch = malloc(max_records * sizeof b.epoch[0]);
+    if (!b.epoch || batch_reserve(&b, 1))
+    {
+        err = ENOMEM;
+    }
+    while (!err && !self->eof && b.n_epochs < (size_t)max_records)
+    {
+        res = self->parser->read(self->parser);
+        if (res == RINEX_EOF)
+        {
+            self->eof = 1;
+            break;
+        }
+        if (res != RINEX_SUCCESS)
+        {
+            err = (res == RINEX_ERR_SYSTEM) ? errno : EINVAL;
+            error_line = self->parser->error_line;
+            break;
+        }
+        err = batch_add_record(&b, self->parser);
+    }
+    Py_END_ALLOW_THREADS
+    PyThread_release_lock(self->lock);
+
+    if (err)
+    {
+        batch_free(&b);
+        if (res != RINEX_SUCCESS && res != RINEX_ERR_SYSTEM)
+        {
+            PyErr_Format(srnx_py_error,
+                "Invalid RINEX record (parser line %d)", error_line);
+            return NULL;
+        }
+        errno = err;
+        return PyErr_SetFromErrno(PyExc_OSError);
+    }
+
+    result = Py_BuildValue("{s:N,s:N,s:N,s:N,s:N,s:N,s:N}",
+        "epochs", array_wrap(b.epoch, b.n_epochs, sizeof b.epoch[0],
+            EPOCH_FORMAT, free),
+        "record", array_wrap(b.record, b.n_values, sizeof b.record[0],
+            "i", free),
+        "satellite", array_wrap(b.sat, b.n_values, sizeof b.sat[0],
+            "4s", free),
+        "code", array_wrap(b.code, b.n_values, sizeof b.code[0], "h", free),
+        "value", array_wrap(b.value, b.n_values, sizeof b.value[0],
+            "q", free),
+        "lli", array_wrap(b.lli, b.n_values, 1, "c", free),
+        "ssi", array_wrap(b.ssi, b.n_values, 1, "c", free));
+
+    return result;
+}
+
+static PyMethodDef RinexParser_methods[] = {
+    { "close", (PyCFunction)RinexParser_close, METH_NOARGS,
+      "close()\n\nCloses the file." },
+    { "__enter__", (PyCFunction)Reader_enter, METH_NOARGS, NULL },
+    { "__exit__", (PyCFunction)RinexParser_exit, METH_VARARGS, NULL },
+    { "read", (PyCFunction)(void (*)(void))RinexParser_read,
+      METH_VARARGS | METH_KEYWORDS,
+      "read(max_records=65536) -> dict of Array\n\n"
+      "Parses up to max_records records.  The result has one row per\n"
+      "record in 'epochs' (struct rinex_epoch), and one row per\n"
+      "observation in 'record' (row in 'epochs'), 'satellite' (such as\n"
+      "b'G01'), 'code' (index into the header's observation types),\n"
+      "'value' (times 1000), 'lli' and 'ssi'.  At end of file, 'epochs'\n"
+      "is empty." },
+    { NULL, NULL, 0, NULL }
+};
+
+static PyGetSetDef RinexParser_getset[] = {
+    { "header", (getter)RinexParser_get_header, NULL,
+      "The file header, as bytes.", NULL },
+    { NULL, NULL, NULL, NULL, NULL }
+};
+
+static PyTypeObject RinexParser_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "srnx.RinexParser",
+    .tp_basicsize = sizeof(RinexParserObject),
+    .tp_dealloc = (destructor)RinexParser_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
+    .tp_doc = "RinexParser(filename)\n\n"
+        "Opens a RINEX observation file and reads its header.",
+    .tp_methods = RinexParser_methods,
+    .tp_getset = RinexParser_getset,
+    .tp_init = (initproc)RinexParser_init,
+    .tp_new = RinexParser_new,
+};
+
+/* Multi-file decoding */
+
+/** One file's work for read_files(). */
+struct file_job
+{
+    const char *filename;
+    int64_t *obs;
+    char *lli;
+    char *ssi;
+    int n_values;
+    int res;
+    int error_line;
+};
+
+/** State shared by read_files() worker threads. */
+struct file_jobs
+{
+    struct file_job *job;
+    size_t n_jobs;
+    struct srnx_numa_queue *queue;
+    int n_workers;
+    pthread_mutex_t mutex;
+    struct srnx_satellite_name name;
+    int idx;
+    int use_pread;
+};
+
+static void *read_files_thread(void *arg)
+{
+    struct file_jobs *jobs = arg;
+    struct srnx_reader *srnx;
+    struct file_job *job;
+    int ii, node;
+
+    node = srnx_numa_current_node();
+    while ((ii = srnx_numa_queue_next(jobs->queue, node)) >= 0)
+    {
+        job = &jobs->job[ii];
+        srnx = NULL;
+        job->res = jobs->use_pread
+            ? srnx_open_pread(&srnx, job->filename)
+            : srnx_open(&srnx, job->filename);
+        if (!job->res)
+        {
+            job->res = srnx_get_obs_by_index(srnx, jobs->name, 1, &jobs->idx,
+                &job->n_values, &job->obs, &job->lli, &job->ssi);
+        }
+        job->error_line = srnx ? srnx_error_line(srnx) : 0;
+        srnx_close(srnx);
+    }
+
+    return NULL;
+}
+
+/** Places a thread that read_files() started, then decodes files. */
+static void *read_files_worker(void *arg)
+{
+    struct file_jobs *jobs = arg;
+    int worker;
+
+    pthread_mutex_lock(&jobs->mutex);
+    worker = jobs->n_workers++;
+    pthread_mutex_unlock(&jobs->mutex);
+    srnx_numa_bind_worker(worker);
+
+    return read_files_thread(arg);
+}
+
+static PyObject *srnx_py_read_files(PyObject *module, PyObject *args,
+    PyObject *kwds)
+{
+    static char *kwlist[] = { "filenames", "satellite", "index", "threads",
+        "pread", NULL };
+    struct file_jobs jobs;
+    pthread_t *tid = NULL;
+    int *node;
+    PyObject *seq, *names, *result = NULL;
+    Py_ssize_t ii, n_threads = 0, started = 0;
+    int use_pread = 0;
+
+    (void)module;
+    memset(&jobs, 0, sizeof jobs);
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO&i|np", kwlist, &seq,
+        sat_name_converter, &jobs.name, &jobs.idx, &n_threads, &use_pread))
+    {
+        return NULL;
+    }
+    jobs.use_pread = use_pread;
+
+    seq = PySequence_Fast(seq, "filenames must be a sequence");
+    if (!seq)
+    {
+        return NULL;
+    }
+    jobs.n_jobs = PySequence_Fast_GET_SIZE(seq);
+    names = PyList_New(jobs.n_jobs);
+    jobs.job = PyMem_Calloc(jobs.n_jobs ? jobs.n_jobs : 1, sizeof jobs.job[0]);
+    if (!names || !jobs.job)
+    {
+        PyErr_NoMemory();
+        goto out;
+    }
+    for (ii = 0; ii < (Py_ssize_t)jobs.n_jobs; ++ii)
+    {
+        PyObject *fn;
+        if (!PyUnicode_FSConverter(PySequence_Fast_GET_ITEM(seq, ii), &fn))
+        {
+            goto out;
+        }
+        PyList_SET_ITEM(names, ii, fn);
+        jobs.job[ii].filename = PyBytes_AS_STRING(fn);
+    }
+
+    if (n_threads <= 0)
+    {
+        n_threads = 4;
+    }
+    if (n_threads > (Py_ssize_t)jobs.n_jobs)
+    {
+        n_threads = jobs.n_jobs;
+    }
+    tid = PyMem_Calloc(n_threads ? n_threads : 1, sizeof tid[0]);
+    if (!tid)
+    {
+        PyErr_NoMemory();
+        goto out;
+    }
+
+    /* Decode each file on the node that caches it, if that is known. */
+    node = NULL;
+    if (n_threads > 1 && srnx_numa_node_count() > 1)
+    {
+        node = PyMem_Calloc(jobs.n_jobs, sizeof node[0]);
+        for (ii = 0; node && ii < (Py_ssize_t)jobs.n_jobs; ++ii)
+        {
+            node[ii] = srnx_numa_file_node(jobs.job[ii].filename);
+        }
+    }
+    if (srnx_numa_queue_create(&jobs.queue, jobs.n_jobs, node))
+    {
+        PyMem_Free(node);
+        PyErr_NoMemory();
+        goto out;
+    }
+    PyMem_Free(node);
+
+    Py_BEGIN_ALLOW_THREADS
+    pthread_mutex_init(&jobs.mutex, NULL);
+    for (started = 0; started < n_threads; ++started)
+    {
+        if (pthread_create(&tid[started], NULL, read_files_worker, &jobs))
+        {
+            break;
+        }
+    }
+    if (started == 0)
+    {
+        read_files_thread(&jobs);
+    }
+    for (ii = 0; ii < started; ++ii)
+    {
+        pthread_join(tid[ii], NULL);
+    }
+    pthread_mutex_destroy(&jobs.mutex);
+    Py_END_ALLOW_THREADS
+    srnx_numa_queue_free(jobs.queue);
+
+    for (ii = 0; ii < (Py_ssize_t)jobs.n_jobs; ++ii)
+    {
+        if (jobs.job[ii].res)
+        {
+            srnx_py_raise(jobs.job[ii].res, jobs.job[ii].error_line,
+                jobs.job[ii].filename);
+            goto out;
+        }
+    }
+
+    result = PyList_New(jobs.n_jobs);
+    for (ii = 0; result && ii < (Py_ssize_t)jobs.n_jobs; ++ii)
+    {
+        struct file_job *job = &jobs.job[ii];
+        PyObject *item = wrap_signal(job->n_values, job->obs, job->lli,
+            job->ssi);
+        job->obs = NULL;
+        job->lli = job->ssi = NULL;
+        if (!item)
+        {
+            Py_CLEAR(result);
+            break;
+        }
+        PyList_SET_ITEM(result, ii, item);
+    }
+
+out:
+    for (ii = 0; jobs.job && ii < (Py_ssize_t)jobs.n_jobs; ++ii)
+    {
+        srnx_free(jobs.job[ii].obs);
+        srnx_free(jobs.job[ii].lli);
+        srnx_free(jobs.job[ii].ssi);
+    }
+    PyMem_Free(tid);
+    PyMem_Free(jobs.job);
+    Py_XDECREF(names);
+    Py_DECREF(seq);
+
+    return result;
+}
+
+/* Module */
+
+static PyMethodDef srnx_py_methods[] = {
+    { "read_files", (PyCFunction)(void (*)(void))srnx_py_read_files,
+      METH_VARARGS | METH_KEYWORDS,
+      "read_files(filenames, satellite, index, threads=4, pread=False)\n"
+      "    -> list of (values, lli, ssi)\n\n"
+      "Decodes the same signal from several SRNX files, using up to\n"
+      "threads threads, without holding the GIL." },
+    { NULL, NULL, 0, NULL }
+};
+
+static struct PyModuleDef srnx_py_module = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "srnx",
+    .m_doc = "Reads Succinct RINEX (SRNX) and RINEX observation files.",
+    .m_size = -1,
+    .m_methods = srnx_py_methods,
+};
+
+PyMODINIT_FUNC PyInit_srnx(void)
+{
+    PyObject *m;
+
+    if (PyType_Ready(&Array_Type) < 0
+        || PyType_Ready(&Reader_Type) < 0
+        || PyType_Ready(&RinexParser_Type) < 0)
+    {
+        return NULL;
+    }
+
+    m = PyModule_Create(&srnx_py_module);
+    if (!m)
+    {
+        return NULL;
+    }
+
+    srnx_py_error = PyErr_NewExceptionWithDoc("srnx.Error",
+        "Raised when an SRNX or RINEX file is invalid.", PyExc_ValueError,
+        NULL);
+    if (PyModule_AddObjectRef(m, "Error", srnx_py_error) < 0
+        || PyModule_AddObjectRef(m, "Array", (PyObject *)&Array_Type) < 0
+        || PyModule_AddObjectRef(m, "Reader", (PyObject *)&Reader_Type) < 0
+        || PyModule_AddObjectRef(m, "RinexParser",
+            (PyObject *)&RinexParser_Type) < 0
+        || PyModule_AddStringConstant(m, "EPOCH_FORMAT", EPOCH_FORMAT) < 0)
+    {
+        Py_DECREF(m);
+        return NULL;
+    }
+
+    return m;
+}
@@ -34,6 +34,8 @@
 
 void (*transpose)(int64_t *out, const char *in, int bits, int count);
 
+void (*transpose_kernel[96])(int64_t *out, const char *in, int bits, int count);
+
 static void transpose_init(void) __attribute__((constructor));
 
 static void transpose_generic(int64_t *out, const char *in, int bits, int count)
@@ -1128,6 +1130,328 @@ void transpose_avx2(int64_t *out, const char *in, int bits, int count)
     }
 }
 
+static void transpose_gfni(int64_t *out, const char *in, int bits, int count)
+    __attribute__((target("gfni,avx2")));
+
+/* Byte order to gather each byte lane's eight rows into one 64-bit
+ * word.  The first sixteen are for 16-by-8 blocks, the second sixteen
+ * are for (half of) 32-by-8 blocks.
+ */
+static const char gfni_gather[32] __attribute__((aligned(16))) = {
+    0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15,
+    0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15
+};
+
+/* Loading from gfni_valid + 64 - n gives a mask of n leading bytes. */
+static const char gfni_valid[128] __attribute__((aligned(32))) = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+/* Combines the column bytes from \a groups 8-row groups in \a r and
+ * writes \a n sign-extended values to \a out.
+ *
+ * \a r[g] holds the bits from rows 8*g through 8*g+7 (MSB first) of
+ * column \a k in byte \a k.  The rows after the real \a bits rows are
+ * zero, so an arithmetic right shift by \a shift sign-extends them.
+ */
+static inline void gfni_store_16(int64_t *out, const __m128i r[4],
+    int groups, int shift, int n)
+    __attribute__((always_inline, target("gfni,avx2")));
+static inline void gfni_store_16(int64_t *out, const __m128i r[4],
+    int groups, int shift, int n)
+{
+    const __m128i v_shift = _mm_cvtsi32_si128(shift);
+    __m128i w0, w1, w2, w3;
+
+    if (groups == 1)
+    {
+        w0 = _mm_sra_epi16(_mm_cvtepi8_epi16(r[0]), v_shift);
+        _mm256_storeu_si256((__m256i *)out, _mm256_cvtepi16_epi64(w0));
+        _mm256_storeu_si256((__m256i *)(out + 4),
+            _mm256_cvtepi16_epi64(_mm_srli_si128(w0, 8)));
+        if (n > 8)
+        {
+            w1 = _mm_sra_epi16(_mm_cvtepi8_epi16(_mm_srli_si128(r[0], 8)), v_shift);
+            _mm256_storeu_si256((__m256i *)(out + 8), _mm256_cvtepi16_epi64(w1));
+            _mm256_storeu_si256((__m256i *)(out + 12),
+                _mm256_cvtepi16_epi64(_mm_srli_si128(w1, 8)));
+        }
+    }
+    else if (groups == 2)
+    {
+        w0 = _mm_sra_epi16(_mm_unpacklo_epi8(r[1], r[0]), v_shift);
+        _mm256_storeu_si256((__m256i *)out, _mm256_cvtepi16_epi64(w0));
+        _mm256_storeu_si256((__m256i *)(out + 4),
+            _mm256_cvtepi16_epi64(_mm_srli_si128(w0, 8)));
+        if (n > 8)
+        {
+            w1 = _mm_sra_epi16(_mm_unpackhi_epi8(r[1], r[0]), v_shift);
+            _mm256_storeu_si256((__m256i *)(out + 8), _mm256_cvtepi16_epi64(w1));
+            _mm256_storeu_si256((__m256i *)(out + 12),
+                _mm256_cvtepi16_epi64(_mm_srli_si128(w1, 8)));
+        }
+    }
+    else /* groups == 4 */
+    {
+        w0 = _mm_unpacklo_epi8(r[1], r[0]);
+        w2 = _mm_unpacklo_epi8(r[3], r[2]);
+        w1 = _mm_sra_epi32(_mm_unpacklo_epi16(w2, w0), v_shift);
+        w3 = _mm_sra_epi32(_mm_unpackhi_epi16(w2, w0), v_shift);
+        _mm256_storeu_si256((__m256i *)out, _mm256_cvtepi32_epi64(w1));
+        _mm256_storeu_si256((__m256i *)(out + 4), _mm256_cvtepi32_epi64(w3));
+        if (n > 8)
+        {
+            w0 = _mm_unpackhi_epi8(r[1], r[0]);
+            w2 = _mm_unpackhi_epi8(r[3], r[2]);
+            w1 = _mm_sra_epi32(_mm_unpacklo_epi16(w2, w0), v_shift);
+            w3 = _mm_sra_epi32(_mm_unpackhi_epi16(w2, w0), v_shift);
+            _mm256_storeu_si256((__m256i *)(out + 8), _mm256_cvtepi32_epi64(w1));
+            _mm256_storeu_si256((__m256i *)(out + 12), _mm256_cvtepi32_epi64(w3));
+        }
+    }
+}
+
+/* Transposes with GF2P8AFFINEQB, which transposes an 8x8 bit matrix
+ * in each 64-bit word when the matrix is the second operand and the
+ * first operand selects one bit per output byte.
+ *
+ * The input is treated as 8, 16 or 32 rows, with the rows past \a bits
+ * masked to zero; each group of 8 rows is transposed, and the zero rows
+ * are shifted out with an arithmetic right shift to sign-extend the
+ * outputs.  Like transpose_avx2(), this reads past the end of \a in
+ * (by up to 60 bytes), relying on RINEX_EXTRA padding.
+ */
+void transpose_gfni(int64_t *out, const char *in, int bits, int count)
+{
+    const __m128i v_sel = _mm_set1_epi64x(0x0102040810204080);
+    __m128i r_lo[4], r_hi[4];
+    int groups, shift, width, gg, n_valid;
+
+    if (bits < 1)
+    {
+        return;
+    }
+
+    groups = (bits <= 8) ? 1 : (bits <= 16) ? 2 : 4;
+    shift = 8 * groups - bits;
+    width = count >> 3;
+
+    if (count == 8)
+    {
+        /* All the groups fit in one AVX2 register. */
+        const __m256i mask = _mm256_loadu_si256(
+            (const __m256i *)(gfni_valid + 64 - bits));
+        const __m256i x = _mm256_and_si256(mask,
+            _mm256_loadu_si256((const __m256i *)in));
+        const __m256i y = _mm256_gf2p8affine_epi64_epi8(
+            _mm256_broadcastsi128_si256(v_sel), x, 0);
+        r_lo[0] = _mm256_castsi256_si128(y);
+        r_lo[1] = _mm_srli_si128(r_lo[0], 8);
+        r_lo[2] = _mm256_extracti128_si256(y, 1);
+        r_lo[3] = _mm_srli_si128(r_lo[2], 8);
+        gfni_store_16(out, r_lo, groups, shift, 8);
+        return;
+    }
+
+    for (gg = 0; gg < groups; ++gg)
+    {
+        const char *rows = in + 8 * width * gg;
+
+        n_valid = (bits - 8 * gg) * width;
+        if (n_valid > 64)
+        {
+            n_valid = 64;
+        }
+
+        if (count == 16)
+        {
+            __m128i x = _mm_and_si128(
+                _mm_loadu_si128((const __m128i *)(gfni_valid + 64 - n_valid)),
+                _mm_loadu_si128((const __m128i *)rows));
+            x = _mm_shuffle_epi8(x, _mm_load_si128((const __m128i *)gfni_gather));
+            r_lo[gg] = _mm_gf2p8affine_epi64_epi8(v_sel, x, 0);
+        }
+        else /* count == 32 */
+        {
+            const __m128i perm = _mm_load_si128((const __m128i *)(gfni_gather + 16));
+            const __m256i mask = _mm256_loadu_si256(
+                (const __m256i *)(gfni_valid + 64 - n_valid));
+            const __m256i v = _mm256_shuffle_epi8(_mm256_and_si256(mask,
+                _mm256_loadu_si256((const __m256i *)rows)),
+                _mm256_broadcastsi128_si256(perm));
+            const __m128i x = _mm256_castsi256_si128(v);
+            const __m128i y = _mm256_extracti128_si256(v, 1);
+            r_lo[gg] = _mm_gf2p8affine_epi64_epi8(v_sel, _mm_unpacklo_epi32(x, y), 0);
+            r_hi[gg] = _mm_gf2p8affine_epi64_epi8(v_sel, _mm_unpackhi_epi32(x, y), 0);
+        }
+    }
+
+    gfni_store_16(out, r_lo, groups, shift, 16);
+    if (count == 32)
+    {
+        gfni_store_16(out + 16, r_hi, groups, shift, 16);
+    }
+}
+
+static void transpose_avx512(int64_t *out, const char *in, int bits, int count)
+    __attribute__((target("avx512f,avx512bw,avx512vbmi,gfni,bmi2")));
+
+/* avx512_row[n] is row 8*(q%4) + (n%8) of the zero-extended 32-row
+ * matrix, where q = n/8 is the 64-bit word that gathers it;
+ * avx512_lane[n] is the byte lane (q/4) within each row.
+ */
+static const char avx512_row[64] __attribute__((aligned(64))) = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+    16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31,
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+    16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31
+};
+
+static const char avx512_lane[64] __attribute__((aligned(64))) = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1
+};
+
+/* Collects the transposed bytes of 16 columns into 32-bit values. */
+static const char avx512_collect[64] __attribute__((aligned(64))) = {
+    24, 16, 8, 0, 25, 17, 9, 1, 26, 18, 10, 2, 27, 19, 11, 3,
+    28, 20, 12, 4, 29, 21, 13, 5, 30, 22, 14, 6, 31, 23, 15, 7,
+    56, 48, 40, 32, 57, 49, 41, 33, 58, 50, 42, 34, 59, 51, 43, 35,
+    60, 52, 44, 36, 61, 53, 45, 37, 62, 54, 46, 38, 63, 55, 47, 39
+};
+
+/* Transposes using VPERMB to gather all eight rows of each 8x8 block
+ * into a 64-bit word, GF2P8AFFINEQB to transpose the blocks, and VPERMB
+ * again to collect each column's bytes into a 32-bit value.
+ *
+ * The gather treats the input as 32 rows, repeating row 0 (the sign
+ * bits) in place of the missing 32 - \a bits rows, so the 32-bit values
+ * are already sign-extended.  Masked loads mean this never reads past
+ * the end of the matrix.
+ */
+void transpose_avx512(int64_t *out, const char *in, int bits, int count)
+{
+    const __m512i v_sel = _mm512_set1_epi64(0x0102040810204080);
+    const __m512i v_collect = _mm512_load_si512(avx512_collect);
+    const int n_bytes = bits * (count >> 3);
+    __m512i row, idx, v, lo, hi;
+
+    if (bits < 1)
+    {
+        return;
+    }
+
+    /* Which input row does each byte come from? */
+    row = _mm512_max_epi8(_mm512_setzero_si512(),
+        _mm512_add_epi8(_mm512_load_si512(avx512_row),
+            _mm512_set1_epi8(bits - 32)));
+
+    if (count == 8)
+    {
+        v = _mm512_maskz_loadu_epi8(_bzhi_u64(~0ULL, n_bytes), in);
+        v = _mm512_permutexvar_epi8(row, v);
+        v = _mm512_gf2p8affine_epi64_epi8(v_sel, v, 0);
+        v = _mm512_permutexvar_epi8(v_collect, v);
+        _mm512_storeu_si512(out, _mm512_cvtepi32_epi64(_mm512_castsi512_si256(v)));
+    }
+    else if (count == 16)
+    {
+        idx = _mm512_add_epi8(_mm512_add_epi8(row, row),
+            _mm512_load_si512(avx512_lane));
+        v = _mm512_maskz_loadu_epi8(_bzhi_u64(~0ULL, n_bytes), in);
+        v = _mm512_permutexvar_epi8(idx, v);
+        v = _mm512_gf2p8affine_epi64_epi8(v_sel, v, 0);
+        v = _mm512_permutexvar_epi8(v_collect, v);
+        _mm512_storeu_si512(out, _mm512_cvtepi32_epi64(_mm512_castsi512_si256(v)));
+        _mm512_storeu_si512(out + 8, _mm512_cvtepi32_epi64(
+            _mm512_extracti64x4_epi64(v, 1)));
+    }
+    else /* count == 32 */
+    {
+        /* row < 32, so shifting 16-bit lanes cannot carry between bytes. */
+        idx = _mm512_add_epi8(_mm512_slli_epi16(row, 2),
+            _mm512_load_si512(avx512_lane));
+        lo = _mm512_maskz_loadu_epi8(_bzhi_u64(~0ULL, n_bytes), in);
+        hi = _mm512_maskz_loadu_epi8(
+            _bzhi_u64(~0ULL, (n_bytes > 64) ? n_bytes - 64 : 0), in + 64);
+
+        v = _mm512_permutex2var_epi8(lo, idx, hi);
+        v = _mm512_gf2p8affine_epi64_epi8(v_sel, v, 0);
+        v = _mm512_permutexvar_epi8(v_collect, v);
+        _mm512_storeu_si512(out, _mm512_cvtepi32_epi64(_mm512_castsi512_si256(v)));
+        _mm512_storeu_si512(out + 8, _mm512_cvtepi32_epi64(
+            _mm512_extracti64x4_epi64(v, 1)));
+
+        idx = _mm512_add_epi8(idx, _mm512_set1_epi8(2));
+        v = _mm512_permutex2var_epi8(lo, idx, hi);
+        v = _mm512_gf2p8affine_epi64_epi8(v_sel, v, 0);
+        v = _mm512_permutexvar_epi8(v_collect, v);
+        _mm512_storeu_si512(out + 16, _mm512_cvtepi32_epi64(_mm512_castsi512_si256(v)));
+        _mm512_storeu_si512(out + 24, _mm512_cvtepi32_epi64(
+            _mm512_extracti64x4_epi64(v, 1)));
+    }
+}
+
+#endif
+
+/* Specialized kernels: each wrapper below fixes (count, bits) so that
+ * the flattened implementation is compiled without runtime branches on
+ * either.  Only the narrower widths that dominate delta-coded data are
+ * specialized; other table entries use the general kernel.
+ */
+
+#define TRANSPOSE_ATTR_transpose_generic
+#define TRANSPOSE_ATTR_transpose_avx2 __attribute__((target("avx2")))
+#define TRANSPOSE_ATTR_transpose_gfni __attribute__((target("gfni,avx2")))
+
+#define TRANSPOSE_SPECIALIZE(IMPL, COUNT, BITS) \
+    static void IMPL##_##COUNT##x##BITS(int64_t *out, const char *in, \
+        int bits, int count) __attribute__((flatten)) TRANSPOSE_ATTR_##IMPL; \
+    void IMPL##_##COUNT##x##BITS(int64_t *out, const char *in, \
+        int bits, int count) \
+    { \
+        (void)bits; \
+        (void)count; \
+        IMPL(out, in, BITS, COUNT); \
+    }
+
+#define TRANSPOSE_ENTRY(IMPL, COUNT, BITS) IMPL##_##COUNT##x##BITS,
+
+#define TRANSPOSE_EACH_BITS(X, IMPL, COUNT) \
+    X(IMPL, COUNT, 1) X(IMPL, COUNT, 2) X(IMPL, COUNT, 3) X(IMPL, COUNT, 4) \
+    X(IMPL, COUNT, 5) X(IMPL, COUNT, 6) X(IMPL, COUNT, 7) X(IMPL, COUNT, 8) \
+    X(IMPL, COUNT, 9) X(IMPL, COUNT, 10) X(IMPL, COUNT, 11) \
+    X(IMPL, COUNT, 12) X(IMPL, COUNT, 13) X(IMPL, COUNT, 14) \
+    X(IMPL, COUNT, 15) X(IMPL, COUNT, 16) X(IMPL, COUNT, 17) \
+    X(IMPL, COUNT, 18) X(IMPL, COUNT, 19) X(IMPL, COUNT, 20)
+
+/* Twelve entries for bits 21 through 32. */
+#define TRANSPOSE_UNSPECIALIZED(IMPL) \
+    IMPL, IMPL, IMPL, IMPL, IMPL, IMPL, IMPL, IMPL, IMPL, IMPL, IMPL, IMPL,
+
+#define TRANSPOSE_KERNELS(IMPL) \
+    TRANSPOSE_EACH_BITS(TRANSPOSE_SPECIALIZE, IMPL, 8) \
+    TRANSPOSE_EACH_BITS(TRANSPOSE_SPECIALIZE, IMPL, 16) \
+    TRANSPOSE_EACH_BITS(TRANSPOSE_SPECIALIZE, IMPL, 32) \
+    static void (*const IMPL##_kernels[96])(int64_t *, const char *, int, int) = { \
+        TRANSPOSE_EACH_BITS(TRANSPOSE_ENTRY, IMPL, 8) \
+        TRANSPOSE_UNSPECIALIZED(IMPL) \
+        TRANSPOSE_EACH_BITS(TRANSPOSE_ENTRY, IMPL, 16) \
+        TRANSPOSE_UNSPECIALIZED(IMPL) \
+        TRANSPOSE_EACH_BITS(TRANSPOSE_ENTRY, IMPL, 32) \
+        TRANSPOSE_UNSPECIALIZED(IMPL) \
+    };
+
+TRANSPOSE_KERNELS(transpose_generic)
+
+#ifdef __x86_64__
+TRANSPOSE_KERNELS(transpose_avx2)
+TRANSPOSE_KERNELS(transpose_gfni)
 #endif
 
 /* ifunc-based resolvers are glibc-specific and cannot use getenv(). */
@@ -1137,19 +1461,66 @@ static void (*resolve_transpose(const char *version))(int64_t *, const char *, i
         return transpose_generic;
 
 #ifdef __x86_64__
-    if (__builtin_cpu_supports("avx2") || (version && !strcmp(version, "avx2")))
+    const int has_avx512 = __builtin_cpu_supports("avx512bw")
+        && __builtin_cpu_supports("avx512vbmi")
+        && __builtin_cpu_supports("gfni")
+        && __builtin_cpu_supports("bmi2");
+    const int has_gfni = __builtin_cpu_supports("gfni")
+        && __builtin_cpu_supports("avx2");
+
+    if (version)
+    {
+        if (!strcmp(version, "avx512"))
+            return has_avx512 ? transpose_avx512 : NULL;
+        if (!strcmp(version, "gfni"))
+            return has_gfni ? transpose_gfni : NULL;
+        if (!strcmp(version, "avx2"))
+            return __builtin_cpu_supports("avx2") ? transpose_avx2 : NULL;
+    }
+
+    /* Measured fastest first; see `transpose_test -bench`.  The
+     * AVX-512 kernel is only used when requested: on the Xeon it was
+     * measured on, it ran 2-3x slower than transpose_avx2() for n-by-8
+     * and n-by-16 blocks.
+     */
+    if (has_gfni)
+        return transpose_gfni;
+    if (__builtin_cpu_supports("avx2"))
         return transpose_avx2;
 #endif
 
     return transpose_generic;
 }
 
-void transpose_select(const char *version)
+int transpose_select(const char *version)
 {
-    transpose = resolve_transpose(version);
+    void (*impl)(int64_t *, const char *, int, int);
+    int ii;
+
+    impl = resolve_transpose(version);
+    if (!impl)
+        return -1;
+
+    transpose = impl;
+    for (ii = 0; ii < 96; ++ii)
+    {
+        transpose_kernel[ii] = impl;
+    }
+    if (impl == transpose_generic)
+        memcpy(transpose_kernel, transpose_generic_kernels, sizeof transpose_kernel);
+#ifdef __x86_64__
+    if (impl == transpose_avx2)
+        memcpy(transpose_kernel, transpose_avx2_kernels, sizeof transpose_kernel);
+    if (impl == transpose_gfni)
+        memcpy(transpose_kernel, transpose_gfni_kernels, sizeof transpose_kernel);
+#endif
+    return 0;
 }
 
 void transpose_init(void)
 {
-    transpose_select(getenv("TRANSPOSE_FORCE"));
+    if (transpose_select(getenv("TRANSPOSE_FORCE")))
+    {
+        transpose_select(NULL);
+    }
 }
@@ -30,13 +30,18 @@ extern "C" {
 #endif /* defined(__cplusplus) */
 
 /** Assigns #transpose to implementation \a version.
+ *
+ * On x86-64, the platform-specific implementations are "avx2",
+ * "gfni" (GFNI with AVX2) and "avx512" (GFNI with AVX-512BW and VBMI).
  *
  * \param[in] version Implementation selector: "generic" for a version
  *   that does not use processor-specific instructions, NULL for the
  *   version preferred on this processor, or a platform-specific string
  *   to select a particular implementation.
+ * \returns Zero on success, or -1 (leaving #transpose unchanged) if
+ *   \a version is not supported on this processor.
 */
-extern void transpose_select(const char *version);
+extern int transpose_select(const char *version);
 
 /** Pointer to function that will transpose a bit matrix, \a count bits
  * wide by \a bits tall, from \a in to \a out.  Each input column from
@@ -49,6 +54,14 @@ extern void transpose_select(const char *version);
  */
 extern void (*transpose)(int64_t *out, const char *in, int bits, int count);
 
+/** Transpose kernels from the implementation selected for #transpose,
+ * indexed by the SOCD block header byte: `8 << (ch >> 5)` columns and
+ * `(ch & 31) + 1` rows.  Common sizes use kernels specialized for
+ * their exact size, which ignore their \a bits and \a count arguments;
+ * callers should pass them anyway.
+ */
+extern void (*transpose_kernel[96])(int64_t *out, const char *in, int bits, int count);
+
 #if defined(__cplusplus)
 }
 #endif /* defined(__cplusplus) */
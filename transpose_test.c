@@ -72,14 +72,92 @@ static void test_transpose(void)
     }
 }
 
+static const char *versions[] = {
+    "generic",
+#ifdef __x86_64__
+    "avx2",
+    "gfni",
+    "avx512",
+#endif
+    NULL
+};
+
+/* Returns the #transpose_kernel index for a \a count by \a bits block. */
+static int kernel_index(int bits, int count)
+{
+    return ((count >> 4) << 5) + bits - 1;
+}
+
+/* Checks \a version against the generic implementation on random
+ * bit matrices of every supported size.  Returns the number of
+ * mismatched outputs.
+ */
+static int validate_transpose(const char *version)
+{
+    char input[128 + 64];
+    int64_t expect[32], actual[32];
+    int ii, jj, rep, bits, count, errors;
+
+    for (rep = errors = 0; rep < 1000; ++rep)
+    {
+        for (ii = 0; ii < (int)sizeof input; ++ii)
+        {
+            input[ii] = rand();
+        }
+
+        for (count = 8; count <= 32; count <<= 1)
+        {
+            for (bits = 1; bits < 33; ++bits)
+            {
+                transpose_select("generic");
+                transpose(expect, input, bits, count);
+                if (transpose_select(version))
+                {
+                    return 0;
+                }
+                memset(actual, 0x55, sizeof actual);
+                transpose(actual, input, bits, count);
+
+                for (jj = 0; jj < count; ++jj)
+                {
+                    if (actual[jj] != expect[jj] && errors++ < 10)
+                    {
+                        printf("%s %d-by-%d [%d]: %llx != %llx\n",
+                            version, count, bits, jj,
+                            (long long)actual[jj], (long long)expect[jj]);
+                    }
+                }
+
+                memset(actual, 0x55, sizeof actual);
+                transpose_kernel[kernel_index(bits, count)](actual, input, bits, count);
+
+                for (jj = 0; jj < count; ++jj)
+                {
+                    if (actual[jj] != expect[jj] && errors++ < 10)
+                    {
+                        printf("%s kernel %d-by-%d [%d]: %llx != %llx\n",
+                            version, count, bits, jj,
+                            (long long)actual[jj], (long long)expect[jj]);
+                    }
+                }
+            }
+        }
+    }
+
+    return errors;
+}
+
 static void benchmark_transpose(const char *version)
 {
     struct timespec t[33];
     unsigned long long nsec;
     const int n_reps = 1000000;
-    int ii, bits, count;
+    int ii, bits, count, pass;
 
-    transpose_select(version);
+    if (transpose_select(version))
+    {
+        return;
+    }
     if (!version) version = "default";
 
     /* Warm up the cache and hint that we are CPU-intensive. */
@@ -87,24 +165,31 @@ static void benchmark_transpose(const char *version)
     transpose(out, input_8, 32, 16);
     transpose(out, input_8, 32, 8);
 
-    for (count = 8; count <= 32; count <<= 1)
+    /* The second pass uses the size-specialized kernels. */
+    for (pass = 0; pass < 2; ++pass)
     {
-        printf("\n%s n-by-%d", version, count);
-        clock_gettime(CLOCK_MONOTONIC, &t[0]);
-        for (bits = 1; bits < 33; ++bits)
+        for (count = 8; count <= 32; count <<= 1)
         {
-            for (ii = 0; ii < n_reps; ++ii)
+            printf("\n%s%s n-by-%d", version, pass ? " kernel" : "", count);
+            clock_gettime(CLOCK_MONOTONIC, &t[0]);
+            for (bits = 1; bits < 33; ++bits)
             {
-                transpose(out, input_8, bits, count);
+                void (*impl)(int64_t *, const char *, int, int) = pass
+                    ? transpose_kernel[kernel_index(bits, count)] : transpose;
+
+                for (ii = 0; ii < n_reps; ++ii)
+                {
+                    impl(out, input_8, bits, count);
+                }
+                clock_gettime(CLOCK_MONOTONIC, &t[bits]);
             }
-            clock_gettime(CLOCK_MONOTONIC, &t[bits]);
-        }
 
-        for (ii = 0; ii + 1 < bits; ++ii)
-        {
-            nsec = (t[ii+1].tv_sec - t[ii].tv_sec) * 1000000000
-                + t[ii+1].tv_nsec - t[ii].tv_nsec;
-            printf(",%llu", nsec);
+            for (ii = 0; ii + 1 < bits; ++ii)
+            {
+                nsec = (t[ii+1].tv_sec - t[ii].tv_sec) * 1000000000
+                    + t[ii+1].tv_nsec - t[ii].tv_nsec;
+                printf(",%llu", nsec);
+            }
         }
     }
 }
@@ -134,6 +219,29 @@ int main(int argc, char *argv[])
         test_transpose();
     }
 
+    if (argc < 2 || (argc == 2 && !strcmp(argv[1], "-validate")))
+    {
+        int errors = 0;
+
+        for (ii = 0; versions[ii]; ++ii)
+        {
+            if (transpose_select(versions[ii]))
+            {
+                printf("%s: not supported\n", versions[ii]);
+                continue;
+            }
+            jj = validate_transpose(versions[ii]);
+            printf("%s: %d mismatches\n", versions[ii], jj);
+            errors += jj;
+        }
+        transpose_select(NULL);
+
+        if (errors)
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
     for (jj = 1; jj < argc; ++jj)
     {
         if (!strcmp(argv[jj], "-truth"))
@@ -154,7 +262,10 @@ int main(int argc, char *argv[])
             {
                 printf(",%d", ii);
             }
-            benchmark_transpose("generic");
+            for (ii = 0; versions[ii]; ++ii)
+            {
+                benchmark_transpose(versions[ii]);
+            }
             benchmark_transpose(NULL);
             printf("\n");
         }